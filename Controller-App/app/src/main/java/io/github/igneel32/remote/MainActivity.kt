@@ -42,9 +42,24 @@ class MainActivity : AppCompatActivity() {
             DEFAULT_MATCHPLAY_WARN_TIME,
             DEFAULT_AUTO_TOGGLE_DETAIL,
             DEFAULT_MATCHPLAY_NUM_ENDS,
-            DEFAULT_PER_ARROW_TIME
+            DEFAULT_PER_ARROW_TIME,
+            DEFAULT_ERROR_CORRECTION,
+            DEFAULT_RECEIVER_RUNS_ROUND
         )
     }
+    private val clockSyncTask = object : Runnable {
+        override fun run() {
+            serialComms.syncClocks()
+            mainLooper.postDelayed(this, SerialCommunications.CLOCK_SYNC_INTERVAL_MILLIS)
+        }
+    }
+    private val stateRepeatTask = object : Runnable {
+        override fun run() {
+            serialComms.repeatState()
+            mainLooper.postDelayed(this, SerialCommunications.STATE_REPEAT_INTERVAL_MILLIS)
+        }
+    }
+
     var countDownTimer: CountDownTimer? = null
     var countDownNumber: Int = 0
 
@@ -91,6 +106,8 @@ class MainActivity : AppCompatActivity() {
 
     override fun onPause() {
         super.onPause()
+        mainLooper.removeCallbacks(clockSyncTask)
+        mainLooper.removeCallbacks(stateRepeatTask)
         serialComms.disconnect()
         unregisterReceiver(broadcastReceiver)
     }
@@ -129,6 +146,10 @@ class MainActivity : AppCompatActivity() {
         }
 
         serialComms.connect(driver, connection)
+        mainLooper.removeCallbacks(clockSyncTask)
+        mainLooper.post(clockSyncTask)
+        mainLooper.removeCallbacks(stateRepeatTask)
+        mainLooper.postDelayed(stateRepeatTask, SerialCommunications.STATE_REPEAT_INTERVAL_MILLIS)
     }
 
     /**
@@ -141,6 +162,7 @@ class MainActivity : AppCompatActivity() {
                 storage.value = GSON.fromJson(it, Storage::class.java)
             }
         }
+        serialComms.errorCorrection = storage.value!!.errorCorrection
     }
 
     /**
@@ -154,11 +176,14 @@ class MainActivity : AppCompatActivity() {
         file.bufferedWriter().use {
             GSON.toJson(storage.value, it)
         }
+        serialComms.errorCorrection = storage.value!!.errorCorrection
     }
 
     /**
      * Set the internal state with the given values, and send the updated state.
      * If some/all values are not provided, defaults to a blank idle state.
+     * Scheduled states are acted on by every receiver at the same moment, a short while after sending.
+     * An emergency stop goes out as the stop signal first.
      */
     fun setAndSendState(countdownContinues: Boolean = false,
                         lastEnd: Boolean = false,
@@ -170,7 +195,11 @@ class MainActivity : AppCompatActivity() {
                         timeEnabled: Boolean = false,
                         time: Int = 0,
                         startNumBeeps: Int = 0,
-                        endNumBeeps: Int = 0) {
+                        endNumBeeps: Int = 0,
+                        scheduled: Boolean = false) {
+        if (emergencyStop && !serialState.emergencyStop) {
+            serialComms.sendEmergencyStop()
+        }
         serialState.countdownContinues = countdownContinues
         serialState.lastEnd = lastEnd
         serialState.emergencyStop = emergencyStop
@@ -182,7 +211,11 @@ class MainActivity : AppCompatActivity() {
         serialState.time = time
         serialState.startNumBeeps = startNumBeeps
         serialState.endNumBeeps = endNumBeeps
-        serialComms.sendState()
+        if (scheduled) {
+            serialComms.sendScheduledState()
+        } else {
+            serialComms.sendState()
+        }
     }
 
     companion object {
@@ -197,6 +230,8 @@ class MainActivity : AppCompatActivity() {
         const val DEFAULT_AUTO_TOGGLE_DETAIL = true
         const val DEFAULT_MATCHPLAY_NUM_ENDS = 3
         const val DEFAULT_PER_ARROW_TIME = 40
+        const val DEFAULT_ERROR_CORRECTION = false
+        const val DEFAULT_RECEIVER_RUNS_ROUND = false
     }
 }
 
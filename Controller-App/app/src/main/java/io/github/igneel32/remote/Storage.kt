@@ -7,5 +7,7 @@ data class Storage (
     var matchplayWarnTime: Int,
     var autoToggleDetail: Boolean,
     var matchplayNumEnds: Int,
-    var equipFailTime: Int
+    var equipFailTime: Int,
+    var errorCorrection: Boolean,
+    var receiverRunsRound: Boolean
 )
\ No newline at end of file
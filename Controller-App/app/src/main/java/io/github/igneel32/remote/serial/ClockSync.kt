@@ -0,0 +1,196 @@
+package io.github.igneel32.remote.serial
+
+import io.netty.buffer.ByteBuf
+
+/**
+ * The controller's side of the clock exchange with each receiver.
+ *
+ * A ping carries the controller's send time t1. The receiver answers with a pong giving when the ping arrived (t2)
+ * and when the pong left (t3), by its own clock, and the controller notes when the pong arrived (t4). From those:
+ * offset = ((t1 - t2) + (t4 - t3)) / 2, the controller's clock minus the receiver's, and
+ * round trip = (t4 - t1) - (t3 - t2), the time spent on the link.
+ *
+ * t4 goes back to the receiver in its next ping, so it keeps the same estimate (ControllerClock.h on the receiver).
+ * Both ends use the same filter: the newest exchange until drift is known, then the one with the shortest round
+ * trip out of the last few, carried forward by the drift.
+ */
+class ClockSync {
+    private val receivers = LinkedHashMap<Int, ReceiverClock>()
+    private var sequence = 0
+    private var nextReceiver = 0
+
+    /**
+     * The controller's estimate for each receiver found, by receiver id.
+     */
+    val estimates: Map<Int, ClockEstimate>
+        @Synchronized get() = receivers.filterValues { it.synced }.mapValues { it.value.estimate() }
+
+    /**
+     * What each receiver last reported of its own estimate, by receiver id.
+     */
+    val reports: Map<Int, ClockReport>
+        @Synchronized get() = receivers.filterValues { it.report != null }.mapValues { it.value.report!! }
+
+    /**
+     * Picks the next receiver to ping, in turn.
+     *
+     * @return The receiver's id, or null if none have been found yet
+     */
+    @Synchronized
+    fun nextReceiver(): Int? {
+        if (receivers.isEmpty()) return null
+        nextReceiver = (nextReceiver + 1) % receivers.size
+        return receivers.keys.elementAt(nextReceiver)
+    }
+
+    /**
+     * Writes a ping to the given receiver.
+     *
+     * @param buf The frame's data segment
+     * @param receiverId The receiver to ping
+     * @param sentAt SystemClock.elapsedRealtime() as the ping is sent
+     */
+    @Synchronized
+    fun writePing(buf: ByteBuf, receiverId: Int, sentAt: Long) {
+        val receiver = receivers.getOrPut(receiverId) { ReceiverClock() }
+        sequence = (sequence + 1) and 0xFF
+        buf.writeByte(FRAME_PING)
+        buf.writeShort(receiverId)
+        buf.writeByte(sequence)
+        buf.writeInt(sentAt.toInt())
+        buf.writeByte(receiver.lastSequence ?: sequence)
+        buf.writeInt(receiver.lastT4.toInt())
+    }
+
+    /**
+     * Takes in a frame from a receiver. Pongs complete an exchange, and clock reports record the receiver's own
+     * estimate (and let receivers be found in the first place).
+     *
+     * @param data The frame's data segment
+     * @param receivedAt SystemClock.elapsedRealtime() when its last byte was read
+     */
+    @Synchronized
+    fun onFrame(data: ByteBuf, receivedAt: Long) {
+        val t4 = receivedAt - wireMillis(data.readableBytes() + PACKET_OVERHEAD)
+        when (data.getUnsignedByte(data.readerIndex()).toInt()) {
+            FRAME_PONG -> {
+                if (data.readableBytes() < PONG_FRAME_SIZE) return
+                data.skipBytes(1)
+                val receiver = receivers.getOrPut(data.readUnsignedShort()) { ReceiverClock() }
+                receiver.lastSequence = data.readUnsignedByte().toInt()
+                receiver.lastT4 = t4
+                receiver.add(data.readUnsignedInt(), data.readUnsignedInt(), data.readUnsignedInt(), t4)
+            }
+            FRAME_CLOCK_REPORT -> {
+                if (data.readableBytes() < CLOCK_REPORT_FRAME_SIZE) return
+                data.skipBytes(1)
+                val receiver = receivers.getOrPut(data.readUnsignedShort()) { ReceiverClock() }
+                val offset = data.readInt()
+                val roundTrip = data.readUnsignedShort()
+                receiver.report = ClockReport(offset, if (roundTrip == 0xFFFF) null else roundTrip,
+                    data.readShort().toInt(), data.readUnsignedByte().toInt())
+            }
+        }
+    }
+
+    /**
+     * One receiver's exchanges with the controller.
+     */
+    private class ReceiverClock {
+        private val exchanges = ArrayDeque<Exchange>()
+        private var best: Exchange? = null
+        private var anchor: Exchange? = null
+        private var driftMeasured = false
+        private var driftPpm = 0.0
+
+        var lastSequence: Int? = null
+        var lastT4 = 0L
+        var report: ClockReport? = null
+
+        val synced: Boolean get() = best != null
+
+        fun add(t1: Long, t2: Long, t3: Long, t4: Long) {
+            val exchange = Exchange(
+                ((t1 - t2).toInt() + (t4 - t3).toInt()) / 2.0,
+                maxOf(0.0, (t4 - t1).toInt().toDouble() - (t3 - t2).toInt()),
+                t2
+            )
+            exchanges.addLast(exchange)
+            if (exchanges.size > EXCHANGES) exchanges.removeFirst()
+
+            val lowest = exchanges.minByOrNull { it.roundTripMillis }!!
+            best = if (driftMeasured) lowest else exchange
+
+            val current = anchor
+            val baseline = if (current == null) 0L else lowest.receiverMillis - current.receiverMillis
+            if (current == null || (!driftMeasured && baseline < DRIFT_BASELINE_MILLIS / 2
+                        && lowest.roundTripMillis < current.roundTripMillis)) {
+                anchor = lowest
+                return
+            }
+            if (baseline < DRIFT_BASELINE_MILLIS) return
+
+            val measured = (lowest.offsetMillis - current.offsetMillis) * 1e6 / baseline
+            driftPpm = if (driftMeasured) (3 * driftPpm + measured) / 4 else measured
+            driftMeasured = true
+            anchor = lowest
+            best = lowest
+        }
+
+        fun estimate(): ClockEstimate {
+            val exchange = best!!
+            return ClockEstimate(exchange.offsetMillis, exchange.receiverMillis, exchange.roundTripMillis, driftPpm)
+        }
+    }
+
+    private data class Exchange(val offsetMillis: Double, val roundTripMillis: Double, val receiverMillis: Long)
+
+    companion object {
+        // Kept the same as the receiver's ControllerClock.h
+        private const val EXCHANGES = 8
+        private const val DRIFT_BASELINE_MILLIS = 60000L
+
+        /**
+         * How long the given number of bytes take on the wire.
+         */
+        fun wireMillis(bytes: Int): Long = (bytes * 10000L + SERIAL_BAUD / 2) / SERIAL_BAUD
+    }
+}
+
+/**
+ * The controller's estimate of a receiver's clock.
+ *
+ * @property offsetMillis The controller's clock minus the receiver's, as of the receiver time below
+ * @property atReceiverMillis The receiver's time the offset was measured at
+ * @property roundTripMillis Time on the link both ways for the exchange the offset came from
+ * @property driftPpm How much faster the controller's clock runs than the receiver's
+ */
+data class ClockEstimate(
+    val offsetMillis: Double,
+    val atReceiverMillis: Long,
+    val roundTripMillis: Double,
+    val driftPpm: Double
+) {
+    /**
+     * The receiver's clock at the given controller time.
+     */
+    fun receiverMillis(controllerMillis: Long): Long {
+        val receiver = controllerMillis - offsetMillis
+        return (receiver - driftPpm * (receiver - atReceiverMillis) / 1e6).toLong()
+    }
+}
+
+/**
+ * A receiver's own estimate of the controller's clock, from a clock report.
+ *
+ * @property offsetMillis The controller's clock minus its own
+ * @property roundTripMillis Of the exchange the offset came from, or null if it only has clock frames to go by
+ * @property driftPpm How much faster it measures the controller's clock to run than its own
+ * @property exchanges How many exchanges it is holding
+ */
+data class ClockReport(
+    val offsetMillis: Int,
+    val roundTripMillis: Int?,
+    val driftPpm: Int,
+    val exchanges: Int
+)
@@ -0,0 +1,70 @@
+package io.github.igneel32.remote.serial
+
+import io.netty.buffer.ByteBuf
+
+/**
+ * Encodes frames as FEC packets, which a receiver can still read with a few bits flipped on the radio link.
+ * Must be kept the same as the receiver's Fec.h, which has the details of the format.
+ */
+object FecEncoder {
+    private val HEADER = byteArrayOf(0x5B, 0xEE.toByte(), 0x1B, 0x27)
+    const val MAX_DATA = 16
+
+    // Extended Hamming(8,4) codeword for each nibble
+    private val HAMMING = intArrayOf(
+        0x00, 0x87, 0x99, 0x1E, 0xAA, 0x2D, 0x33, 0xB4, 0x4B, 0xCC, 0xD2, 0x55, 0xE1, 0x66, 0x78, 0xFF
+    )
+
+    /**
+     * Encodes the frame as a full FEC packet.
+     *
+     * @param data The frame's data segment, at most MAX_DATA bytes
+     * @return The packet, ready to be written to the serial port
+     */
+    fun encode(data: ByteBuf): ByteArray {
+        val length = data.readableBytes()
+        require(length in 1..MAX_DATA) { "Frame too big for FEC." }
+        val frame = ByteArray(length)
+        data.readBytes(frame)
+
+        val codewords = IntArray(2 * (length + 1))
+        val crc = crc(frame)
+        for (i in 0..length) {
+            val b = if (i < length) frame[i].toInt() and 0xFF else crc
+            codewords[2 * i] = HAMMING[b and 0x0F]
+            codewords[2 * i + 1] = HAMMING[b shr 4]
+        }
+
+        // Bit b of codeword i goes out as bit b * count + i of the body, LSB first
+        val packet = ByteArray(HEADER.size + 2 + codewords.size)
+        HEADER.copyInto(packet)
+        packet[HEADER.size] = HAMMING[length and 0x0F].toByte()
+        packet[HEADER.size + 1] = HAMMING[length shr 4].toByte()
+        val body = HEADER.size + 2
+        var s = 0
+        for (bit in 0 until 8) {
+            for (codeword in codewords) {
+                if (codeword shr bit and 1 != 0) {
+                    packet[body + (s shr 3)] = (packet[body + (s shr 3)].toInt() or (1 shl (s and 7))).toByte()
+                }
+                s++
+            }
+        }
+        return packet
+    }
+
+    /**
+     * CRC-8, polynomial 0x07 and initial value 0xFF.
+     */
+    private fun crc(frame: ByteArray): Int {
+        var crc = 0xFF
+        for (b in frame) {
+            crc = crc xor (b.toInt() and 0xFF)
+            for (bit in 0 until 8) {
+                crc = if (crc and 0x80 != 0) (crc shl 1) xor 0x07 else crc shl 1
+            }
+            crc = crc and 0xFF
+        }
+        return crc
+    }
+}
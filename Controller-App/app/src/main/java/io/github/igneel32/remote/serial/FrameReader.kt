@@ -0,0 +1,69 @@
+package io.github.igneel32.remote.serial
+
+import io.netty.buffer.ByteBuf
+import io.netty.buffer.Unpooled
+
+/**
+ * Picks the frames a receiver sends back out from among its debug text. They are framed the same way as
+ * SerialCommunications.sendPacket() frames packets: header, total size, checksum, then the data. Flow control bytes
+ * go out between frames, so they are picked out wherever a frame could start. Only bytes that could yet turn out to be
+ * a header wait for more, so a flow control byte straight after debug text is acted on as soon as it arrives.
+ *
+ * @param onFlow Called with each flow control byte: true for FLOW_BUSY, false for FLOW_READY
+ * @param onFrame Called with each frame's data that passes its checksum, and when it was received
+ */
+class FrameReader(private val onFlow: (busy: Boolean) -> Unit,
+                  private val onFrame: (data: ByteBuf, receivedAt: Long) -> Unit) {
+    private val pending = Unpooled.buffer()
+
+    /**
+     * Takes in bytes read from the serial port.
+     *
+     * @param bytes The bytes read
+     * @param receivedAt SystemClock.elapsedRealtime() when they were read
+     */
+    fun feed(bytes: ByteArray, receivedAt: Long) {
+        pending.writeBytes(bytes)
+        while (pending.isReadable) {
+            val start = pending.readerIndex()
+            val first = pending.getUnsignedByte(start).toInt()
+            if (first == FLOW_BUSY || first == FLOW_READY) {
+                onFlow(first == FLOW_BUSY)
+                pending.skipBytes(1)
+                continue
+            }
+            val matched = headerMatched(start)
+            if (matched < SerialCommunications.HEADER.size && matched < pending.readableBytes()) {
+                pending.skipBytes(1)
+                continue
+            }
+            if (pending.readableBytes() < PACKET_OVERHEAD) break
+
+            val size = pending.getUnsignedByte(start + 4).toInt()
+            if (size < PACKET_OVERHEAD) {
+                pending.skipBytes(1)
+                continue
+            }
+            if (pending.readableBytes() < size) break
+
+            val data = pending.slice(start + PACKET_OVERHEAD,
+                size - PACKET_OVERHEAD)
+            if (SerialUtils.checksum(data) == pending.getShort(start + 5)) {
+                onFrame(data, receivedAt)
+                pending.readerIndex(start + size)
+            } else {
+                pending.skipBytes(1)
+            }
+        }
+        pending.discardReadBytes()
+    }
+
+    /**
+     * How many bytes of the header match from the given index, up to the end of what has been read.
+     */
+    private fun headerMatched(index: Int): Int {
+        val available = minOf(SerialCommunications.HEADER.size, pending.writerIndex() - index)
+        return (0 until available).firstOrNull { pending.getByte(index + it) != SerialCommunications.HEADER[it] }
+            ?: available
+    }
+}
@@ -0,0 +1,193 @@
+// Generated from Receiver/protocol/Frames.schema by Receiver/scripts/generate_protocol.py. Edit the schema,
+// not this file.
+package io.github.igneel32.remote.serial
+
+//region Constants
+const val SERIAL_BAUD = 9600
+const val PACKET_OVERHEAD = 7                    // Header, size and checksum
+const val ANY_RECEIVER = 0xFFFF                  // A receiver id that addresses every receiver
+const val BATCH_MAX_SIZE = 40                    // The largest batch frame taken
+/**
+ * The emergency stop signal: four bytes recognised wherever they turn up in what is received, even part-way through
+ * a frame, so a stop never waits for a frame to finish and pass its checksum. The controller sends ESTOP_SIGNAL_COPIES
+ * of it back to back, so a copy lost to noise is made up by the next, then a state with emergencyStop set.
+ * By chance, other frames carry the four bytes about once in 2^32.
+ */
+const val ESTOP_SIGNAL = 0x5E70A18F              // Seen anywhere in what is received: two bytes, then their complements
+const val ESTOP_SIGNAL_COPIES = 3                // Sent back to back, outside any packet
+const val FLOW_BUSY = 0x93                       // From a receiver: hold writes until FLOW_READY
+const val FLOW_READY = 0x91
+const val FLOW_HOLD_MAX_MS = 1000                // The longest the controller holds its writes for one FLOW_BUSY
+const val HANDOFF_COPIES = 3                     // Each handoff is sent this many times, in case the partner misses one
+//endregion
+
+//region State
+/**
+ * What the lights should show.
+ */
+const val STATE_FRAME_SIZE = 8
+const val STATE_FLAGS_OFFSET = 0
+const val STATE_TIME_OFFSET = 2
+const val STATE_START_NUM_BEEPS_OFFSET = 4
+const val STATE_END_NUM_BEEPS_OFFSET = 6
+const val STATE_TIME_ENABLED_MASK = 0x0001       // Show the time
+const val STATE_TIME_ENABLED_SHIFT = 0
+const val STATE_COLOUR_MASK = 0x0006             // 0 red, 1 amber, 2 green
+const val STATE_COLOUR_SHIFT = 1
+const val STATE_DETAIL_MASK = 0x0018             // 0 off, 1 A/B, 2 C/D
+const val STATE_DETAIL_SHIFT = 3
+const val STATE_COUNTDOWN_MASK = 0x0020          // Count the time down
+const val STATE_COUNTDOWN_SHIFT = 5
+const val STATE_MATCHPLAY_MASK = 0x0040          // Only for a receiver in matchplay mode, with detail as its side
+const val STATE_MATCHPLAY_SHIFT = 6
+const val STATE_EMERGENCY_STOP_MASK = 0x0080
+const val STATE_EMERGENCY_STOP_SHIFT = 7
+const val STATE_LAST_END_MASK = 0x0100           // The last end of a match
+const val STATE_LAST_END_SHIFT = 8
+const val STATE_COUNTDOWN_CONTINUES_MASK = 0x0200 // Another countdown follows this one
+const val STATE_COUNTDOWN_CONTINUES_SHIFT = 9
+//endregion
+
+//region Clock
+/**
+ * Sent just before scheduled frames.
+ */
+const val FRAME_CLOCK = 0x10
+const val CLOCK_FRAME_SIZE = 5
+const val CLOCK_CONTROLLER_MS_OFFSET = 1
+//endregion
+
+//region ScheduledState
+/**
+ * A state for every receiver to act on at the same moment.
+ */
+const val FRAME_SCHEDULED_STATE = 0x11
+const val SCHEDULED_STATE_FRAME_SIZE = 13
+const val SCHEDULED_STATE_AT_OFFSET = 1
+const val SCHEDULED_STATE_STATE_OFFSET = 5
+//endregion
+
+//region Ping
+const val FRAME_PING = 0x12
+const val PING_FRAME_SIZE = 13
+const val PING_RECEIVER_ID_OFFSET = 1
+const val PING_SEQUENCE_OFFSET = 3
+const val PING_T1_OFFSET = 4
+const val PING_LAST_SEQUENCE_OFFSET = 8
+const val PING_T4_OFFSET = 9
+//endregion
+
+//region Pong
+const val FRAME_PONG = 0x13
+const val PONG_FRAME_SIZE = 16
+const val PONG_RECEIVER_ID_OFFSET = 1
+const val PONG_SEQUENCE_OFFSET = 3
+const val PONG_T1_OFFSET = 4
+const val PONG_T2_OFFSET = 8
+const val PONG_T3_OFFSET = 12
+//endregion
+
+//region ClockQuery
+/**
+ * Asks for a clock report.
+ */
+const val FRAME_CLOCK_QUERY = 0x14
+const val CLOCK_QUERY_FRAME_SIZE = 3
+const val CLOCK_QUERY_RECEIVER_ID_OFFSET = 1
+//endregion
+
+//region ClockReport
+/**
+ * The receiver's estimate of the controller's clock.
+ */
+const val FRAME_CLOCK_REPORT = 0x15
+const val CLOCK_REPORT_FRAME_SIZE = 16
+const val CLOCK_REPORT_RECEIVER_ID_OFFSET = 1
+const val CLOCK_REPORT_OFFSET_OFFSET = 3
+const val CLOCK_REPORT_ROUND_TRIP_OFFSET = 7
+const val CLOCK_REPORT_DRIFT_PPM_OFFSET = 9
+const val CLOCK_REPORT_EXCHANGES_OFFSET = 11
+const val CLOCK_REPORT_MILLIS_OFFSET = 12
+//endregion
+
+//region Generation
+/**
+ * The controller repeats each generation; only the first copy is acted on.
+ */
+const val FRAME_GENERATION = 0x16
+const val GENERATION_FRAME_SIZE = 11
+const val GENERATION_GENERATION_OFFSET = 1
+const val GENERATION_FRAME_OFFSET = 3
+//endregion
+
+//region RoundSchedule
+/**
+ * A round for the receiver to run by itself, one end per start command.
+ */
+const val FRAME_ROUND_SCHEDULE = 0x17
+const val ROUND_SCHEDULE_FRAME_SIZE = 9
+const val ROUND_SCHEDULE_ENDS_OFFSET = 1
+const val ROUND_SCHEDULE_WALK_UP_OFFSET = 2
+const val ROUND_SCHEDULE_MAX_TIME_OFFSET = 3
+const val ROUND_SCHEDULE_WARN_TIME_OFFSET = 5
+const val ROUND_SCHEDULE_OPTIONS_OFFSET = 7
+const val ROUND_SCHEDULE_DETAILS_MASK = 0x0003   // 0 none shown, 1 A/B alone, 2 A/B and C/D in turn
+const val ROUND_SCHEDULE_DETAILS_SHIFT = 0
+const val ROUND_SCHEDULE_ROTATE_MASK = 0x0004    // Alternate which detail shoots first: A/B then C/D, C/D then A/B
+const val ROUND_SCHEDULE_ROTATE_SHIFT = 2
+const val ROUND_SCHEDULE_WALK_UP_BEEPS_MASK = 0x0038 // As each walk-up starts
+const val ROUND_SCHEDULE_WALK_UP_BEEPS_SHIFT = 3
+const val ROUND_SCHEDULE_SHOOT_BEEPS_MASK = 0x01C0 // As each detail starts shooting
+const val ROUND_SCHEDULE_SHOOT_BEEPS_SHIFT = 6
+const val ROUND_SCHEDULE_END_BEEPS_MASK = 0x0E00 // As the end finishes
+const val ROUND_SCHEDULE_END_BEEPS_SHIFT = 9
+//endregion
+
+//region RoundControl
+/**
+ * Runs the uploaded round.
+ */
+const val FRAME_ROUND_CONTROL = 0x18
+const val ROUND_CONTROL_FRAME_SIZE = 7
+const val ROUND_CONTROL_SEQUENCE_OFFSET = 1
+const val ROUND_CONTROL_COMMAND_OFFSET = 2
+const val ROUND_CONTROL_AT_OFFSET = 3
+const val ROUND_START = 1                        // Start the next end, or resume a paused one
+const val ROUND_PAUSE = 2
+const val ROUND_SKIP = 3                         // Skip to the next phase, e.g. once a detail has all shot
+const val ROUND_STOP = 4                         // Abandon the end, and go back to the start of the round
+//endregion
+
+//region Handoff
+/**
+ * Matchplay: hands the turn to the other side, from its partner or the controller.
+ */
+const val FRAME_HANDOFF = 0x19
+const val HANDOFF_FRAME_SIZE = 6
+const val HANDOFF_SIDE_OFFSET = 1
+const val HANDOFF_TURNS_LEFT_OFFSET = 2
+const val HANDOFF_TIME_OFFSET = 3
+const val HANDOFF_SEQUENCE_OFFSET = 5
+//endregion
+
+//region Batch
+/**
+ * Frames applied together, with one redraw after the last; at most 40 bytes in all.
+ */
+const val FRAME_BATCH = 0x1A
+const val BATCH_FRAME_SIZE = 2
+const val BATCH_COUNT_OFFSET = 1
+//endregion
+
+//region Calibrate
+/**
+ * Measures the receiver's clock against the controller's clock frames over minutes.
+ */
+const val FRAME_CALIBRATE = 0x1B
+const val CALIBRATE_FRAME_SIZE = 4
+const val CALIBRATE_RECEIVER_ID_OFFSET = 1
+const val CALIBRATE_COMMAND_OFFSET = 3
+const val CALIBRATE_START = 1
+const val CALIBRATE_FINISH = 2                   // Work out the correction, apply it and keep it in EEPROM
+const val CALIBRATE_CLEAR = 3
+//endregion
@@ -1,6 +1,7 @@
 package io.github.igneel32.remote.serial
 
 import android.hardware.usb.UsbDeviceConnection
+import android.os.SystemClock
 import android.util.Log
 import com.hoho.android.usbserial.driver.UsbSerialDriver
 import com.hoho.android.usbserial.driver.UsbSerialPort
@@ -14,7 +15,11 @@ import java.lang.Exception
 import java.nio.ByteOrder
 import java.util.*
 import java.util.concurrent.CompletableFuture
+import java.util.concurrent.Executors
+import java.util.concurrent.TimeUnit
+import java.util.concurrent.locks.ReentrantLock
 import java.util.function.Consumer
+import kotlin.concurrent.withLock
 import kotlin.experimental.and
 
 
@@ -26,6 +31,47 @@ import kotlin.experimental.and
 class SerialCommunications {
     private var usbSerialPort: UsbSerialPort? = null
     val serialState : SerialState = SerialState()
+    val clockSync = ClockSync()
+    private val frameReader = FrameReader({ busy -> onFlow(busy) }) { data, receivedAt ->
+        clockSync.onFrame(data, receivedAt)
+        onFrame(data)
+    }
+
+    // Everything but the emergency stop signal is written from here, once the receivers let it (see onFlow)
+    private val writer = Executors.newSingleThreadExecutor()
+    private val flowLock = ReentrantLock()
+    private val flowReady = flowLock.newCondition()
+    private var busySince = 0L      // When FLOW_BUSY was heard, 0 once FLOW_READY has been
+    private var clockSyncRound = 0
+    private var discoveryEnds = 0L  // Until every receiver asked to report in has had its slot
+
+    /**
+     * If state frames go out as FEC packets, for a radio link noisy enough to lose plain ones.
+     */
+    var errorCorrection = false
+
+    // Each new state gets the next generation. Starting at random keeps a restarted app's first state from being
+    // taken for a repeat of the last one it sent.
+    private var generation = Random().nextInt(0x10000)
+    private var lastState: ByteArray? = null
+
+    // The round last uploaded, repeated along with each command for it. Round commands are numbered from random for
+    // the same reason as generations.
+    private var roundSchedule: ByteArray? = null
+    private var roundUpload: ByteArray? = null      // The round's frame, until it goes out with the next command
+    private var roundSequence = Random().nextInt(0x100)
+
+    // The last matchplay turn given or heard of; a match starts from the one after it
+    private var handoffSequence = Random().nextInt(0x100)
+
+    // When the calibration under way finishes, or 0 if none is (see startCalibration)
+    private var calibrationEnds = 0L
+
+    /**
+     * Called from the read thread with each matchplay handoff heard: the side now shooting (1 for A/B, 2 for C/D),
+     * the turns still to come after it, and the seconds it has.
+     */
+    var onHandoff: ((side: Int, turnsLeft: Int, time: Int) -> Unit)? = null
 
     /** Uncomment to enable serial debugging messages **/
     var readThread: SerialInputOutputManager? = null
@@ -36,7 +82,7 @@ class SerialCommunications {
     fun connect(driver: UsbSerialDriver, connection: UsbDeviceConnection) {
         usbSerialPort = driver.ports[0] // Most devices have just one port (port 0)
         usbSerialPort!!.open(connection)
-        usbSerialPort!!.setParameters(BAUD_RATE, 8, UsbSerialPort.STOPBITS_1,
+        usbSerialPort!!.setParameters(SERIAL_BAUD, 8, UsbSerialPort.STOPBITS_1,
             UsbSerialPort.PARITY_NONE)
 
         /** Uncomment to enable serial debugging messages **/
@@ -44,7 +90,8 @@ class SerialCommunications {
             val buffer = StringBuffer()
 
             override fun onNewData(data: ByteArray?) {
-                for (it in data!!) {
+                frameReader.feed(data!!, SystemClock.elapsedRealtime())
+                for (it in data) {
                     if (it.toChar() == '\n') {
                         Log.i("Serial", buffer.toString())
                         buffer.setLength(0)
@@ -70,27 +117,329 @@ class SerialCommunications {
             usbSerialPort!!.close()
         } catch (ignored : Throwable) { }
         usbSerialPort = null
+        onFlow(false)
     }
 
+    /**
+     * Sends the state as a new generation, which repeatState() then repeats.
+     */
     fun sendState() {
-        sendPacket { buf ->
-            buf.writeShort(serialState.pack())
-            buf.writeShort(serialState.time)
-            buf.writeShort(serialState.startNumBeeps)
-            buf.writeShort(serialState.endNumBeeps)
+        val bytes = buildFrame(nextGeneration { buf -> writeState(buf) })
+        lastState = bytes
+        write { bytes }
+    }
+
+    /**
+     * Sends the emergency stop signal, which receivers act on as soon as it arrives, even part-way through a frame,
+     * rather than once a whole frame has passed its checksum. The state with emergencyStop set should follow, for
+     * any receiver that missed every copy. It goes out at once, even while the receivers hold the line off: a show()
+     * loses at most five bytes, so one of the copies gets through.
+     */
+    fun sendEmergencyStop() {
+        val signal = ByteArray(4 * ESTOP_SIGNAL_COPIES) { i -> (ESTOP_SIGNAL shr (24 - 8 * (i % 4))).toByte() }
+        usbSerialPort?.write(signal, 200)
+    }
+
+    /**
+     * Sends the state for every receiver to act on at the same moment, a short while from now.
+     * A clock frame goes first so each receiver knows when that moment is.
+     *
+     * @param leadMillis How far ahead of the moment to send, long enough for every receiver to hear it
+     */
+    fun sendScheduledState(leadMillis: Long = SCHEDULE_LEAD_MILLIS) {
+        val now = SystemClock.elapsedRealtime()
+        val frame = nextGeneration { buf ->
+            buf.writeByte(FRAME_SCHEDULED_STATE)
+            buf.writeInt((now + leadMillis).toInt())
+            writeState(buf)
+        }
+        lastState = buildFrame(frame)
+        sendWithClock(frame)
+    }
+
+    /**
+     * Uploads a round for the receivers to run themselves: each end then only needs sendRoundControl(ROUND_START),
+     * and the walk-up, shooting, warning and change of detail follow on the receivers' own clocks. A receiver that
+     * already has the same round ignores it, so it can be sent before every end. The upload goes out with the next
+     * sendRoundControl(), in the same batch where it fits.
+     *
+     * @param details   0 for no detail shown, 1 for A/B alone, 2 for A/B and C/D in turn
+     * @param rotate    If C/D shoots first in every other end
+     */
+    fun sendRoundSchedule(ends: Int, walkUp: Int, maxTime: Int, warnTime: Int, details: Int, rotate: Boolean,
+                          walkUpBeeps: Int, shootBeeps: Int, endBeeps: Int) {
+        val options = (details and 0x3) or
+                ((if (rotate) 1 else 0) shl 2) or
+                ((walkUpBeeps and 0x7) shl 3) or
+                ((shootBeeps and 0x7) shl 6) or
+                ((endBeeps and 0x7) shl 9)
+        val frame = frameBytes { buf ->
+            buf.writeByte(FRAME_ROUND_SCHEDULE)
+            buf.writeByte(ends)
+            buf.writeByte(walkUp)
+            buf.writeShort(maxTime)
+            buf.writeShort(warnTime)
+            buf.writeShort(options)
+        }
+        roundSchedule = buildFrame(frame)
+        roundUpload = frame
+    }
+
+    /**
+     * Sends a command for the uploaded round, for every receiver to act on at the same moment, a short while from
+     * now. repeatState() repeats it along with the round, and each receiver acts on it only once.
+     *
+     * @param command One of ROUND_START, ROUND_PAUSE, ROUND_SKIP or ROUND_STOP
+     */
+    fun sendRoundControl(command: Int, leadMillis: Long = SCHEDULE_LEAD_MILLIS) {
+        val now = SystemClock.elapsedRealtime()
+        roundSequence = (roundSequence + 1) and 0xFF
+        val frame = frameBytes { buf ->
+            buf.writeByte(FRAME_ROUND_CONTROL)
+            buf.writeByte(roundSequence)
+            buf.writeByte(command)
+            buf.writeInt((now + leadMillis).toInt())
+        }
+        lastState = (roundSchedule ?: ByteArray(0)) + buildFrame(frame)
+        sendWithClock(frame, roundUpload)
+        roundUpload = null
+    }
+
+    /**
+     * Starts a matchplay end with the given side's first turn. After that the receivers pass each turn straight to
+     * each other as it ends, and the controller only listens (see onHandoff). The handoff is sent a few times rather
+     * than repeated by repeatState(), as a copy arriving after the turn had been passed on would start it again.
+     *
+     * @param side      1 for A/B, 2 for C/D
+     * @param turnsLeft Turns to come after this one, both sides together
+     */
+    fun sendHandoff(side: Int, turnsLeft: Int, time: Int) {
+        handoffSequence = (handoffSequence + 1) and 0xFF
+        val bytes = buildFrame { buf ->
+            buf.writeByte(FRAME_HANDOFF)
+            buf.writeByte(side)
+            buf.writeByte(turnsLeft)
+            buf.writeShort(time)
+            buf.writeByte(handoffSequence)
+        }
+        lastState = null
+        repeat(HANDOFF_COPIES) { write { bytes } }
+    }
+
+    /**
+     * Has the receivers measure how fast their clocks run against this one. For CALIBRATION_MILLIS, syncClocks() adds
+     * a clock frame each time it is called, then tells the receivers to work out the correction and keep it. The start
+     * and finish are sent a few times, as a handoff is; a receiver ignores a start while it is calibrating, and a
+     * finish when it is not.
+     */
+    fun startCalibration() {
+        calibrationEnds = SystemClock.elapsedRealtime() + CALIBRATION_MILLIS
+        sendCalibrate(CALIBRATE_START)
+    }
+
+    /**
+     * Abandons any calibration under way, and has the receivers forget the correction they keep.
+     */
+    fun clearCalibration() {
+        calibrationEnds = 0L
+        sendCalibrate(CALIBRATE_CLEAR)
+    }
+
+    private fun sendCalibrate(command: Int) {
+        val bytes = buildFrame { buf ->
+            buf.writeByte(FRAME_CALIBRATE)
+            buf.writeShort(ANY_RECEIVER)
+            buf.writeByte(command)
+        }
+        repeat(HANDOFF_COPIES) { write { bytes } }
+    }
+
+    private fun onFrame(data: ByteBuf) {
+        val start = data.readerIndex()
+        if (data.getUnsignedByte(start).toInt() != FRAME_HANDOFF || data.readableBytes() < HANDOFF_FRAME_SIZE) return
+        handoffSequence = data.getUnsignedByte(start + 5).toInt()
+        onHandoff?.invoke(data.getUnsignedByte(start + 1).toInt(), data.getUnsignedByte(start + 2).toInt(),
+            data.getShort(start + 3).toInt())
+    }
+
+    /**
+     * Called from the read thread with each flow control byte heard. A receiver sends FLOW_BUSY before a show() that
+     * would leave it deaf for longer than its USART can cover, and FLOW_READY after it; writes wait in between, for at
+     * most FLOW_HOLD_MAX_MS in case FLOW_READY is lost. With several receivers on the line, the last byte heard
+     * counts.
+     */
+    private fun onFlow(busy: Boolean) {
+        flowLock.withLock {
+            busySince = if (busy) SystemClock.elapsedRealtime() else 0L
+            if (!busy) flowReady.signalAll()
+        }
+    }
+
+    private fun awaitReady() {
+        flowLock.withLock {
+            while (busySince != 0L) {
+                val left = busySince + FLOW_HOLD_MAX_MS - SystemClock.elapsedRealtime()
+                if (left <= 0) {
+                    busySince = 0L
+                    break
+                }
+                flowReady.await(left, TimeUnit.MILLISECONDS)
+            }
+        }
+    }
+
+    /**
+     * Writes bytes from the writer thread, once the receivers let it. They are only built then, so any time they carry
+     * is the time they go out.
+     */
+    private fun write(bytes: () -> ByteArray) {
+        writer.execute {
+            awaitReady()
+            try {
+                usbSerialPort?.write(bytes(), 200)
+            } catch (e: IOException) {
+                Log.w("Serial", "Write failed", e)
+            }
+        }
+    }
+
+    /**
+     * Sends the last state again, for any receiver that missed it. Receivers that already have it drop the repeat
+     * as soon as they see its generation, so this can be called several times a second. A repeat due while the
+     * receivers hold the line off is skipped, as the next one will do.
+     * Meant to be called every STATE_REPEAT_INTERVAL_MILLIS.
+     */
+    fun repeatState() {
+        if (flowLock.withLock { busySince != 0L }) return
+        lastState?.let { write { it } }
+    }
+
+    /**
+     * Takes the next step of keeping the receivers' clocks in sync: pings the receivers found so far in turn, and
+     * every so often asks every receiver for a clock report, which is how new ones are found. While calibrating, also
+     * sends a clock frame, timed as it is written.
+     * Meant to be called every CLOCK_SYNC_INTERVAL_MILLIS.
+     */
+    fun syncClocks() {
+        if (calibrationEnds != 0L && SystemClock.elapsedRealtime() >= calibrationEnds) {
+            calibrationEnds = 0L
+            sendCalibrate(CALIBRATE_FINISH)
+        } else if (calibrationEnds != 0L) {
+            sendPacket { buf ->
+                buf.writeByte(FRAME_CLOCK)
+                buf.writeInt(SystemClock.elapsedRealtime().toInt())
+            }
+        }
+
+        val receiverId = clockSync.nextReceiver()
+        if (receiverId == null || clockSyncRound++ % DISCOVERY_ROUNDS == 0) {
+            // Asking again sooner would only hold up the reports still to come; the receivers found are pinged in the
+            // meantime, which leaves the next query to those not yet found
+            val now = SystemClock.elapsedRealtime()
+            if (now < discoveryEnds) return
+            discoveryEnds = now + DISCOVERY_MILLIS
+            sendPacket { buf ->
+                buf.writeByte(FRAME_CLOCK_QUERY)
+                buf.writeShort(ANY_RECEIVER)
+            }
+            return
+        }
+        sendPacket { buf -> clockSync.writePing(buf, receiverId, SystemClock.elapsedRealtime()) }
+    }
+
+    private fun writeState(buf: ByteBuf) {
+        buf.writeShort(serialState.pack())
+        buf.writeShort(serialState.time)
+        buf.writeShort(serialState.startNumBeeps)
+        buf.writeShort(serialState.endNumBeeps)
+    }
+
+    /**
+     * Builds a frame carrying state as the next generation.
+     */
+    private fun nextGeneration(func: Consumer<ByteBuf>): ByteArray {
+        generation = (generation + 1) and 0xFFFF
+        return frameBytes { buf ->
+            buf.writeByte(FRAME_GENERATION)
+            buf.writeShort(generation)
+            func.accept(buf)
         }
     }
 
+    /**
+     * Sends a frame behind a clock frame, so each receiver knows when the time in it is, and behind another frame
+     * first if one is given. They go out as one batch where they fit in one, and as a packet each otherwise. The
+     * clock frame carries the time they are written, however long the receivers held them up.
+     */
+    private fun sendWithClock(frame: ByteArray, first: ByteArray? = null) {
+        write {
+            val clock = frameBytes { buf ->
+                buf.writeByte(FRAME_CLOCK)
+                buf.writeInt(SystemClock.elapsedRealtime().toInt())
+            }
+            batchBytes(listOfNotNull(first, clock, frame))
+                ?: (first?.let { buildFrame(it) } ?: ByteArray(0)) +
+                    buildPacket(Unpooled.wrappedBuffer(clock)) + buildFrame(frame)
+        }
+    }
+
+    /**
+     * Packages frames as one batch, which the receivers apply together with a single redraw, saving the header, size
+     * and checksum of every packet but one. Returns null if they would not fit in a batch, or with error correction
+     * on, as an FEC packet is too small to carry one.
+     */
+    private fun batchBytes(frames: List<ByteArray>): ByteArray? {
+        if (errorCorrection || BATCH_FRAME_SIZE + frames.sumOf { 1 + it.size } > BATCH_MAX_SIZE) return null
+        val dataSeg = Unpooled.buffer().order(ByteOrder.BIG_ENDIAN)
+        dataSeg.writeByte(FRAME_BATCH)
+        dataSeg.writeByte(frames.size)
+        for (frame in frames) {
+            dataSeg.writeByte(frame.size)
+            dataSeg.writeBytes(frame)
+        }
+        return buildPacket(dataSeg)
+    }
+
+    /**
+     * The bytes of a frame, as written by func.
+     */
+    private fun frameBytes(func: Consumer<ByteBuf>): ByteArray {
+        val dataSeg = Unpooled.buffer().order(ByteOrder.BIG_ENDIAN)
+        func.accept(dataSeg)
+        return ByteArray(dataSeg.readableBytes()).also { dataSeg.readBytes(it) }
+    }
+
+    /**
+     * Packages a frame the way state frames go out: as an FEC packet if error correction is turned on.
+     */
+    private fun buildFrame(func: Consumer<ByteBuf>): ByteArray {
+        val dataSeg = Unpooled.buffer().order(ByteOrder.BIG_ENDIAN)
+        func.accept(dataSeg)
+        return if (errorCorrection) FecEncoder.encode(dataSeg) else buildPacket(dataSeg)
+    }
+
+    private fun buildFrame(frame: ByteArray): ByteArray = buildFrame { buf -> buf.writeBytes(frame) }
+
     /**
      * Packages the given data into packet format and sends the packet.
-     * Relies on the init method being run already.
+     * Relies on the init method being run already. The data is written by func on the writer thread, as the packet
+     * goes out.
      *
      * @param func Byte buffer containing packet data
      */
     fun sendPacket(func: Consumer<ByteBuf>) {
-        // Build data segment
-        val dataSeg = Unpooled.buffer().order(ByteOrder.BIG_ENDIAN)
-        func.accept(dataSeg) // Fill in the rest of the bytes
+        write {
+            // Build data segment
+            val dataSeg = Unpooled.buffer().order(ByteOrder.BIG_ENDIAN)
+            func.accept(dataSeg) // Fill in the rest of the bytes
+            buildPacket(dataSeg)
+        }
+    }
+
+    /**
+     * Packages the given data segment into packet format.
+     */
+    private fun buildPacket(dataSeg: ByteBuf): ByteArray {
         // Packet must not exceed 256 bytes, including header segment
         require(dataSeg.readableBytes() + 4 + 2 + 1 <= 256) {
             "Packet too big."
@@ -105,15 +454,22 @@ class SerialCommunications {
         headerSeg.writeBytes(dataSeg) // Append data segment to final packet
         val bos = ByteArrayOutputStream()
         headerSeg.readBytes(bos, headerSeg.readableBytes())
-        val bytes = bos.toByteArray()
-        usbSerialPort!!.write(bytes, 200)
+        return bos.toByteArray()
     }
 
     companion object {
-        private val HEADER = byteArrayOf(
+        // Frame types, sizes and the other constants of the link are in Protocol.kt, generated from the receiver's
+        // protocol/Frames.schema
+        val HEADER = byteArrayOf(
             0xA4.toByte(), 0x11,
             0xE4.toByte(), 0xD8.toByte()
         )
-        private const val BAUD_RATE = 9600
+        private const val SCHEDULE_LEAD_MILLIS = 250L
+
+        const val CLOCK_SYNC_INTERVAL_MILLIS = 1000L
+        const val CALIBRATION_MILLIS = 300000L      // The longer, the less the link's jitter is left in the correction
+        const val STATE_REPEAT_INTERVAL_MILLIS = 250L
+        private const val DISCOVERY_ROUNDS = 30     // Look for new receivers every this many calls to syncClocks()
+        private const val DISCOVERY_MILLIS = 6000L  // The CLOCK_REPORT_SLOTS report slots, and the radio's delay
     }
 }
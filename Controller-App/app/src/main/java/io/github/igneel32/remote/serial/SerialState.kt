@@ -5,25 +5,8 @@ package io.github.igneel32.remote.serial
  */
 class SerialState {
 
-    // struct State {
-    //   bool countdown;    // If the unit should count down the seconds
-    //   byte detail;       // The detail being displayed (none, A/B, or C/D)
-    //   byte colour;       // The colour on the traffic light (red, amber, or green)
-    //   bool timeEnabled;  // If the time should be displayed on the panel
-    //   int time;          // The time to display
-    //   int numBeeps;      // Number of beeps to sound at the end of the countdown
-    //};
-
-    // X = Emergency Stop
-    // Y = Matchplay
-    // C = Countdown
-    // D = Detail
-    // c = Colour
-    // T = TimeEnabled
-    // XYCD DccT
-
-    // 00 = DETAIL_OFF, 01 = DETAIL_AB, 10 = DETAIL_CD
-    // 00 = RED, 01 = AMBER, 10 = GREEN
+    // The bits pack() sets, and the rest of the state frame, are laid out in Documentation/Protocol.txt, which is
+    // generated from the receiver's protocol/Frames.schema. Change the schema first, then this to match.
 
     var countdownContinues: Boolean = false
     var lastEnd: Boolean = false
@@ -23,6 +23,9 @@ class MatchplayFragment : Fragment() {
     private lateinit var matchplayViewModel: MatchplayViewModel
     private lateinit var storage: Storage
     private lateinit var resetOnSwapSwitch: SwitchCompat
+    private lateinit var leftText: TextView
+    private lateinit var rightText: TextView
+    private var shooting: SerialState.Detail? = null   // The side whose turn it is, as last heard
 
     override fun onCreateView(
         inflater: LayoutInflater,
@@ -36,10 +39,10 @@ class MatchplayFragment : Fragment() {
         storage = mainActivity.storage.value!!
         val root = inflater.inflate(R.layout.fragment_matchplay, container, false)
 
-        val leftText = root.findViewById<TextView>(R.id.left_seg_text)
+        leftText = root.findViewById(R.id.left_seg_text)
         leftText.text = storage.matchplayMaxTime.toString()
 
-        val rightText = root.findViewById<TextView>(R.id.right_seg_text)
+        rightText = root.findViewById(R.id.right_seg_text)
         rightText.text = storage.matchplayMaxTime.toString()
 
         val maxTimeLabel = root.findViewById<TextView>(R.id.max_time)
@@ -55,17 +58,48 @@ class MatchplayFragment : Fragment() {
 
         val startLeftBtn = root.findViewById<Button>(R.id.start_left)
         startLeftBtn.setOnClickListener {
-            runStartCountdowns(leftText, SerialState.Detail.AB)
+            startOrStop(leftText, SerialState.Detail.AB)
         }
 
         val startRightBtn = root.findViewById<Button>(R.id.start_right)
         startRightBtn.setOnClickListener {
-            runStartCountdowns(rightText, SerialState.Detail.CD)
+            startOrStop(rightText, SerialState.Detail.CD)
+        }
+
+        // The receivers pass the turns between themselves; the app follows along
+        serialComms.onHandoff = { side, _, time ->
+            val detail = SerialState.Detail.values().getOrNull(side)
+            if (detail != null && detail != SerialState.Detail.OFF) {
+                activity?.runOnUiThread { runTurn(detail, time) }
+            }
         }
 
         return root
     }
 
+    override fun onDestroyView() {
+        super.onDestroyView()
+        serialComms.onHandoff = null
+    }
+
+    /**
+     * Starts the end with the given side, or if it is that side's turn, stops the turn once its shooter has shot.
+     * The side's receiver hands the next turn to the other side as it stops.
+     */
+    private fun startOrStop(segText: TextView, detail: SerialState.Detail) {
+        if (shooting != detail) {
+            runStartCountdowns(segText, detail)
+            return
+        }
+        shooting = null
+        mainActivity.countDownTimer?.cancel()
+        mainActivity.countDownTimer = null
+        mainActivity.setAndSendState(
+            matchplay = true, detail = detail, colour = SerialState.Colour.RED, timeEnabled = true,
+            time = storage.matchplayMaxTime
+        )
+    }
+
     private fun runStartCountdowns(segText: TextView, detail: SerialState.Detail) {
         mainActivity.setAndSendState(
             matchplay = true, countdown = true, detail = detail, colour = SerialState.Colour.AMBER,
@@ -86,47 +120,39 @@ class MatchplayFragment : Fragment() {
             }
 
             override fun onFinish() {
-                mainActivity.setAndSendState(
-                    matchplay = true, countdown = true, detail = detail,
-                    colour = SerialState.Colour.GREEN, timeEnabled = true,
-                    time = storage.matchplayMaxTime, endNumBeeps = 3
-                )
-
-                segText.text = (storage.matchplayMaxTime).toString()
-                mainActivity.countDownNumber = storage.matchplayMaxTime
-                mainActivity.countDownTimer =
-                    object : CountDownTimer(storage.matchplayMaxTime * 1000L, 1000) {
-                        override fun onTick(millisUntilFinished: Long) {
-                            if (mainActivity.countDownNumber < 0) {
-                                // Emergency stop pressed
-                                mainActivity.countDownTimer?.cancel()
-                                mainActivity.countDownTimer = null
-                                return
-                            }
-
-                            segText.text = (--mainActivity.countDownNumber).toString()
-                        }
-
-                        override fun onFinish() {
-                            runCountdownLoop(segText, detail)
-                        }
-                    }
+                // Each side shoots matchplayNumEnds arrows, one a turn
+                serialComms.sendHandoff(detail.ordinal, storage.matchplayNumEnds * 2 - 1, storage.matchplayMaxTime)
+                runTurn(detail, storage.matchplayMaxTime)
             }
         }.start()
     }
 
-    private fun runCountdownLoop(segText: TextView, originalDetail: SerialState.Detail) {
-//        resetOnSwapSwitch.isChecked
-//        storage.matchplayNumEnds * 2 - 1
-
-//        val oppositeDetail =
-//            if (originalDetail == SerialState.Detail.AB) SerialState.Detail.CD else SerialState.Detail.AB
-        // TODO: This condition will always be true until the - is changed to be adaptive
-//        val detail = if ((storage.matchplayNumEnds * 2 - 1) % 2 == 1) oppositeDetail else originalDetail
-//        mainActivity.setAndSendState(
-//            matchplay = true, countdown = true, detail = detail,
-//            colour = SerialState.Colour.GREEN, timeEnabled = true,
-//            time = storage.matchplayMaxTime, endNumBeeps = 3
-//        )
+    /**
+     * Counts down a side's turn on screen. The receiver counts its own; this only shows the judge where it is.
+     */
+    private fun runTurn(detail: SerialState.Detail, time: Int) {
+        val segText = if (detail == SerialState.Detail.AB) leftText else rightText
+        shooting = detail
+        mainActivity.countDownTimer?.cancel()
+        segText.text = time.toString()
+        mainActivity.countDownNumber = time
+        mainActivity.countDownTimer =
+            object : CountDownTimer(time * 1000L, 1000) {
+                override fun onTick(millisUntilFinished: Long) {
+                    if (mainActivity.countDownNumber < 0) {
+                        // Emergency stop pressed
+                        mainActivity.countDownTimer?.cancel()
+                        mainActivity.countDownTimer = null
+                        shooting = null
+                        return
+                    }
+
+                    segText.text = (--mainActivity.countDownNumber).toString()
+                }
+
+                override fun onFinish() {
+                    if (shooting == detail) shooting = null
+                }
+            }.start()
     }
 }
@@ -4,6 +4,7 @@ import android.os.Bundle
 import android.view.LayoutInflater
 import android.view.View
 import android.view.ViewGroup
+import android.widget.Button
 import android.widget.EditText
 import android.widget.Toast
 import androidx.appcompat.widget.SwitchCompat
@@ -23,10 +24,12 @@ class SettingsFragment : Fragment() {
     private lateinit var tgtEndSecondsField : EditText
     private lateinit var tgtWarnTimeField : EditText
     private lateinit var tgtAutoDetailToggle : SwitchCompat
+    private lateinit var tgtReceiverRunsRoundToggle : SwitchCompat
     private lateinit var mtchEndSecondsField : EditText
     private lateinit var mtchWarnTimeField : EditText
     private lateinit var mtchNumEndsField : EditText
     private lateinit var equipFailSecondsPerField : EditText
+    private lateinit var errorCorrectionToggle : SwitchCompat
 
     override fun onCreateView(
         inflater: LayoutInflater,
@@ -45,13 +48,21 @@ class SettingsFragment : Fragment() {
             Toast.makeText(mainActivity, R.string.saved, Toast.LENGTH_SHORT).show()
         }
 
+        val calibrateBtn = root.findViewById<Button>(R.id.calibrate_clocks)
+        calibrateBtn.setOnClickListener {
+            mainActivity.serialComms.startCalibration()
+            Toast.makeText(mainActivity, R.string.calibrating, Toast.LENGTH_LONG).show()
+        }
+
         tgtEndSecondsField = root.findViewById(R.id.total_time_field)
         tgtWarnTimeField = root.findViewById(R.id.warning_time_field)
         tgtAutoDetailToggle = root.findViewById(R.id.auto_toggle_detail)
+        tgtReceiverRunsRoundToggle = root.findViewById(R.id.receiver_runs_round)
         mtchEndSecondsField = root.findViewById(R.id.matchplay_seconds_per_end_field)
         mtchWarnTimeField = root.findViewById(R.id.matchplay_warning_time_field)
         mtchNumEndsField = root.findViewById(R.id.num_times_swap)
         equipFailSecondsPerField = root.findViewById(R.id.equip_fail_seconds_field)
+        errorCorrectionToggle = root.findViewById(R.id.error_correction)
 
         fillFields()
 
@@ -62,20 +73,24 @@ class SettingsFragment : Fragment() {
         tgtEndSecondsField.setText(storage.targetMaxTime.toString())
         tgtWarnTimeField.setText(storage.targetWarnTime.toString())
         tgtAutoDetailToggle.isChecked = storage.autoToggleDetail
+        tgtReceiverRunsRoundToggle.isChecked = storage.receiverRunsRound
         mtchEndSecondsField.setText(storage.matchplayMaxTime.toString())
         mtchWarnTimeField.setText(storage.matchplayWarnTime.toString())
         mtchNumEndsField.setText(storage.matchplayNumEnds.toString())
         equipFailSecondsPerField.setText(storage.equipFailTime.toString())
+        errorCorrectionToggle.isChecked = storage.errorCorrection
     }
 
     private fun saveSettings() {
         storage.targetMaxTime = tgtEndSecondsField.text.toString().toInt()
         storage.targetWarnTime = tgtWarnTimeField.text.toString().toInt()
         storage.autoToggleDetail = tgtAutoDetailToggle.isChecked
+        storage.receiverRunsRound = tgtReceiverRunsRoundToggle.isChecked
         storage.matchplayMaxTime = mtchEndSecondsField.text.toString().toInt()
         storage.matchplayWarnTime = mtchWarnTimeField.text.toString().toInt()
         storage.matchplayNumEnds = mtchNumEndsField.text.toString().toInt()
         storage.equipFailTime = equipFailSecondsPerField.text.toString().toInt()
+        storage.errorCorrection = errorCorrectionToggle.isChecked
 
         mainActivity.saveStorage()
     }
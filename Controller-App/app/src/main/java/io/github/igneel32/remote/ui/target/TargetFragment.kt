@@ -16,6 +16,8 @@ import androidx.lifecycle.ViewModelProvider
 import io.github.igneel32.remote.MainActivity
 import io.github.igneel32.remote.R
 import io.github.igneel32.remote.Storage
+import io.github.igneel32.remote.serial.ROUND_SKIP
+import io.github.igneel32.remote.serial.ROUND_START
 import io.github.igneel32.remote.serial.SerialCommunications
 import io.github.igneel32.remote.serial.SerialState
 
@@ -52,6 +54,12 @@ class TargetFragment : Fragment() {
 
         val startBtn = root.findViewById<Button>(R.id.start_button)
         startBtn.setOnClickListener {
+            if (storage.receiverRunsRound) {
+                startRoundEnd(checkedRadioBtn)
+                runCountdown(segText, sendPhases = false)
+                return@setOnClickListener
+            }
+
             mainActivity.serialState.countdownContinues = true
             mainActivity.serialState.emergencyStop = false
             mainActivity.serialState.matchplay = false
@@ -68,7 +76,7 @@ class TargetFragment : Fragment() {
             mainActivity.serialState.time = 10
             mainActivity.serialState.startNumBeeps = 2
             mainActivity.serialState.endNumBeeps = 1
-            mainActivity.serialComms.sendState()
+            mainActivity.serialComms.sendScheduledState()
 
             runCountdown(segText)
         }
@@ -76,10 +84,16 @@ class TargetFragment : Fragment() {
         val scoreBtn = root.findViewById<Button>(R.id.score_button)
         scoreBtn.setOnClickListener {
             mainActivity.countDownTimer?.cancel()
+            if (storage.receiverRunsRound) {
+                // Everyone on the line has shot, so the receivers move on to the next detail or finish the end
+                serialComms.sendRoundControl(ROUND_SKIP)
+                return@setOnClickListener
+            }
             mainActivity.setAndSendState(
                 timeEnabled = true,
                 time = storage.targetMaxTime,
-                endNumBeeps = 3
+                endNumBeeps = 3,
+                scheduled = true
             )
         }
 
@@ -110,7 +124,31 @@ class TargetFragment : Fragment() {
         return root
     }
 
-    private fun runCountdown(segText: TextView) {
+    /**
+     * Uploads the round from the settings, which the receivers ignore if they already have it, and starts the next
+     * end. The receivers then run the end themselves.
+     */
+    private fun startRoundEnd(checkedRadioBtn: Int) {
+        val details = when {
+            checkedRadioBtn == R.id.radio_none -> 0
+            storage.autoToggleDetail -> 2
+            else -> 1
+        }
+        serialComms.sendRoundSchedule(
+            ends = ROUND_ENDS, walkUp = WALK_UP_SECONDS,
+            maxTime = storage.targetMaxTime, warnTime = storage.targetWarnTime,
+            details = details, rotate = storage.autoToggleDetail,
+            walkUpBeeps = 2, shootBeeps = 1, endBeeps = 3
+        )
+        serialComms.sendRoundControl(ROUND_START)
+    }
+
+    /**
+     * Counts the walk-up and the end down on screen.
+     *
+     * @param sendPhases If the green is sent when the walk-up finishes, rather than left to receivers running the end
+     */
+    private fun runCountdown(segText: TextView, sendPhases: Boolean = true) {
         // Begin initial 10 second countdown where archers go to the shooting line
         mainActivity.countDownNumber = 10
         mainActivity.countDownTimer = object : CountDownTimer(10000, 1000) {
@@ -127,11 +165,14 @@ class TargetFragment : Fragment() {
 
             override fun onFinish() {
                 // Begin full countdown for shooting
-                mainActivity.setAndSendState(
-                    countdown = true, detail = mainActivity.serialState.detail,
-                    colour = SerialState.Colour.GREEN, timeEnabled = true,
-                    time = storage.targetMaxTime, endNumBeeps = 3
-                )
+                if (sendPhases) {
+                    mainActivity.setAndSendState(
+                        countdown = true, detail = mainActivity.serialState.detail,
+                        colour = SerialState.Colour.GREEN, timeEnabled = true,
+                        time = storage.targetMaxTime, endNumBeeps = 3,
+                        scheduled = true
+                    )
+                }
 
                 segText.text = storage.targetMaxTime.toString()
                 mainActivity.countDownNumber = storage.targetMaxTime
@@ -165,7 +206,8 @@ class TargetFragment : Fragment() {
             colour = SerialState.Colour.AMBER,
             timeEnabled = true, time = 10,
             startNumBeeps = 2,
-            endNumBeeps = 1
+            endNumBeeps = 1,
+            scheduled = true
         )
         mainActivity.countDownTimer = object : CountDownTimer(10000, 1000) {
             override fun onTick(millisUntilFinished: Long) {
@@ -185,7 +227,8 @@ class TargetFragment : Fragment() {
                     countdown = true,
                     colour = SerialState.Colour.GREEN,
                     timeEnabled = true, time = maxTime,
-                    endNumBeeps = 3
+                    endNumBeeps = 3,
+                    scheduled = true
                 )
 
                 segText.text = maxTime.toString()
@@ -208,4 +251,10 @@ class TargetFragment : Fragment() {
             }
         }.start()
     }
-}
\ No newline at end of file
+
+    companion object {
+        // The range starts every end, so the round is left long enough never to run out
+        private const val ROUND_ENDS = 255
+        private const val WALK_UP_SECONDS = 10
+    }
+}
@@ -0,0 +1,415 @@
+/*
+ * Runs the real env:uno firmware under simavr, cycle for cycle, to measure what the native simulator can only
+ * estimate: 64-bit shifts in displayDigit(), String allocation in the debug output, and FastLED bit-banging the
+ * WS2812 frames with interrupts off.
+ *
+ * Serial bytes go in on a schedule at the wire rate, the LED data pin (LED_PIN 10, PB2) is decoded back into
+ * frames, and the firmware's bench markers (include/Bench.h) give the exact cycles spent in handlePacket(),
+ * drawing the number, and showing the LEDs. Build the firmware with the uno-bench environment so the markers are in:
+ *
+ *     pio run -e uno-bench -t bench
+ *
+ * or by hand, with simavr and libelf installed:
+ *
+ *     cc -O2 -o avr_bench bench/AvrBench.c `pkg-config --cflags --libs simavr` -lelf
+ *     ./avr_bench .pio/build/uno-bench/firmware.elf [options]
+ */
+
+#include <sim_avr.h>
+#include <sim_elf.h>
+#include <sim_io.h>
+#include <avr_adc.h>
+#include <avr_ioport.h>
+#include <avr_uart.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define F_CPU 16000000UL
+#define BAUD 9600
+#define CYCLES_PER_BYTE (F_CPU * 10 / BAUD)     /* Start, 8 data and stop bits */
+#define CYCLES_PER_MS (F_CPU / 1000)
+
+#define NUM_LEDS 251                            /* Must match Receiver.cpp */
+#define FRAME_BYTES (NUM_LEDS * 3)
+
+/* GPIOR0, as a data space address. Markers are the same as include/Bench.h */
+#define BENCH_REGISTER 0x3E
+#define BENCH_HANDLE_PACKET 0x01
+#define BENCH_RENDER 0x02
+#define BENCH_SHOW 0x03
+#define BENCH_RX_ISR 0x04
+#define BENCH_BYTE_READ 0x40
+#define BENCH_END 0x80
+
+/* Bytes the USART can hold while interrupts are off: two in its FIFO and one in the shift register */
+#define USART_DEPTH 3
+/* A WS2812 bit with its data line high for longer than this is a 1 */
+#define WS2812_ONE_NS 550
+/* How long to keep running after the last byte, so the last packet's debug output can finish */
+#define TAIL_MS 2000
+#define MAX_BYTES 65536
+
+#define CYCLES_TO_US(c) ((double) (c) * 1e6 / F_CPU)
+#define CYCLES_TO_NS(c) ((double) (c) * 1e9 / F_CPU)
+
+typedef struct {
+    const char *name;
+    uint8_t id;
+    int open;
+    avr_cycle_count_t start;
+    long count;
+    avr_cycle_count_t min, max, total;
+} span_t;
+
+static span_t spans[] = {
+    {"handlePacket()", BENCH_HANDLE_PACKET},
+    {"render (number)", BENCH_RENDER},
+    {"show()", BENCH_SHOW},
+    {"RX interrupt", BENCH_RX_ISR},
+};
+#define SPAN_COUNT (sizeof(spans) / sizeof(spans[0]))
+
+/* A byte to send and the cycle it finishes arriving on */
+typedef struct {
+    avr_cycle_count_t at;
+    uint8_t value;
+} scheduled_byte_t;
+
+static scheduled_byte_t schedule[MAX_BYTES];
+static int scheduled;
+
+static avr_t *avr;
+static long bytesRead;
+static long bytesInjected;
+static long bytesOverrun;
+static int usartHeld;                           /* Bytes that arrived since interrupts were last on */
+static long debugBytes;
+static int echo;
+
+/* WS2812 decoding */
+static int pinLevel;
+static avr_cycle_count_t riseAt, fallAt;
+static uint8_t frame[FRAME_BYTES];
+static long frameBits;
+static long framesDecoded;
+static long framesShort;
+static long litLeds;
+static avr_cycle_count_t highMin[2] = {~0ULL, ~0ULL}, highMax[2];
+static avr_cycle_count_t periodMin = ~0ULL, periodMax;
+static FILE *framesOut;
+
+static span_t *findSpan(uint8_t id) {
+    for (unsigned i = 0; i < SPAN_COUNT; ++i) {
+        if (spans[i].id == id) return &spans[i];
+    }
+    return NULL;
+}
+
+static void finishFrame(void) {
+    if (frameBits == 0) return;
+    if (frameBits != FRAME_BYTES * 8L) {
+        framesShort++;
+    } else {
+        framesDecoded++;
+        litLeds = 0;
+        for (int i = 0; i < FRAME_BYTES; i += 3) {
+            if (frame[i] || frame[i + 1] || frame[i + 2]) litLeds++;
+        }
+        if (framesOut) {
+            fprintf(framesOut, "%.3f", avr->cycle / (double) CYCLES_PER_MS);
+            for (int i = 0; i < FRAME_BYTES; ++i) {
+                fprintf(framesOut, i % 3 ? "%02X" : " %02X", frame[i]);
+            }
+            fputc('\n', framesOut);
+        }
+    }
+    frameBits = 0;
+    memset(frame, 0, sizeof(frame));
+}
+
+static void onBenchMarker(struct avr_t *avr, avr_io_addr_t addr, uint8_t v, void *param) {
+    (void) addr;
+    (void) param;
+    if (v == BENCH_BYTE_READ) {
+        bytesRead++;
+        return;
+    }
+    span_t *span = findSpan(v & ~BENCH_END);
+    if (!span) return;
+    if (!(v & BENCH_END)) {
+        span->open = 1;
+        span->start = avr->cycle;
+        return;
+    }
+    if (!span->open) return;
+    const avr_cycle_count_t cycles = avr->cycle - span->start;
+    span->open = 0;
+    span->count++;
+    span->total += cycles;
+    if (cycles < span->min || span->count == 1) span->min = cycles;
+    if (cycles > span->max) span->max = cycles;
+    if (span->id == BENCH_SHOW) finishFrame();
+}
+
+/*
+ * WS2812 bits are a rising edge every 1.25 us, with the line held high for longer for a 1 than a 0. GRB order,
+ * most significant bit first.
+ */
+static void onLedPin(struct avr_irq_t *irq, uint32_t value, void *param) {
+    (void) irq;
+    (void) param;
+    value = value ? 1 : 0;
+    if ((int) value == pinLevel) return;
+    pinLevel = value;
+    if (value) {
+        if (riseAt && fallAt > riseAt) {
+            const avr_cycle_count_t period = avr->cycle - riseAt;
+            /* Anything much longer is the latch gap between frames, not a bit */
+            if (period < CYCLES_PER_MS / 20) {
+                if (period < periodMin) periodMin = period;
+                if (period > periodMax) periodMax = period;
+            } else {
+                finishFrame();
+            }
+        }
+        riseAt = avr->cycle;
+        return;
+    }
+
+    fallAt = avr->cycle;
+    const avr_cycle_count_t high = fallAt - riseAt;
+    const int bit = CYCLES_TO_NS(high) > WS2812_ONE_NS;
+    if (high < highMin[bit]) highMin[bit] = high;
+    if (high > highMax[bit]) highMax[bit] = high;
+    if (frameBits < FRAME_BYTES * 8L) {
+        if (bit) frame[frameBits >> 3] |= 0x80 >> (frameBits & 7);
+    }
+    frameBits++;
+}
+
+static void onUartOutput(struct avr_irq_t *irq, uint32_t value, void *param) {
+    (void) irq;
+    (void) param;
+    debugBytes++;
+    if (echo) fputc((int) value, stderr);
+}
+
+/*
+ * The id is picked from the noise on a floating A0 on first power-on, so give it some.
+ */
+static void onAdcTrigger(struct avr_irq_t *irq, uint32_t value, void *param) {
+    (void) irq;
+    (void) value;
+    avr_raise_irq((avr_irq_t *) param, 2000 + rand() % 16);
+}
+
+//region schedule
+
+static void scheduleBytes(avr_cycle_count_t at, const uint8_t *bytes, int length) {
+    /* Bytes queue behind any still going out */
+    if (scheduled && schedule[scheduled - 1].at > at) at = schedule[scheduled - 1].at;
+    for (int i = 0; i < length && scheduled < MAX_BYTES; ++i) {
+        at += CYCLES_PER_BYTE;
+        schedule[scheduled].at = at;
+        schedule[scheduled].value = bytes[i];
+        scheduled++;
+    }
+}
+
+/*
+ * A state packet showing the time, the layout in Documentation/Protocol.txt.
+ */
+static int encodeStatePacket(int16_t time, uint8_t *out) {
+    const uint16_t flags = 0x0001 | 2 << 1;     /* timeEnabled, green */
+    const uint8_t frameBytes[8] = {
+        (uint8_t) (flags >> 8), (uint8_t) flags, (uint8_t) (time >> 8), (uint8_t) time, 0, 0, 0, 0
+    };
+    unsigned int checksum = 0;
+    for (int i = 0; i < 8; ++i) {
+        checksum += frameBytes[i];
+    }
+    const uint8_t head[7] = {0xA4, 0x11, 0xE4, 0xD8, 15, (uint8_t) (checksum >> 8), (uint8_t) checksum};
+    memcpy(out, head, sizeof(head));
+    memcpy(out + sizeof(head), frameBytes, sizeof(frameBytes));
+    return 15;
+}
+
+/*
+ * A script is one send per line: the time in ms after reset, then the bytes in hex, spaces between them optional.
+ * # starts a comment.
+ */
+static int loadScript(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+    char line[4096];
+    while (fgets(line, sizeof(line), f)) {
+        char *hash = strchr(line, '#');
+        if (hash) *hash = 0;
+        char *p = line;
+        const double ms = strtod(p, &p);
+        if (p == line) continue;
+        uint8_t bytes[sizeof(line) / 2];
+        int length = 0;
+        for (char *word = strtok(p, " \t\r\n"); word; word = strtok(NULL, " \t\r\n")) {
+            for (; word[0] && word[1]; word += 2) {
+                const char pair[3] = {word[0], word[1], 0};
+                bytes[length++] = (uint8_t) strtoul(pair, NULL, 16);
+            }
+        }
+        scheduleBytes((avr_cycle_count_t) (ms * CYCLES_PER_MS), bytes, length);
+    }
+    fclose(f);
+    return 1;
+}
+
+//endregion
+
+static void report(avr_cycle_count_t lastCycle) {
+    printf("%.1f s of firmware time, %.0f M cycles\n\n", lastCycle / (double) F_CPU, lastCycle / 1e6);
+    printf("%-18s %7s %10s %10s %10s %10s\n", "", "calls", "min", "mean", "max", "max us");
+    for (unsigned i = 0; i < SPAN_COUNT; ++i) {
+        const span_t *s = &spans[i];
+        if (s->count == 0) {
+            printf("%-18s %7d\n", s->name, 0);
+            continue;
+        }
+        printf("%-18s %7ld %10llu %10.0f %10llu %10.1f\n", s->name, s->count, (unsigned long long) s->min,
+               (double) s->total / s->count, (unsigned long long) s->max, CYCLES_TO_US(s->max));
+    }
+    printf("(cycles between markers, each marker is one out instruction)\n\n");
+
+    const long ringDropped = bytesInjected - bytesRead;
+    printf("serial: %d bytes sent, %ld read by the firmware, %ld dropped (%ld overrun in the USART, %ld by the RX "
+           "ring)\n", scheduled, bytesRead, bytesOverrun + ringDropped, bytesOverrun, ringDropped);
+    printf("debug output: %ld bytes\n\n", debugBytes);
+
+    printf("LED frames: %ld decoded, %ld incomplete, %ld LEDs lit in the last\n", framesDecoded, framesShort,
+           litLeds);
+    if (highMax[0] || highMax[1]) {
+        printf("  0 high %.0f-%.0f ns, 1 high %.0f-%.0f ns, bit period %.0f-%.0f ns\n",
+               CYCLES_TO_NS(highMin[0]), CYCLES_TO_NS(highMax[0]), CYCLES_TO_NS(highMin[1]),
+               CYCLES_TO_NS(highMax[1]), CYCLES_TO_NS(periodMin), CYCLES_TO_NS(periodMax));
+    }
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: avr_bench <firmware.elf> [options]\n"
+            "  --updates N    State updates to send, counting the time down (default 50)\n"
+            "  --spacing MS   Time between updates (default 500)\n"
+            "  --start MS     When the first update goes out, after reset (default 1000)\n"
+            "  --script FILE  Send these bytes instead: one line per send, ms after reset then hex bytes\n"
+            "  --frames FILE  Write every decoded LED frame: ms, then then one GGRRBB hex word per LED, as sent\n"
+            "  --echo         Copy the firmware's serial output to stderr\n");
+}
+
+int main(int argc, char **argv) {
+    int updates = 50;
+    double spacingMs = 500;
+    double startMs = 1000;
+    const char *script = NULL;
+    const char *framesPath = NULL;
+
+    if (argc < 2) {
+        usage();
+        return 2;
+    }
+    for (int i = 2; i < argc; ++i) {
+        if (!strcmp(argv[i], "--echo")) {
+            echo = 1;
+        } else if (i + 1 >= argc) {
+            usage();
+            return 2;
+        } else if (!strcmp(argv[i], "--updates")) {
+            updates = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--spacing")) {
+            spacingMs = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--start")) {
+            startMs = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--script")) {
+            script = argv[++i];
+        } else if (!strcmp(argv[i], "--frames")) {
+            framesPath = argv[++i];
+        } else {
+            usage();
+            return 2;
+        }
+    }
+
+    elf_firmware_t firmware;
+    memset(&firmware, 0, sizeof(firmware));
+    if (elf_read_firmware(argv[1], &firmware) != 0) {
+        fprintf(stderr, "%s: could not read firmware\n", argv[1]);
+        return 1;
+    }
+    /* Arduino ELFs carry no .mmcu section */
+    strcpy(firmware.mmcu, "atmega328p");
+    firmware.frequency = F_CPU;
+    avr = avr_make_mcu_by_name(firmware.mmcu);
+    if (!avr) return 1;
+    avr_init(avr);
+    avr_load_firmware(avr, &firmware);
+
+    avr_register_io_write(avr, BENCH_REGISTER, onBenchMarker, NULL);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), 2), onLedPin, NULL);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT), onUartOutput, NULL);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_OUT_TRIGGER), onAdcTrigger,
+                            avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_ADC0));
+    uint32_t flags = 0;
+    avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+    flags &= ~AVR_UART_FLAG_STDIO;
+    avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+    avr_irq_t *uartInput = avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_INPUT);
+
+    if (script) {
+        if (!loadScript(script)) return 1;
+    } else {
+        for (int i = 0; i < updates; ++i) {
+            uint8_t packet[15];
+            const int length = encodeStatePacket((int16_t) (updates - i), packet);
+            scheduleBytes((avr_cycle_count_t) ((startMs + i * spacingMs) * CYCLES_PER_MS), packet, length);
+        }
+    }
+    if (framesPath && !(framesOut = fopen(framesPath, "w"))) {
+        perror(framesPath);
+        return 1;
+    }
+
+    const avr_cycle_count_t quiet = (scheduled ? schedule[scheduled - 1].at : 0) + TAIL_MS * CYCLES_PER_MS;
+    int next = 0;
+    for (;;) {
+        const int state = avr_run(avr);
+        if (state == cpu_Done || state == cpu_Crashed) {
+            fprintf(stderr, "firmware stopped at cycle %llu\n", (unsigned long long) avr->cycle);
+            break;
+        }
+
+        /*
+         * With interrupts on, the RX ISR empties the USART long before the next byte is in. With them off, as they
+         * are through show(), it fills up and every byte after that is lost.
+         */
+        if (avr->sreg[S_I]) usartHeld = 0;
+        while (next < scheduled && avr->cycle >= schedule[next].at) {
+            if (!avr->sreg[S_I] && ++usartHeld > USART_DEPTH) {
+                bytesOverrun++;
+            } else {
+                avr_raise_irq(uartInput, schedule[next].value);
+                bytesInjected++;
+            }
+            next++;
+        }
+
+        if (next == scheduled && avr->cycle >= quiet) break;
+    }
+
+    finishFrame();
+    if (framesOut) fclose(framesOut);
+    report(avr->cycle);
+    return 0;
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <Pixel.h>
+#include <NumericLEDs.h>
+#include <State.h>
+#include <TrafficLights.h>
+
+/**
+ * Animations drawn over the static display. Each running animation is a bit in a mask, and nothing is done while
+ * the mask is clear.
+ *
+ * Frames fall due every ANIMATION_FRAME_MS. A due frame waits while serial data is arriving, and if it is still
+ * waiting when the next one falls due it is dropped rather than run late. Animations work out what to draw from
+ * how long they have been running, so dropping frames never slows them down.
+ */
+
+const byte ANIMATION_LAMP_FADE = 0x01;       // The light that was on fades out once the red is lit
+const byte ANIMATION_FINAL_SECONDS = 0x02;   // The time flashes for the last FINAL_SECONDS of an end
+const byte ANIMATION_ESTOP = 0x04;           // The red light pulses while emergency stopped
+
+const unsigned long ANIMATION_FRAME_MS = 50;            // 20 frames a second
+const unsigned long ANIMATION_RENDER_BUDGET_US = 1000;  // Drawing a frame into leds[] should take less than this
+const unsigned long ANIMATION_QUIET_MS = 20;            // A frame's show() waits until the line has been idle this long
+
+const unsigned long LAMP_FADE_MS = 500;
+const int FINAL_SECONDS = 10;
+const unsigned long FLASH_ON_MS = 500;       // The time is shown for this long after each tick, then hidden
+const unsigned long ESTOP_PULSE_MS = 500;    // The red light alternates between full and dim this often
+const byte ESTOP_DIM_LEVEL = 48;
+
+/**
+ * Work out if an animation frame should be rendered now.
+ *
+ * @param now         The current time in ms.
+ * @param nextFrameMs When the next frame falls due. Moved on past the current frame, and any missed ones, when it
+ *                    is rendered.
+ * @param lineBusy    If serial data is arriving, in which case the frame waits.
+ * @return            If a frame should be rendered.
+ */
+inline bool animationFrameDue(unsigned long now, unsigned long &nextFrameMs, bool lineBusy) {
+    if ((long) (now - nextFrameMs) < 0 || lineBusy) return false;
+
+    nextFrameMs += ((now - nextFrameMs) / ANIMATION_FRAME_MS + 1) * ANIMATION_FRAME_MS;
+    return true;
+}
+
+/**
+ * Draw a light part-way through fading out.
+ *
+ * @param leds    Array of all CRGB LEDs.
+ * @param light   The light fading out (AMBER or GREEN).
+ * @param elapsed How long the fade has been running, in ms.
+ * @return        If any LEDs were changed.
+ */
+inline bool renderLampFade(CRGB leds[], byte light, unsigned long elapsed) {
+    const byte level = elapsed >= LAMP_FADE_MS ? 0 : 255 - elapsed * 255 / LAMP_FADE_MS;
+    if (lightAtLevel(leds, light, level)) return false;
+
+    displayLightLevel(leds, light, level);
+    return true;
+}
+
+/**
+ * Show or hide the time, flashing it once a second.
+ *
+ * @param leds      Array of all CRGB LEDs.
+ * @param time      The time to display.
+ * @param sinceTick How long since the countdown last ticked, in ms.
+ * @return          If any LEDs were changed.
+ */
+inline bool renderFlash(CRGB leds[], int time, unsigned long sinceTick) {
+    const bool on = sinceTick % 1000 < FLASH_ON_MS;
+    if (on == numberShown(leds)) return false;
+
+    if (on) {
+        displayNumber(leds, time);
+    } else {
+        clearNumber(leds);
+    }
+    return true;
+}
+
+/**
+ * Pulse the red light between full and dim.
+ *
+ * @param leds    Array of all CRGB LEDs.
+ * @param elapsed How long since the emergency stop, in ms.
+ * @return        If any LEDs were changed.
+ */
+inline bool renderEStop(CRGB leds[], unsigned long elapsed) {
+    const byte level = (elapsed / ESTOP_PULSE_MS) % 2 ? ESTOP_DIM_LEVEL : 255;
+    if (lightAtLevel(leds, RED, level)) return false;
+
+    displayLightLevel(leds, RED, level);
+    return true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <Arduino.h>
+
+/**
+ * Markers for the simavr benchmark (bench/AvrBench.c), which counts the cycles between them. A marker is a write to
+ * GPIOR0, a general purpose register nothing else uses, so it costs one instruction and changes nothing the firmware
+ * does. Only the uno-bench build defines AVR_BENCH. The native simulator's Arduino.h defines SIM_BENCH_MARKERS, and
+ * records each marker on its virtual clock instead; everywhere else the markers compile to nothing.
+ *
+ * The end of a span is its id with BENCH_END set. Keep the ids the same as in bench/AvrBench.c.
+ */
+const byte BENCH_HANDLE_PACKET = 0x01;
+const byte BENCH_RENDER = 0x02;        // Drawing the number into leds[]
+const byte BENCH_SHOW = 0x03;          // Showing the LEDs (include/LedOutput.h)
+const byte BENCH_RX_ISR = 0x04;        // The RX interrupt framing a byte (ISR_FRAMING)
+const byte BENCH_BYTE_READ = 0x40;     // A byte taken from Serial
+const byte BENCH_END = 0x80;
+
+#if defined(AVR_BENCH) || defined(SIM_BENCH_MARKERS)
+
+inline void benchMark(byte marker) {
+#ifdef AVR_BENCH
+    GPIOR0 = marker;
+#else
+    simBenchMark(marker);
+#endif
+}
+
+/**
+ * Marks a span as lasting until the end of the enclosing scope, whichever way it is left.
+ */
+struct BenchScope {
+    const byte id;
+
+    explicit BenchScope(byte id) : id(id) {
+        benchMark(id);
+    }
+
+    ~BenchScope() {
+        benchMark(id | BENCH_END);
+    }
+};
+
+#define BENCH_SCOPE(id) BenchScope benchScope(id)
+
+#else
+
+inline void benchMark(byte) {}
+
+#define BENCH_SCOPE(id)
+
+#endif
@@ -0,0 +1,20 @@
+#pragma once
+
+/**
+ * How the receiver is wired: the pins, and where each part of the display sits along the LEDs. The simulator's
+ * scenarios drive the same pins and read the same LEDs, so they include this rather than keeping copies.
+ */
+
+#define QUIET_PIN 7
+#define MATCHPLAY_PIN 8
+#define BRIGHTNESS_PIN 9
+#define LED_PIN 10           // The whole chain, or just the detail LEDs when the chains are split
+#define NUMBER_LED_PIN 5     // Split chains only
+#define LIGHTS_LED_PIN 6     // Split chains only
+#define SPLIT_CHAINS_PIN 4   // Jumpered to ground on a receiver wired as three chains
+#define BUZZER_PIN 11
+#define LOUD_PIN 12
+#define NUM_LEDS 251
+#define LIGHTS_FIRST_LED 161
+#define HIGH_BRIGHTNESS 192
+#define LOW_BRIGHTNESS 64
@@ -0,0 +1,185 @@
+#pragma once
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <ControllerClock.h>
+#include <Snapshot.h>
+
+/**
+ * Correcting the receiver's own timekeeping. The Uno's ceramic resonator can be off by 0.5%, over a second in a
+ * four minute end, which a countdown the receiver runs by itself shows against the controller's. Calibration measures
+ * how fast millis() runs against the controller's clock frames over several minutes, and the correction is kept in
+ * EEPROM. Countdowns, round phases and the buzzer then time their seconds with it.
+ *
+ * Times stay in millis() throughout; only the lengths of durations are corrected, in fixed point.
+ */
+
+const unsigned long CALIBRATION_WINDOW_MS = 10000;  // Of clock frames, of which the one held up least is used
+const unsigned long CALIBRATION_MIN_MS = 120000;    // From the first window to the last, for a correction to be kept
+
+/**
+ * How fast true time, as the controller keeps it, runs against millis().
+ */
+struct ClockTrim {
+    long ppm;                   // How much faster true time runs than millis()
+    long scale;                 // millis() per true ms, less 1, in Q24
+    long inverse;               // True ms per millis(), less 1, in Q24
+    unsigned long secondQ;      // millis() per true second, in Q16
+};
+
+/**
+ * The copy of the correction kept in EEPROM.
+ */
+struct StoredTrim {
+    int16_t ppm;
+    byte crc;
+};
+
+/**
+ * A clock frame, as the offset from millis() of the controller's clock.
+ */
+struct CalibrationPoint {
+    long offset;
+    unsigned long localMs;
+};
+
+/**
+ * A calibration under way. The clock frame held up least in each window (the one with the largest offset, as in
+ * addClockSample()) gives a point, and the correction is the slope from the first window's point to the last's.
+ */
+struct Calibration {
+    bool running;
+    byte windows;               // Completed, up to 2
+    bool windowOpen;
+    unsigned long windowStart;
+    CalibrationPoint window;    // The best so far of the window open
+    CalibrationPoint first;
+    CalibrationPoint last;
+};
+
+void setClockTrim(ClockTrim &trim, long ppm) {
+    trim.ppm = constrain(ppm, -MAX_DRIFT_PPM, MAX_DRIFT_PPM);
+    trim.scale = (long) (-((int64_t) trim.ppm << 24) / (1000000 + trim.ppm));
+    trim.inverse = (long) (((int64_t) trim.ppm << 24) / 1000000);
+    trim.secondQ = (1000UL << 16) + (1000 * trim.scale >> 8);
+}
+
+/**
+ * The millis() a duration of true time takes, rounded up so that a wake for its end is never early.
+ */
+unsigned long trimmedMs(const ClockTrim &trim, unsigned long ms) {
+    return ms + (long) (((int64_t) ms * trim.scale + 0xFFFFFF) >> 24);
+}
+
+/**
+ * The millis() whole seconds of true time take, exactly as a countdown's ticks add up to them.
+ */
+unsigned long trimmedSeconds(const ClockTrim &trim, unsigned long seconds) {
+    return (unsigned long) ((uint64_t) seconds * trim.secondQ >> 16);
+}
+
+/**
+ * The true time in a duration measured by millis().
+ */
+unsigned long trueMs(const ClockTrim &trim, unsigned long ms) {
+    return ms + (long) ((int64_t) ms * trim.inverse >> 24);
+}
+
+/**
+ * The millis() a countdown's next second takes. The part of a ms each second leaves over is carried to the next in
+ * fraction, by nextSecond().
+ */
+unsigned long secondLength(const ClockTrim &trim, uint16_t fraction) {
+    return (trim.secondQ + fraction) >> 16;
+}
+
+/**
+ * Move on to a countdown's next second.
+ *
+ * @return The millis() the second just finished took.
+ */
+unsigned long nextSecond(const ClockTrim &trim, uint16_t &fraction) {
+    const unsigned long length = secondLength(trim, fraction);
+    fraction = (trim.secondQ + fraction) & 0xFFFF;
+    return length;
+}
+
+/**
+ * Load the correction kept in EEPROM, or none if there is not a valid one.
+ */
+void loadClockTrim(ClockTrim &trim, int address) {
+    StoredTrim stored;
+    EEPROM.get(address, stored);
+    bool valid = stored.crc == crc8((const byte *) &stored.ppm, sizeof(stored.ppm));
+    setClockTrim(trim, valid ? stored.ppm : 0);
+}
+
+void storeClockTrim(const ClockTrim &trim, int address) {
+    StoredTrim stored;
+    stored.ppm = (int16_t) trim.ppm;
+    stored.crc = crc8((const byte *) &stored.ppm, sizeof(stored.ppm));
+    EEPROM.put(address, stored);
+}
+
+/**
+ * Start calibrating, unless already doing so.
+ */
+void startCalibration(Calibration &calibration) {
+    if (calibration.running) return;
+
+    calibration = Calibration();
+    calibration.running = true;
+}
+
+void closeCalibrationWindow(Calibration &calibration) {
+    if (!calibration.windowOpen) return;
+
+    if (calibration.windows == 0) {
+        calibration.first = calibration.window;
+        calibration.windows = 1;
+    } else {
+        calibration.last = calibration.window;
+        calibration.windows = 2;
+    }
+    calibration.windowOpen = false;
+}
+
+/**
+ * Take in a clock frame, if calibrating.
+ *
+ * @param controllerMs The time the controller sent.
+ * @param localMs      millis() when the frame was read.
+ */
+void addCalibrationSample(Calibration &calibration, unsigned long controllerMs, unsigned long localMs) {
+    if (!calibration.running) return;
+
+    if (calibration.windowOpen && localMs - calibration.windowStart >= CALIBRATION_WINDOW_MS) {
+        closeCalibrationWindow(calibration);
+    }
+    CalibrationPoint point;
+    point.offset = (long) (controllerMs + CLOCK_FRAME_WIRE_MS - localMs);
+    point.localMs = localMs;
+    if (!calibration.windowOpen) {
+        calibration.windowOpen = true;
+        calibration.windowStart = localMs;
+        calibration.window = point;
+    } else if (point.offset - calibration.window.offset > 0) {
+        calibration.window = point;
+    }
+}
+
+/**
+ * Stop calibrating, and work out the correction.
+ *
+ * @param ppm Set to how much faster true time runs than millis().
+ * @return    If the clock frames spanned CALIBRATION_MIN_MS, and the correction can be used.
+ */
+bool finishCalibration(Calibration &calibration, long &ppm) {
+    closeCalibrationWindow(calibration);
+    calibration.running = false;
+    const long baseline = (long) (calibration.last.localMs - calibration.first.localMs);
+    if (calibration.windows < 2 || baseline < (long) CALIBRATION_MIN_MS) return false;
+
+    ppm = (long) ((int64_t) (calibration.last.offset - calibration.first.offset) * 1000000 / baseline);
+    ppm = constrain(ppm, -MAX_DRIFT_PPM, MAX_DRIFT_PPM);
+    return true;
+}
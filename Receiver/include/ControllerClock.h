@@ -0,0 +1,167 @@
+#pragma once
+#include <Arduino.h>
+
+const byte CLOCK_SAMPLES = 4;
+const byte CLOCK_EXCHANGES = 4;                 // Ping exchanges kept for the round trip filter, 10 bytes of SRAM each
+const unsigned long DRIFT_BASELINE_MS = 60000;  // Drift is measured between exchanges at least this far apart
+const int MAX_DRIFT_PPM = 20000;
+// A clock frame is 12 bytes on the wire at 9600 baud, so the controller's clock has moved on this far by the time
+// the last byte arrives
+const unsigned long CLOCK_FRAME_WIRE_MS = 13;
+
+/**
+ * One completed ping exchange: the controller's send time t1, our receive and send times t2 and t3, and the
+ * controller's receive time t4 (sent back with its next ping).
+ */
+struct ClockExchange {
+    long offset;             // Controller time minus local time, ((t1 - t2) + (t4 - t3)) / 2
+    unsigned int roundTrip;  // Time on the link both ways, (t4 - t1) - (t3 - t2)
+    unsigned long localMs;   // t2
+};
+
+/**
+ * The receiver's idea of the controller's clock, kept as an offset from millis().
+ *
+ * Clock frames only give a lower bound on the offset, as they cannot see the link delay. Once ping exchanges have
+ * been completed, the offset comes from one of the last few, carried forward by the measured drift between the two
+ * clocks.
+ */
+struct ControllerClock {
+    long samples[CLOCK_SAMPLES];   // Controller time minus local time, from the latest clock frames
+    byte count;
+    byte next;
+    long offset;
+
+    ClockExchange exchanges[CLOCK_EXCHANGES];
+    byte exchangeCount;
+    byte nextExchange;
+    ClockExchange best;            // The exchange the offset is taken from
+    ClockExchange driftAnchor;     // Drift is measured from this exchange
+    bool driftMeasured;
+    long driftPpm;                 // How much faster the controller's clock runs than ours
+
+    // The exchange waiting for the controller to send back its t4
+    byte pendingSequence;
+    bool pending;
+    unsigned long pendingT1;
+    unsigned long pendingT2;
+    unsigned long pendingT3;
+};
+
+/**
+ * Take in a clock frame.
+ *
+ * A clock frame can be held up (by the radio, or by the loop being busy when it arrives) but never arrives early,
+ * so of the latest few samples, the one with the largest offset was held up least and is the one used.
+ *
+ * @param clock        The clock to update.
+ * @param controllerMs The time the controller sent.
+ * @param localMs      millis() when the frame was read.
+ */
+void addClockSample(ControllerClock &clock, unsigned long controllerMs, unsigned long localMs) {
+    clock.samples[clock.next] = (long) (controllerMs + CLOCK_FRAME_WIRE_MS - localMs);
+    clock.next = (clock.next + 1) % CLOCK_SAMPLES;
+    if (clock.count < CLOCK_SAMPLES) clock.count++;
+
+    clock.offset = clock.samples[0];
+    for (byte i = 1; i < clock.count; ++i) {
+        if (clock.samples[i] - clock.offset > 0) clock.offset = clock.samples[i];
+    }
+}
+
+/**
+ * The offset from an exchange, carried forward to the given local time by the measured drift.
+ */
+long driftedOffset(const ControllerClock &clock, const ClockExchange &exchange, unsigned long localMs) {
+    return exchange.offset + (long) ((int64_t) clock.driftPpm * (long) (localMs - exchange.localMs) / 1000000);
+}
+
+/**
+ * Measure the drift between exchanges with short round trips, far enough apart. Each new measurement is averaged in
+ * with a weight of 1/4.
+ *
+ * Until the drift is known, the newest exchange is used for the offset, as an older one could have drifted further
+ * than any hold-up on the link. After that, it is the one with the shortest round trip, carried forward.
+ *
+ * @param clock  The clock to update.
+ * @param latest The exchange just completed.
+ */
+void updateClockEstimate(ControllerClock &clock, const ClockExchange &latest) {
+    ClockExchange lowest = clock.exchanges[0];
+    for (byte i = 1; i < clock.exchangeCount; ++i) {
+        if (clock.exchanges[i].roundTrip < lowest.roundTrip) lowest = clock.exchanges[i];
+    }
+    clock.best = clock.driftMeasured ? lowest : latest;
+
+    // The first anchor can be swapped for a better one, as long as that does not hold up the first measurement
+    // for too long
+    const long baseline = (long) (lowest.localMs - clock.driftAnchor.localMs);
+    if (clock.exchangeCount == 1 || (!clock.driftMeasured && baseline < (long) DRIFT_BASELINE_MS / 2
+                                     && lowest.roundTrip < clock.driftAnchor.roundTrip)) {
+        clock.driftAnchor = lowest;
+        return;
+    }
+    if (baseline < (long) DRIFT_BASELINE_MS) return;
+
+    long measured = (long) ((int64_t) (lowest.offset - clock.driftAnchor.offset) * 1000000 / baseline);
+    measured = constrain(measured, -MAX_DRIFT_PPM, MAX_DRIFT_PPM);
+    clock.driftPpm = clock.driftMeasured ? (3 * clock.driftPpm + measured) / 4 : measured;
+    clock.driftMeasured = true;
+    clock.driftAnchor = lowest;
+    clock.best = lowest;
+}
+
+/**
+ * Take in a ping. Completes the previous exchange if the ping carries its t4, and starts a new one.
+ *
+ * @param clock        The clock to update.
+ * @param sequence     The ping's sequence number.
+ * @param t1           When the controller sent the ping, by its clock.
+ * @param t2           When the ping arrived, by ours.
+ * @param t3           When the pong will leave, by ours.
+ * @param lastSequence The sequence number of the last pong the controller heard.
+ * @param t4           When that pong arrived, by the controller's clock.
+ */
+void addPing(ControllerClock &clock, byte sequence, unsigned long t1, unsigned long t2, unsigned long t3,
+             byte lastSequence, unsigned long t4) {
+    if (clock.pending && lastSequence == clock.pendingSequence) {
+        ClockExchange exchange;
+        exchange.offset = ((long) (clock.pendingT1 - clock.pendingT2) + (long) (t4 - clock.pendingT3)) / 2;
+        long roundTrip = (long) (t4 - clock.pendingT1) - (long) (clock.pendingT3 - clock.pendingT2);
+        exchange.roundTrip = constrain(roundTrip, 0, 0xFFFF);
+        exchange.localMs = clock.pendingT2;
+
+        clock.exchanges[clock.nextExchange] = exchange;
+        clock.nextExchange = (clock.nextExchange + 1) % CLOCK_EXCHANGES;
+        if (clock.exchangeCount < CLOCK_EXCHANGES) clock.exchangeCount++;
+        updateClockEstimate(clock, exchange);
+    }
+
+    clock.pending = true;
+    clock.pendingSequence = sequence;
+    clock.pendingT1 = t1;
+    clock.pendingT2 = t2;
+    clock.pendingT3 = t3;
+}
+
+/**
+ * If a clock frame or a ping exchange has been heard since power-on.
+ */
+bool clockSet(const ControllerClock &clock) {
+    return clock.count > 0 || clock.exchangeCount > 0;
+}
+
+/**
+ * The controller's clock minus ours, in ms, at the given local time.
+ */
+long clockOffset(const ControllerClock &clock, unsigned long localMs) {
+    if (!clock.exchangeCount) return clock.offset;
+    return driftedOffset(clock, clock.best, localMs);
+}
+
+/**
+ * The controller's clock, in ms, at the given local time.
+ */
+unsigned long controllerMillis(const ControllerClock &clock, unsigned long localMs) {
+    return localMs + clockOffset(clock, localMs);
+}
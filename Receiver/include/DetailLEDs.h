@@ -1,5 +1,6 @@
 #pragma once
-#include "FastLED.h"
+#include <Pixel.h>
+#include <Palette.h>
 
 /**
  * Binary definitions for the colouration of 7-seg characters (4 LEDs per seg).
@@ -20,7 +21,7 @@ const uint32_t D =   0b00001111111111111111111100001111;
  */
 void displayDetail(CRGB leds[], const uint32_t letter, uint32_t offset) {
     for (int i = 0; i < 28; ++i) {
-        leds[i + offset] = (letter >> i) & 1 ? 0xFFFF00 : 0x000000;
+        leds[i + offset] = (letter >> i) & 1 ? palette->colours[PALETTE_YELLOW] : CRGB(0x000000);
     }
 }
 
@@ -0,0 +1,189 @@
+#pragma once
+#include <Arduino.h>
+
+/**
+ * Forward error correction for frames sent over a noisy radio link, so a flipped bit no longer loses the update.
+ *
+ * An FEC packet is FEC_HEADER, then the length of the frame as two codewords, then the frame and a CRC-8 of it as
+ * codewords interleaved bit by bit. Each codeword carries one nibble in extended Hamming(8,4), which corrects any
+ * one flipped bit and detects any two. The interleaving puts neighbouring bits on the wire in different codewords,
+ * so a burst of as many bits in a row as there are codewords is corrected as well.
+ *
+ * The header is matched allowing for FEC_HEADER_TOLERANCE flipped bits. The CRC catches what the codewords
+ * cannot correct. Decoding costs one table lookup per codeword plus the de-interleaving, so it is the same for
+ * every frame of a given length however many bits were flipped.
+ *
+ * Inline, as the simulator's encoder and benchmark share this header.
+ */
+
+const byte FEC_HEADER[4] = {0x5B, 0xEE, 0x1B, 0x27};   // HEADER with every bit flipped
+const byte FEC_HEADER_SIZE = 4;
+const byte FEC_LENGTH_SIZE = 2;
+const byte FEC_HEADER_TOLERANCE = 2;
+const byte FEC_MAX_DATA = 16;
+
+// Flags in HAMMING_DECODE, above the nibble
+const byte HAMMING_CORRECTED = 0x40;
+const byte HAMMING_UNCORRECTABLE = 0x80;
+
+// Codeword bits, LSB first: p1 p2 d0 p4 d1 d2 d3, then the parity of all seven
+const byte HAMMING_ENCODE[16] PROGMEM = {
+        0x00, 0x87, 0x99, 0x1E, 0xAA, 0x2D, 0x33, 0xB4, 0x4B, 0xCC, 0xD2, 0x55, 0xE1, 0x66, 0x78, 0xFF,
+};
+
+// The nearest codeword's nibble for every byte, flagged if a bit was corrected or if two bits were flipped
+const byte HAMMING_DECODE[256] PROGMEM = {
+        0x00, 0x40, 0x40, 0x80, 0x40, 0x80, 0x80, 0x41, 0x40, 0x80, 0x80, 0x48, 0x80, 0x45, 0x43, 0x80,
+        0x40, 0x80, 0x80, 0x46, 0x80, 0x4B, 0x43, 0x80, 0x80, 0x42, 0x43, 0x80, 0x43, 0x80, 0x03, 0x43,
+        0x40, 0x80, 0x80, 0x46, 0x80, 0x45, 0x4D, 0x80, 0x80, 0x45, 0x44, 0x80, 0x45, 0x05, 0x80, 0x45,
+        0x80, 0x46, 0x46, 0x06, 0x47, 0x80, 0x80, 0x46, 0x4E, 0x80, 0x80, 0x46, 0x80, 0x45, 0x43, 0x80,
+        0x40, 0x80, 0x80, 0x48, 0x80, 0x4B, 0x4D, 0x80, 0x80, 0x48, 0x48, 0x08, 0x49, 0x80, 0x80, 0x48,
+        0x80, 0x4B, 0x4A, 0x80, 0x4B, 0x0B, 0x80, 0x4B, 0x4E, 0x80, 0x80, 0x48, 0x80, 0x4B, 0x43, 0x80,
+        0x80, 0x4C, 0x4D, 0x80, 0x4D, 0x80, 0x0D, 0x4D, 0x4E, 0x80, 0x80, 0x48, 0x80, 0x45, 0x4D, 0x80,
+        0x4E, 0x80, 0x80, 0x46, 0x80, 0x4B, 0x4D, 0x80, 0x0E, 0x4E, 0x4E, 0x80, 0x4E, 0x80, 0x80, 0x4F,
+        0x40, 0x80, 0x80, 0x41, 0x80, 0x41, 0x41, 0x01, 0x80, 0x42, 0x44, 0x80, 0x49, 0x80, 0x80, 0x41,
+        0x80, 0x42, 0x4A, 0x80, 0x47, 0x80, 0x80, 0x41, 0x42, 0x02, 0x80, 0x42, 0x80, 0x42, 0x43, 0x80,
+        0x80, 0x4C, 0x44, 0x80, 0x47, 0x80, 0x80, 0x41, 0x44, 0x80, 0x04, 0x44, 0x80, 0x45, 0x44, 0x80,
+        0x47, 0x80, 0x80, 0x46, 0x07, 0x47, 0x47, 0x80, 0x80, 0x42, 0x44, 0x80, 0x47, 0x80, 0x80, 0x4F,
+        0x80, 0x4C, 0x4A, 0x80, 0x49, 0x80, 0x80, 0x41, 0x49, 0x80, 0x80, 0x48, 0x09, 0x49, 0x49, 0x80,
+        0x4A, 0x80, 0x0A, 0x4A, 0x80, 0x4B, 0x4A, 0x80, 0x80, 0x42, 0x4A, 0x80, 0x49, 0x80, 0x80, 0x4F,
+        0x4C, 0x0C, 0x80, 0x4C, 0x80, 0x4C, 0x4D, 0x80, 0x80, 0x4C, 0x44, 0x80, 0x49, 0x80, 0x80, 0x4F,
+        0x80, 0x4C, 0x4A, 0x80, 0x47, 0x80, 0x80, 0x4F, 0x4E, 0x80, 0x80, 0x4F, 0x80, 0x4F, 0x4F, 0x0F,
+};
+
+/**
+ * The number of bytes the frame and its CRC take once encoded.
+ */
+inline byte fecBodySize(byte length) {
+    return 2 * (length + 1);
+}
+
+/**
+ * The number of bytes an FEC packet takes on the wire, for a frame of the given length.
+ */
+inline byte fecPacketSize(byte length) {
+    return FEC_HEADER_SIZE + FEC_LENGTH_SIZE + fecBodySize(length);
+}
+
+/**
+ * If the bytes are FEC_HEADER, allowing for up to FEC_HEADER_TOLERANCE flipped bits.
+ */
+inline bool isFecHeader(const byte bytes[FEC_HEADER_SIZE]) {
+    byte flipped = 0;
+    for (byte i = 0; i < FEC_HEADER_SIZE; ++i) {
+        for (byte diff = bytes[i] ^ FEC_HEADER[i]; diff; diff &= diff - 1) {
+            flipped++;
+        }
+    }
+    return flipped <= FEC_HEADER_TOLERANCE;
+}
+
+/**
+ * CRC-8 (polynomial 0x07, initial value 0xFF) of the frame.
+ */
+inline byte fecCrc(const byte *data, byte length) {
+    byte crc = 0xFF;
+    for (byte i = 0; i < length; ++i) {
+        crc ^= data[i];
+        for (byte bit = 0; bit < 8; ++bit) {
+            crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+/**
+ * Decode a byte sent as two codewords, low nibble first.
+ *
+ * @param low       The codeword for the low nibble.
+ * @param high      The codeword for the high nibble.
+ * @param corrected Incremented for each bit corrected.
+ * @return          The byte, or -1 if either codeword could not be corrected.
+ */
+inline int hammingDecodeByte(byte low, byte high, byte &corrected) {
+    const byte lo = pgm_read_byte(&HAMMING_DECODE[low]);
+    const byte hi = pgm_read_byte(&HAMMING_DECODE[high]);
+    if ((lo | hi) & HAMMING_UNCORRECTABLE) return -1;
+
+    corrected += (lo & HAMMING_CORRECTED ? 1 : 0) + (hi & HAMMING_CORRECTED ? 1 : 0);
+    return (hi & 0x0F) << 4 | (lo & 0x0F);
+}
+
+/**
+ * Encode a frame's length as two codewords.
+ *
+ * @param out Where to write the two bytes.
+ */
+inline void fecEncodeLength(byte length, byte *out) {
+    out[0] = pgm_read_byte(&HAMMING_ENCODE[length & 0x0F]);
+    out[1] = pgm_read_byte(&HAMMING_ENCODE[length >> 4]);
+}
+
+/**
+ * Decode a frame's length.
+ *
+ * @return The length, or -1 if it could not be corrected, is 0 or is more than FEC_MAX_DATA.
+ */
+inline int fecDecodeLength(byte low, byte high) {
+    byte corrected = 0;
+    const int length = hammingDecodeByte(low, high, corrected);
+    return length < 1 || length > FEC_MAX_DATA ? -1 : length;
+}
+
+/**
+ * Encode a frame and its CRC, interleaving the codewords so that bit b of codeword i goes out as bit b * count + i
+ * of the body, where count is the number of codewords. Bytes go out LSB first, so that is also the order on the
+ * wire.
+ *
+ * @param data   The frame.
+ * @param length Its length, at most FEC_MAX_DATA.
+ * @param out    Where to write the fecBodySize(length) bytes.
+ */
+inline void fecEncodeBody(const byte *data, byte length, byte *out) {
+    const byte count = fecBodySize(length);
+    byte codewords[2 * (FEC_MAX_DATA + 1)];
+    const byte crc = fecCrc(data, length);
+    for (byte i = 0; i <= length; ++i) {
+        const byte b = i < length ? data[i] : crc;
+        codewords[2 * i] = pgm_read_byte(&HAMMING_ENCODE[b & 0x0F]);
+        codewords[2 * i + 1] = pgm_read_byte(&HAMMING_ENCODE[b >> 4]);
+    }
+
+    memset(out, 0, count);
+    unsigned int s = 0;
+    for (byte bit = 0; bit < 8; ++bit) {
+        for (byte i = 0; i < count; ++i, ++s) {
+            if (codewords[i] >> bit & 1) out[s >> 3] |= 1 << (s & 7);
+        }
+    }
+}
+
+/**
+ * Undo fecEncodeBody(), correcting what can be corrected.
+ *
+ * @param in     The fecBodySize(length) bytes received.
+ * @param length The frame's length, from fecDecodeLength().
+ * @param data   Where to write the frame.
+ * @return       The number of bits corrected, or -1 if a codeword could not be corrected or the CRC failed.
+ */
+inline int fecDecodeBody(const byte *in, byte length, byte *data) {
+    const byte count = fecBodySize(length);
+    byte codewords[2 * (FEC_MAX_DATA + 1)];
+    memset(codewords, 0, count);
+    unsigned int s = 0;
+    for (byte bit = 0; bit < 8; ++bit) {
+        for (byte i = 0; i < count; ++i, ++s) {
+            if (in[s >> 3] >> (s & 7) & 1) codewords[i] |= 1 << bit;
+        }
+    }
+
+    byte corrected = 0;
+    for (byte i = 0; i < length; ++i) {
+        const int b = hammingDecodeByte(codewords[2 * i], codewords[2 * i + 1], corrected);
+        if (b < 0) return -1;
+        data[i] = b;
+    }
+    const int crc = hammingDecodeByte(codewords[2 * length], codewords[2 * length + 1], corrected);
+    if (crc != fecCrc(data, length)) return -1;
+    return corrected;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <Arduino.h>
+#include <Protocol.h>   // Frame types, sizes and layouts, generated from protocol/Frames.schema
+
+// Pings to ANY_RECEIVER are only for one on the bench; clock reports to it are spread over slots so a line can be found
+const byte CLOCK_REPORT_SLOTS = 64;        // Picked afresh for each query, so two that clash once need not again
+const unsigned long CLOCK_REPORT_SLOT_MS = 90;   // A report on the wire, and the spread of the radio's delay both ways
+const unsigned long DISCOVERED_QUIET_MS = 300000;   // A receiver addressed by its id leaves reports to those not yet
+                                                    // found for this long, longer than the app takes to ping each
+
+/**
+ * Flow control on the back-channel. show() clocks the LEDs out with interrupts off, and the USART keeps only
+ * FLOW_USART_BYTES of what arrives meanwhile. Before a show() longer than that, the receiver writes FLOW_BUSY, then
+ * waits for it to reach the controller and for the line to go quiet. It shows, then writes FLOW_READY. The controller
+ * holds its writes in between, for at most FLOW_HOLD_MAX_MS in case FLOW_READY is lost. They go out between frames,
+ * often straight after debug text, so the controller picks them out as soon as they arrive, wherever a frame could
+ * start. They are XOFF and XON with the top bit set, which neither the ASCII debug text, nor HEADER, nor a frame type
+ * uses, so neither a line of text nor a bad frame the controller skips a byte at a time can pass for one.
+ */
+const byte FLOW_USART_BYTES = 3;                // Two in UDR0, one more in the receive shift register
+const unsigned long FLOW_GUARD_MS = 20;         // For FLOW_BUSY to reach the app; a USB serial adapter can sit on it
+                                                // for 16 ms
+const unsigned long FLOW_QUIET_MS = 3;          // Without a byte, the controller has stopped
+const unsigned long FLOW_HOLD_MS = 250;         // The show goes ahead regardless, for a controller that never holds
+// A show after a hold has been kept up this long sends FLOW_BUSY again, so the controller is still holding during it
+const unsigned long FLOW_HOLD_STALE_MS = FLOW_HOLD_MAX_MS - FLOW_HOLD_MS - FLOW_GUARD_MS;
+
+/**
+ * How long the given number of bytes take on the wire, to the nearest ms.
+ * Inline, as the simulator's packet encoder shares this header.
+ */
+inline unsigned long wireMillis(unsigned long bytes) {
+    return (bytes * 10000 + SERIAL_BAUD / 2) / SERIAL_BAUD;
+}
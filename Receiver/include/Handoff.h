@@ -0,0 +1,31 @@
+#pragma once
+#include <Arduino.h>
+#include <Frames.h>
+
+/**
+ * Matchplay alternate shooting. The two receivers, one set to A/B (left) and one to C/D (right), take turns: when
+ * one shooter's time runs out, or the controller stops it, that receiver hands the turn straight to its partner
+ * over the shared radio channel. The controller only starts the first turn, and otherwise just listens, so a slow
+ * link to the controller no longer holds up the change of shooter.
+ */
+
+const unsigned long HANDOFF_GAP_MS = 50;    // Between copies; one takes 13 ms at 9600 baud
+const byte MATCH_END_BEEPS = 3;             // After the last turn, as the controller beeps the end of an end
+
+struct Handoff {
+    bool shooting;              // This receiver's shooter has the turn
+    byte turnsLeft;             // Turns to come after this one
+    int time;                   // Seconds each turn has
+    byte sequence;              // Of the last turn given or taken, if sequenceSeen
+    bool sequenceSeen;
+    byte copiesLeft;            // Copies of the last handoff still to send
+    unsigned long nextCopyAt;
+    HandoffFrame sent;
+};
+
+/**
+ * The side that takes over from the given one.
+ */
+inline byte partnerSide(byte side) {
+    return side == 1 ? 2 : 1;
+}
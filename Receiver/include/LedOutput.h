@@ -0,0 +1,190 @@
+#pragma once
+#include <Arduino.h>
+#include <Pixel.h>
+
+/**
+ * Clocking the display out to the LEDs. Everything else draws into CRGB arrays, and only these three calls reach the
+ * hardware, so the backend behind them can be swapped:
+ *
+ * - FastLED, the default, as the firmware has always used it. It alone can scale the LEDs by brightness and colour
+ *   correction as it sends them.
+ * - LED_BITBANG: a cycle-counted WS2812 driver for the 16 MHz AVR, with no FastLED at all. It sends leds[] as it
+ *   stands, so it relies on the brightness being baked into the palettes (include/Palette.h). No environment in
+ *   platformio.ini builds it: it has not been built with avr-gcc, nor run on a board or under simavr. Only what it
+ *   sends has been checked, by the capture backend in the simulator.
+ * - Capture, in the native simulator only (ledCapture): the LEDs go straight to the simulated board as they stand,
+ *   with no FastLED in the way, as the bit-bang driver would send them.
+ *
+ * A chain is a run of the display's LEDs on a data pin of its own, sent in the GRB order of the WS2812. Interrupts
+ * are off while a chain is sent, and back on between chains.
+ */
+
+const unsigned long LED_WIRE_US = 30;       // 24 bits of 20 cycles each, per LED
+const unsigned long LED_LATCH_US = 50;      // The data line held low for this long ends a frame
+
+#ifdef SIM_LED_CAPTURE
+extern bool ledCapture;
+#endif
+
+#ifdef LED_BITBANG
+
+#if !defined(__AVR__) || F_CPU != 16000000L
+#error "The bit-bang LED driver is timed for a 16 MHz AVR"
+#endif
+
+extern volatile unsigned long timer0_millis;   // From the Arduino core's wiring.c, which millis() reads
+
+const unsigned int TIMER0_OVERFLOW_US = 1024;
+
+struct LedChain {
+    CRGB *leds;
+    int count;
+    volatile uint8_t *port;
+    uint8_t mask;
+    unsigned long shownAt;      // micros() at the end of the last show, for the latch
+};
+
+/**
+ * Set up a chain: drive its data pin low, ready for the first bit.
+ *
+ * @param leds  Array of all CRGB LEDs.
+ * @param first The first LED of the chain in leds.
+ * @param count How many LEDs the chain has.
+ */
+template<byte PIN>
+void ledChainBegin(LedChain &chain, CRGB leds[], int first, int count) {
+    chain.leds = leds + first;
+    chain.count = count;
+    chain.port = portOutputRegister(digitalPinToPort(PIN));
+    chain.mask = digitalPinToBitMask(PIN);
+    chain.shownAt = 0;
+    pinMode(PIN, OUTPUT);
+    digitalWrite(PIN, LOW);
+}
+
+/**
+ * Send one byte, most significant bit first, each bit taking 20 cycles (1.25 us). The line goes high for 5 cycles for
+ * a 0 and 13 for a 1. Both ways through the skip take the same time, so every bit is the same length. The line stays
+ * low for a few more cycles after the last bit while the caller fetches the next byte, well inside what the WS2812
+ * takes as still the same frame.
+ *
+ * @param hi The port with the data pin set.
+ * @param lo The port with it clear.
+ */
+inline void ledSendByte(volatile uint8_t *port, uint8_t hi, uint8_t lo, uint8_t value) {
+    uint8_t bits;
+    uint8_t next;
+    asm volatile(
+            "ldi  %[bits], 8\n"
+            "1:\n\t"
+            "st   %a[port], %[hi]\n\t"      // 0: high
+            "mov  %[next], %[lo]\n\t"       // 2
+            "sbrc %[value], 7\n\t"          // 3
+            "mov  %[next], %[hi]\n\t"       // 4
+            "st   %a[port], %[next]\n\t"    // 5: low for a 0
+            "lsl  %[value]\n\t"             // 7
+            "rjmp .+0\n\t"                  // 8
+            "rjmp .+0\n\t"                  // 10
+            "nop\n\t"                       // 12
+            "st   %a[port], %[lo]\n\t"      // 13: low for a 1
+            "dec  %[bits]\n\t"              // 15
+            "rjmp .+0\n\t"                  // 16
+            "brne 1b\n"                     // 18, and the next bit at 20
+            : [value] "+r"(value), [bits] "=&d"(bits), [next] "=&r"(next)
+            : [port] "e"(port), [hi] "r"(hi), [lo] "r"(lo));
+}
+
+/**
+ * Send a chain's LEDs, once the line has been low long enough since its last show to latch it.
+ */
+inline void ledChainShow(LedChain &chain) {
+    while (micros() - chain.shownAt < LED_LATCH_US) {}
+
+    const uint8_t oldSREG = SREG;
+    cli();
+    const uint8_t hi = *chain.port | chain.mask;
+    const uint8_t lo = *chain.port & ~chain.mask;
+    const CRGB *led = chain.leds;
+    for (int i = 0; i < chain.count; ++i, ++led) {
+        ledSendByte(chain.port, hi, lo, led->g);
+        ledSendByte(chain.port, hi, lo, led->r);
+        ledSendByte(chain.port, hi, lo, led->b);
+    }
+
+    // Timer 0 overflows every 1024 us, and all but one of the overflows while interrupts were off are lost, along with
+    // the millis() they would have counted. Put them back, as FastLED does.
+    static unsigned int lostUs;
+    const unsigned long us = chain.count * LED_WIRE_US + lostUs;
+    if (us > TIMER0_OVERFLOW_US) {
+        timer0_millis += (us - TIMER0_OVERFLOW_US) / 1000;
+        lostUs = (us - TIMER0_OVERFLOW_US) % 1000;
+    } else {
+        lostUs = us;
+    }
+    SREG = oldSREG;
+    chain.shownAt = micros();
+}
+
+/**
+ * The bit-bang driver sends the LEDs as they are drawn, so there is nothing to scale them by. Keep bakedColours set.
+ */
+inline void ledsScale(byte, uint32_t) {}
+
+#else
+
+struct LedChain {
+    CRGB *leds;
+    int count;
+    int first;
+    CLEDController *controller;
+};
+
+/**
+ * Register a chain with FastLED.
+ *
+ * @param leds  Array of all CRGB LEDs.
+ * @param first The first LED of the chain in leds.
+ * @param count How many LEDs the chain has.
+ */
+template<byte PIN>
+void ledChainBegin(LedChain &chain, CRGB leds[], int first, int count) {
+    chain.leds = leds + first;
+    chain.count = count;
+    chain.first = first;
+#ifdef SIM_LED_CAPTURE
+    if (ledCapture) return;
+#endif
+    chain.controller = &CFastLED::addLeds<WS2812, PIN, GRB>(chain.leds, count);
+}
+
+/**
+ * Send a chain's LEDs. A lone chain goes out through FastLED.show(), which leaves out dithering while it counts under
+ * 100 frames a second, as it always has.
+ */
+inline void ledChainShow(LedChain &chain) {
+#ifdef SIM_LED_CAPTURE
+    if (ledCapture) {
+        simCaptureLeds((const uint8_t *) chain.leds, chain.first, chain.count);
+        return;
+    }
+#endif
+    if (FastLED.count() == 1) {
+        FastLED.show();
+    } else {
+        chain.controller->showLeds(FastLED.getBrightness());
+    }
+}
+
+/**
+ * Have FastLED scale every chain by a brightness and colour correction as it sends it, dithering unless that leaves
+ * the LEDs as they are.
+ */
+inline void ledsScale(byte brightness, uint32_t correction) {
+    for (int i = 0; i < FastLED.count(); ++i) {
+        FastLED[i].setCorrection(CRGB(correction));
+    }
+    FastLED.setBrightness(brightness);
+    FastLED.setDither(brightness == 255 && correction == UncorrectedColor ? DISABLE_DITHER : BINARY_DITHER);
+}
+
+#endif
@@ -1,34 +1,29 @@
 #pragma once
-#include "FastLED.h"
+#include <Pixel.h>
+#include <Bench.h>
+#include <SegmentFont.h>
+#include <Palette.h>
 
 /**
- * Binary definitions for the colouration of 7-seg characters (5 LEDs per seg).
- * 0 = off, 1 = 0xFFFF00 (yellow)
+ * The numerical display is three 7-seg characters of 35 LEDs, 5 per segment, in this order along the chain.
+ * Glyphs come from the flash-resident font in SegmentFont.h.
  */
-const uint64_t NUMBER_OFF = 0b0000000000000000000000000000000000000000000000000000000000000000;
-const uint64_t ZERO =       0b0000000000000000000000000000000000111111111111111111111111111111;
-const uint64_t ONE =        0b0000000000000000000000000000000000000000000011111111110000000000;
-const uint64_t TWO =        0b0000000000000000000000000000011111000001111111111000001111111111;
-const uint64_t THREE =      0b0000000000000000000000000000011111000001111111111111111111100000;
-const uint64_t FOUR =       0b0000000000000000000000000000011111111110000011111111110000000000;
-const uint64_t FIVE =       0b0000000000000000000000000000011111111111111100000111111111100000;
-const uint64_t SIX =        0b0000000000000000000000000000011111111111111100000111111111111111;
-const uint64_t SEVEN =      0b0000000000000000000000000000000000000001111111111111110000000000;
-const uint64_t EIGHT =      0b0000000000000000000000000000011111111111111111111111111111111111;
-const uint64_t NINE =       0b0000000000000000000000000000011111111111111111111111111111100000;
-
-const uint64_t NUMBERS[11] = {ZERO, ONE, TWO, THREE, FOUR, FIVE, SIX, SEVEN, EIGHT, NINE, NUMBER_OFF};
+const byte NUMERIC_SEGMENT_ORDER[7] PROGMEM = {SEG_E, SEG_D, SEG_C, SEG_B, SEG_A, SEG_F, SEG_G};
+const byte LEDS_PER_SEGMENT = 5;
+const byte NUMERIC_DIGITS = 3;
 
 const uint32_t HUNDREDS_OFFSET = 56;
 const uint32_t TENS_OFFSET = 91;
 const uint32_t ONES_OFFSET = 126;
+const int NUMBER_LEDS = NUMERIC_DIGITS * 7 * LEDS_PER_SEGMENT;
 
 /**
  * Turns off all LEDs in the numerical display.
  *
  * @param leds Array of all CRGB LEDs.
  */
-void clearNumber(CRGB leds[]) {
+inline void clearNumber(CRGB leds[]) {
+    BENCH_SCOPE(BENCH_RENDER);
     for (int i = HUNDREDS_OFFSET; i < 161; ++i) {
         leds[i] = 0x000000;
     }
@@ -40,48 +35,110 @@ void clearNumber(CRGB leds[]) {
  * @param leds   Array of all CRGB LEDs.
  * @param offset The index of the first LED in the 7-seg array.
  */
-void clearDigit(CRGB leds[], uint32_t offset) {
+inline void clearDigit(CRGB leds[], uint32_t offset) {
     for (int i = 0; i < 35; ++i) {
         leds[i + offset] = 0x000000;
     }
 }
 
+/**
+ * Draw a glyph on the numerical display, in the position given by the offset value.
+ *
+ * @param leds     Array of all CRGB LEDs.
+ * @param offset   The index of the first LED in the 7-seg array.
+ * @param segments The segments to light in yellow, as from glyphSegments().
+ */
+inline void displayGlyph(CRGB leds[], uint32_t offset, byte segments) {
+    CRGB *led = leds + offset;
+    const CRGB yellow = palette->colours[PALETTE_YELLOW];
+    for (byte s = 0; s < 7; ++s) {
+        const CRGB colour = segments & pgm_read_byte(&NUMERIC_SEGMENT_ORDER[s]) ? yellow : CRGB(0x000000);
+        for (byte i = 0; i < LEDS_PER_SEGMENT; ++i) {
+            *led++ = colour;
+        }
+    }
+}
+
 /**
  * Draw the given digit on the numerical display, in the position given by the offset value.
  *
  * @param leds   Array of all CRGB LEDs.
  * @param offset The index of the first LED in the 7-seg array.
- * @param digit  The binary pattern for the digit, where 0 is off and 1 is yellow.
+ * @param digit  The digit, 0 to 9.
  */
-void displayDigit(CRGB leds[], uint32_t offset, uint32_t digit) {
-    const auto segs = NUMBERS[digit];
-    for (int i = 0; i < 35; ++i) {
-        leds[i + offset] = (segs >> i) & 1 ? 0xFFFF00 : 0x000000;
+inline void displayDigit(CRGB leds[], uint32_t offset, uint32_t digit) {
+    displayGlyph(leds, offset, glyphSegments('0' + digit));
+}
+
+/**
+ * Write a message across the numerical display, such as an error code or "End". Characters past the third are
+ * dropped, and a short message is padded with blanks.
+ *
+ * @param leds Array of all CRGB LEDs.
+ * @param text The message, in flash (PSTR("...")) so it costs no SRAM.
+ */
+inline void displayText(CRGB leds[], const char *text) {
+    BENCH_SCOPE(BENCH_RENDER);
+    const uint32_t offsets[NUMERIC_DIGITS] = {HUNDREDS_OFFSET, TENS_OFFSET, ONES_OFFSET};
+    for (byte i = 0; i < NUMERIC_DIGITS; ++i) {
+        const char c = pgm_read_byte(text);
+        if (c) text++;
+        displayGlyph(leds, offsets[i], glyphSegments(c));
     }
 }
 
+/**
+ * Work out the glyphs the numerical display shows for a number, with its leading zeros left blank. The divisions are
+ * done here, leaving displayGlyphs() only a copy, so a number can be worked out ahead of the moment it is to be shown
+ * in three bytes rather than drawn ahead into a buffer of NUMBER_LEDS.
+ *
+ * @param glyphs Set to the segments of the hundreds, tens and ones, as from glyphSegments().
+ * @param value  The at-most 3-digit number to display.
+ */
+inline void numberGlyphs(byte glyphs[NUMERIC_DIGITS], uint32_t value) {
+    const uint32_t hundreds = value / 100;
+    const uint32_t tens = (value - (hundreds * 100)) / 10;
+    const uint32_t ones = value - (hundreds * 100) - (tens * 10);
+
+    glyphs[0] = hundreds == 0 ? 0 : glyphSegments('0' + hundreds);
+    glyphs[1] = tens == 0 && hundreds == 0 ? 0 : glyphSegments('0' + tens);
+    glyphs[2] = glyphSegments('0' + ones);
+}
+
+/**
+ * Draw the glyphs from numberGlyphs() on the numerical display.
+ *
+ * @param leds   Array of all CRGB LEDs.
+ * @param glyphs The segments of the hundreds, tens and ones.
+ */
+inline void displayGlyphs(CRGB leds[], const byte glyphs[NUMERIC_DIGITS]) {
+    BENCH_SCOPE(BENCH_RENDER);
+    displayGlyph(leds, HUNDREDS_OFFSET, glyphs[0]);
+    displayGlyph(leds, TENS_OFFSET, glyphs[1]);
+    displayGlyph(leds, ONES_OFFSET, glyphs[2]);
+}
+
 /**
  * Draw the given number on the numerical display.
  *
  * @param leds   Array of all CRGB LEDs.
  * @param number The at-most 3-digit number to display.
  */
-void displayNumber(CRGB leds[], uint32_t number) {
-    const uint32_t hundreds = number / 100;
-    const uint32_t tens = (number - (hundreds * 100)) / 10;
-    const uint32_t ones = number - (hundreds * 100) - (tens * 10);
-
-    if (hundreds == 0) {
-        clearDigit(leds, HUNDREDS_OFFSET);
-    } else {
-        displayDigit(leds, HUNDREDS_OFFSET, hundreds);
-    }
+inline void displayNumber(CRGB leds[], uint32_t number) {
+    byte glyphs[NUMERIC_DIGITS];
+    numberGlyphs(glyphs, number);
+    displayGlyphs(leds, glyphs);
+}
 
-    if (tens == 0 && hundreds == 0) {
-        clearDigit(leds, TENS_OFFSET);
-    } else {
-        displayDigit(leds, TENS_OFFSET, tens);
+/**
+ * If a number is being displayed. The ones digit is always drawn, so it is enough to look there.
+ *
+ * @param leds Array of all CRGB LEDs.
+ */
+inline bool numberShown(CRGB leds[]) {
+    for (int i = 0; i < 35; ++i) {
+        const CRGB &led = leds[i + ONES_OFFSET];
+        if (led.r || led.g || led.b) return true;
     }
-
-    displayDigit(leds, ONES_OFFSET, ones);
+    return false;
 }
@@ -0,0 +1,69 @@
+#pragma once
+#include <Pixel.h>
+#include <State.h>
+
+/**
+ * The colours the display is drawn in, baked with the LEDs' colour correction and the brightness the switch picks.
+ * leds[] is then clocked out as it stands, at full brightness with no correction and no temporal dithering, rather
+ * than FastLED scaling every channel of every LED on every show() and dithering between shows that come seconds
+ * apart. Each channel is scaled as FastLED scales it, so the bytes on the wire are the same as it would send. The
+ * LED backends other than FastLED (include/LedOutput.h) cannot scale at all, and rely on this.
+ *
+ * Only the entries are baked: the levels of a light part-way through an animation are scaled with the palette's
+ * adjustment as they are drawn. The palette in use is picked by configureBrightness().
+ */
+
+const byte PALETTE_YELLOW = 3;      // Digits and details; the lights are at RED, AMBER and GREEN
+const byte PALETTE_SIZE = 4;
+const uint32_t PALETTE_COLOURS[PALETTE_SIZE] = {0xFF0000, 0xFF8000, 0x00FF00, 0xFFFF00};
+
+struct Palette {
+    CRGB adjust;                    // Per channel: the colour correction scaled by the brightness
+    CRGB colours[PALETTE_SIZE];
+};
+
+extern const Palette *palette;
+
+/**
+ * Scale a channel as FastLED's scale8() does.
+ */
+inline byte paletteScale(byte value, byte scale) {
+    return ((uint16_t) value * (1 + (uint16_t) scale)) >> 8;
+}
+
+/**
+ * A colour as the palette's LEDs show it.
+ */
+inline CRGB bakeColour(const Palette &p, uint32_t colour) {
+    return CRGB(paletteScale(colour >> 16 & 0xFF, p.adjust.r), paletteScale(colour >> 8 & 0xFF, p.adjust.g),
+                paletteScale(colour & 0xFF, p.adjust.b));
+}
+
+/**
+ * Work out a palette, adjusting each channel the way FastLED adjusts it for a brightness and colour correction.
+ * A brightness of 255 with UncorrectedColor leaves every colour as it is.
+ */
+inline void makePalette(Palette &p, byte brightness, uint32_t correction) {
+    p.adjust = CRGB(paletteScale(correction >> 16 & 0xFF, brightness), paletteScale(correction >> 8 & 0xFF, brightness),
+                    paletteScale(correction & 0xFF, brightness));
+    for (byte i = 0; i < PALETTE_SIZE; ++i) {
+        p.colours[i] = bakeColour(p, PALETTE_COLOURS[i]);
+    }
+}
+
+/**
+ * Redraw LEDs drawn from one palette in another. An LED of no entry's colour is left as it is, for the animation
+ * that drew it to redraw.
+ *
+ * @param leds  Array of CRGB LEDs.
+ * @param count How many.
+ */
+inline void recolour(CRGB leds[], int count, const Palette &from, const Palette &to) {
+    for (int i = 0; i < count; ++i) {
+        for (byte c = 0; c < PALETTE_SIZE; ++c) {
+            if (leds[i] != from.colours[c]) continue;
+            leds[i] = to.colours[c];
+            break;
+        }
+    }
+}
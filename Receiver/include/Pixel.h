@@ -0,0 +1,45 @@
+#pragma once
+
+/**
+ * The pixel every part of the display is drawn in. Normally this is FastLED's CRGB. The bit-bang LED driver
+ * (LED_BITBANG) leaves FastLED out, so it has its own CRGB with the same layout and the parts of it the firmware uses.
+ * The drawing code is the same either way, and include/LedOutput.h sends whichever one it is.
+ */
+
+#ifdef LED_BITBANG
+#include <Arduino.h>
+
+enum LEDColorCorrection {
+    TypicalSMD5050 = 0xFFB0F0,
+    UncorrectedColor = 0xFFFFFF
+};
+
+struct CRGB {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+
+    CRGB() = default;
+
+    CRGB(uint8_t ir, uint8_t ig, uint8_t ib) : r(ir), g(ig), b(ib) {}
+
+    CRGB(uint32_t colorcode) : r((colorcode >> 16) & 0xFF), g((colorcode >> 8) & 0xFF), b(colorcode & 0xFF) {}
+
+    CRGB &operator=(uint32_t colorcode) {
+        r = (colorcode >> 16) & 0xFF;
+        g = (colorcode >> 8) & 0xFF;
+        b = colorcode & 0xFF;
+        return *this;
+    }
+
+    bool operator==(const CRGB &rhs) const {
+        return r == rhs.r && g == rhs.g && b == rhs.b;
+    }
+
+    bool operator!=(const CRGB &rhs) const {
+        return !(*this == rhs);
+    }
+};
+#else
+#include "FastLED.h"
+#endif
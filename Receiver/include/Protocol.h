@@ -0,0 +1,648 @@
+#pragma once
+#include <Arduino.h>
+
+// Generated from protocol/Frames.schema by scripts/generate_protocol.py. Edit the schema, not this file.
+//
+// Offsets are from the start of the frame, type byte included, and multi-byte fields are big-endian.
+// The decoders and encoders only ever touch fixed offsets, so they compile to straight-line loads, stores
+// and shifts.
+
+//region Constants
+constexpr uint32_t SERIAL_BAUD = 9600;
+constexpr byte PACKET_OVERHEAD = 7;              // Header, size and checksum
+constexpr uint16_t ANY_RECEIVER = 0xFFFF;        // A receiver id that addresses every receiver
+constexpr byte BATCH_MAX_SIZE = 40;              // The largest batch frame taken
+/**
+ * The emergency stop signal: four bytes recognised wherever they turn up in what is received, even part-way through
+ * a frame, so a stop never waits for a frame to finish and pass its checksum. The controller sends ESTOP_SIGNAL_COPIES
+ * of it back to back, so a copy lost to noise is made up by the next, then a state with emergencyStop set.
+ * By chance, other frames carry the four bytes about once in 2^32.
+ */
+constexpr uint32_t ESTOP_SIGNAL = 0x5E70A18F;    // Seen anywhere in what is received: two bytes, then their complements
+constexpr byte ESTOP_SIGNAL_COPIES = 3;          // Sent back to back, outside any packet
+constexpr byte FLOW_BUSY = 0x93;                 // From a receiver: hold writes until FLOW_READY
+constexpr byte FLOW_READY = 0x91;
+constexpr uint32_t FLOW_HOLD_MAX_MS = 1000;      // The longest the controller holds its writes for one FLOW_BUSY
+constexpr byte HANDOFF_COPIES = 3;               // Each handoff is sent this many times, in case the partner misses one
+//endregion
+
+//region State
+/**
+ * What the lights should show.
+ */
+constexpr byte STATE_FRAME_SIZE = 8;
+constexpr byte STATE_FLAGS_OFFSET = 0;
+constexpr byte STATE_TIME_OFFSET = 2;
+constexpr byte STATE_START_NUM_BEEPS_OFFSET = 4;
+constexpr byte STATE_END_NUM_BEEPS_OFFSET = 6;
+constexpr uint16_t STATE_TIME_ENABLED_MASK = 0x0001;
+constexpr byte STATE_TIME_ENABLED_SHIFT = 0;
+constexpr uint16_t STATE_COLOUR_MASK = 0x0006;
+constexpr byte STATE_COLOUR_SHIFT = 1;
+constexpr uint16_t STATE_DETAIL_MASK = 0x0018;
+constexpr byte STATE_DETAIL_SHIFT = 3;
+constexpr uint16_t STATE_COUNTDOWN_MASK = 0x0020;
+constexpr byte STATE_COUNTDOWN_SHIFT = 5;
+constexpr uint16_t STATE_MATCHPLAY_MASK = 0x0040;
+constexpr byte STATE_MATCHPLAY_SHIFT = 6;
+constexpr uint16_t STATE_EMERGENCY_STOP_MASK = 0x0080;
+constexpr byte STATE_EMERGENCY_STOP_SHIFT = 7;
+constexpr uint16_t STATE_LAST_END_MASK = 0x0100;
+constexpr byte STATE_LAST_END_SHIFT = 8;
+constexpr uint16_t STATE_COUNTDOWN_CONTINUES_MASK = 0x0200;
+constexpr byte STATE_COUNTDOWN_CONTINUES_SHIFT = 9;
+
+struct StateFrame {
+    uint16_t flags;
+    int16_t time;                // Seconds to show
+    int16_t startNumBeeps;       // Beeps as the countdown starts
+    int16_t endNumBeeps;         // Beeps as it ends
+};
+
+inline void decodeStateFrame(const byte *data, StateFrame &frame) {
+    frame.flags = (uint16_t) ((uint16_t) data[0] << 8 | data[1]);
+    frame.time = (int16_t) ((uint16_t) data[2] << 8 | data[3]);
+    frame.startNumBeeps = (int16_t) ((uint16_t) data[4] << 8 | data[5]);
+    frame.endNumBeeps = (int16_t) ((uint16_t) data[6] << 8 | data[7]);
+}
+
+inline void encodeStateFrame(const StateFrame &frame, byte *data) {
+    data[0] = (byte) (frame.flags >> 8);
+    data[1] = (byte) (frame.flags);
+    data[2] = (byte) (frame.time >> 8);
+    data[3] = (byte) (frame.time);
+    data[4] = (byte) (frame.startNumBeeps >> 8);
+    data[5] = (byte) (frame.startNumBeeps);
+    data[6] = (byte) (frame.endNumBeeps >> 8);
+    data[7] = (byte) (frame.endNumBeeps);
+}
+
+/**
+ * Show the time.
+ */
+inline bool stateTimeEnabled(uint16_t flags) {
+    return flags & STATE_TIME_ENABLED_MASK;
+}
+
+inline uint16_t withStateTimeEnabled(uint16_t flags, bool value) {
+    return (flags & ~STATE_TIME_ENABLED_MASK) |
+           ((uint16_t) value << STATE_TIME_ENABLED_SHIFT & STATE_TIME_ENABLED_MASK);
+}
+
+/**
+ * 0 red, 1 amber, 2 green.
+ */
+inline byte stateColour(uint16_t flags) {
+    return (flags & STATE_COLOUR_MASK) >> STATE_COLOUR_SHIFT;
+}
+
+inline uint16_t withStateColour(uint16_t flags, byte value) {
+    return (flags & ~STATE_COLOUR_MASK) |
+           ((uint16_t) value << STATE_COLOUR_SHIFT & STATE_COLOUR_MASK);
+}
+
+/**
+ * 0 off, 1 A/B, 2 C/D.
+ */
+inline byte stateDetail(uint16_t flags) {
+    return (flags & STATE_DETAIL_MASK) >> STATE_DETAIL_SHIFT;
+}
+
+inline uint16_t withStateDetail(uint16_t flags, byte value) {
+    return (flags & ~STATE_DETAIL_MASK) |
+           ((uint16_t) value << STATE_DETAIL_SHIFT & STATE_DETAIL_MASK);
+}
+
+/**
+ * Count the time down.
+ */
+inline bool stateCountdown(uint16_t flags) {
+    return flags & STATE_COUNTDOWN_MASK;
+}
+
+inline uint16_t withStateCountdown(uint16_t flags, bool value) {
+    return (flags & ~STATE_COUNTDOWN_MASK) |
+           ((uint16_t) value << STATE_COUNTDOWN_SHIFT & STATE_COUNTDOWN_MASK);
+}
+
+/**
+ * Only for a receiver in matchplay mode, with detail as its side.
+ */
+inline bool stateMatchplay(uint16_t flags) {
+    return flags & STATE_MATCHPLAY_MASK;
+}
+
+inline uint16_t withStateMatchplay(uint16_t flags, bool value) {
+    return (flags & ~STATE_MATCHPLAY_MASK) |
+           ((uint16_t) value << STATE_MATCHPLAY_SHIFT & STATE_MATCHPLAY_MASK);
+}
+
+inline bool stateEmergencyStop(uint16_t flags) {
+    return flags & STATE_EMERGENCY_STOP_MASK;
+}
+
+inline uint16_t withStateEmergencyStop(uint16_t flags, bool value) {
+    return (flags & ~STATE_EMERGENCY_STOP_MASK) |
+           ((uint16_t) value << STATE_EMERGENCY_STOP_SHIFT & STATE_EMERGENCY_STOP_MASK);
+}
+
+/**
+ * The last end of a match.
+ */
+inline bool stateLastEnd(uint16_t flags) {
+    return flags & STATE_LAST_END_MASK;
+}
+
+inline uint16_t withStateLastEnd(uint16_t flags, bool value) {
+    return (flags & ~STATE_LAST_END_MASK) |
+           ((uint16_t) value << STATE_LAST_END_SHIFT & STATE_LAST_END_MASK);
+}
+
+/**
+ * Another countdown follows this one.
+ */
+inline bool stateCountdownContinues(uint16_t flags) {
+    return flags & STATE_COUNTDOWN_CONTINUES_MASK;
+}
+
+inline uint16_t withStateCountdownContinues(uint16_t flags, bool value) {
+    return (flags & ~STATE_COUNTDOWN_CONTINUES_MASK) |
+           ((uint16_t) value << STATE_COUNTDOWN_CONTINUES_SHIFT & STATE_COUNTDOWN_CONTINUES_MASK);
+}
+//endregion
+
+//region Clock
+/**
+ * Sent just before scheduled frames.
+ */
+constexpr byte FRAME_CLOCK = 0x10;
+constexpr byte CLOCK_FRAME_SIZE = 5;
+constexpr byte CLOCK_CONTROLLER_MS_OFFSET = 1;
+
+struct ClockFrame {
+    uint32_t controllerMs;       // The controller's clock as the frame is sent
+};
+
+inline void decodeClockFrame(const byte *data, ClockFrame &frame) {
+    frame.controllerMs = (uint32_t) ((uint32_t) data[1] << 24 | (uint32_t) data[2] << 16 |
+                                     (uint16_t) data[3] << 8 | data[4]);
+}
+
+inline void encodeClockFrame(const ClockFrame &frame, byte *data) {
+    data[0] = FRAME_CLOCK;
+    data[1] = (byte) (frame.controllerMs >> 24);
+    data[2] = (byte) (frame.controllerMs >> 16);
+    data[3] = (byte) (frame.controllerMs >> 8);
+    data[4] = (byte) (frame.controllerMs);
+}
+//endregion
+
+//region ScheduledState
+/**
+ * A state for every receiver to act on at the same moment.
+ */
+constexpr byte FRAME_SCHEDULED_STATE = 0x11;
+constexpr byte SCHEDULED_STATE_FRAME_SIZE = 13;
+constexpr byte SCHEDULED_STATE_AT_OFFSET = 1;
+constexpr byte SCHEDULED_STATE_STATE_OFFSET = 5;
+
+struct ScheduledStateFrame {
+    uint32_t at;                 // Controller time to act at
+    StateFrame state;
+};
+
+inline void decodeScheduledStateFrame(const byte *data, ScheduledStateFrame &frame) {
+    frame.at = (uint32_t) ((uint32_t) data[1] << 24 | (uint32_t) data[2] << 16 | (uint16_t) data[3] << 8 | data[4]);
+    decodeStateFrame(data + 5, frame.state);
+}
+
+inline void encodeScheduledStateFrame(const ScheduledStateFrame &frame, byte *data) {
+    data[0] = FRAME_SCHEDULED_STATE;
+    data[1] = (byte) (frame.at >> 24);
+    data[2] = (byte) (frame.at >> 16);
+    data[3] = (byte) (frame.at >> 8);
+    data[4] = (byte) (frame.at);
+    encodeStateFrame(frame.state, data + 5);
+}
+//endregion
+
+//region Ping
+constexpr byte FRAME_PING = 0x12;
+constexpr byte PING_FRAME_SIZE = 13;
+constexpr byte PING_RECEIVER_ID_OFFSET = 1;
+constexpr byte PING_SEQUENCE_OFFSET = 3;
+constexpr byte PING_T1_OFFSET = 4;
+constexpr byte PING_LAST_SEQUENCE_OFFSET = 8;
+constexpr byte PING_T4_OFFSET = 9;
+
+struct PingFrame {
+    uint16_t receiverId;         // Or ANY_RECEIVER
+    uint8_t sequence;
+    uint32_t t1;                 // Controller send time
+    uint8_t lastSequence;        // Of the last pong heard, or this ping's if none has been
+    uint32_t t4;                 // Controller receive time of that pong
+};
+
+inline void decodePingFrame(const byte *data, PingFrame &frame) {
+    frame.receiverId = (uint16_t) ((uint16_t) data[1] << 8 | data[2]);
+    frame.sequence = data[3];
+    frame.t1 = (uint32_t) ((uint32_t) data[4] << 24 | (uint32_t) data[5] << 16 | (uint16_t) data[6] << 8 | data[7]);
+    frame.lastSequence = data[8];
+    frame.t4 = (uint32_t) ((uint32_t) data[9] << 24 | (uint32_t) data[10] << 16 | (uint16_t) data[11] << 8 | data[12]);
+}
+
+inline void encodePingFrame(const PingFrame &frame, byte *data) {
+    data[0] = FRAME_PING;
+    data[1] = (byte) (frame.receiverId >> 8);
+    data[2] = (byte) (frame.receiverId);
+    data[3] = (byte) (frame.sequence);
+    data[4] = (byte) (frame.t1 >> 24);
+    data[5] = (byte) (frame.t1 >> 16);
+    data[6] = (byte) (frame.t1 >> 8);
+    data[7] = (byte) (frame.t1);
+    data[8] = (byte) (frame.lastSequence);
+    data[9] = (byte) (frame.t4 >> 24);
+    data[10] = (byte) (frame.t4 >> 16);
+    data[11] = (byte) (frame.t4 >> 8);
+    data[12] = (byte) (frame.t4);
+}
+//endregion
+
+//region Pong
+constexpr byte FRAME_PONG = 0x13;
+constexpr byte PONG_FRAME_SIZE = 16;
+constexpr byte PONG_RECEIVER_ID_OFFSET = 1;
+constexpr byte PONG_SEQUENCE_OFFSET = 3;
+constexpr byte PONG_T1_OFFSET = 4;
+constexpr byte PONG_T2_OFFSET = 8;
+constexpr byte PONG_T3_OFFSET = 12;
+
+struct PongFrame {
+    uint16_t receiverId;
+    uint8_t sequence;            // The ping's
+    uint32_t t1;                 // The ping's
+    uint32_t t2;                 // Receiver time the ping arrived
+    uint32_t t3;                 // Receiver time the pong left
+};
+
+inline void decodePongFrame(const byte *data, PongFrame &frame) {
+    frame.receiverId = (uint16_t) ((uint16_t) data[1] << 8 | data[2]);
+    frame.sequence = data[3];
+    frame.t1 = (uint32_t) ((uint32_t) data[4] << 24 | (uint32_t) data[5] << 16 | (uint16_t) data[6] << 8 | data[7]);
+    frame.t2 = (uint32_t) ((uint32_t) data[8] << 24 | (uint32_t) data[9] << 16 | (uint16_t) data[10] << 8 | data[11]);
+    frame.t3 = (uint32_t) ((uint32_t) data[12] << 24 | (uint32_t) data[13] << 16 | (uint16_t) data[14] << 8 | data[15]);
+}
+
+inline void encodePongFrame(const PongFrame &frame, byte *data) {
+    data[0] = FRAME_PONG;
+    data[1] = (byte) (frame.receiverId >> 8);
+    data[2] = (byte) (frame.receiverId);
+    data[3] = (byte) (frame.sequence);
+    data[4] = (byte) (frame.t1 >> 24);
+    data[5] = (byte) (frame.t1 >> 16);
+    data[6] = (byte) (frame.t1 >> 8);
+    data[7] = (byte) (frame.t1);
+    data[8] = (byte) (frame.t2 >> 24);
+    data[9] = (byte) (frame.t2 >> 16);
+    data[10] = (byte) (frame.t2 >> 8);
+    data[11] = (byte) (frame.t2);
+    data[12] = (byte) (frame.t3 >> 24);
+    data[13] = (byte) (frame.t3 >> 16);
+    data[14] = (byte) (frame.t3 >> 8);
+    data[15] = (byte) (frame.t3);
+}
+//endregion
+
+//region ClockQuery
+/**
+ * Asks for a clock report.
+ */
+constexpr byte FRAME_CLOCK_QUERY = 0x14;
+constexpr byte CLOCK_QUERY_FRAME_SIZE = 3;
+constexpr byte CLOCK_QUERY_RECEIVER_ID_OFFSET = 1;
+
+struct ClockQueryFrame {
+    uint16_t receiverId;         // Or ANY_RECEIVER, answered in a random slot by any not yet found
+};
+
+inline void decodeClockQueryFrame(const byte *data, ClockQueryFrame &frame) {
+    frame.receiverId = (uint16_t) ((uint16_t) data[1] << 8 | data[2]);
+}
+
+inline void encodeClockQueryFrame(const ClockQueryFrame &frame, byte *data) {
+    data[0] = FRAME_CLOCK_QUERY;
+    data[1] = (byte) (frame.receiverId >> 8);
+    data[2] = (byte) (frame.receiverId);
+}
+//endregion
+
+//region ClockReport
+/**
+ * The receiver's estimate of the controller's clock.
+ */
+constexpr byte FRAME_CLOCK_REPORT = 0x15;
+constexpr byte CLOCK_REPORT_FRAME_SIZE = 16;
+constexpr byte CLOCK_REPORT_RECEIVER_ID_OFFSET = 1;
+constexpr byte CLOCK_REPORT_OFFSET_OFFSET = 3;
+constexpr byte CLOCK_REPORT_ROUND_TRIP_OFFSET = 7;
+constexpr byte CLOCK_REPORT_DRIFT_PPM_OFFSET = 9;
+constexpr byte CLOCK_REPORT_EXCHANGES_OFFSET = 11;
+constexpr byte CLOCK_REPORT_MILLIS_OFFSET = 12;
+
+struct ClockReportFrame {
+    uint16_t receiverId;
+    int32_t offset;              // Controller clock minus receiver clock, in ms
+    uint16_t roundTrip;          // Of the exchange the offset came from, 0xFFFF if none
+    int16_t driftPpm;            // How much faster the controller's clock runs
+    uint8_t exchanges;           // Exchanges held
+    uint32_t millis;             // Receiver millis() as the report was sent
+};
+
+inline void decodeClockReportFrame(const byte *data, ClockReportFrame &frame) {
+    frame.receiverId = (uint16_t) ((uint16_t) data[1] << 8 | data[2]);
+    frame.offset = (int32_t) ((uint32_t) data[3] << 24 | (uint32_t) data[4] << 16 | (uint16_t) data[5] << 8 | data[6]);
+    frame.roundTrip = (uint16_t) ((uint16_t) data[7] << 8 | data[8]);
+    frame.driftPpm = (int16_t) ((uint16_t) data[9] << 8 | data[10]);
+    frame.exchanges = data[11];
+    frame.millis = (uint32_t) ((uint32_t) data[12] << 24 | (uint32_t) data[13] << 16 |
+                               (uint16_t) data[14] << 8 | data[15]);
+}
+
+inline void encodeClockReportFrame(const ClockReportFrame &frame, byte *data) {
+    data[0] = FRAME_CLOCK_REPORT;
+    data[1] = (byte) (frame.receiverId >> 8);
+    data[2] = (byte) (frame.receiverId);
+    data[3] = (byte) (frame.offset >> 24);
+    data[4] = (byte) (frame.offset >> 16);
+    data[5] = (byte) (frame.offset >> 8);
+    data[6] = (byte) (frame.offset);
+    data[7] = (byte) (frame.roundTrip >> 8);
+    data[8] = (byte) (frame.roundTrip);
+    data[9] = (byte) (frame.driftPpm >> 8);
+    data[10] = (byte) (frame.driftPpm);
+    data[11] = (byte) (frame.exchanges);
+    data[12] = (byte) (frame.millis >> 24);
+    data[13] = (byte) (frame.millis >> 16);
+    data[14] = (byte) (frame.millis >> 8);
+    data[15] = (byte) (frame.millis);
+}
+//endregion
+
+//region Generation
+/**
+ * The controller repeats each generation; only the first copy is acted on.
+ */
+constexpr byte FRAME_GENERATION = 0x16;
+constexpr byte GENERATION_FRAME_SIZE = 11;
+constexpr byte GENERATION_GENERATION_OFFSET = 1;
+constexpr byte GENERATION_FRAME_OFFSET = 3;
+
+struct GenerationFrame {
+    uint16_t generation;
+};
+
+inline void decodeGenerationFrame(const byte *data, GenerationFrame &frame) {
+    frame.generation = (uint16_t) ((uint16_t) data[1] << 8 | data[2]);
+}
+
+inline void encodeGenerationFrame(const GenerationFrame &frame, byte *data) {
+    data[0] = FRAME_GENERATION;
+    data[1] = (byte) (frame.generation >> 8);
+    data[2] = (byte) (frame.generation);
+}
+//endregion
+
+//region RoundSchedule
+/**
+ * A round for the receiver to run by itself, one end per start command.
+ */
+constexpr byte FRAME_ROUND_SCHEDULE = 0x17;
+constexpr byte ROUND_SCHEDULE_FRAME_SIZE = 9;
+constexpr byte ROUND_SCHEDULE_ENDS_OFFSET = 1;
+constexpr byte ROUND_SCHEDULE_WALK_UP_OFFSET = 2;
+constexpr byte ROUND_SCHEDULE_MAX_TIME_OFFSET = 3;
+constexpr byte ROUND_SCHEDULE_WARN_TIME_OFFSET = 5;
+constexpr byte ROUND_SCHEDULE_OPTIONS_OFFSET = 7;
+constexpr uint16_t ROUND_SCHEDULE_DETAILS_MASK = 0x0003;
+constexpr byte ROUND_SCHEDULE_DETAILS_SHIFT = 0;
+constexpr uint16_t ROUND_SCHEDULE_ROTATE_MASK = 0x0004;
+constexpr byte ROUND_SCHEDULE_ROTATE_SHIFT = 2;
+constexpr uint16_t ROUND_SCHEDULE_WALK_UP_BEEPS_MASK = 0x0038;
+constexpr byte ROUND_SCHEDULE_WALK_UP_BEEPS_SHIFT = 3;
+constexpr uint16_t ROUND_SCHEDULE_SHOOT_BEEPS_MASK = 0x01C0;
+constexpr byte ROUND_SCHEDULE_SHOOT_BEEPS_SHIFT = 6;
+constexpr uint16_t ROUND_SCHEDULE_END_BEEPS_MASK = 0x0E00;
+constexpr byte ROUND_SCHEDULE_END_BEEPS_SHIFT = 9;
+
+struct RoundScheduleFrame {
+    uint8_t ends;
+    uint8_t walkUp;              // Seconds of amber before each detail shoots
+    uint16_t maxTime;            // Seconds each detail has to shoot
+    uint16_t warnTime;           // Seconds left when the light turns amber, 0 for none
+    uint16_t options;
+};
+
+inline void decodeRoundScheduleFrame(const byte *data, RoundScheduleFrame &frame) {
+    frame.ends = data[1];
+    frame.walkUp = data[2];
+    frame.maxTime = (uint16_t) ((uint16_t) data[3] << 8 | data[4]);
+    frame.warnTime = (uint16_t) ((uint16_t) data[5] << 8 | data[6]);
+    frame.options = (uint16_t) ((uint16_t) data[7] << 8 | data[8]);
+}
+
+inline void encodeRoundScheduleFrame(const RoundScheduleFrame &frame, byte *data) {
+    data[0] = FRAME_ROUND_SCHEDULE;
+    data[1] = (byte) (frame.ends);
+    data[2] = (byte) (frame.walkUp);
+    data[3] = (byte) (frame.maxTime >> 8);
+    data[4] = (byte) (frame.maxTime);
+    data[5] = (byte) (frame.warnTime >> 8);
+    data[6] = (byte) (frame.warnTime);
+    data[7] = (byte) (frame.options >> 8);
+    data[8] = (byte) (frame.options);
+}
+
+/**
+ * 0 none shown, 1 A/B alone, 2 A/B and C/D in turn.
+ */
+inline byte roundScheduleDetails(uint16_t options) {
+    return (options & ROUND_SCHEDULE_DETAILS_MASK) >> ROUND_SCHEDULE_DETAILS_SHIFT;
+}
+
+inline uint16_t withRoundScheduleDetails(uint16_t options, byte value) {
+    return (options & ~ROUND_SCHEDULE_DETAILS_MASK) |
+           ((uint16_t) value << ROUND_SCHEDULE_DETAILS_SHIFT & ROUND_SCHEDULE_DETAILS_MASK);
+}
+
+/**
+ * Alternate which detail shoots first: A/B then C/D, C/D then A/B.
+ */
+inline bool roundScheduleRotate(uint16_t options) {
+    return options & ROUND_SCHEDULE_ROTATE_MASK;
+}
+
+inline uint16_t withRoundScheduleRotate(uint16_t options, bool value) {
+    return (options & ~ROUND_SCHEDULE_ROTATE_MASK) |
+           ((uint16_t) value << ROUND_SCHEDULE_ROTATE_SHIFT & ROUND_SCHEDULE_ROTATE_MASK);
+}
+
+/**
+ * As each walk-up starts.
+ */
+inline byte roundScheduleWalkUpBeeps(uint16_t options) {
+    return (options & ROUND_SCHEDULE_WALK_UP_BEEPS_MASK) >> ROUND_SCHEDULE_WALK_UP_BEEPS_SHIFT;
+}
+
+inline uint16_t withRoundScheduleWalkUpBeeps(uint16_t options, byte value) {
+    return (options & ~ROUND_SCHEDULE_WALK_UP_BEEPS_MASK) |
+           ((uint16_t) value << ROUND_SCHEDULE_WALK_UP_BEEPS_SHIFT & ROUND_SCHEDULE_WALK_UP_BEEPS_MASK);
+}
+
+/**
+ * As each detail starts shooting.
+ */
+inline byte roundScheduleShootBeeps(uint16_t options) {
+    return (options & ROUND_SCHEDULE_SHOOT_BEEPS_MASK) >> ROUND_SCHEDULE_SHOOT_BEEPS_SHIFT;
+}
+
+inline uint16_t withRoundScheduleShootBeeps(uint16_t options, byte value) {
+    return (options & ~ROUND_SCHEDULE_SHOOT_BEEPS_MASK) |
+           ((uint16_t) value << ROUND_SCHEDULE_SHOOT_BEEPS_SHIFT & ROUND_SCHEDULE_SHOOT_BEEPS_MASK);
+}
+
+/**
+ * As the end finishes.
+ */
+inline byte roundScheduleEndBeeps(uint16_t options) {
+    return (options & ROUND_SCHEDULE_END_BEEPS_MASK) >> ROUND_SCHEDULE_END_BEEPS_SHIFT;
+}
+
+inline uint16_t withRoundScheduleEndBeeps(uint16_t options, byte value) {
+    return (options & ~ROUND_SCHEDULE_END_BEEPS_MASK) |
+           ((uint16_t) value << ROUND_SCHEDULE_END_BEEPS_SHIFT & ROUND_SCHEDULE_END_BEEPS_MASK);
+}
+//endregion
+
+//region RoundControl
+/**
+ * Runs the uploaded round.
+ */
+constexpr byte FRAME_ROUND_CONTROL = 0x18;
+constexpr byte ROUND_CONTROL_FRAME_SIZE = 7;
+constexpr byte ROUND_CONTROL_SEQUENCE_OFFSET = 1;
+constexpr byte ROUND_CONTROL_COMMAND_OFFSET = 2;
+constexpr byte ROUND_CONTROL_AT_OFFSET = 3;
+constexpr byte ROUND_START = 1;                  // Start the next end, or resume a paused one
+constexpr byte ROUND_PAUSE = 2;
+constexpr byte ROUND_SKIP = 3;                   // Skip to the next phase, e.g. once a detail has all shot
+constexpr byte ROUND_STOP = 4;                   // Abandon the end, and go back to the start of the round
+
+struct RoundControlFrame {
+    uint8_t sequence;            // Repeats of a command carry the same sequence, and only the first is acted on
+    uint8_t command;
+    uint32_t at;                 // Controller time to act at, if the receiver has a clock
+};
+
+inline void decodeRoundControlFrame(const byte *data, RoundControlFrame &frame) {
+    frame.sequence = data[1];
+    frame.command = data[2];
+    frame.at = (uint32_t) ((uint32_t) data[3] << 24 | (uint32_t) data[4] << 16 | (uint16_t) data[5] << 8 | data[6]);
+}
+
+inline void encodeRoundControlFrame(const RoundControlFrame &frame, byte *data) {
+    data[0] = FRAME_ROUND_CONTROL;
+    data[1] = (byte) (frame.sequence);
+    data[2] = (byte) (frame.command);
+    data[3] = (byte) (frame.at >> 24);
+    data[4] = (byte) (frame.at >> 16);
+    data[5] = (byte) (frame.at >> 8);
+    data[6] = (byte) (frame.at);
+}
+//endregion
+
+//region Handoff
+/**
+ * Matchplay: hands the turn to the other side, from its partner or the controller.
+ */
+constexpr byte FRAME_HANDOFF = 0x19;
+constexpr byte HANDOFF_FRAME_SIZE = 6;
+constexpr byte HANDOFF_SIDE_OFFSET = 1;
+constexpr byte HANDOFF_TURNS_LEFT_OFFSET = 2;
+constexpr byte HANDOFF_TIME_OFFSET = 3;
+constexpr byte HANDOFF_SEQUENCE_OFFSET = 5;
+
+struct HandoffFrame {
+    uint8_t side;                // To shoot next: 1 A/B (left), 2 C/D (right)
+    uint8_t turnsLeft;           // Turns still to come after this one, both sides together
+    int16_t time;                // Seconds for the turn
+    uint8_t sequence;            // One more for every turn of a match; copies of a turn already taken are ignored
+};
+
+inline void decodeHandoffFrame(const byte *data, HandoffFrame &frame) {
+    frame.side = data[1];
+    frame.turnsLeft = data[2];
+    frame.time = (int16_t) ((uint16_t) data[3] << 8 | data[4]);
+    frame.sequence = data[5];
+}
+
+inline void encodeHandoffFrame(const HandoffFrame &frame, byte *data) {
+    data[0] = FRAME_HANDOFF;
+    data[1] = (byte) (frame.side);
+    data[2] = (byte) (frame.turnsLeft);
+    data[3] = (byte) (frame.time >> 8);
+    data[4] = (byte) (frame.time);
+    data[5] = (byte) (frame.sequence);
+}
+//endregion
+
+//region Batch
+/**
+ * Frames applied together, with one redraw after the last; at most 40 bytes in all.
+ */
+constexpr byte FRAME_BATCH = 0x1A;
+constexpr byte BATCH_FRAME_SIZE = 2;
+constexpr byte BATCH_COUNT_OFFSET = 1;
+
+struct BatchFrame {
+    uint8_t count;               // Frames to follow, each a u8 length then the frame; none of them a batch
+};
+
+inline void decodeBatchFrame(const byte *data, BatchFrame &frame) {
+    frame.count = data[1];
+}
+
+inline void encodeBatchFrame(const BatchFrame &frame, byte *data) {
+    data[0] = FRAME_BATCH;
+    data[1] = (byte) (frame.count);
+}
+//endregion
+
+//region Calibrate
+/**
+ * Measures the receiver's clock against the controller's clock frames over minutes.
+ */
+constexpr byte FRAME_CALIBRATE = 0x1B;
+constexpr byte CALIBRATE_FRAME_SIZE = 4;
+constexpr byte CALIBRATE_RECEIVER_ID_OFFSET = 1;
+constexpr byte CALIBRATE_COMMAND_OFFSET = 3;
+constexpr byte CALIBRATE_START = 1;
+constexpr byte CALIBRATE_FINISH = 2;             // Work out the correction, apply it and keep it in EEPROM
+constexpr byte CALIBRATE_CLEAR = 3;
+
+struct CalibrateFrame {
+    uint16_t receiverId;         // Or ANY_RECEIVER
+    uint8_t command;
+};
+
+inline void decodeCalibrateFrame(const byte *data, CalibrateFrame &frame) {
+    frame.receiverId = (uint16_t) ((uint16_t) data[1] << 8 | data[2]);
+    frame.command = data[3];
+}
+
+inline void encodeCalibrateFrame(const CalibrateFrame &frame, byte *data) {
+    data[0] = FRAME_CALIBRATE;
+    data[1] = (byte) (frame.receiverId >> 8);
+    data[2] = (byte) (frame.receiverId);
+    data[3] = (byte) (frame.command);
+}
+//endregion
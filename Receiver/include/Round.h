@@ -0,0 +1,164 @@
+#pragma once
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <ClockTrim.h>
+#include <Frames.h>
+#include <Snapshot.h>
+#include <State.h>
+
+/**
+ * A round uploaded by the controller once, and then run by the receiver itself. The controller only says when each
+ * end starts; the walk-up, shooting, the warning and the change of detail follow on the receiver's own clock, so a
+ * lost packet can no longer stall the range part way through an end.
+ */
+
+const byte PHASE_WAITING = 0;   // For the controller to start the next end
+const byte PHASE_WALK_UP = 1;
+const byte PHASE_SHOOT = 2;
+const byte PHASE_WARN = 3;      // Still shooting, with warnTime or less left
+const byte PHASE_DONE = 4;      // Every end has been shot
+
+struct Round {
+    RoundScheduleFrame schedule;
+    bool loaded;
+    byte end;                   // From 0
+    byte turn;                  // Which of the end's details is shooting, from 0
+    byte phase;                 // PHASE_*
+    unsigned long phaseStart;   // millis()
+    bool paused;
+    unsigned long pausedAt;
+    byte lastSequence;          // Of the last command acted on, if commandSeen
+    bool commandSeen;
+    byte pendingCommand;        // Waiting for the controller's clock to reach pendingAt, 0 if none
+    unsigned long pendingAt;
+};
+
+/**
+ * The copy of the schedule kept in EEPROM: the frame as it arrived, less its type byte, and a CRC.
+ */
+struct StoredRound {
+    byte data[ROUND_SCHEDULE_FRAME_SIZE - 1];
+    byte crc;
+};
+
+/**
+ * Set the round going from its first end with the given schedule.
+ */
+void newRound(Round &round, const RoundScheduleFrame &schedule) {
+    round.schedule = schedule;
+    round.loaded = true;
+    round.end = 0;
+    round.turn = 0;
+    round.phase = PHASE_WAITING;
+    round.paused = false;
+    round.pendingCommand = 0;
+}
+
+bool sameSchedule(const RoundScheduleFrame &a, const RoundScheduleFrame &b) {
+    return a.ends == b.ends && a.walkUp == b.walkUp && a.maxTime == b.maxTime && a.warnTime == b.warnTime
+           && a.options == b.options;
+}
+
+/**
+ * If the round is part way through an end, in one of the phases with a countdown.
+ */
+bool roundRunning(const Round &round) {
+    return round.phase == PHASE_WALK_UP || round.phase == PHASE_SHOOT || round.phase == PHASE_WARN;
+}
+
+byte detailsPerEnd(const RoundScheduleFrame &schedule) {
+    return roundScheduleDetails(schedule.options) == 2 ? 2 : 1;
+}
+
+/**
+ * The detail to show for a turn of an end.
+ *
+ * @param end  The end, from 0.
+ * @param turn Which of its details, from 0.
+ * @return     DETAIL_OFF, DETAIL_AB or DETAIL_CD.
+ */
+byte roundDetail(const RoundScheduleFrame &schedule, byte end, byte turn) {
+    switch (roundScheduleDetails(schedule.options)) {
+        case 0:
+            return DETAIL_OFF;
+
+        case 1:
+            return DETAIL_AB;
+
+        default:
+            bool cdFirst = roundScheduleRotate(schedule.options) && end % 2 == 1;
+            return (turn == 0) != cdFirst ? DETAIL_AB : DETAIL_CD;
+    }
+}
+
+/**
+ * If the shooting has a warning, with time left to shoot before it.
+ */
+bool roundWarns(const RoundScheduleFrame &schedule) {
+    return schedule.warnTime > 0 && schedule.warnTime < schedule.maxTime;
+}
+
+/**
+ * How long the current phase lasts, in seconds. Shooting with a warning is split in two at the warning.
+ */
+unsigned long phaseSeconds(const Round &round) {
+    const RoundScheduleFrame &schedule = round.schedule;
+    switch (round.phase) {
+        case PHASE_WALK_UP:
+            return schedule.walkUp;
+
+        case PHASE_SHOOT:
+            return roundWarns(schedule) ? schedule.maxTime - schedule.warnTime : schedule.maxTime;
+
+        case PHASE_WARN:
+            return schedule.warnTime;
+
+        default:
+            return 0;
+    }
+}
+
+/**
+ * When the current phase ends, by millis(). Its seconds are corrected by the trim as the countdown's ticks are, so the
+ * two stay together.
+ */
+unsigned long phaseEnd(const Round &round, const ClockTrim &trim) {
+    return round.phaseStart + trimmedSeconds(trim, phaseSeconds(round));
+}
+
+/**
+ * If the current phase has run its length.
+ */
+bool phaseDue(const Round &round, unsigned long now, const ClockTrim &trim) {
+    return roundRunning(round) && !round.paused
+           && now - round.phaseStart >= trimmedSeconds(trim, phaseSeconds(round));
+}
+
+/**
+ * Load the schedule kept in EEPROM, if there is a valid one, ready to start from its first end.
+ */
+void loadRound(Round &round, int address) {
+    StoredRound stored;
+    EEPROM.get(address, stored);
+    round.loaded = false;
+    if (stored.crc != crc8(stored.data, sizeof(stored.data))) return;
+
+    byte frame[ROUND_SCHEDULE_FRAME_SIZE] = {FRAME_ROUND_SCHEDULE};
+    memcpy(frame + 1, stored.data, sizeof(stored.data));
+    RoundScheduleFrame schedule;
+    decodeRoundScheduleFrame(frame, schedule);
+    newRound(round, schedule);
+}
+
+/**
+ * Keep the schedule in EEPROM. Only bytes that differ are written, so uploading the same schedule again costs
+ * nothing.
+ */
+void storeRound(const RoundScheduleFrame &schedule, int address) {
+    byte frame[ROUND_SCHEDULE_FRAME_SIZE];
+    encodeRoundScheduleFrame(schedule, frame);
+    StoredRound stored;
+    memcpy(stored.data, frame + 1, sizeof(stored.data));
+    stored.crc = crc8(stored.data, sizeof(stored.data));
+    EEPROM.put(address, stored);
+}
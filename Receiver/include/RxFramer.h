@@ -0,0 +1,182 @@
+#pragma once
+#include <Arduino.h>
+#include <Frames.h>
+#include <Fec.h>
+
+// The uno-isr firmware frames in the interrupt, and the simulator can run either way; the uno firmware leaves it out
+#if defined(ISR_FRAMING) || defined(SIM_RX_INTERRUPT)
+#define RX_FRAMER
+#endif
+
+/**
+ * Framing in the USART RX interrupt, in place of HardwareSerial's ring (ISR_FRAMING). Each byte is taken straight
+ * from the USART and run through the framing state machine: the header is hunted for, the size read, and the frame
+ * written into a packet slot as its checksum is summed. A frame that checks out is flagged ready and the next is
+ * written into the next slot, so loop() only ever sees whole frames, and never looks at a byte until its frame is
+ * complete. FEC packets are framed the same way, and their body left in the slot for loop() to decode.
+ *
+ * A frame that arrives while every slot still waits for loop() is dropped, as HardwareSerial drops bytes when its
+ * ring is full. Two slots would do if loop() kept up, but the debug output can hold it up for a few frames' time:
+ * the four back-to-back frames of an end transition need all four.
+ */
+
+const byte RX_SLOTS = 4;
+const byte RX_SLOT_SIZE = BATCH_MAX_SIZE;       // The largest frame taken
+static_assert(RX_SLOT_SIZE >= 2 * (FEC_MAX_DATA + 1), "A slot must hold the body of an FEC packet of FEC_MAX_DATA");
+
+// Framing states
+const byte RX_HUNT = 0;             // For a header
+const byte RX_SIZE = 1;
+const byte RX_CHECKSUM_HIGH = 2;
+const byte RX_CHECKSUM_LOW = 3;
+const byte RX_FEC_LENGTH_LOW = 4;
+const byte RX_FEC_LENGTH_HIGH = 5;
+const byte RX_DATA = 6;
+
+struct RxFramer {
+    const byte *header;
+    byte window[4];             // The last four bytes, while hunting
+    byte state;
+    byte length;                // Of the frame being written
+    byte count;                 // Written so far
+    bool fec;
+    byte fecLow;
+    byte fecLength;             // Of the frame the FEC body being written decodes to
+    unsigned int expected;      // Checksum
+    unsigned int sum;
+    byte writing;               // The slot being written
+    byte reading;               // The slot loop() takes next
+    volatile bool ready[RX_SLOTS];      // Set by the interrupt, cleared by loop(); a byte each, so neither needs the
+                                        // other to be atomic
+    byte slotLength[RX_SLOTS];
+    bool slotFec[RX_SLOTS];
+    byte slots[RX_SLOTS][RX_SLOT_SIZE];
+    volatile bool seen;         // A byte arrived since loop() last looked
+    byte framed;                // Frames flagged ready, wrapping
+    byte taken;                 // Frames loop() has taken, wrapping
+    uint32_t estopWindow;       // The last four bytes, for the emergency stop signal
+    volatile bool estop;        // The signal arrived, and loop() has yet to stop
+    volatile byte estopFramed;  // framed as it arrived; the frames before it are older than the stop
+    volatile unsigned int dropped;      // Frames with no free slot
+    volatile unsigned int failed;       // Frames with a bad size, length or checksum
+};
+
+void rxFramerReset(RxFramer &framer, const byte header[4]) {
+    memset(&framer, 0, sizeof(framer));
+    framer.header = header;
+}
+
+/**
+ * If the framer is part-way through a frame.
+ */
+inline bool rxFramerBusy(const RxFramer &framer) {
+    return framer.state != RX_HUNT;
+}
+
+/**
+ * Start writing a frame into the free slot, if there is one.
+ */
+void rxFramerStart(RxFramer &framer, byte length, bool fec) {
+    framer.state = RX_HUNT;
+    if (length > RX_SLOT_SIZE) {
+        framer.failed++;
+        return;
+    }
+    if (framer.ready[framer.writing]) {
+        framer.dropped++;
+        return;
+    }
+    framer.length = length;
+    framer.count = 0;
+    framer.fec = fec;
+    framer.sum = 0;
+    framer.state = RX_DATA;
+}
+
+void rxFramerFinish(RxFramer &framer) {
+    framer.state = RX_HUNT;
+    if (!framer.fec && framer.sum != framer.expected) {
+        framer.failed++;
+        return;
+    }
+    framer.slotLength[framer.writing] = framer.fec ? framer.fecLength : framer.length;
+    framer.slotFec[framer.writing] = framer.fec;
+    framer.ready[framer.writing] = true;
+    framer.writing = (framer.writing + 1) % RX_SLOTS;
+    framer.framed++;
+}
+
+/**
+ * Take one byte from the USART. Called from the RX interrupt.
+ */
+void rxFramerByte(RxFramer &framer, byte b) {
+    framer.seen = true;
+    framer.estopWindow = framer.estopWindow << 8 | b;
+    if (framer.estopWindow == ESTOP_SIGNAL) {
+        // Whatever frame the signal broke into is dropped
+        framer.estopFramed = framer.framed;
+        framer.estop = true;
+        framer.state = RX_HUNT;
+        return;
+    }
+    switch (framer.state) {
+        case RX_HUNT:
+            framer.window[0] = framer.window[1];
+            framer.window[1] = framer.window[2];
+            framer.window[2] = framer.window[3];
+            framer.window[3] = b;
+            if (!memcmp(framer.window, framer.header, 4)) {
+                framer.state = RX_SIZE;
+            } else if (isFecHeader(framer.window)) {
+                framer.state = RX_FEC_LENGTH_LOW;
+            } else {
+                break;
+            }
+            memset(framer.window, 0, sizeof(framer.window));
+            break;
+
+        case RX_SIZE:
+            if (b < PACKET_OVERHEAD) {
+                framer.failed++;
+                framer.state = RX_HUNT;
+                break;
+            }
+            framer.length = b - PACKET_OVERHEAD;
+            framer.state = RX_CHECKSUM_HIGH;
+            break;
+
+        case RX_CHECKSUM_HIGH:
+            framer.expected = (unsigned int) b << 8;
+            framer.state = RX_CHECKSUM_LOW;
+            break;
+
+        case RX_CHECKSUM_LOW:
+            framer.expected |= b;
+            rxFramerStart(framer, framer.length, false);
+            if (framer.state == RX_DATA && !framer.length) rxFramerFinish(framer);
+            break;
+
+        case RX_FEC_LENGTH_LOW:
+            framer.fecLow = b;
+            framer.state = RX_FEC_LENGTH_HIGH;
+            break;
+
+        case RX_FEC_LENGTH_HIGH: {
+            const int length = fecDecodeLength(framer.fecLow, b);
+            if (length < 0) {
+                framer.failed++;
+                framer.state = RX_HUNT;
+                break;
+            }
+            framer.fecLength = length;
+            rxFramerStart(framer, fecBodySize(length), true);
+            break;
+        }
+
+        case RX_DATA:
+            framer.slots[framer.writing][framer.count++] = b;
+            framer.sum += b;
+            if (framer.count == framer.length) rxFramerFinish(framer);
+            break;
+    }
+}
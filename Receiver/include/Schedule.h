@@ -0,0 +1,80 @@
+#pragma once
+#include <Arduino.h>
+#include <Frames.h>
+
+/**
+ * A state frame to act on once the controller's clock reaches a set time.
+ */
+struct ScheduledCommand {
+    unsigned long at;                  // Controller time in ms
+    byte data[STATE_FRAME_SIZE];
+};
+
+const byte SCHEDULE_CAPACITY = 4;
+
+/**
+ * Commands waiting to run, kept as a binary min-heap on their time so the next one due is always first.
+ */
+struct Schedule {
+    ScheduledCommand commands[SCHEDULE_CAPACITY];
+    byte size;
+};
+
+/**
+ * If time a comes before time b, allowing for the clock wrapping.
+ */
+bool scheduledBefore(unsigned long a, unsigned long b) {
+    return (long) (a - b) < 0;
+}
+
+/**
+ * Add a command to the schedule.
+ *
+ * @param schedule The schedule.
+ * @param command  The command to add.
+ * @return         False if the schedule is full, in which case the command is not added.
+ */
+bool scheduleCommand(Schedule &schedule, const ScheduledCommand &command) {
+    if (schedule.size == SCHEDULE_CAPACITY) return false;
+
+    // Sift up
+    byte i = schedule.size++;
+    while (i > 0 && scheduledBefore(command.at, schedule.commands[(i - 1) / 2].at)) {
+        schedule.commands[i] = schedule.commands[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    schedule.commands[i] = command;
+    return true;
+}
+
+/**
+ * Remove the first command from the schedule.
+ */
+void popCommand(Schedule &schedule) {
+    if (schedule.size == 0) return;
+
+    // Sift the last command down from the top
+    const ScheduledCommand last = schedule.commands[--schedule.size];
+    byte i = 0;
+    while (true) {
+        byte child = 2 * i + 1;
+        if (child >= schedule.size) break;
+        if (child + 1 < schedule.size && scheduledBefore(schedule.commands[child + 1].at, schedule.commands[child].at)) {
+            child++;
+        }
+        if (!scheduledBefore(schedule.commands[child].at, last.at)) break;
+        schedule.commands[i] = schedule.commands[child];
+        i = child;
+    }
+    schedule.commands[i] = last;
+}
+
+/**
+ * If the first command in the schedule is due.
+ *
+ * @param schedule The schedule.
+ * @param now      The controller's clock, in ms.
+ */
+bool commandDue(const Schedule &schedule, unsigned long now) {
+    return schedule.size > 0 && !scheduledBefore(now, schedule.commands[0].at);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <Arduino.h>
+
+/**
+ * Seven-segment font, kept in flash. A glyph is one byte with a bit per segment:
+ *
+ *      aaa
+ *     f   b
+ *      ggg
+ *     e   c
+ *      ddd
+ *
+ * Covers printable ASCII from space to underscore; lower case letters use the upper case glyph, which is drawn
+ * however reads best (b, d, n, r, t and so on). Letters no seven-segment display can show (K, M, V, W, X) and the
+ * punctuation it can't are blank.
+ */
+const byte SEG_A = 0x01;
+const byte SEG_B = 0x02;
+const byte SEG_C = 0x04;
+const byte SEG_D = 0x08;
+const byte SEG_E = 0x10;
+const byte SEG_F = 0x20;
+const byte SEG_G = 0x40;
+
+const char FONT_FIRST = ' ';
+const char FONT_LAST = '_';
+
+const byte FONT[FONT_LAST - FONT_FIRST + 1] PROGMEM = {
+    0x00, 0x00, 0x22, 0x00, 0x00, 0x00, 0x00, 0x02,     //   ! " # $ % & '
+    0x39, 0x0F, 0x00, 0x00, 0x10, 0x40, 0x00, 0x52,     // ( ) * + , - . /
+    0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07,     // 0 1 2 3 4 5 6 7
+    0x7F, 0x6F, 0x00, 0x00, 0x58, 0x48, 0x4C, 0x53,     // 8 9 : ; < = > ?
+    0x00, 0x77, 0x7C, 0x39, 0x5E, 0x79, 0x71, 0x3D,     // @ A b C d E F G
+    0x76, 0x30, 0x1E, 0x00, 0x38, 0x00, 0x54, 0x3F,     // H I J K L M n O
+    0x73, 0x67, 0x50, 0x6D, 0x78, 0x3E, 0x00, 0x00,     // P q r S t U V W
+    0x00, 0x6E, 0x5B, 0x39, 0x64, 0x0F, 0x23, 0x08,     // X y Z [ \ ] ^ _
+};
+
+/**
+ * The segments to light for a character, blank for one the font has no glyph for.
+ */
+inline byte glyphSegments(char c) {
+    if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+    if (c < FONT_FIRST || c > FONT_LAST) return 0;
+    return pgm_read_byte(&FONT[c - FONT_FIRST]);
+}
@@ -0,0 +1,147 @@
+#pragma once
+#include <EEPROM.h>
+#include <State.h>
+
+/**
+ * Compact copy of the state kept in EEPROM, so a receiver that browns out mid-end can carry on where it left off.
+ *
+ * Snapshots rotate through SNAPSHOT_SLOTS slots to spread the wear, and the newest valid one is found by its
+ * sequence number. A write interrupted by the power going leaves the previous slot intact.
+ * A live snapshot is not acted on at boot until the controller confirms it (see isLiveSnapshot()), so each one carries
+ * the generation of the controller's state it was taken under.
+ * Fields are ordered so the layout is the same 10 bytes on the AVR and the host.
+ */
+struct Snapshot {
+    byte sequence;           // Incremented with every write, wrapping at 255
+    byte flags;              // SNAPSHOT_* bits
+    int16_t time;            // Seconds remaining at the countdown anchor
+    uint16_t generation;     // The controller's generation last acted on, if SNAPSHOT_GENERATION
+    byte detailColour;       // Detail in the high nibble, colour in the low nibble
+    byte startNumBeeps;
+    byte endNumBeeps;
+    byte crc;                // CRC-8 of the bytes above
+};
+
+static_assert(sizeof(Snapshot) == 10, "Snapshot layout must match between the AVR and the host");
+
+const byte SNAPSHOT_COUNTDOWN = 0x01;
+const byte SNAPSHOT_COUNTDOWN_CONTINUES = 0x02;
+const byte SNAPSHOT_LAST_END = 0x04;
+const byte SNAPSHOT_TIME_ENABLED = 0x08;
+const byte SNAPSHOT_GENERATION = 0x10;
+
+const int SNAPSHOT_ADDRESS = 0;
+const byte SNAPSHOT_SLOTS = 32;
+const int SNAPSHOT_CHECKPOINT_SECONDS = 15;   // How often a running countdown re-anchors its snapshot
+
+/**
+ * CRC-8 (polynomial 0x07, initial value 0xFF).
+ */
+byte crc8(const byte *data, byte length) {
+    byte crc = 0xFF;
+    for (byte i = 0; i < length; ++i) {
+        crc ^= data[i];
+        for (byte bit = 0; bit < 8; ++bit) {
+            crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+/**
+ * CRC-8 of everything in the snapshot but the CRC itself. A blank (all 0xFF) or zeroed slot never validates.
+ */
+byte snapshotCrc(const Snapshot &snapshot) {
+    return crc8((const byte *) &snapshot, sizeof(Snapshot) - 1);
+}
+
+/**
+ * Build a snapshot of the given state.
+ *
+ * @param state         The state to copy.
+ * @param sequence      The sequence number for the new snapshot.
+ * @param hasGeneration If a generation has been acted on since power-on (or restored from EEPROM).
+ * @param generation    The generation last acted on.
+ */
+Snapshot makeSnapshot(const State &state, byte sequence, bool hasGeneration, uint16_t generation) {
+    Snapshot snapshot;
+    snapshot.sequence = sequence;
+    snapshot.flags = (state.countdown ? SNAPSHOT_COUNTDOWN : 0)
+                     | (state.countdownContinues ? SNAPSHOT_COUNTDOWN_CONTINUES : 0)
+                     | (state.lastEnd ? SNAPSHOT_LAST_END : 0)
+                     | (state.timeEnabled ? SNAPSHOT_TIME_ENABLED : 0)
+                     | (hasGeneration ? SNAPSHOT_GENERATION : 0);
+    snapshot.time = state.time;
+    snapshot.generation = hasGeneration ? generation : 0;
+    snapshot.detailColour = state.detail << 4 | state.colour;
+    snapshot.startNumBeeps = state.startNumBeeps;
+    snapshot.endNumBeeps = state.endNumBeeps;
+    snapshot.crc = snapshotCrc(snapshot);
+    return snapshot;
+}
+
+/**
+ * Copy a snapshot back into the state.
+ */
+void applySnapshot(const Snapshot &snapshot, State &state) {
+    state.countdown = snapshot.flags & SNAPSHOT_COUNTDOWN;
+    state.countdownContinues = snapshot.flags & SNAPSHOT_COUNTDOWN_CONTINUES;
+    state.lastEnd = snapshot.flags & SNAPSHOT_LAST_END;
+    state.timeEnabled = snapshot.flags & SNAPSHOT_TIME_ENABLED;
+    state.time = snapshot.time;
+    state.detail = snapshot.detailColour >> 4;
+    state.colour = snapshot.detailColour & 0x0F;
+    state.startNumBeeps = snapshot.startNumBeeps;
+    state.endNumBeeps = snapshot.endNumBeeps;
+}
+
+/**
+ * If two snapshots hold the same state and generation, regardless of their sequence numbers.
+ */
+bool sameSnapshot(const Snapshot &a, const Snapshot &b) {
+    return a.flags == b.flags && a.time == b.time && a.generation == b.generation
+           && a.detailColour == b.detailColour && a.startNumBeeps == b.startNumBeeps && a.endNumBeeps == b.endNumBeeps;
+}
+
+/**
+ * If the snapshot was taken while an end was in progress, so is worth restoring.
+ * Every end finishes (or is stopped) by writing a snapshot that is not live.
+ * Nothing says how long ago a snapshot was taken, so a live one is only restored once the controller repeats its
+ * generation, showing it is still running that end (see restoreState()).
+ */
+bool isLiveSnapshot(const Snapshot &snapshot) {
+    return (snapshot.flags & SNAPSHOT_COUNTDOWN) || (snapshot.detailColour & 0x0F) != RED;
+}
+
+/**
+ * Find the newest valid snapshot in EEPROM.
+ *
+ * @param latest Set to the newest snapshot, if one is found.
+ * @return       The slot it was found in, or -1 if no slot holds a valid snapshot.
+ */
+int findLatestSnapshot(Snapshot &latest) {
+    int latestSlot = -1;
+    for (byte slot = 0; slot < SNAPSHOT_SLOTS; ++slot) {
+        Snapshot candidate;
+        EEPROM.get(SNAPSHOT_ADDRESS + slot * sizeof(Snapshot), candidate);
+        if (candidate.crc != snapshotCrc(candidate)) continue;
+
+        // Sequence numbers wrap, so the newer of two is the one less than half the range ahead
+        if (latestSlot == -1 || (int8_t) (candidate.sequence - latest.sequence) > 0) {
+            latest = candidate;
+            latestSlot = slot;
+        }
+    }
+    return latestSlot;
+}
+
+/**
+ * Write a snapshot to the slot after the given one. Only bytes that differ are written.
+ *
+ * @param snapshot The snapshot to write.
+ * @param slot     The slot last written to (-1 if none), updated to the slot written.
+ */
+void writeSnapshot(const Snapshot &snapshot, int &slot) {
+    slot = (slot + 1) % SNAPSHOT_SLOTS;
+    EEPROM.put(SNAPSHOT_ADDRESS + slot * sizeof(Snapshot), snapshot);
+}
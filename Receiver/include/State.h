@@ -0,0 +1,22 @@
+#pragma once
+#include <Arduino.h>
+
+struct State {
+   bool countdownContinues;  // If the countdown currently ending will be followed by another
+   bool lastEnd;             // If the current end is the last (for matchplay)
+   bool countdown;           // If the unit should count down the seconds
+   byte detail;              // The detail being displayed (none, A/B, or C/D)
+   byte colour;              // The colour on the traffic light (red, amber, or green)
+   bool timeEnabled;         // If the time should be displayed on the panel
+   int time;                 // The time to display
+   int startNumBeeps;        // Number of beeps to sound at the start of the countdown
+   int endNumBeeps;          // Number of beeps to sound at the end of the countdown
+};
+
+const byte DETAIL_OFF = 0;
+const byte DETAIL_AB = 1;
+const byte DETAIL_CD = 2;
+
+const byte RED = 0;
+const byte AMBER = 1;
+const byte GREEN = 2;
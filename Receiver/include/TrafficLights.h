@@ -1,39 +1,74 @@
 #pragma once
-#include "FastLED.h"
+#include <Pixel.h>
+#include <Palette.h>
 
 /**
  * Display the given colour on the LED grid specified by the offset.
  *
  * @param leds   Array of all CRGB LEDs.
- * @param colour The hex code of the colour to display.
+ * @param colour The colour to display, as the LEDs show it (see Palette.h).
  * @param offset The index of the first LED in the grid.
  */
-void displayColour(CRGB *leds, uint32_t colour, uint32_t offset) {
+inline void displayColour(CRGB *leds, CRGB colour, uint32_t offset) {
     for (int i = 0; i < 30; ++i) {
         leds[i + offset] = colour;
     }
 }
 
-void displayRedLight(CRGB leds[]) {
-    displayColour(leds, 0xFF0000, 221);
+inline void displayRedLight(CRGB leds[]) {
+    displayColour(leds, palette->colours[RED], 221);
 }
 
-void displayAmberLight(CRGB *leds) {
-    displayColour(leds, 0xFF8000, 191);
+inline void displayAmberLight(CRGB *leds) {
+    displayColour(leds, palette->colours[AMBER], 191);
 }
 
-void displayGreenLight(CRGB leds[]) {
-    displayColour(leds, 0x00FF00, 161);
+inline void displayGreenLight(CRGB leds[]) {
+    displayColour(leds, palette->colours[GREEN], 161);
 }
 
-void clearRedLight(CRGB leds[]) {
+inline void clearRedLight(CRGB leds[]) {
     displayColour(leds, 0x000000, 221);
 }
 
-void clearAmberLight(CRGB *leds) {
+inline void clearAmberLight(CRGB *leds) {
     displayColour(leds, 0x000000, 191);
 }
 
-void clearGreenLight(CRGB leds[]) {
+inline void clearGreenLight(CRGB leds[]) {
     displayColour(leds, 0x000000, 161);
 }
+
+/**
+ * The first LED of each light, indexed by RED, AMBER and GREEN, as their colours are in PALETTE_COLOURS.
+ */
+const uint32_t LIGHT_OFFSETS[3] = {221, 191, 161};
+
+/**
+ * A light's full colour at a fraction of its brightness, as the LEDs show it.
+ */
+inline CRGB lightLevelColour(byte light, byte level) {
+    const uint32_t colour = PALETTE_COLOURS[light];
+    const uint32_t r = (colour >> 16 & 0xFF) * level / 255;
+    const uint32_t g = (colour >> 8 & 0xFF) * level / 255;
+    const uint32_t b = (colour & 0xFF) * level / 255;
+    return bakeColour(*palette, r << 16 | g << 8 | b);
+}
+
+/**
+ * Display a light at a fraction of its full colour.
+ *
+ * @param leds  Array of all CRGB LEDs.
+ * @param light RED, AMBER, or GREEN.
+ * @param level How bright, from 0 (off) to 255 (full).
+ */
+inline void displayLightLevel(CRGB leds[], byte light, byte level) {
+    displayColour(leds, lightLevelColour(light, level), LIGHT_OFFSETS[light]);
+}
+
+/**
+ * If the given light is showing at the given level.
+ */
+inline bool lightAtLevel(CRGB leds[], byte light, byte level) {
+    return leds[LIGHT_OFFSETS[light]] == lightLevelColour(light, level);
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <Arduino.h>
+
+/**
+ * The serial port for the uno-isr build (ISR_FRAMING), which reads frames in its own USART RX interrupt
+ * (include/RxFramer.h). The core's Serial would bring HardwareSerial's RX interrupt with it, as both live in its
+ * HardwareSerial0.cpp. This takes Serial's place instead: it only writes, through a TX ring emptied by the USART data
+ * register empty interrupt as HardwareSerial's is, and leaves USART_RX_vect to the firmware. Nothing then references
+ * the core's Serial, so the linker leaves HardwareSerial0.cpp out, and its vectors with it.
+ *
+ * Reading goes through RxFramer, so available() is always 0.
+ */
+
+#if defined(ISR_FRAMING) && defined(__AVR__)
+#include <util/atomic.h>
+
+class TxSerial : public Stream {
+private:
+    volatile byte head;         // Where the next byte is written
+    volatile byte tail;         // The next byte to go out
+    byte ring[SERIAL_TX_BUFFER_SIZE];
+
+public:
+    /**
+     * Set the USART up as HardwareSerial::begin() does for 8N1, with the receiver and its interrupt on for the
+     * firmware's USART_RX_vect.
+     */
+    void begin(unsigned long baud) {
+        head = tail = 0;
+        UCSR0A = 1 << U2X0;
+        UBRR0 = (F_CPU / 4 / baud - 1) / 2;
+        UCSR0C = (1 << UCSZ01) | (1 << UCSZ00);
+        UCSR0B = (1 << RXEN0) | (1 << TXEN0) | (1 << RXCIE0);
+    }
+
+    int available() override {
+        return 0;
+    }
+
+    int read() override {
+        return -1;
+    }
+
+    int peek() override {
+        return -1;
+    }
+
+    int availableForWrite() override {
+        const byte used = (head - tail + SERIAL_TX_BUFFER_SIZE) % SERIAL_TX_BUFFER_SIZE;
+        return SERIAL_TX_BUFFER_SIZE - 1 - used;
+    }
+
+    /**
+     * Queue a byte, waiting for room in the ring if it is full. Straight into the USART if the ring is empty and the
+     * data register free, as HardwareSerial does.
+     */
+    size_t write(uint8_t b) override {
+        if (head == tail && bit_is_set(UCSR0A, UDRE0)) {
+            ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+                UDR0 = b;
+                UCSR0A = (UCSR0A & (1 << U2X0)) | (1 << TXC0);
+            }
+            return 1;
+        }
+
+        const byte next = (head + 1) % SERIAL_TX_BUFFER_SIZE;
+        while (next == tail) {
+            // With interrupts off, as in show(), the ring has to be emptied by hand
+            if (bit_is_clear(SREG, SREG_I) && bit_is_set(UCSR0A, UDRE0)) sendNext();
+        }
+        ring[head] = b;
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            head = next;
+            UCSR0B |= 1 << UDRIE0;
+        }
+        return 1;
+    }
+
+    using Print::write;
+
+    /**
+     * Move the next byte from the ring into the USART, from the data register empty interrupt.
+     */
+    void sendNext() {
+        UDR0 = ring[tail];
+        tail = (tail + 1) % SERIAL_TX_BUFFER_SIZE;
+        UCSR0A = (UCSR0A & (1 << U2X0)) | (1 << TXC0);
+        if (head == tail) UCSR0B &= ~(1 << UDRIE0);
+    }
+};
+
+TxSerial txSerial;
+
+ISR(USART_UDRE_vect) {
+    txSerial.sendNext();
+}
+
+// Everything after this writes through txSerial
+#define Serial txSerial
+
+#endif
@@ -0,0 +1,24 @@
+#pragma once
+#include <Arduino.h>
+
+/**
+ * Hints for the native simulator (lib/NativeSim), which jumps its virtual clock over time in which loop() would find
+ * nothing to do rather than stepping through it. Each handler waiting on a time of its own passes it on with
+ * wakeBy(), and the simulator runs loop() again at the earliest of those times or when the next byte arrives.
+ *
+ * Only the simulator's Arduino.h defines SIM_WAKE_HINTS; on the board the hints compile to nothing.
+ */
+#ifdef SIM_WAKE_HINTS
+
+/**
+ * @param ms The millis() at which loop() next has something to do.
+ */
+inline void wakeBy(unsigned long ms) {
+    simWakeBy(ms);
+}
+
+#else
+
+inline void wakeBy(unsigned long) {}
+
+#endif
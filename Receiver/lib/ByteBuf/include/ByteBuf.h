@@ -171,6 +171,15 @@ public:
      */
     uint8_t peekByte(size_t index);
 
+    /**
+     * Gets the readable bytes in place, for decoding without copying them out.
+     *
+     * Only `getReadableBytes()` bytes may be read, and only until the buffer is next written to or resized.
+     *
+     * @return A pointer to the byte at the reader index.
+     */
+    const uint8_t *peekBytes() const;
+
     /**
      * Peeks ahead into the buffer.
      *
@@ -206,7 +215,7 @@ public:
      * @return The peeked short.
      */
     unsigned short peekUShort(size_t index) {
-        unsigned short ret;
+        unsigned short ret = 0;
         byte *pointer = (byte *) &ret;
         pointer[0] = peekByte(index + 1);
         pointer[1] = peekByte(index);
@@ -234,7 +243,7 @@ public:
      * @return The peeked unsigned int.
      */
     unsigned int peekUInt(size_t index) {
-        unsigned int ret;
+        unsigned int ret = 0;
 #ifndef BYTEBUF_32INT
         byte *pointer = (byte *) &ret;
         pointer[1] = peekByte(index);
@@ -269,7 +278,7 @@ public:
      * @return The peeked unsigned long.
      */
     unsigned long peekULong(size_t index) {
-        unsigned long ret;
+        unsigned long ret = 0;
         byte *pointer = (byte *) &ret;
 #ifndef BYTEBUF_64LONG
         pointer[3] = peekByte(index + 0);
@@ -384,7 +393,7 @@ public:
      * @return The unsigned short.
      */
     unsigned short readUShort() {
-        unsigned short ret;
+        unsigned short ret = 0;
         byte *pointer = (byte *) &ret;
         pointer[1] = readByte();
         pointer[0] = readByte();
@@ -410,7 +419,7 @@ public:
      * @return The unsigned int.
      */
     unsigned int readUInt() {
-        unsigned int ret;
+        unsigned int ret = 0;
         byte *pointer = (byte *) &ret;
 #ifndef BYTEBUF_32INT
         pointer[1] = readByte();
@@ -443,7 +452,7 @@ public:
      * @return The unsigned long.
      */
     unsigned long readULong() {
-        unsigned long ret;
+        unsigned long ret = 0;
         byte *pointer = (byte *) &ret;
 #ifndef BYTEBUF_64LONG
         pointer[3] = readByte();
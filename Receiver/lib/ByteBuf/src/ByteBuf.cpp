@@ -85,18 +85,18 @@ void ByteBuf::skip(int num) {
 }
 
 ByteBuf ByteBuf::slice(bool trim) {
-    ByteBuf slice(trim ? getSize() : getMaxCapacity());
+    ByteBuf slice(trim ? getReadableBytes() : getMaxCapacity());
     slice.size = getReadableBytes();
-    memcpy(slice.buffer, buffer, slice.size);
+    slice.writerIndex = slice.size;
+    memcpy(slice.buffer, buffer + readerIndex, slice.size);
     return slice;
 }
 
 void ByteBuf::take() {
-    //TODO, dont use slice here, we can shuffle the data without an intermediate buffer.
-    ByteBuf sl = slice(false);
-    free(buffer);
-    buffer = sl.buffer;
-    size = sl.size;
+    // Shuffle the readable bytes down in place. Going through slice() here used to free the
+    // buffer it had just adopted, and copied from the start of the buffer rather than the reader index.
+    size = getReadableBytes();
+    memmove(buffer, buffer + readerIndex, size);
     readerIndex = 0;
     writerIndex = size;
 }
@@ -106,6 +106,10 @@ uint8_t ByteBuf::peekByte(size_t index) {
     return buffer[readerIndex + index];
 }
 
+const uint8_t *ByteBuf::peekBytes() const {
+    return buffer + readerIndex;
+}
+
 uint8_t ByteBuf::readByte() {
     if (readerIndex >= size) return 0;
     return buffer[readerIndex++];
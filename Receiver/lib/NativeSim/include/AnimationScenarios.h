@@ -0,0 +1,46 @@
+#pragma once
+
+#include "LoadGen.h"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Traffic that sets off one of the receiver's animations, and the part of the display the animation moves.
+ */
+struct AnimationScenario {
+    const char *name;
+    const char *description;
+    std::vector<PlannedSend> (*traffic)(uint64_t durationUs);
+    int probeFirst;             // The LEDs to watch
+    int probeCount;
+    uint64_t stepUs;            // How often the watched LEDs should change while the animation runs
+    uint64_t settleUs;          // Changes before this, from the start of the traffic, are not counted
+};
+
+/**
+ * How evenly an animation stepped, and what it cost the serial link.
+ */
+struct AnimationReport {
+    int sent;
+    int delivered;
+    unsigned long lostBytes;    // Ring overflows plus show() overruns
+    int shows;
+    int steps;                  // Shows that changed the watched LEDs
+    uint64_t stepP50Us;         // Time between steps, within a run of the animation
+    uint64_t stepMaxUs;
+    int dropped;                // Steps the animation skipped, going by stepUs
+};
+
+extern const AnimationScenario ANIMATION_SCENARIOS[];
+extern const int NUM_ANIMATION_SCENARIOS;
+
+/**
+ * Run a scenario against a freshly booted simulated receiver.
+ */
+AnimationReport runAnimationScenario(const AnimationScenario &scenario, uint64_t durationUs);
+
+/**
+ * Entry point for the `animation` command.
+ */
+int animationMain(int argc, char **argv);
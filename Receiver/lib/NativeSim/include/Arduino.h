@@ -0,0 +1,197 @@
+#pragma once
+
+/**
+ * Host stand-in for the parts of the Arduino core used by the receiver firmware.
+ *
+ * Every call is routed to the SimBoard the firmware is currently running on, so
+ * timing (millis(), serial baud, buzzer pins) follows the simulator's virtual clock.
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define A0 14
+
+// HardwareSerial's rings, as on the AVR core
+#define SERIAL_TX_BUFFER_SIZE 64
+#define SERIAL_RX_BUFFER_SIZE 64
+
+// Flash and RAM share one address space on the host
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *) (addr))
+#define PSTR(s) (s)
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(PSTR(s)))
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+extern uint8_t TCCR2B;
+
+unsigned long millis();
+
+// The firmware passes on the times it is waiting for (include/Wake.h), so that the clock can jump to them
+#define SIM_WAKE_HINTS
+
+void simWakeBy(unsigned long ms);
+
+// The firmware's bench markers (include/Bench.h) are recorded on the virtual clock
+#define SIM_BENCH_MARKERS
+
+void simBenchMark(uint8_t marker);
+
+// The firmware can take received bytes in an interrupt of its own (include/RxFramer.h), in place of the RX ring
+#define SIM_RX_INTERRUPT
+
+void simAttachRxInterrupt(void (*isr)(uint8_t));
+
+// The firmware can send its LEDs straight to the board, rather than through FastLED (include/LedOutput.h)
+#define SIM_LED_CAPTURE
+
+void simCaptureLeds(const uint8_t *rgb, int first, int count);
+
+unsigned long micros();
+
+void delay(unsigned long ms);
+
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+
+int digitalRead(uint8_t pin);
+
+void digitalWrite(uint8_t pin, uint8_t val);
+
+void analogWrite(uint8_t pin, int val);
+
+int analogRead(uint8_t pin);
+
+void noInterrupts();
+
+void interrupts();
+
+/**
+ * Minimal Arduino String, backed by std::string.
+ */
+class String {
+private:
+    std::string str;
+public:
+    String(const char *cstr = "") : str(cstr) {}
+
+    String(const std::string &s) : str(s) {}
+
+    String(const __FlashStringHelper *s) : str(reinterpret_cast<const char *>(s)) {}
+
+    explicit String(char c) : str(1, c) {}
+
+    String(unsigned char value, unsigned char base = DEC);
+
+    String(int value, unsigned char base = DEC);
+
+    String(unsigned int value, unsigned char base = DEC);
+
+    String(long value, unsigned char base = DEC);
+
+    String(unsigned long value, unsigned char base = DEC);
+
+    unsigned int length() const {
+        return str.length();
+    }
+
+    const char *c_str() const {
+        return str.c_str();
+    }
+
+    String &operator+=(const String &rhs) {
+        str += rhs.str;
+        return *this;
+    }
+
+    friend String operator+(const String &lhs, const String &rhs) {
+        return String(lhs.str + rhs.str);
+    }
+
+    bool operator==(const String &rhs) const {
+        return str == rhs.str;
+    }
+};
+
+/**
+ * Serial port backed by the simulated UART.
+ */
+class HardwareSerial {
+public:
+    void begin(unsigned long baud);
+
+    int available();
+
+    int peek();
+
+    int read();
+
+    void flush();
+
+    int availableForWrite();
+
+    size_t write(uint8_t b);
+
+    size_t write(const uint8_t *buf, size_t size);
+
+    size_t print(const char *str);
+
+    size_t print(const String &str);
+
+    size_t print(char c);
+
+    size_t print(unsigned char n, int base = DEC);
+
+    size_t print(int n, int base = DEC);
+
+    size_t print(unsigned int n, int base = DEC);
+
+    size_t print(long n, int base = DEC);
+
+    size_t print(unsigned long n, int base = DEC);
+
+    size_t println();
+
+    template<typename T>
+    size_t println(const T &value) {
+        size_t n = print(value);
+        return n + println();
+    }
+
+    template<typename T>
+    size_t println(const T &value, int base) {
+        size_t n = print(value, base);
+        return n + println();
+    }
+
+    explicit operator bool() const {
+        return true;
+    }
+};
+
+extern HardwareSerial Serial;
+
+void setup();
+
+void loop();
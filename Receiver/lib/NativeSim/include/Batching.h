@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * How one transition went, sent as separate packets or as one batch.
+ */
+struct BatchReport {
+    int packets;
+    long bytes;                     // On the wire
+    double meanShows;               // From the first byte to the transition being on the display, the last included
+    double meanDisplayUs;           // From the first byte on the wire to the end of the show() that finishes it
+    uint64_t worstDisplayUs;
+    unsigned long lostBytes;
+    int missed;                     // Runs in which the display never settled on the transition
+};
+
+/**
+ * The transitions compared: an end transition as four state frames, a scheduled state behind its clock frame, and
+ * the start of an uploaded round's end behind the upload and a clock frame.
+ */
+struct BatchTransition {
+    const char *name;
+    const char *description;
+};
+
+extern const BatchTransition BATCH_TRANSITIONS[];
+extern const int NUM_BATCH_TRANSITIONS;
+
+/**
+ * Send a transition to freshly booted simulated receivers, once for each run, each a little later in loop() than
+ * the last.
+ *
+ * @param isrFraming If the RX interrupt frames the packets, rather than loop() reading them from Serial.
+ */
+BatchReport runBatchTransition(int transition, bool batched, int runs, bool isrFraming);
+
+/**
+ * Entry point for the `batch` command.
+ */
+int batchMain(int argc, char **argv);
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "SimBoard.h"
+
+#include <State.h>
+
+/**
+ * When to cut the power during a simulated end, and what the receiver should come back with.
+ */
+struct BrownoutCase {
+    const char *name;
+    double cutSeconds;          // Seconds after the end starts
+    bool controllerRepeats;     // If the controller is still there to repeat its last state once the power is back
+    bool expectRestore;         // If the state should be restored on the next boot
+};
+
+/**
+ * What the receiver was doing when the power went, and what it came back with.
+ */
+struct BrownoutResult {
+    State before;
+    State after;
+    bool held;              // Red with the countdown stopped on power-on, before the controller is heard from
+    bool restored;
+    uint64_t restoreUs;     // From the controller's first repeat to the end of the show() of the restored state
+};
+
+/**
+ * EEPROM use over one full end.
+ */
+struct EndWrites {
+    unsigned long bytes;    // Bytes programmed
+    unsigned int maxCell;   // Most writes to any one cell
+};
+
+/**
+ * Run an end as the app runs it, cutting the power part-way through, then boot again from the same EEPROM.
+ */
+BrownoutResult runBrownout(const BrownoutCase &brownout);
+
+/**
+ * Run a full end from power-on and count the EEPROM writes it costs.
+ */
+EndWrites measureEndWrites();
+
+/**
+ * Entry point for the `brownout` command.
+ */
+int brownoutMain(int argc, char **argv);
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "SimBoard.h"
+
+#include <cstdint>
+
+/**
+ * A receiver whose clock runs fast or slow calibrated against the controller, which keeps true time, and a countdown
+ * timed against true time before and after. The controller sends a clock frame every interval, each held up on the
+ * link by the latency plus exponential jitter, as the app does while calibrating.
+ */
+struct CalibrationOptions {
+    double skewPpm = 5000;              // How much faster the receiver's millis() runs than true time
+    uint64_t calibrateUs = 300000000;   // From the start command to the finish, as CALIBRATION_MILLIS in the app
+    uint64_t intervalUs = 1000000;      // Between clock frames
+    double latencyMs = 10;
+    double jitterMs = 10;               // Mean
+    int time = 240;                     // Seconds the countdown starts from
+    uint32_t seed = 1;
+};
+
+const int CALIBRATION_BEEPS = 3;        // At the end of the countdown
+
+/**
+ * What the receiver made of the calibration, and the countdown measured in true time, before it and after.
+ */
+struct CalibrationRun {
+    bool calibrated;            // If the receiver kept a correction
+    int trimPpm;                // How much faster it took true time to run than millis()
+    double countdownMs[2];      // From the start of the countdown to the beeps
+    double beepsMs[2];          // From the first beep to the end of the last
+};
+
+/**
+ * Calibrate a freshly booted simulated receiver, timing a countdown before and after.
+ */
+CalibrationRun runCalibration(const CalibrationOptions &options);
+
+/**
+ * Entry point for the `calibrate` command.
+ */
+int calibrateMain(int argc, char **argv);
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * A byte on the receiver's serial line, and when its stop bit completed.
+ */
+struct CapturedByte {
+    uint64_t us;            // From the start of the capture
+    uint8_t value;
+};
+
+/**
+ * A recording of the bytes a receiver was sent. On disk it is the magic "TLCAP1", the baud as a little-endian
+ * uint32, then for each byte the microseconds since the one before as a LEB128 varint, followed by the byte.
+ * Bytes back-to-back at 9600 baud take three bytes each.
+ */
+struct Capture {
+    uint32_t baud = 9600;
+    std::vector<CapturedByte> bytes;
+};
+
+bool writeCapture(const char *path, const Capture &capture);
+
+/**
+ * @return False if the file cannot be read or is not a capture. A capture cut short keeps every whole record.
+ */
+bool readCapture(const char *path, Capture &capture, std::string &error);
+
+/**
+ * What a simulated receiver did with a capture, and a digest of everything it did, to tell whether two replays
+ * behaved the same down to the microsecond.
+ */
+struct ReplayReport {
+    long bytes;
+    int stateFrames;            // "Time value:" lines, one per state frame handled
+    int lines;                  // All lines of serial output
+    unsigned long rxOverflows;
+    unsigned long rxOverruns;
+    int shows;
+    uint64_t blackoutUs;
+    uint64_t longestBlackoutUs;
+    uint64_t endUs;
+    uint32_t digest;            // FNV-1a of the timestamped serial output and LED frames
+};
+
+/**
+ * Feed a capture to a freshly booted simulated receiver, each byte arriving at its recorded time after boot.
+ *
+ * @param printSerial Print the receiver's serial output as it was written, with virtual timestamps.
+ */
+ReplayReport replayCapture(const Capture &capture, uint64_t bootUs, bool printSerial);
+
+/**
+ * Entry point for the `capture` command.
+ */
+int captureMain(int argc, char **argv);
+
+/**
+ * Entry point for the `replay` command.
+ */
+int replayMain(int argc, char **argv);
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "SimBoard.h"
+
+#include <cstdint>
+
+/**
+ * How the extra delay on each frame is drawn.
+ */
+enum JitterModel {
+    JITTER_NONE,
+    JITTER_UNIFORM,         // Evenly from 0 to the jitter
+    JITTER_EXPONENTIAL,     // Mostly small, with a long tail; the jitter is the mean
+};
+
+/**
+ * One receiver and the controller, each with its own clock, on a link with a fixed delay and jitter each way.
+ */
+struct ClockSyncOptions {
+    uint64_t durationUs = 600000000;
+    uint64_t pingIntervalUs = 5000000;
+    uint64_t queryIntervalUs = 30000000;
+    double latencyMs = 10;              // Fixed delay each way
+    double asymmetryMs = 0;             // Extra fixed delay on the way back
+    double jitterMs = 10;
+    JitterModel model = JITTER_EXPONENTIAL;
+    double driftPpm = 500;              // How much faster the controller's clock runs than the receiver's
+    uint32_t seed = 1;
+};
+
+/**
+ * An estimate of the controller's clock minus the receiver's.
+ */
+struct ClockEstimate {
+    double offsetErrorMs;   // Estimated offset minus the true one
+    int roundTripMs;        // Of the exchange the estimate came from, -1 if none
+    int driftPpm;
+};
+
+/**
+ * Both ends' estimates at the moment the receiver answered a query.
+ */
+struct ClockSyncSample {
+    double atS;
+    double trueOffsetMs;
+    ClockEstimate receiver;
+    ClockEstimate controller;
+};
+
+const int CLOCK_SYNC_MAX_SAMPLES = 256;
+
+struct ClockSyncReport {
+    uint16_t receiverId;
+    int pings;
+    int pongs;
+    double trueRoundTripMs;     // Mean time on the link both ways, without jitter
+    int samples;
+    ClockSyncSample sample[CLOCK_SYNC_MAX_SAMPLES];
+};
+
+/**
+ * Run the exchange between the controller and one receiver.
+ */
+ClockSyncReport runClockSync(const ClockSyncOptions &options);
+
+/**
+ * Entry point for the `clocksync` command.
+ */
+int clockSyncMain(int argc, char **argv);
@@ -0,0 +1,38 @@
+#pragma once
+
+/**
+ * Host stand-in for the AVR core's EEPROM library, backed by the current SimBoard's EEPROM.
+ */
+
+#include <Arduino.h>
+
+class EEPROMClass {
+public:
+    uint8_t read(int idx);
+
+    void write(int idx, uint8_t val);
+
+    void update(int idx, uint8_t val);
+
+    uint16_t length();
+
+    template<typename T>
+    T &get(int idx, T &t) {
+        uint8_t *ptr = (uint8_t *) &t;
+        for (size_t i = 0; i < sizeof(T); ++i) {
+            ptr[i] = read(idx + i);
+        }
+        return t;
+    }
+
+    template<typename T>
+    const T &put(int idx, const T &t) {
+        const uint8_t *ptr = (const uint8_t *) &t;
+        for (size_t i = 0; i < sizeof(T); ++i) {
+            update(idx + i, ptr[i]);
+        }
+        return t;
+    }
+};
+
+extern EEPROMClass EEPROM;
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * What the line is doing when the emergency stop is pressed.
+ */
+struct EstopScenario {
+    const char *name;
+    const char *description;
+    uint64_t windowUs;          // The stop is pressed at points spread over this long
+};
+
+extern const EstopScenario ESTOP_SCENARIOS[];
+extern const int NUM_ESTOP_SCENARIOS;
+
+/**
+ * How quickly one way of sending the stop stopped the display, over every run of a scenario.
+ */
+struct EstopReport {
+    int runs;
+    int stopped;                // Runs in which the display was blanked, but for "StP" on the number
+    int held;                   // Runs in which it still showed that at the end, with nothing counting down
+    double meanUs;              // From the first byte of the stop on the wire to the end of the show() that stopped it
+    uint64_t worstUs;
+};
+
+/**
+ * Press the stop at each of the given number of points in a scenario, on a freshly booted simulated receiver each
+ * time.
+ *
+ * @param signal     If the stop goes out as the emergency stop signal ahead of the state carrying it, rather than
+ *                   as that state alone.
+ * @param isrFraming If the RX interrupt frames the packets, rather than loop() reading them from Serial.
+ */
+EstopReport runEstop(int scenario, bool signal, int runs, bool isrFraming);
+
+/**
+ * Entry point for the `estop` command.
+ */
+int estopMain(int argc, char **argv);
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "SimBoard.h"
+
+#include <cstdint>
+
+/**
+ * A run of state updates over a link that flips bits.
+ */
+struct NoiseOptions {
+    double bitErrorRate = 0;    // Chance of any one data bit being flipped, on average
+    int burst = 1;              // Bits flipped in a row for each error
+    int updates = 200;
+    uint64_t spacingUs = 500000;
+    uint32_t seed = 1;
+};
+
+/**
+ * How many of the updates the receiver took, with and without FEC.
+ */
+struct NoiseResult {
+    int sent;
+    int delivered;      // Handled with the time value that was sent
+    int wrong;          // Handled with a time value that was never sent
+    int corrected;      // Delivered only because FEC corrected it
+    long flippedBits;
+};
+
+/**
+ * Send the updates to a freshly booted simulated receiver.
+ *
+ * @param fec If the updates go out as FEC packets rather than plain ones.
+ */
+NoiseResult runNoisyLink(const NoiseOptions &options, bool fec);
+
+/**
+ * Entry point for the `fec` command.
+ */
+int fecMain(int argc, char **argv);
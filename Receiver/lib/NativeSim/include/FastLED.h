@@ -0,0 +1,159 @@
+#pragma once
+
+/**
+ * Host stand-in for the parts of FastLED used by the receiver firmware.
+ *
+ * show() does not drive any hardware; it hands the scaled GRB output to the
+ * current SimBoard, which records the frame and charges the WS2812 clock-out time.
+ * Temporal dithering is done as FastLED does it, unless simDithering is cleared.
+ */
+
+#include <Arduino.h>
+
+enum EOrder {
+    RGB = 0012,
+    RBG = 0021,
+    GRB = 0102,
+    GBR = 0120,
+    BRG = 0201,
+    BGR = 0210
+};
+
+enum LEDColorCorrection {
+    TypicalSMD5050 = 0xFFB0F0,
+    TypicalLEDStrip = 0xFFB0F0,
+    Typical8mmPixel = 0xFFE08C,
+    TypicalPixelString = 0xFFE08C,
+    UncorrectedColor = 0xFFFFFF
+};
+
+const uint8_t DISABLE_DITHER = 0x00;
+const uint8_t BINARY_DITHER = 0x01;
+
+/**
+ * If chains left dithering show dithered bytes. Cleared, every chain shows the same bytes for the same LEDs, so that
+ * frames can be compared byte for byte whether the firmware dithers or not.
+ */
+extern bool simDithering;
+
+struct CRGB {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+
+    CRGB() = default;
+
+    CRGB(uint8_t ir, uint8_t ig, uint8_t ib) : r(ir), g(ig), b(ib) {}
+
+    CRGB(uint32_t colorcode) : r((colorcode >> 16) & 0xFF), g((colorcode >> 8) & 0xFF), b(colorcode & 0xFF) {}
+
+    CRGB &operator=(uint32_t colorcode) {
+        r = (colorcode >> 16) & 0xFF;
+        g = (colorcode >> 8) & 0xFF;
+        b = colorcode & 0xFF;
+        return *this;
+    }
+
+    bool operator==(const CRGB &rhs) const {
+        return r == rhs.r && g == rhs.g && b == rhs.b;
+    }
+
+    bool operator!=(const CRGB &rhs) const {
+        return !(*this == rhs);
+    }
+};
+
+template<uint8_t DATA_PIN, EOrder RGB_ORDER>
+class WS2812 {
+};
+
+template<uint8_t DATA_PIN, EOrder RGB_ORDER>
+class WS2812B {
+};
+
+/**
+ * One chain of LEDs on a data pin.
+ */
+class CLEDController {
+public:
+    CRGB *leds = nullptr;
+    int numLeds = 0;
+    int first = 0;      // Where the chain's LEDs start in the whole display, counting earlier chains
+    uint8_t pin = 0;
+    EOrder order = GRB;
+    CRGB correction = CRGB(UncorrectedColor);
+    uint8_t dither = BINARY_DITHER;
+
+    CLEDController &setCorrection(CRGB c) {
+        correction = c;
+        return *this;
+    }
+
+    CLEDController &setCorrection(LEDColorCorrection c) {
+        correction = CRGB((uint32_t) c);
+        return *this;
+    }
+
+    CLEDController &setDither(uint8_t mode) {
+        dither = mode;
+        return *this;
+    }
+
+    /**
+     * Scale this chain's LEDs by brightness and colour correction, and dither them, into the bytes for the wire.
+     *
+     * @param wire Three bytes for each LED, in wire order.
+     */
+    void encode(uint8_t brightness, uint8_t *wire);
+
+    /**
+     * Encode this chain's LEDs, then clock them out on its data pin.
+     */
+    void showLeds(uint8_t brightness = 255);
+};
+
+class CFastLED {
+private:
+    static const int MAX_CONTROLLERS = 8;
+    CLEDController controllers[MAX_CONTROLLERS];
+    int numControllers = 0;
+    uint8_t brightness = 255;
+
+    CLEDController &add(CRGB *data, int nLeds, uint8_t pin, EOrder order);
+public:
+    template<template<uint8_t DATA_PIN, EOrder RGB_ORDER> class CHIPSET, uint8_t DATA_PIN, EOrder RGB_ORDER>
+    static CLEDController &addLeds(CRGB *data, int nLeds);
+
+    void setBrightness(uint8_t scale) {
+        brightness = scale;
+    }
+
+    uint8_t getBrightness() const {
+        return brightness;
+    }
+
+    int count() const {
+        return numControllers;
+    }
+
+    CLEDController &operator[](int x) {
+        return controllers[x];
+    }
+
+    /**
+     * Set the dithering of every chain added so far.
+     */
+    void setDither(uint8_t mode = BINARY_DITHER);
+
+    /**
+     * Show every chain in turn, at the global brightness, undithered.
+     */
+    void show();
+};
+
+extern CFastLED FastLED;
+
+template<template<uint8_t DATA_PIN, EOrder RGB_ORDER> class CHIPSET, uint8_t DATA_PIN, EOrder RGB_ORDER>
+CLEDController &CFastLED::addLeds(CRGB *data, int nLeds) {
+    return FastLED.add(data, nLeds, DATA_PIN, RGB_ORDER);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "SimBoard.h"
+
+#include <cstdint>
+
+/**
+ * A tournament field of receivers, one per buttress, all on the one radio channel with the controller.
+ */
+struct FleetOptions {
+    int receivers = 40;
+    int ends = 5;
+    int threads = 0;                    // Receivers run at once; 0 for one per core
+    uint64_t minDelayUs = 5000;         // Fixed radio delay, picked per receiver from this range
+    uint64_t maxDelayUs = 15000;
+    uint64_t jitterUs = 20000;          // Extra delay, picked per packet from 0 to this
+    double loss = 0;                    // Chance of any one receiver missing any one packet
+    uint64_t pollGapUs = 60000;         // Between the controller's queries to each receiver by its id
+    uint64_t repeatUs = 250000;         // The controller repeats the state last sent this often
+    uint32_t seed = 1;
+};
+
+const int FLEET_MAX_COMMANDS = 3 * 20;
+const int FLEET_MAX_REPLIES = 16;
+
+/**
+ * A frame a receiver sent back, as it went over the air, in controller time.
+ */
+struct FleetReply {
+    uint64_t startUs;
+    uint64_t endUs;
+    uint8_t type;                       // FRAME_CLOCK_REPORT or FRAME_PONG
+};
+
+/**
+ * What one receiver did over the session.
+ */
+struct FleetReceiver {
+    uint16_t id;                                // The id it picked for itself
+    int replies;
+    FleetReply reply[FLEET_MAX_REPLIES];
+    uint64_t lightUs[FLEET_MAX_COMMANDS];       // End of the show() that first displayed each command, 0 if none
+};
+
+/**
+ * Run every receiver through the session, `threads` at a time. Each is its own process, forked from the calling
+ * thread alone, so the receivers share nothing but what goes over the radio.
+ *
+ * @param found The ids the controller heard clear in each discovery round so far.
+ * @param ids   The ids the receivers picked, to query one by one; empty while discovering, when the session stops
+ *              after one more round of reports.
+ */
+std::vector<FleetReceiver> runFleet(const FleetOptions &options, const std::vector<std::vector<uint16_t>> &found,
+                                    const std::vector<uint16_t> &ids, int threads);
+
+/**
+ * Entry point for the `fleet` command.
+ */
+int fleetMain(int argc, char **argv);
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "LoadGen.h"
+#include "SimBoard.h"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * The controller's end of the link: writes each packet when it falls due or, if it follows the receiver's flow
+ * control, once the receiver lets it go. It hears each flow byte reactionUs after its stop bit. A packet once written
+ * goes out whole, as the app hands each to the USB serial adapter in one write.
+ */
+class FlowController {
+private:
+    SimBoard &sim;
+    const std::vector<PlannedSend> &sends;
+    uint64_t startUs;
+    uint64_t reactionUs;
+    bool follows;
+    size_t next;
+    size_t scanned;                             // Of the receiver's TX bytes
+    std::vector<std::pair<uint64_t, bool>> heard;   // When each flow byte was heard, and if it was FLOW_BUSY
+
+    uint64_t freeAt(uint64_t us) const;
+public:
+    std::vector<uint64_t> lastByteUs;           // Of each send, once written
+
+    FlowController(SimBoard &sim, const std::vector<PlannedSend> &sends, uint64_t startUs, uint64_t reactionUs,
+                   bool follows);
+
+    /**
+     * Write whatever falls due by the given time. Set as the board's peer (SimBoard::setPeer()).
+     */
+    void operator()(uint64_t nowUs);
+
+    bool done() const;
+
+    /**
+     * Time spent holding off, and how many holds ran out without FLOW_READY, up to the given time.
+     */
+    uint64_t heldUs(uint64_t untilUs) const;
+
+    int timeouts(uint64_t untilUs) const;
+};
+
+/**
+ * State updates, each with a new time, at random intervals around the given rate.
+ */
+struct FlowOptions {
+    double rate = 4;                // Updates a second
+    int updates = 200;
+    bool countdown = true;          // Each update has the countdown running, so it ticks between them
+    uint64_t reactionUs = 5000;     // From the stop bit of a flow byte to the controller acting on it
+    int cutEvery = 0;               // Every this many updates is followed by the start of another, as a frame cut short
+                                    // on the link leaves; 0 for none
+    uint32_t seed = 1;
+};
+
+/**
+ * What happened to the updates in one run.
+ */
+struct FlowReport {
+    double rate;
+    int sent;
+    int delivered;
+    unsigned long rxOverflows;      // Dropped by the RX ISR, HardwareSerial ring full
+    unsigned long rxOverruns;       // Lost in the USART while show() had interrupts off
+    int shows;
+    int busy;                       // FLOW_BUSY written by the receiver
+    int timeouts;
+    double heldPercent;             // Of the run
+    uint64_t longestHoldUs;         // From a FLOW_BUSY to the next flow byte the receiver writes
+    uint64_t latencyP50Us;          // From when an update fell due to the receiver's debug echo of it
+    uint64_t latencyMaxUs;
+};
+
+/**
+ * Run the updates against a freshly booted simulated receiver.
+ *
+ * @param flowControl If the receiver sends FLOW_BUSY and FLOW_READY and the controller holds off between them,
+ *                    rather than the controller writing each update when it falls due.
+ * @param splitChains If the receiver is wired with a chain per region of the display, rather than one chain.
+ */
+FlowReport runFlow(const FlowOptions &options, bool flowControl, bool splitChains);
+
+/**
+ * Entry point for the `flow` command.
+ */
+int flowMain(int argc, char **argv);
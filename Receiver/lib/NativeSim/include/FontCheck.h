@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * How the flash font in SegmentFont.h compares with the SRAM digit bitmaps it replaced.
+ */
+struct FontReport {
+    int mismatchedDigits;   // Digits that light different LEDs than the old bitmaps did
+    int badGlyphs;          // Glyphs using a bit that is not a segment
+    size_t sramBefore;      // Bytes of glyph tables in SRAM on the AVR
+    size_t sramAfter;
+    size_t flashBefore;     // Bytes of glyph tables in flash, counting the copy SRAM data is initialised from
+    size_t flashAfter;
+    double oldDigit;        // Host cycles (or ns) to draw one digit from the 64-bit bitmaps
+    double newGlyph;        // And one glyph from the font
+};
+
+FontReport checkFont();
+
+/**
+ * Entry point for the `font` command.
+ */
+int fontMain(int argc, char **argv);
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "UartScenarios.h"
+
+#include <cstdint>
+
+/**
+ * How one RX path coped with a traffic scenario: HardwareSerial's ring read byte by byte in loop(), or the
+ * firmware's own RX interrupt framing each byte as it arrives (include/RxFramer.h).
+ */
+struct FramingReport {
+    int sent;
+    int delivered;
+    long bytes;
+    unsigned long lostBytes;        // Overflowing the ring, or overrun in the USART while show() had interrupts off
+    long loopReads;                 // Bytes loop() took from Serial
+    double meanLatencyUs;           // From the last byte of a packet on the wire to handlePacket() starting on it
+    uint64_t maxLatencyUs;
+};
+
+/**
+ * Run a scenario against a freshly booted simulated receiver.
+ *
+ * @param isrFraming If the RX interrupt frames the packets, rather than loop() reading them from Serial.
+ */
+FramingReport runFraming(const UartScenario &scenario, uint64_t durationUs, bool splitChains, bool isrFraming);
+
+/**
+ * Entry point for the `framing` command.
+ */
+int framingMain(int argc, char **argv);
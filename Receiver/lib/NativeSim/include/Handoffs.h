@@ -0,0 +1,49 @@
+#pragma once
+
+#include "SimBoard.h"
+
+#include <cstdint>
+
+/**
+ * A matchplay end shot in alternation by the two sides, each on its own receiver: A/B (left) first, then C/D
+ * (right), and so on.
+ */
+struct HandoffOptions {
+    int arrows = 3;                     // Each side shoots this many, one per turn
+    int time = 20;                      // Seconds per turn
+    uint64_t shotUs = 0;                // After a turn starts, when the judge stops it; 0 to let every turn time out
+    uint64_t delayUs = 100000;          // Each radio hop, on top of the bytes' own time on the wire
+    uint64_t noticeUs = 200000;         // For the app to react to a receiver's turn ending
+    uint64_t repeatUs = 250000;         // The controller repeats the state last sent this often
+    double loss = 0;                    // Chance of the radio losing any one packet
+    uint32_t seed = 1;
+};
+
+/**
+ * How the turns passed from one side to the other.
+ */
+struct HandoffReport {
+    int handoffs;               // Turns that should have passed to the other side
+    int missed;                 // Of those, never started on the other side
+    int overlapped;             // Started on the other side before this side's light left green
+    double meanGapUs;           // Of the rest, from one side's light leaving green to the other's turning green
+    int64_t minGapUs;
+    int64_t maxGapUs;
+    double meanFromStopUs;      // From the judge stopping a turn to the other side's green, if turns were stopped
+    int64_t maxFromStopUs;
+    int packets;                // On the radio, from the controller and both receivers
+    int passes;                 // Runs of the two receivers before what each heard from the other settled
+};
+
+/**
+ * Run the end on two freshly booted simulated receivers sharing the radio channel.
+ *
+ * @param direct If the receivers hand the turn to each other, rather than the controller relaying each change after
+ *               hearing the turn end.
+ */
+HandoffReport runHandoffs(const HandoffOptions &options, bool direct);
+
+/**
+ * Entry point for the `handoff` command.
+ */
+int handoffMain(int argc, char **argv);
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "PaletteCheck.h"
+
+/**
+ * Run the palette command's script with the palettes baked, as the LED backends other than FastLED need
+ * (include/LedOutput.h).
+ *
+ * @param capture     If the LEDs go to the capture backend, rather than FastLED.
+ * @param splitChains If the receiver is wired with a chain per region of the display, rather than one chain.
+ */
+PaletteRun runBackend(bool capture, bool splitChains);
+
+/**
+ * Entry point for the `leds` command.
+ */
+int ledsMain(int argc, char **argv);
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "SimBoard.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * The kinds of state packet the load generator can send.
+ * Every packet carries a fresh tag in its time field, so each one changes the numeric display.
+ */
+enum PacketKind {
+    KIND_TIME,          // New time only
+    KIND_COLOUR,        // New time, next traffic light colour
+    KIND_DETAIL,        // New time, next detail
+    KIND_COUNTDOWN,     // New time, countdown toggled on/off
+    KIND_REPEAT,        // Byte-for-byte copy of the previous packet
+    KIND_ESTOP,         // New time, emergency stop set
+    NUM_KINDS
+};
+
+extern const char *const PACKET_KIND_NAMES[NUM_KINDS];
+
+/**
+ * What to send, and how fast.
+ */
+struct LoadProfile {
+    double rate = 10;               // Average packets per second
+    int burst = 1;                  // Packets sent back-to-back at the start of each burst
+    double garbage = 0;             // Garbage bytes injected before each packet, per packet byte
+    int mix[NUM_KINDS] = {6, 2, 1, 0, 1, 0};
+    int packets = 200;              // Packets per trial
+    uint32_t seed = 1;
+};
+
+/**
+ * A packet as it goes out, preceded by any garbage bytes.
+ */
+struct PlannedSend {
+    uint64_t startUs;               // When the sender starts writing, relative to the start of the trial
+    std::vector<uint8_t> bytes;     // Garbage followed by the packet
+    int garbageBytes;
+    int tag;                        // The time value the packet carries
+    PacketKind kind;
+};
+
+/**
+ * Build the full, deterministic list of sends for a trial.
+ */
+std::vector<PlannedSend> planLoad(const LoadProfile &profile);
+
+/**
+ * Highest packet rate the link can carry for this profile, in packets per second.
+ */
+double wireRate(const LoadProfile &profile, unsigned long baud);
+
+/**
+ * Work out which sends the receiver handled, from the "Time value:" line handlePacket() prints for every
+ * packet that passes the checksum (with DEBUG_LOGGING).
+ *
+ * @param sends  The packets, in the order they were sent.
+ * @param lines  The receiver's serial output.
+ * @param fromUs Lines before this time are ignored.
+ * @return       For each send, the time its acknowledgement was written, or 0 if there was none.
+ */
+std::vector<uint64_t> findAcks(const std::vector<PlannedSend> &sends, const std::vector<SerialLine> &lines,
+                               uint64_t fromUs);
+
+/**
+ * Summary of one trial. Latencies are in microseconds, from the last byte of a packet on the wire to the end
+ * of the show() that first displayed it (simulator), or to the receiver's debug echo of it (device).
+ */
+struct TrialResult {
+    double rate;
+    int sent;
+    int delivered;
+    int displayed;
+    long garbageBytes;
+    unsigned long rxOverflows;
+    unsigned long rxOverruns;
+    int shows;
+    uint64_t latencyMin;
+    uint64_t latencyP50;
+    uint64_t latencyP95;
+    uint64_t latencyP99;
+    uint64_t latencyMax;
+    uint64_t latencyMean;
+};
+
+/**
+ * Run a trial against a freshly booted simulated receiver.
+ */
+TrialResult runSimTrial(const LoadProfile &profile);
+
+/**
+ * Run a trial against a real receiver (or radio dongle) on a serial device.
+ *
+ * @param fd   The open, configured serial device.
+ * @param baud The baud the device is configured for.
+ */
+TrialResult runDeviceTrial(const LoadProfile &profile, int fd, unsigned long baud);
+
+/**
+ * Open a serial device raw, 8N1, at the given baud.
+ *
+ * @return The file descriptor, or -1 on failure.
+ */
+int openSerial(const char *path, unsigned long baud);
+
+/**
+ * Entry point for the `loadgen` command.
+ */
+int loadGenMain(int argc, char **argv);
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "SimBoard.h"
+
+#include <cstdint>
+
+/**
+ * A line of receivers all listening to one controller, each through its own radio.
+ */
+struct LockstepOptions {
+    int receivers = 8;
+    int ends = 5;
+    uint64_t leadUs = 250000;           // How far ahead the controller sends scheduled frames
+    uint64_t minDelayUs = 5000;         // Fixed radio delay, picked per receiver from this range
+    uint64_t maxDelayUs = 15000;
+    uint64_t jitterUs = 20000;          // Extra delay, picked per frame from 0 to this
+    uint32_t seed = 1;
+};
+
+const int LOCKSTEP_MAX_COMMANDS = 3 * 20;
+
+/**
+ * When one receiver acted on each command, in controller time. 0 if it never did.
+ */
+struct ReceiverActivations {
+    uint64_t lightUs[LOCKSTEP_MAX_COMMANDS];    // End of the show() that first displayed the command
+    uint64_t beepUs[LOCKSTEP_MAX_COMMANDS];     // The buzzer starting, for commands that beep
+};
+
+/**
+ * How far apart the receivers acted on the same commands.
+ */
+struct SkewSummary {
+    int commands;           // Commands every receiver acted on
+    uint64_t skewP50Us;     // Latest receiver minus earliest, per command
+    uint64_t skewMaxUs;
+    uint64_t latencyP50Us;  // From the command's time to a receiver acting on it
+};
+
+/**
+ * Run every receiver through the ends, sending each command either as a plain state frame at its time or as a
+ * scheduled frame ahead of it.
+ *
+ * @param options   The line and its links.
+ * @param scheduled If commands are sent as scheduled frames.
+ * @return          Each receiver's activations.
+ */
+std::vector<ReceiverActivations> runLockstep(const LockstepOptions &options, bool scheduled);
+
+/**
+ * Entry point for the `lockstep` command.
+ */
+int lockstepMain(int argc, char **argv);
@@ -0,0 +1,175 @@
+#pragma once
+
+#include "SimBoard.h"
+
+#include <Frames.h>
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Host-side packet encoder, mirroring SerialCommunications.sendPacket() in the controller app:
+ * 4 byte HEADER, total size byte, 16 bit big-endian checksum of the data, then the data.
+ */
+
+const uint8_t PACKET_HEADER[4] = {0xA4, 0x11, 0xE4, 0xD8};
+
+/**
+ * The fields of a state packet, as set by the app's SerialState.
+ */
+struct StateFields {
+    bool countdownContinues = false;
+    bool lastEnd = false;
+    bool emergencyStop = false;
+    bool matchplay = false;
+    bool countdown = false;
+    uint8_t detail = 0;         // 0 = off, 1 = A/B, 2 = C/D
+    uint8_t colour = 0;         // 0 = red, 1 = amber, 2 = green
+    bool timeEnabled = false;
+    int16_t time = 0;
+    int16_t startNumBeeps = 0;
+    int16_t endNumBeeps = 0;
+};
+
+/**
+ * Pack the flag bits the way SerialState.pack() does.
+ */
+uint16_t packStateFlags(const StateFields &fields);
+
+/**
+ * Wrap a data segment in the header, size and checksum.
+ *
+ * @param data The data segment.
+ * @return     The full packet, ready to be written to the wire.
+ */
+std::vector<uint8_t> encodePacket(const std::vector<uint8_t> &data);
+
+/**
+ * Build the full packet that SerialCommunications.sendState() would send for these fields.
+ */
+std::vector<uint8_t> encodeStatePacket(const StateFields &fields);
+
+/**
+ * Wrap a frame in an FEC packet instead: the FEC header, then the frame's length and the frame itself, encoded so
+ * that flipped bits can be corrected (see Fec.h).
+ *
+ * @param data The frame, at most FEC_MAX_DATA bytes.
+ * @return     The full packet, ready to be written to the wire.
+ */
+std::vector<uint8_t> encodeFecPacket(const std::vector<uint8_t> &data);
+
+/**
+ * Build the FEC packet carrying the state frame for these fields.
+ */
+std::vector<uint8_t> encodeFecStatePacket(const StateFields &fields);
+
+/**
+ * Build a clock frame, giving the controller's clock at the moment it starts sending.
+ */
+std::vector<uint8_t> encodeClockPacket(uint32_t controllerMs);
+
+/**
+ * Build a frame carrying a state for the receiver to act on once the controller's clock reaches the given time.
+ */
+std::vector<uint8_t> encodeScheduledStatePacket(uint32_t atMs, const StateFields &fields);
+
+/**
+ * Build a state frame tagged with its generation, as SerialCommunications.sendState() sends it to be repeated.
+ */
+std::vector<uint8_t> encodeGenerationPacket(uint16_t generation, const StateFields &fields);
+
+/**
+ * Wrap the frame of a packet in a generation, as SerialCommunications.sendGeneration() does with a scheduled state.
+ */
+std::vector<uint8_t> encodeGenerationPacket(uint16_t generation, const std::vector<uint8_t> &packet);
+
+/**
+ * Build the upload of a round for the receiver to run itself, as SerialCommunications.sendRoundSchedule() sends it.
+ */
+std::vector<uint8_t> encodeRoundSchedulePacket(const RoundScheduleFrame &schedule);
+
+/**
+ * Build a command for the uploaded round.
+ *
+ * @param sequence Changes with every new command; repeats of one keep its sequence.
+ * @param command  One of the ROUND_* commands in Round.h.
+ * @param atMs     Controller time to act at.
+ */
+std::vector<uint8_t> encodeRoundControlPacket(uint8_t sequence, uint8_t command, uint32_t atMs);
+
+/**
+ * Build a matchplay handoff, as a receiver sends it to its partner or SerialCommunications.sendHandoff() sends the
+ * first turn of a match.
+ */
+std::vector<uint8_t> encodeHandoffPacket(const HandoffFrame &frame);
+
+/**
+ * Build a batch carrying the frames of these packets in order, for the receiver to apply together.
+ *
+ * @param packets Whole packets, as built by the encoders here.
+ */
+std::vector<uint8_t> encodeBatchPacket(const std::vector<std::vector<uint8_t>> &packets);
+
+/**
+ * Build the emergency stop signal as SerialCommunications.sendEmergencyStop() sends it, ahead of the state carrying
+ * the stop: ESTOP_SIGNAL_COPIES copies back to back, outside any packet.
+ */
+std::vector<uint8_t> encodeEmergencyStopSignal();
+
+/**
+ * Build a ping for the given receiver.
+ *
+ * @param receiverId   The receiver to answer, or ANY_RECEIVER.
+ * @param sequence     This ping's sequence number.
+ * @param t1           The controller's clock at the moment it starts sending.
+ * @param lastSequence The sequence number of the last pong heard, or this ping's if none has been.
+ * @param t4           When the first byte of that pong arrived, by the controller's clock.
+ */
+std::vector<uint8_t> encodePingPacket(uint16_t receiverId, uint8_t sequence, uint32_t t1, uint8_t lastSequence,
+                                      uint32_t t4);
+
+/**
+ * Build a frame asking the given receiver for its clock estimate.
+ */
+std::vector<uint8_t> encodeClockQueryPacket(uint16_t receiverId);
+
+/**
+ * Build a calibration command, as SerialCommunications.startCalibration() and syncClocks() send it.
+ *
+ * @param receiverId The receiver to act on it, or ANY_RECEIVER.
+ * @param command    One of the CALIBRATE_* commands in ClockTrim.h.
+ */
+std::vector<uint8_t> encodeCalibratePacket(uint16_t receiverId, uint8_t command);
+
+/**
+ * A frame sent by the receiver.
+ */
+struct DecodedFrame {
+    uint64_t endUs;             // When its last byte went out
+    std::vector<uint8_t> data;  // The data segment
+};
+
+/**
+ * A flow control byte sent by the receiver.
+ */
+struct DecodedFlow {
+    uint64_t us;                // When it went out
+    bool busy;                  // FLOW_BUSY, rather than FLOW_READY
+};
+
+/**
+ * Pick out the frames the receiver wrote from among its debug text, as the app's FrameReader does. Frames that fail
+ * their checksum are skipped a byte at a time. Flow control bytes are picked out wherever a frame could start, without
+ * waiting on the bytes after them.
+ *
+ * @param bytes Everything the receiver has written.
+ * @param next  Where to start looking. Moved on past the frames found, stopping at any frame still being written.
+ * @param flow  If given, the flow control bytes found are added to it.
+ */
+std::vector<DecodedFrame> decodeFrames(const std::vector<TxByte> &bytes, size_t &next,
+                                       std::vector<DecodedFlow> *flow = nullptr);
+
+/**
+ * Read a big-endian field out of a frame's data.
+ */
+uint32_t readField(const std::vector<uint8_t> &data, size_t offset, size_t size);
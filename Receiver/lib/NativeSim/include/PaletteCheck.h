@@ -0,0 +1,48 @@
+#pragma once
+
+#include "SimBoard.h"
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * The frames of a scripted run through every colour, a lamp fade and an emergency stop, with the brightness switch
+ * flipped on the way, one of them part-way through the fade.
+ */
+struct PaletteRun {
+    static const size_t MAX_FRAMES = 4096;
+
+    size_t frames;
+    uint64_t showUs;                // Spent in show(), over every frame
+    uint32_t hashes[MAX_FRAMES];    // Of the bytes on the wire, one per show
+};
+
+/**
+ * Run the script against a freshly booted simulated receiver.
+ *
+ * @param baked       If brightness and colour correction are baked into palettes, rather than applied by FastLED.
+ * @param dithering   If the sim dithers as FastLED does, where the chains ask it to.
+ * @param splitChains If the receiver is wired with a chain per region of the display, rather than one chain.
+ * @param capture     If the LEDs go straight to the board (ledCapture), rather than through FastLED.
+ */
+PaletteRun runPalette(bool baked, bool dithering, bool splitChains, bool capture);
+
+/**
+ * Frames at the same place in two runs that differ, counting any one run has and the other does not.
+ */
+size_t differing(const PaletteRun &a, const PaletteRun &b);
+
+/**
+ * Host cycles (or ns) to encode the whole display for the wire, as FastLED does on every show().
+ */
+struct EncodeTiming {
+    double scaled;      // At the low brightness, with colour correction and dithering
+    double raw;         // At full brightness with neither, as the baked palettes leave it
+};
+
+EncodeTiming timeEncode();
+
+/**
+ * Entry point for the `palette` command.
+ */
+int paletteMain(int argc, char **argv);
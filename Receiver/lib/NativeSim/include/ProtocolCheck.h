@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Check the simulator's hand-written packet encoders, which mirror the app's, against the generated decoders. Every
+ * field of every frame is round-tripped by the unit test in test/test_protocol.
+ */
+bool checkSimEncoders();
+
+/**
+ * Host code size and time of decoding a state frame, the generated way and the way handlePacket() used to.
+ */
+struct DecodeCost {
+    size_t bytes;
+    double cycles;      // Per frame, or nanoseconds where there is no cycle counter
+};
+
+struct DecodeComparison {
+    DecodeCost byteBufShifts;   // ByteBuf::readInt() and shifts, as before
+    DecodeCost byteBufFrame;    // decodeStateFrame() in place in the ByteBuf, as handlePacket() does now
+    DecodeCost arrayFrame;      // decodeStateFrame() straight from a byte array
+};
+
+DecodeComparison compareDecode();
+
+/**
+ * Entry point for the `protocol` command.
+ */
+int protocolMain(int argc, char **argv);
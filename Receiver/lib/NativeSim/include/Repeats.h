@@ -0,0 +1,37 @@
+#pragma once
+
+#include "SimBoard.h"
+
+#include <cstdint>
+
+/**
+ * A countdown started by one state frame, which the controller then repeats unchanged.
+ */
+struct RepeatOptions {
+    uint64_t durationUs = 30000000;
+    uint64_t intervalUs = 250000;       // Between repeats
+    bool generation = true;             // If the repeats go out as generation frames, rather than plain ones
+};
+
+/**
+ * What the repeats cost the receiver, after the first copy.
+ */
+struct RepeatReport {
+    int repeats;
+    double busyUs;          // Mean, from a repeat's last byte to the end of the loop() pass that took it
+    uint64_t maxBusyUs;
+    double txBytes;         // Debug output per repeat
+    int shows;              // LED frames clocked out over the whole run
+    int rewinds;            // Repeats that put the countdown back to the time the controller started it at
+    double hostNs;          // Host time per call of handleFrame() with a repeat
+};
+
+/**
+ * Run the countdown against a freshly booted simulated receiver.
+ */
+RepeatReport runRepeats(const RepeatOptions &options);
+
+/**
+ * Entry point for the `repeats` command.
+ */
+int repeatsMain(int argc, char **argv);
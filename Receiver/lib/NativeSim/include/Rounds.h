@@ -0,0 +1,62 @@
+#pragma once
+
+#include "SimBoard.h"
+
+#include <cstdint>
+
+/**
+ * A round of ends, each shot by one or two details in turn, as the range would run it.
+ */
+struct RoundOptions {
+    int ends = 2;
+    int details = 2;                    // 1 A/B alone, 2 A/B and C/D in turn
+    bool rotate = true;                 // C/D shoots first in every other end
+    int walkUp = 10;                    // Seconds
+    int maxTime = 120;
+    int warnTime = 30;
+    uint64_t scoringUs = 20000000;      // Between one end finishing and the controller starting the next
+    uint64_t repeatUs = 250000;         // The controller repeats the frame last sent this often
+    double loss = 0;                    // Chance of the radio losing any one packet
+    bool skipIdle = true;               // Jump the clock over idle time, rather than stepping loop() through it
+    uint32_t seed = 1;
+};
+
+enum RoundTransition {
+    TRANSITION_WALK_UP,     // Amber, the detail walks up to the line
+    TRANSITION_SHOOT,       // Green
+    TRANSITION_WARN,        // Amber, warnTime left
+    TRANSITION_END,         // Red, the end is over
+    NUM_TRANSITIONS
+};
+
+/**
+ * How the round went on one receiver.
+ */
+struct RoundReport {
+    int frames;                                 // Distinct frames the controller sent for the round
+    int frameBytes;                             // Their bytes on the wire, repeats aside
+    int packets;                                // Sent, counting repeats
+    int lost;                                   // Of those, lost by the radio
+    int transitions[NUM_TRANSITIONS];
+    int missed[NUM_TRANSITIONS];                // Not on the lights before the next transition was due
+    int early[NUM_TRANSITIONS];                 // The lights changed before its frame was heard, or before it
+                                                // was due if the receiver makes it by itself
+    double meanLatencyUs[NUM_TRANSITIONS];      // From when the transition was due to the lights showing it, once
+    int64_t minLatencyUs[NUM_TRANSITIONS];      // its frame was heard
+    int64_t maxLatencyUs[NUM_TRANSITIONS];
+    int timed[NUM_TRANSITIONS];                 // Shown once heard, so counted in the latencies
+    uint64_t simulatedUs;
+    unsigned long passes;                       // Of loop()
+};
+
+/**
+ * Run the round on a freshly booted simulated receiver.
+ *
+ * @param uploaded If the controller uploads the round and starts each end, rather than sending every phase.
+ */
+RoundReport runRound(const RoundOptions &options, bool uploaded);
+
+/**
+ * Entry point for the `round` command.
+ */
+int roundMain(int argc, char **argv);
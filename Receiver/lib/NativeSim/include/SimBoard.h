@@ -0,0 +1,420 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <sys/types.h>
+
+/**
+ * Time charged to the virtual clock for work the firmware does, in microseconds.
+ *
+ * The defaults are estimates for a 16 MHz Uno, not measurements.
+ */
+struct CostModel {
+    uint32_t loopUs = 20;       // One pass through loop() that finds nothing to do
+    uint32_t readByteUs = 4;    // Serial.read() plus ByteBuf::writeByte()
+    uint32_t writeByteUs = 4;   // Serial.write() into the TX ring
+    uint32_t ledUs = 30;        // WS2812 clock-out per LED (24 bits at 800 kHz)
+    uint32_t latchUs = 50;      // WS2812 reset gap at the end of each show()
+    uint32_t eepromWriteUs = 3400;  // Programming one EEPROM byte, which eeprom_write_byte() waits out
+    uint32_t rxIsrUs = 4;       // The firmware's own RX interrupt framing a byte (include/RxFramer.h); HardwareSerial's
+                                // putting one in its ring is not charged
+};
+
+/**
+ * A chain of LEDs clocked out by FastLED. The hashes cover the whole display as it stands after the chain is sent,
+ * so frames can be compared however the LEDs are split into chains.
+ */
+struct ShownFrame {
+    uint64_t startUs;
+    uint64_t endUs;
+    uint32_t hash;      // FNV-1a of the GRB bytes of every LED
+    bool changed;       // If the bytes differ from the previous frame
+    uint32_t probe;     // FNV-1a of just the LEDs set with setProbe() and addProbe()
+    size_t leds;        // How many were clocked out
+};
+
+/**
+ * A change of the PWM level on a pin, e.g. the buzzer starting or stopping.
+ */
+struct AnalogChange {
+    uint64_t us;
+    uint8_t pin;
+    int level;
+};
+
+/**
+ * A byte written by the firmware to Serial.
+ */
+struct TxByte {
+    uint64_t us;        // When its stop bit completes
+    uint8_t value;
+};
+
+/**
+ * A bench marker written by the firmware (include/Bench.h).
+ */
+struct BenchMarker {
+    uint64_t us;
+    uint8_t id;
+};
+
+/**
+ * A line of text written by the firmware to Serial.
+ */
+struct SerialLine {
+    uint64_t us;        // When the newline was queued for transmission
+    std::string text;
+};
+
+/**
+ * The simulated Uno the firmware runs on: a virtual clock, the serial port, the GPIO pins and the LED data pin.
+ *
+ * Nothing here runs on its own; the virtual clock only moves when the firmware does work
+ * (each step of loop(), a byte read, a blocked Serial write, a show()), or, with setSkipIdle(), jumps over time in
+ * which loop() would find nothing to do.
+ */
+class SimBoard {
+private:
+    static const int NUM_PINS = 20;
+
+    uint64_t nowUs;
+    unsigned long baud;
+
+    bool skipIdle;
+    uint64_t wakeUs;            // Earliest time the firmware asked to be woken at in the last pass, if wakeSet
+    bool wakeSet;
+    unsigned long activity;     // Bytes read or written, pin and buzzer changes, shows and EEPROM writes
+    int idlePasses;             // Passes in a row without any
+    unsigned long passes;
+    unsigned long jumps;
+    uint64_t skippedUs;
+
+    std::function<void(uint64_t)> peer;
+    uint64_t lineFreeUs;
+    std::deque<std::pair<uint64_t, uint8_t>> incoming;
+    std::deque<uint8_t> rxFifo;
+    int rxShift;
+    std::deque<uint8_t> rxRing;
+    unsigned long rxOverflows;
+    unsigned long rxOverruns;
+    void (*rxIsr)(uint8_t);
+
+    bool interruptsOn;
+    uint64_t interruptsOffUs;
+    uint64_t blackoutUs;
+    uint64_t longestBlackoutUs;
+
+    uint64_t txDoneUs;
+    std::string txLine;
+    std::vector<SerialLine> txLines;
+    std::vector<TxByte> txBytes;
+
+    int pinLevels[NUM_PINS];
+    int pinModes[NUM_PINS];
+    int analogLevels[NUM_PINS];
+    std::vector<AnalogChange> analogChanges;
+    uint32_t noise;
+
+    std::vector<ShownFrame> shownFrames;
+    std::vector<uint8_t> display;   // GRB bytes of every LED, as last sent
+    uint32_t lastHash;
+    std::vector<std::pair<size_t, size_t>> probes;   // First LED and count of each run probed
+
+    std::vector<BenchMarker> markers;
+
+    uint8_t eeprom[1024];
+    uint16_t eepromCellWrites[1024];
+    unsigned long eepromWrites;
+
+    void deliverRx();
+
+    void pushRing(uint8_t b);
+
+    void skipIdleTime(uint64_t limitUs);
+public:
+    // HardwareSerial has a 64 byte ring, one slot of which is always empty.
+    static const size_t SERIAL_BUFFER_SIZE = 64;
+    // The USART holds two received bytes in UDR0, plus one more in the receive shift register.
+    static const size_t UART_FIFO_SIZE = 2;
+    static const uint16_t EEPROM_SIZE = 1024;
+
+    CostModel cost;
+
+    SimBoard();
+
+    /**
+     * Make this the current board and run the firmware's setup().
+     */
+    void boot();
+
+    //region clock
+    uint64_t now() const;
+
+    /**
+     * Move the virtual clock forward, delivering any serial bytes that arrive on the way.
+     *
+     * @param us The number of microseconds to advance.
+     */
+    void advance(uint64_t us);
+
+    /**
+     * Run one pass of loop() and charge its fixed overhead.
+     */
+    void step();
+
+    /**
+     * Call loop() repeatedly until the predicate returns true.
+     *
+     * @param done     Checked before every pass.
+     * @param maxUs    Hard limit on virtual time, in case the predicate never becomes true. Skipping idle time
+     *                 never jumps past it, so a predicate on the time alone should be given as maxUs.
+     */
+    void runUntil(const std::function<bool()> &done, uint64_t maxUs);
+
+    /**
+     * Once two passes of loop() in a row have done nothing, have runUntil() jump the clock to the earliest of the
+     * next received byte and the times the firmware asked to be woken at (include/Wake.h), rather than stepping
+     * through the time in between. Off by default.
+     */
+    void setSkipIdle(bool enabled);
+
+    /**
+     * Called by the firmware, through simWakeBy(), for each time it is waiting on.
+     */
+    void wakeBy(uint64_t us);
+
+    /**
+     * Passes of loop() run since power-on.
+     */
+    unsigned long getPasses() const;
+
+    /**
+     * Jumps made over idle time, and the time they covered.
+     */
+    unsigned long getJumps() const;
+
+    uint64_t getSkippedUs() const;
+
+    /**
+     * Enable or disable interrupts. While they are off the RX ISR cannot empty the USART,
+     * so bytes beyond what it can hold are lost as data overruns.
+     */
+    void setInterrupts(bool enabled);
+
+    bool interruptsEnabled() const;
+
+    /**
+     * Total time spent with interrupts disabled.
+     */
+    uint64_t getBlackoutUs() const;
+
+    uint64_t getLongestBlackoutUs() const;
+    //endregion
+
+    //region serial
+    unsigned long getBaud() const;
+
+    void setBaud(unsigned long rate);
+
+    /**
+     * Microseconds taken by one 8N1 byte on the wire at the current baud.
+     */
+    uint32_t byteTimeUs() const;
+
+    /**
+     * Have the far end of the link send bytes to the receiver's RX pin, back-to-back at the current baud.
+     * Sending starts at the given time, or once the line has finished any earlier transmission.
+     *
+     * @param atUs  When the sender starts writing.
+     * @param bytes The bytes to send.
+     * @param count The number of bytes.
+     * @return      When the stop bit of the last byte completes.
+     */
+    uint64_t transmit(uint64_t atUs, const uint8_t *bytes, size_t count);
+
+    size_t pendingRx() const;
+
+    /**
+     * Have a model of the far end of the link follow the clock: it is called with the new time whenever the clock
+     * moves, before the bytes due by then are delivered, so it can transmit() in answer to what the firmware has
+     * written so far. It should not transmit() earlier than the time it was last called with. Jumps over idle time do not stop
+     * for what it sends, so the two are not for use together.
+     */
+    void setPeer(const std::function<void(uint64_t)> &far);
+
+    /**
+     * Bytes dropped by the RX ISR because the HardwareSerial ring was full.
+     */
+    unsigned long getRxOverflows() const;
+
+    /**
+     * Bytes lost in the USART because interrupts were off for longer than it could hold them.
+     */
+    unsigned long getRxOverruns() const;
+
+    /**
+     * Have received bytes go to the given interrupt handler as they come out of the USART, rather than into the
+     * HardwareSerial ring. Each is charged CostModel::rxIsrUs.
+     */
+    void setRxInterrupt(void (*isr)(uint8_t));
+
+    int rxAvailable();
+
+    int rxPeek();
+
+    int rxRead();
+
+    void txWrite(uint8_t b);
+
+    bool txIdle() const;
+
+    /**
+     * Free space in the TX ring, as Serial.availableForWrite() reports it.
+     */
+    int txFree() const;
+
+    const std::vector<SerialLine> &lines() const;
+
+    /**
+     * Every byte written to Serial, e.g. to pick binary frames out from among the debug text.
+     */
+    const std::vector<TxByte> &txHistory() const;
+    //endregion
+
+    /**
+     * Record a bench marker at the current time.
+     */
+    void mark(uint8_t id);
+
+    const std::vector<BenchMarker> &benchMarkers() const;
+
+    //region pins
+    void setPin(uint8_t pin, int level);
+
+    void setPinMode(uint8_t pin, int mode);
+
+    int readPin(uint8_t pin) const;
+
+    void writePin(uint8_t pin, int level);
+
+    void writeAnalog(uint8_t pin, int level);
+
+    int readAnalog(uint8_t pin) const;
+
+    /**
+     * analogRead() of a floating input: a few bits of noise.
+     */
+    int readAnalogInput(uint8_t pin);
+
+    /**
+     * Seed the noise on floating inputs, so each simulated receiver can pick its own random numbers.
+     */
+    void setNoiseSeed(uint32_t seed);
+
+    const std::vector<AnalogChange> &analogHistory() const;
+    //endregion
+
+    //region leds
+    /**
+     * Clock a chain of LEDs out of its data pin.
+     *
+     * @param grb     The bytes in wire order.
+     * @param first   Where the chain starts in the whole display.
+     * @param numLeds The number of LEDs in the chain.
+     */
+    void show(const uint8_t *grb, size_t first, size_t numLeds);
+
+    const std::vector<ShownFrame> &frames() const;
+
+    /**
+     * Pick a run of LEDs to hash separately in each shown frame, to follow one part of the display.
+     *
+     * @param first The index of the first LED, in chain order.
+     * @param count How many LEDs.
+     */
+    void setProbe(size_t first, size_t count);
+
+    /**
+     * Add another run of LEDs to the probe, hashed along with those already picked.
+     */
+    void addProbe(size_t first, size_t count);
+    //endregion
+
+    //region eeprom
+    uint8_t eepromRead(int idx) const;
+
+    void eepromWrite(int idx, uint8_t val);
+
+    /**
+     * The number of bytes programmed since power-on.
+     */
+    unsigned long getEepromWrites() const;
+
+    /**
+     * The number of times one cell has been programmed since power-on.
+     */
+    unsigned int getEepromWrites(int idx) const;
+
+    /**
+     * Copy the EEPROM contents, e.g. to carry them over a simulated power cycle.
+     */
+    void saveEeprom(uint8_t out[EEPROM_SIZE]) const;
+
+    void loadEeprom(const uint8_t in[EEPROM_SIZE]);
+    //endregion
+};
+
+/**
+ * The board the firmware is currently running on.
+ */
+SimBoard &board();
+
+void setBoard(SimBoard *b);
+
+/**
+ * Run a scenario in a forked child process, so that it starts from a freshly powered-on receiver.
+ *
+ * The firmware keeps its state in globals which are only initialised once per process; forking gives every
+ * scenario its own pristine copy. The child copies its result back to the parent through a pipe.
+ *
+ * @param scenario Fills in the result. Runs in the child, which creates the SimBoard and should call boot().
+ * @param result   Where the child's result is copied to.
+ * @param size     Size of the result in bytes.
+ * @return         If the child ran to completion and returned its result.
+ */
+bool runIsolated(const std::function<void(void *)> &scenario, void *result, size_t size);
+
+/**
+ * A scenario started in a child process by startIsolated(), for finishIsolated() to collect.
+ */
+struct IsolatedRun {
+    pid_t pid;
+    int fd;                 // The read end of the child's pipe
+};
+
+/**
+ * Start a scenario as runIsolated() does, without waiting for it, so one thread can keep several running at once.
+ * Only ever fork from one thread: a child of a process with other threads running can inherit a lock one of them
+ * held, and the pipes those threads had open.
+ *
+ * @return If the child was started, in which case finishIsolated() must be called on it.
+ */
+bool startIsolated(const std::function<void(void *)> &scenario, size_t size, IsolatedRun &run);
+
+/**
+ * Collect the result of a scenario started by startIsolated(), waiting for it to finish.
+ *
+ * @return If the child ran to completion and returned its result.
+ */
+bool finishIsolated(const IsolatedRun &run, void *result, size_t size);
+
+template<typename T>
+bool runIsolated(const std::function<T()> &scenario, T &result) {
+    static_assert(std::is_trivially_copyable<T>::value, "Scenario results are copied between processes");
+    return runIsolated([&](void *out) { *(T *) out = scenario(); }, &result, sizeof(T));
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "SimBoard.h"
+
+#include <cstdint>
+
+/**
+ * A countdown run to the end, with the controller repeating its state as the app does. Each tick of the number is
+ * timed from when it falls due, on the whole seconds from the start of the countdown, to the end of the show that
+ * puts it on the display.
+ */
+struct TickOptions {
+    int time = 30;                  // Seconds the countdown starts from
+    uint64_t repeatUs = 250000;     // How often the controller repeats the state; 0 to send it once
+    uint64_t reactionUs = 5000;     // From the stop bit of a flow byte to the controller acting on it
+};
+
+/**
+ * Tick-to-photon times over one run. The ticks measured are those down to FINAL_SECONDS, after which the number
+ * flashes; the tick to 0 is timed apart.
+ */
+struct TickReport {
+    int ticks;
+    int64_t minUs;
+    int64_t p5Us;
+    int64_t p50Us;
+    int64_t p95Us;
+    int64_t maxUs;
+    int64_t lastUs;             // Of the last tick measured, which shows how far lateness builds up
+    int64_t blankUs;            // The tick to 0, to the end of the show of the blank display
+    int64_t beepUs;             // The tick to 0, to the buzzer sounding
+};
+
+/**
+ * Run the countdown against a freshly booted simulated receiver.
+ *
+ * @param tickAhead   If the receiver draws each tick ahead and shows it on the tick, rather than drawing it when the
+ *                    tick is handled and showing it at the end of loop().
+ * @param splitChains If the receiver is wired with a chain per region of the display, rather than one chain.
+ */
+TickReport runTicks(const TickOptions &options, bool tickAhead, bool splitChains);
+
+/**
+ * Entry point for the `ticks` command.
+ */
+int ticksMain(int argc, char **argv);
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "LoadGen.h"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * A traffic pattern to run against the UART model.
+ */
+struct UartScenario {
+    const char *name;
+    const char *description;
+    std::vector<PlannedSend> (*traffic)(uint64_t durationUs);
+};
+
+/**
+ * Where the bytes of a scenario went.
+ */
+struct UartReport {
+    int sent;
+    int delivered;
+    long bytes;
+    unsigned long rxOverflows;      // Dropped by the RX ISR, HardwareSerial ring full
+    unsigned long rxOverruns;       // Lost in the USART while show() had interrupts off
+    int shows;          // Chains clocked out
+    long ledsShown;
+    uint64_t blackoutUs;
+    uint64_t longestBlackoutUs;
+};
+
+extern const UartScenario UART_SCENARIOS[];
+extern const int NUM_UART_SCENARIOS;
+
+/**
+ * Run a scenario against a freshly booted simulated receiver.
+ *
+ * @param splitChains If the receiver is wired with a chain per region of the display, rather than one chain.
+ */
+UartReport runUartScenario(const UartScenario &scenario, uint64_t durationUs, bool splitChains);
+
+/**
+ * Entry point for the `uart` command.
+ */
+int uartMain(int argc, char **argv);
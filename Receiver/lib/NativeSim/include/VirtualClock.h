@@ -0,0 +1,51 @@
+#pragma once
+
+#include "SimBoard.h"
+
+#include <cstdint>
+
+/**
+ * An uploaded round, run long: each end is started once by the controller, and the receiver does the rest by
+ * itself, so nearly all of it is the receiver waiting on its own countdown and buzzer.
+ */
+struct VirtualClockOptions {
+    int ends = 6;
+    int details = 2;
+    int walkUp = 10;                    // Seconds
+    int maxTime = 240;
+    int warnTime = 30;
+    uint64_t scoringUs = 20000000;      // Between one end finishing and the controller starting the next
+    uint64_t repeatUs = 0;              // How often the controller repeats the start of an end; 0 to send it once
+};
+
+const int VIRTUAL_CLOCK_MAX_FRAMES = 16384;
+const int VIRTUAL_CLOCK_MAX_EDGES = 4096;
+
+/**
+ * What the receiver did over the round, to compare stepping through it with jumping over its idle time.
+ */
+struct VirtualClockRun {
+    uint64_t simulatedUs;
+    double wallSeconds;
+    unsigned long passes;               // Of loop()
+    unsigned long jumps;
+    uint64_t skippedUs;
+    int frames;                         // Shown, of which the first VIRTUAL_CLOCK_MAX_FRAMES are kept
+    uint64_t frameUs[VIRTUAL_CLOCK_MAX_FRAMES];
+    uint32_t frameHash[VIRTUAL_CLOCK_MAX_FRAMES];
+    int edges;                          // Buzzer level changes, likewise
+    uint64_t edgeUs[VIRTUAL_CLOCK_MAX_EDGES];
+    int edgeLevel[VIRTUAL_CLOCK_MAX_EDGES];
+};
+
+/**
+ * Run the round on a freshly booted simulated receiver.
+ *
+ * @param skipIdle If the clock jumps over idle time (SimBoard::setSkipIdle()), rather than stepping loop() through it.
+ */
+void runVirtualClock(const VirtualClockOptions &options, bool skipIdle, VirtualClockRun &run);
+
+/**
+ * Entry point for the `clock` command.
+ */
+int virtualClockMain(int argc, char **argv);
@@ -0,0 +1,207 @@
+#include "AnimationScenarios.h"
+#include "Packets.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static const uint64_t SECOND_US = 1000000;
+static const uint64_t TAIL_US = 2 * SECOND_US;
+// Matches ANIMATION_FRAME_MS in the firmware
+static const uint64_t FRAME_US = 50000;
+// Longer than this between changes is a gap between runs of an animation, rather than a stall within one
+static const uint64_t RUN_GAP_US = 1200000;
+
+// The LEDs each animation moves, in chain order
+static const int GREEN_LIGHT_FIRST = 161;
+static const int RED_LIGHT_FIRST = 221;
+static const int LIGHT_LEDS = 30;
+static const int ONES_DIGIT_FIRST = 126;
+static const int DIGIT_LEDS = 35;
+
+static PlannedSend stateSend(uint64_t atUs, const StateFields &fields) {
+    PlannedSend send;
+    send.startUs = atUs;
+    send.bytes = encodeStatePacket(fields);
+    send.garbageBytes = 0;
+    send.tag = fields.time;
+    send.kind = KIND_TIME;
+    return send;
+}
+
+/**
+ * State repeated at 4 Hz, switching from green to red every 4 seconds. The green fades out each time.
+ */
+static std::vector<PlannedSend> fadeTraffic(uint64_t durationUs) {
+    StateFields fields;
+    fields.detail = 1;
+
+    std::vector<PlannedSend> sends;
+    for (uint64_t at = 0; at < durationUs; at += SECOND_US / 4) {
+        fields.colour = (at / (2 * SECOND_US)) % 2 ? 0 : 2;
+        fields.time++;
+        sends.push_back(stateSend(at, fields));
+    }
+    return sends;
+}
+
+/**
+ * The last 10 seconds of a green countdown, with the controller repeating its view of the time at 2 Hz.
+ * The time flashes throughout.
+ */
+static std::vector<PlannedSend> finalSecondsTraffic(uint64_t durationUs) {
+    StateFields fields;
+    fields.countdown = true;
+    fields.detail = 1;
+    fields.colour = 2;
+    fields.timeEnabled = true;
+
+    std::vector<PlannedSend> sends;
+    for (uint64_t at = 0; at < std::min(durationUs, 9 * SECOND_US); at += SECOND_US / 2) {
+        // The receiver takes a second off when the countdown starts
+        fields.time = (int16_t) (at ? 9 - at / SECOND_US : 10);
+        sends.push_back(stateSend(at, fields));
+    }
+    return sends;
+}
+
+/**
+ * An emergency stop, held for the whole run while the controller keeps sending at 2 Hz. The red pulses.
+ */
+static std::vector<PlannedSend> estopTraffic(uint64_t durationUs) {
+    StateFields fields;
+    fields.emergencyStop = true;
+    fields.detail = 1;
+
+    std::vector<PlannedSend> sends;
+    for (uint64_t at = 0; at < durationUs; at += SECOND_US / 2) {
+        fields.time++;
+        sends.push_back(stateSend(at, fields));
+    }
+    return sends;
+}
+
+/**
+ * The fade scenario's traffic with the light left on green, so nothing animates.
+ */
+static std::vector<PlannedSend> staticTraffic(uint64_t durationUs) {
+    StateFields fields;
+    fields.detail = 1;
+    fields.colour = 2;
+
+    std::vector<PlannedSend> sends;
+    for (uint64_t at = 0; at < durationUs; at += SECOND_US / 4) {
+        fields.time++;
+        sends.push_back(stateSend(at, fields));
+    }
+    return sends;
+}
+
+const AnimationScenario ANIMATION_SCENARIOS[] = {
+        {"fade",          "Green fades out every 4 s, state at 4 Hz", fadeTraffic,
+                GREEN_LIGHT_FIRST, LIGHT_LEDS, FRAME_US, 0},
+        {"final-seconds", "Time flashes, countdown repeated at 2 Hz", finalSecondsTraffic,
+                ONES_DIGIT_FIRST, DIGIT_LEDS, SECOND_US / 2, 3 * SECOND_US / 2},
+        {"estop",         "Red pulses, e-stop held at 2 Hz",          estopTraffic,
+                RED_LIGHT_FIRST, LIGHT_LEDS, SECOND_US / 2, 0},
+        {"static",        "Fade traffic with nothing animating",     staticTraffic,
+                GREEN_LIGHT_FIRST, LIGHT_LEDS, FRAME_US, 0},
+};
+const int NUM_ANIMATION_SCENARIOS = sizeof(ANIMATION_SCENARIOS) / sizeof(ANIMATION_SCENARIOS[0]);
+
+/**
+ * Work out the pacing from the times the watched LEDs changed.
+ */
+static void summariseSteps(const std::vector<uint64_t> &steps, uint64_t stepUs, AnimationReport &report) {
+    std::vector<uint64_t> intervals;
+    for (size_t i = 1; i < steps.size(); ++i) {
+        uint64_t interval = steps[i] - steps[i - 1];
+        if (interval > RUN_GAP_US) continue;
+        intervals.push_back(interval);
+        uint64_t missed = (interval + stepUs / 2) / stepUs;
+        if (missed > 1) report.dropped += (int) (missed - 1);
+    }
+    if (intervals.empty()) return;
+
+    std::sort(intervals.begin(), intervals.end());
+    report.stepP50Us = intervals[intervals.size() / 2];
+    report.stepMaxUs = intervals.back();
+}
+
+AnimationReport runAnimationScenario(const AnimationScenario &scenario, uint64_t durationUs) {
+    std::vector<PlannedSend> sends = scenario.traffic(durationUs);
+    AnimationReport report = {};
+
+    bool ok = runIsolated<AnimationReport>([&]() {
+        SimBoard sim;
+        sim.setProbe(scenario.probeFirst, scenario.probeCount);
+        sim.boot();
+        sim.runUntil([]() { return false; }, 100000);
+
+        const uint64_t start = sim.now();
+        const size_t showsBefore = sim.frames().size();
+        for (const PlannedSend &send : sends) {
+            sim.transmit(start + send.startUs, send.bytes.data(), send.bytes.size());
+        }
+        const uint64_t quiet = start + durationUs + TAIL_US;
+        sim.runUntil([&]() { return sim.now() >= quiet && sim.pendingRx() == 0; }, quiet + 60 * SECOND_US);
+
+        AnimationReport r = {};
+        r.sent = (int) sends.size();
+        for (uint64_t handled : findAcks(sends, sim.lines(), start)) {
+            if (handled) r.delivered++;
+        }
+        r.lostBytes = sim.getRxOverflows() + sim.getRxOverruns();
+
+        std::vector<uint64_t> steps;
+        const std::vector<ShownFrame> &frames = sim.frames();
+        for (size_t i = showsBefore; i < frames.size(); ++i) {
+            r.shows++;
+            if (frames[i].probe == frames[i - 1].probe || frames[i].startUs < start + scenario.settleUs) continue;
+            steps.push_back(frames[i].startUs);
+        }
+        r.steps = (int) steps.size();
+        summariseSteps(steps, scenario.stepUs, r);
+        return r;
+    }, report);
+
+    if (!ok) fprintf(stderr, "Simulated receiver crashed in scenario %s\n", scenario.name);
+    return report;
+}
+
+int animationMain(int argc, char **argv) {
+    uint64_t durationUs = 20 * SECOND_US;
+    const char *only = nullptr;
+
+    for (int i = 0; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--duration")) {
+            durationUs = (uint64_t) (atof(argv[i + 1]) * SECOND_US);
+        } else if (!strcmp(argv[i], "--scenario")) {
+            only = argv[i + 1];
+        } else {
+            argc = -1;
+        }
+    }
+    if (argc < 0 || argc % 2) {
+        fprintf(stderr,
+                "usage: program animation [options]\n"
+                "  --duration S      Seconds of traffic per scenario (default 20)\n"
+                "  --scenario NAME   Run only this scenario\n");
+        return 2;
+    }
+
+    printf("%-14s %5s %9s %5s %6s %6s %8s %8s %8s\n",
+           "scenario", "sent", "delivered", "lost", "shows", "steps", "p50 ms", "max ms", "dropped");
+    for (int i = 0; i < NUM_ANIMATION_SCENARIOS; ++i) {
+        const AnimationScenario &scenario = ANIMATION_SCENARIOS[i];
+        if (only && strcmp(only, scenario.name) != 0) continue;
+
+        AnimationReport r = runAnimationScenario(scenario, durationUs);
+        printf("%-14s %5d %9d %5lu %6d %6d %8.1f %8.1f %8d\n",
+               scenario.name, r.sent, r.delivered, r.lostBytes, r.shows, r.steps,
+               r.stepP50Us / 1000.0, r.stepMaxUs / 1000.0, r.dropped);
+        fflush(stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,184 @@
+#include "Arduino.h"
+#include "SimBoard.h"
+
+#include <vector>
+
+uint8_t TCCR2B = 0;
+HardwareSerial Serial;
+
+unsigned long millis() {
+    return (unsigned long) (board().now() / 1000);
+}
+
+unsigned long micros() {
+    return (unsigned long) board().now();
+}
+
+void simWakeBy(unsigned long ms) {
+    board().wakeBy((uint64_t) ms * 1000);
+}
+
+void simBenchMark(uint8_t marker) {
+    board().mark(marker);
+}
+
+void simAttachRxInterrupt(void (*isr)(uint8_t)) {
+    board().setRxInterrupt(isr);
+}
+
+void simCaptureLeds(const uint8_t *rgb, int first, int count) {
+    std::vector<uint8_t> grb(count * 3);
+    for (int i = 0; i < count * 3; i += 3) {
+        grb[i] = rgb[i + 1];
+        grb[i + 1] = rgb[i];
+        grb[i + 2] = rgb[i + 2];
+    }
+    board().show(grb.data(), first, count);
+}
+
+void delay(unsigned long ms) {
+    board().advance((uint64_t) ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+    board().advance(us);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    board().setPinMode(pin, mode);
+}
+
+int digitalRead(uint8_t pin) {
+    return board().readPin(pin);
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    board().writePin(pin, val);
+}
+
+void analogWrite(uint8_t pin, int val) {
+    board().writeAnalog(pin, val);
+}
+
+int analogRead(uint8_t pin) {
+    return board().readAnalogInput(pin);
+}
+
+void noInterrupts() {
+    board().setInterrupts(false);
+}
+
+void interrupts() {
+    board().setInterrupts(true);
+}
+
+//region String
+static std::string formatNumber(unsigned long n, unsigned char base) {
+    if (base < 2) base = 10;
+    char buf[8 * sizeof(long) + 1];
+    char *str = &buf[sizeof(buf) - 1];
+    *str = '\0';
+    do {
+        char c = n % base;
+        n /= base;
+        *--str = c < 10 ? c + '0' : c + 'A' - 10;
+    } while (n);
+    return str;
+}
+
+static std::string formatSigned(long n, unsigned char base) {
+    if (base == DEC && n < 0) {
+        return "-" + formatNumber(-(unsigned long) n, base);
+    }
+    // Like the AVR core, non-decimal bases print the two's complement bits of the native width
+    return formatNumber((unsigned long) n, base);
+}
+
+String::String(unsigned char value, unsigned char base) : str(formatNumber(value, base)) {}
+
+String::String(int value, unsigned char base) : str(formatSigned(value, base)) {}
+
+String::String(unsigned int value, unsigned char base) : str(formatNumber(value, base)) {}
+
+String::String(long value, unsigned char base) : str(formatSigned(value, base)) {}
+
+String::String(unsigned long value, unsigned char base) : str(formatNumber(value, base)) {}
+//endregion
+
+//region HardwareSerial
+void HardwareSerial::begin(unsigned long baud) {
+    board().setBaud(baud);
+}
+
+int HardwareSerial::available() {
+    return board().rxAvailable();
+}
+
+int HardwareSerial::peek() {
+    return board().rxPeek();
+}
+
+int HardwareSerial::read() {
+    return board().rxRead();
+}
+
+void HardwareSerial::flush() {
+    while (!board().txIdle()) {
+        board().advance(board().byteTimeUs());
+    }
+}
+
+int HardwareSerial::availableForWrite() {
+    return board().txFree();
+}
+
+size_t HardwareSerial::write(uint8_t b) {
+    board().txWrite(b);
+    return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buf, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        write(buf[i]);
+    }
+    return size;
+}
+
+size_t HardwareSerial::print(const char *str) {
+    return write((const uint8_t *) str, strlen(str));
+}
+
+size_t HardwareSerial::print(const String &str) {
+    return print(str.c_str());
+}
+
+size_t HardwareSerial::print(char c) {
+    return write((uint8_t) c);
+}
+
+size_t HardwareSerial::print(unsigned char n, int base) {
+    return print(String(n, base));
+}
+
+size_t HardwareSerial::print(int n, int base) {
+    // The AVR int is 16 bits wide, so BIN/HEX output of negatives matches that width
+    if (base != DEC && n < 0) return print(String((unsigned int) (n & 0xFFFF), base));
+    return print(String(n, base));
+}
+
+size_t HardwareSerial::print(unsigned int n, int base) {
+    return print(String(n, base));
+}
+
+size_t HardwareSerial::print(long n, int base) {
+    return print(String(n, base));
+}
+
+size_t HardwareSerial::print(unsigned long n, int base) {
+    return print(String(n, base));
+}
+
+size_t HardwareSerial::println() {
+    return print("\r\n");
+}
+//endregion
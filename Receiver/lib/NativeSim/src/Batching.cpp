@@ -0,0 +1,190 @@
+#include "Batching.h"
+#include "Packets.h"
+
+#include <Arduino.h>
+#include <Frames.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+extern bool isrFraming;
+
+static const uint64_t SETTLE_US = 100000;       // After boot, before the first run's transition
+static const uint64_t RUN_STEP_US = 1237;       // Between one run's transition and the next's, so each meets loop()
+                                                // somewhere else
+static const uint64_t DISPLAY_BY_US = 900000;   // The display has settled by then, and no countdown has ticked
+static const uint32_t LEAD_MS = 250;            // As SerialCommunications.SCHEDULE_LEAD_MILLIS
+
+const BatchTransition BATCH_TRANSITIONS[] = {
+        {"end",         "An end transition as four state frames: colour, detail, time, then beeps"},
+        {"scheduled",   "A walk-up state scheduled behind a clock frame, as sendScheduledState()"},
+        {"round-start", "The round upload, a clock frame and the start of its next end, as startRoundEnd()"},
+};
+const int NUM_BATCH_TRANSITIONS = sizeof(BATCH_TRANSITIONS) / sizeof(BATCH_TRANSITIONS[0]);
+
+/**
+ * The packets the controller sends for a transition, in order.
+ *
+ * @param nowMs The controller's clock as the first of them goes out.
+ */
+static std::vector<std::vector<uint8_t>> transitionPackets(int transition, uint32_t nowMs) {
+    std::vector<std::vector<uint8_t>> packets;
+    StateFields fields;
+    switch (transition) {
+        case 0:
+            fields.colour = 2;
+            packets.push_back(encodeStatePacket(fields));
+            fields.detail = 1;
+            packets.push_back(encodeStatePacket(fields));
+            fields.timeEnabled = true;
+            fields.time = 240;
+            packets.push_back(encodeStatePacket(fields));
+            fields.endNumBeeps = 3;
+            packets.push_back(encodeStatePacket(fields));
+            break;
+
+        case 1:
+            fields.countdownContinues = true;
+            fields.countdown = true;
+            fields.colour = 1;
+            fields.detail = 1;
+            fields.timeEnabled = true;
+            fields.time = 10;
+            fields.startNumBeeps = 2;
+            fields.endNumBeeps = 1;
+            packets.push_back(encodeClockPacket(nowMs));
+            packets.push_back(encodeGenerationPacket(1, encodeScheduledStatePacket(nowMs + LEAD_MS, fields)));
+            break;
+
+        default: {
+            RoundScheduleFrame schedule = {};
+            schedule.ends = 6;
+            schedule.walkUp = 10;
+            schedule.maxTime = 240;
+            schedule.warnTime = 30;
+            schedule.options = withRoundScheduleDetails(schedule.options, 2);
+            schedule.options = withRoundScheduleRotate(schedule.options, true);
+            schedule.options = withRoundScheduleWalkUpBeeps(schedule.options, 2);
+            schedule.options = withRoundScheduleShootBeeps(schedule.options, 1);
+            schedule.options = withRoundScheduleEndBeeps(schedule.options, 3);
+            packets.push_back(encodeRoundSchedulePacket(schedule));
+            packets.push_back(encodeClockPacket(nowMs));
+            packets.push_back(encodeRoundControlPacket(1, ROUND_START, nowMs + LEAD_MS));
+            break;
+        }
+    }
+    return packets;
+}
+
+/**
+ * One run of a transition.
+ */
+struct TransitionRun {
+    uint64_t displayUs;             // 0 if the display never settled on it
+    int shows;
+    unsigned long lostBytes;
+};
+
+BatchReport runBatchTransition(int transition, bool batched, int runs, bool isr) {
+    BatchReport report = {};
+    uint64_t totalUs = 0;
+    long totalShows = 0;
+    for (int run = 0; run < runs; ++run) {
+        TransitionRun result = {};
+        bool ok = runIsolated<TransitionRun>([&]() {
+            SimBoard sim;
+            isrFraming = isr;
+            sim.boot();
+            sim.runUntil([]() { return false; }, SETTLE_US + run * RUN_STEP_US);
+
+            const uint64_t start = sim.now();
+            std::vector<std::vector<uint8_t>> packets = transitionPackets(transition, (uint32_t) (start / 1000));
+            if (batched) packets = {encodeBatchPacket(packets)};
+            for (const std::vector<uint8_t> &packet : packets) {
+                sim.transmit(start, packet.data(), packet.size());
+            }
+            sim.runUntil([]() { return false; }, start + DISPLAY_BY_US);
+
+            // What the display settled on, and the first show to put it there
+            TransitionRun r = {};
+            r.lostBytes = sim.getRxOverflows() + sim.getRxOverruns();
+            const std::vector<ShownFrame> &frames = sim.frames();
+            size_t first = 0;
+            while (first < frames.size() && frames[first].startUs < start) first++;
+            if (first == frames.size()) return r;
+            const uint32_t settled = frames.back().hash;
+            for (size_t i = first; i < frames.size(); ++i) {
+                if (frames[i].hash != settled) continue;
+                r.displayUs = frames[i].endUs - start;
+                r.shows = (int) (i - first + 1);
+                break;
+            }
+            return r;
+        }, result);
+        if (!ok) fprintf(stderr, "Simulated receiver crashed in transition %s\n", BATCH_TRANSITIONS[transition].name);
+
+        report.lostBytes += result.lostBytes;
+        if (!result.displayUs) {
+            report.missed++;
+            continue;
+        }
+        totalUs += result.displayUs;
+        totalShows += result.shows;
+        report.worstDisplayUs = std::max(report.worstDisplayUs, result.displayUs);
+    }
+
+    const std::vector<std::vector<uint8_t>> packets = transitionPackets(transition, 0);
+    report.packets = batched ? 1 : (int) packets.size();
+    report.bytes = batched ? (long) encodeBatchPacket(packets).size() : 0;
+    for (const std::vector<uint8_t> &packet : packets) {
+        if (!batched) report.bytes += (long) packet.size();
+    }
+    const int settled = runs - report.missed;
+    report.meanShows = settled ? (double) totalShows / settled : 0;
+    report.meanDisplayUs = settled ? (double) totalUs / settled : 0;
+    return report;
+}
+
+int batchMain(int argc, char **argv) {
+    int runs = 10;
+    const char *only = nullptr;
+    bool isr = false;
+
+    for (int i = 0; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--runs")) {
+            runs = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--transition")) {
+            only = argv[i + 1];
+        } else if (!strcmp(argv[i], "--rx")) {
+            isr = !strcmp(argv[i + 1], "isr");
+            if (!isr && strcmp(argv[i + 1], "ring") != 0) argc = -1;
+        } else {
+            argc = -1;
+        }
+    }
+    if (argc < 0 || argc % 2 || runs < 1) {
+        fprintf(stderr,
+                "usage: program batch [options]\n"
+                "  --runs N           Runs of each transition, each a little later in loop() (default 10)\n"
+                "  --transition NAME  Run only this transition: end, scheduled or round-start\n"
+                "  --rx X             Frames read from the serial ring in loop() (ring) or by the RX interrupt (isr)\n"
+                "                     (default ring)\n");
+        return 2;
+    }
+
+    printf("%-12s %-8s %7s %6s %6s %11s %9s %5s %7s\n", "transition", "sent as", "packets", "bytes", "shows",
+           "display ms", "worst ms", "lost", "missed");
+    for (int t = 0; t < NUM_BATCH_TRANSITIONS; ++t) {
+        if (only && strcmp(only, BATCH_TRANSITIONS[t].name) != 0) continue;
+        for (bool batched : {false, true}) {
+            const BatchReport r = runBatchTransition(t, batched, runs, isr);
+            printf("%-12s %-8s %7d %6ld %6.1f %11.2f %9.2f %5lu %7d\n", BATCH_TRANSITIONS[t].name,
+                   batched ? "batch" : "frames", r.packets, r.bytes, r.meanShows, r.meanDisplayUs / 1000.0,
+                   r.worstDisplayUs / 1000.0, r.lostBytes, r.missed);
+            fflush(stdout);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,231 @@
+#include "Brownout.h"
+#include "Packets.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// The firmware's live state, read straight out of the simulated receiver
+extern State state;
+
+static const uint64_t SECOND_US = 1000000;
+static const uint64_t SETTLE_US = 100000;
+static const int AMBER_SECONDS = 10;
+static const int END_SECONDS = 240;
+static const uint16_t AMBER_GENERATION = 1;
+static const uint16_t GREEN_GENERATION = 2;
+// The app repeats its last state every 250 ms; the restored receiver is given a second of them
+static const uint64_t REPEAT_US = 250000;
+static const int REPEATS = 4;
+// A restored countdown may resume from its last checkpoint, up to this far behind
+static const int MAX_RESTORE_LAG_SECONDS = 16;
+
+static const BrownoutCase BROWNOUT_CASES[] = {
+        {"amber",       5,     true,  true},
+        {"green-start", 12,    true,  true},
+        {"mid-end",     100,   true,  true},
+        {"checkpoint",  160.5, true,  true},
+        {"late",        200,   true,  true},
+        {"unattended",  100,   false, false},
+        {"finished",    260,   true,  false},
+};
+static const int NUM_BROWNOUT_CASES = sizeof(BROWNOUT_CASES) / sizeof(BROWNOUT_CASES[0]);
+
+/**
+ * The amber state TargetFragment starts an end with, the countdown continuing into green.
+ */
+static StateFields amberState() {
+    StateFields amber;
+    amber.countdownContinues = true;
+    amber.countdown = true;
+    amber.detail = DETAIL_AB;
+    amber.colour = AMBER;
+    amber.timeEnabled = true;
+    amber.time = AMBER_SECONDS;
+    amber.startNumBeeps = 2;
+    amber.endNumBeeps = 1;
+    return amber;
+}
+
+/**
+ * The green state that follows it.
+ */
+static StateFields greenState() {
+    StateFields green;
+    green.countdown = true;
+    green.detail = DETAIL_AB;
+    green.colour = GREEN;
+    green.timeEnabled = true;
+    green.time = END_SECONDS;
+    green.endNumBeeps = 3;
+    return green;
+}
+
+/**
+ * Queue the packets TargetFragment sends for an end, each state a generation of its own.
+ */
+static void sendEnd(SimBoard &sim, uint64_t startUs) {
+    std::vector<uint8_t> bytes = encodeGenerationPacket(AMBER_GENERATION, amberState());
+    sim.transmit(startUs, bytes.data(), bytes.size());
+    bytes = encodeGenerationPacket(GREEN_GENERATION, greenState());
+    sim.transmit(startUs + AMBER_SECONDS * SECOND_US, bytes.data(), bytes.size());
+}
+
+/**
+ * The EEPROM and state at the moment the power went.
+ */
+struct PowerCut {
+    uint8_t eeprom[SimBoard::EEPROM_SIZE];
+    State state;
+};
+
+BrownoutResult runBrownout(const BrownoutCase &brownout) {
+    PowerCut cut = {};
+    BrownoutResult result = {};
+
+    bool ok = runIsolated<PowerCut>([&]() {
+        SimBoard sim;
+        sim.boot();
+        sim.runUntil([]() { return false; }, SETTLE_US);
+
+        const uint64_t start = sim.now();
+        sendEnd(sim, start);
+        const uint64_t cutUs = start + (uint64_t) (brownout.cutSeconds * SECOND_US);
+        sim.runUntil([&]() { return sim.now() >= cutUs; }, cutUs + SECOND_US);
+
+        PowerCut c;
+        sim.saveEeprom(c.eeprom);
+        c.state = state;
+        return c;
+    }, cut);
+
+    ok = ok && runIsolated<BrownoutResult>([&]() {
+        SimBoard sim;
+        sim.loadEeprom(cut.eeprom);
+        sim.boot();
+        sim.runUntil([&]() { return !sim.frames().empty(); }, SECOND_US);
+
+        BrownoutResult r = {};
+        // Power-on leaves the lights red and the countdown stopped, whatever the snapshot holds
+        r.held = state.colour == RED && !state.countdown;
+
+        // Then the controller, if it is still there, repeats the state it last sent
+        const size_t shows = sim.frames().size();
+        const uint64_t repeatUs = sim.now();
+        if (brownout.controllerRepeats) {
+            const bool amber = brownout.cutSeconds < AMBER_SECONDS;
+            std::vector<uint8_t> bytes = amber ? encodeGenerationPacket(AMBER_GENERATION, amberState())
+                                               : encodeGenerationPacket(GREEN_GENERATION, greenState());
+            for (int i = 0; i < REPEATS; ++i) {
+                sim.transmit(repeatUs + i * REPEAT_US, bytes.data(), bytes.size());
+            }
+        }
+        sim.runUntil([&]() { return sim.frames().size() > shows; }, repeatUs + REPEATS * REPEAT_US);
+
+        r.after = state;
+        r.restored = state.colour != RED || state.countdown;
+        r.restoreUs = sim.frames().size() > shows ? sim.frames()[shows].endUs - repeatUs : 0;
+        return r;
+    }, result);
+
+    if (!ok) fprintf(stderr, "Simulated receiver crashed in case %s\n", brownout.name);
+    result.before = cut.state;
+    return result;
+}
+
+EndWrites measureEndWrites() {
+    EndWrites writes = {};
+    bool ok = runIsolated<EndWrites>([]() {
+        SimBoard sim;
+        sim.boot();
+        sim.runUntil([]() { return false; }, SETTLE_US);
+
+        const unsigned long before = sim.getEepromWrites();
+        const uint64_t start = sim.now();
+        sendEnd(sim, start);
+        const uint64_t doneUs = start + (AMBER_SECONDS + END_SECONDS + 5) * SECOND_US;
+        sim.runUntil([&]() { return sim.now() >= doneUs; }, doneUs + SECOND_US);
+
+        EndWrites w = {};
+        w.bytes = sim.getEepromWrites() - before;
+        for (int i = 0; i < SimBoard::EEPROM_SIZE; ++i) {
+            if (sim.getEepromWrites(i) > w.maxCell) w.maxCell = sim.getEepromWrites(i);
+        }
+        return w;
+    }, writes);
+
+    if (!ok) fprintf(stderr, "Simulated receiver crashed running an end\n");
+    return writes;
+}
+
+static void describe(char *out, size_t size, const State &s) {
+    static const char *const COLOURS[] = {"red", "amber", "green"};
+    static const char *const DETAILS[] = {"--", "AB", "CD"};
+    snprintf(out, size, "%-5s %s %4d %s", s.colour < 3 ? COLOURS[s.colour] : "?", s.detail < 3 ? DETAILS[s.detail] : "?",
+             s.time, s.countdown ? "cd" : "  ");
+}
+
+/**
+ * If the receiver came back the way the case expects.
+ */
+static bool passed(const BrownoutCase &brownout, const BrownoutResult &r) {
+    if (!r.held) return false;
+    if (!brownout.expectRestore) return !r.restored;
+    return r.restored
+           && r.after.colour == r.before.colour
+           && r.after.detail == r.before.detail
+           && r.after.countdown == r.before.countdown
+           && r.after.timeEnabled == r.before.timeEnabled
+           && r.after.time >= r.before.time
+           && r.after.time <= r.before.time + MAX_RESTORE_LAG_SECONDS;
+}
+
+int brownoutMain(int argc, char **argv) {
+    unsigned long budget = 240;
+    const char *only = nullptr;
+
+    for (int i = 0; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--budget")) {
+            budget = strtoul(argv[i + 1], nullptr, 10);
+        } else if (!strcmp(argv[i], "--case")) {
+            only = argv[i + 1];
+        } else {
+            argc = -1;
+        }
+    }
+    if (argc < 0 || argc % 2) {
+        fprintf(stderr,
+                "usage: program brownout [options]\n"
+                "  --budget N    EEPROM bytes one end may program (default 240)\n"
+                "  --case NAME   Run only this case\n");
+        return 2;
+    }
+
+    int failures = 0;
+    printf("%-12s %6s  %-18s %-4s  %-18s %10s  %s\n", "case", "cut s", "before", "held", "after", "restore ms",
+           "result");
+    for (int i = 0; i < NUM_BROWNOUT_CASES; ++i) {
+        const BrownoutCase &brownout = BROWNOUT_CASES[i];
+        if (only && strcmp(only, brownout.name) != 0) continue;
+
+        BrownoutResult r = runBrownout(brownout);
+        bool ok = passed(brownout, r);
+        if (!ok) failures++;
+
+        char before[32], after[32];
+        describe(before, sizeof(before), r.before);
+        describe(after, sizeof(after), r.after);
+        printf("%-12s %6.1f  %-18s %-4s  %-18s %10.1f  %s\n", brownout.name, brownout.cutSeconds, before,
+               r.held ? "yes" : "no", after, r.restoreUs / 1000.0, ok ? "ok" : "FAIL");
+        fflush(stdout);
+    }
+
+    if (!only) {
+        EndWrites writes = measureEndWrites();
+        bool ok = writes.bytes <= budget && writes.maxCell <= 1;
+        if (!ok) failures++;
+        printf("\nEEPROM per end: %lu bytes programmed (budget %lu), at most %u writes to one cell  %s\n",
+               writes.bytes, budget, writes.maxCell, ok ? "ok" : "FAIL");
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,204 @@
+#include "Calibration.h"
+#include "Packets.h"
+
+#include <Board.h>
+#include <Frames.h>
+#include <State.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+extern State state;
+extern unsigned long startTime;
+
+static const uint64_t SECOND_US = 1000000;
+static const uint64_t SETTLE_US = 100000;
+static const double CONTROLLER_START_MS = 3600000;
+// As in SerialCommunications.kt, which sends the start and finish this many times
+static const int COMMAND_COPIES = 3;
+
+static const double DEFAULT_SKEWS[] = {-5000, -2000, 0, 2000, 5000};
+static const int LENGTHS_S[] = {60, 150, 300, 450, 600};
+static const double RESIDUAL_LIMIT_MS = 20;     // A fiftieth of a tick, at the end of the countdown
+
+CalibrationRun runCalibration(const CalibrationOptions &options) {
+    CalibrationRun run = {};
+
+    bool ok = runIsolated<CalibrationRun>([&]() {
+        CalibrationRun r = {};
+        // Sim time is the receiver's millis(); true time runs slower on a receiver that runs fast
+        const double scale = 1 + options.skewPpm / 1e6;
+        std::mt19937 rng(options.seed);
+        std::exponential_distribution<double> jitter(options.jitterMs > 0 ? 1 / options.jitterMs : 1);
+
+        SimBoard sim;
+        sim.setPin(QUIET_PIN, LOW);
+        sim.setSkipIdle(true);
+        sim.boot();
+        sim.runUntil([]() { return false; }, SETTLE_US);
+
+        uint16_t generation = 0;
+        auto timeCountdown = [&](int pass) {
+            StateFields fields;
+            fields.countdown = true;
+            fields.detail = 1;
+            fields.colour = 2;
+            fields.timeEnabled = true;
+            fields.time = (int16_t) options.time;
+            fields.endNumBeeps = CALIBRATION_BEEPS;
+            const std::vector<uint8_t> bytes = encodeGenerationPacket(++generation, fields);
+            sim.transmit(sim.now(), bytes.data(), bytes.size());
+            sim.runUntil([]() { return state.countdown; }, sim.now() + SECOND_US);
+
+            const uint64_t startUs = (uint64_t) startTime * 1000;
+            const size_t from = sim.analogHistory().size();
+            const double lengthUs = (options.time + CALIBRATION_BEEPS * 2 + 2) * SECOND_US * (scale > 1 ? scale : 1);
+            sim.runUntil([]() { return false; }, startUs + (uint64_t) lengthUs);
+
+            const std::vector<AnalogChange> &analog = sim.analogHistory();
+            uint64_t onUs = 0;
+            uint64_t offUs = 0;
+            for (size_t i = from; i < analog.size(); ++i) {
+                if (analog[i].pin != BUZZER_PIN) continue;
+                if (analog[i].level && !onUs) onUs = analog[i].us;
+                if (!analog[i].level) offUs = analog[i].us;
+            }
+            r.countdownMs[pass] = (double) (onUs - startUs) / scale / 1000;
+            r.beepsMs[pass] = (double) (offUs - onUs) / scale / 1000;
+        };
+
+        timeCountdown(0);
+
+        // The controller stamps each clock frame with true time as it starts sending, and the link holds it up
+        const double startTrueUs = (double) sim.now() / scale;
+        auto simUs = [&](double trueUs) { return (uint64_t) (trueUs * scale); };
+        const std::vector<uint8_t> start = encodeCalibratePacket(ANY_RECEIVER, CALIBRATE_START);
+        for (int i = 0; i < COMMAND_COPIES; ++i) {
+            sim.transmit(sim.now(), start.data(), start.size());
+        }
+        for (uint64_t atUs = options.intervalUs; atUs < options.calibrateUs; atUs += options.intervalUs) {
+            const double sentUs = startTrueUs + (double) atUs;
+            const double heldUs = (options.latencyMs + (options.jitterMs > 0 ? jitter(rng) : 0)) * 1000;
+            const std::vector<uint8_t> clock = encodeClockPacket((uint32_t) (CONTROLLER_START_MS + sentUs / 1000));
+            sim.transmit(simUs(sentUs + heldUs), clock.data(), clock.size());
+        }
+        const std::vector<uint8_t> finish = encodeCalibratePacket(ANY_RECEIVER, CALIBRATE_FINISH);
+        const uint64_t finishUs = simUs(startTrueUs + (double) options.calibrateUs);
+        for (int i = 0; i < COMMAND_COPIES; ++i) {
+            sim.transmit(finishUs, finish.data(), finish.size());
+        }
+        sim.runUntil([]() { return false; }, finishUs + SECOND_US);
+
+        // Flow control bytes can land in the debug text, ahead of a line
+        static const char TRIM_LINE[] = "Clock trim: ";
+        for (const SerialLine &line : sim.lines()) {
+            const size_t at = line.text.find(TRIM_LINE);
+            if (at == std::string::npos) continue;
+            r.calibrated = true;
+            r.trimPpm = atoi(line.text.c_str() + at + sizeof(TRIM_LINE) - 1);
+        }
+
+        timeCountdown(1);
+        return r;
+    }, run);
+
+    if (!ok) fprintf(stderr, "Simulated receiver crashed\n");
+    return run;
+}
+
+int calibrateMain(int argc, char **argv) {
+    CalibrationOptions options;
+    bool oneSkew = false;
+
+    for (int i = 0; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--skew")) {
+            options.skewPpm = atof(argv[i + 1]);
+            oneSkew = true;
+        } else if (!strcmp(argv[i], "--interval")) {
+            options.intervalUs = (uint64_t) (atof(argv[i + 1]) * SECOND_US);
+        } else if (!strcmp(argv[i], "--latency")) {
+            options.latencyMs = atof(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--jitter")) {
+            options.jitterMs = atof(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--time")) {
+            options.time = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--seed")) {
+            options.seed = (uint32_t) strtoul(argv[i + 1], nullptr, 10);
+        } else {
+            argc = -1;
+        }
+    }
+    if (argc < 0 || argc % 2 || fabs(options.skewPpm) > 20000 || options.intervalUs == 0 || options.latencyMs < 0 ||
+        options.jitterMs < 0 || options.time < 2 || options.time > 999) {
+        fprintf(stderr,
+                "usage: program calibrate [options]\n"
+                "  --skew PPM       How much faster the receiver's clock runs than true time, up to 20000; by\n"
+                "                   default, each of -5000, -2000, 0, 2000 and 5000\n"
+                "  --interval S     Between clock frames (default 1)\n"
+                "  --latency MS     Fixed delay on the link (default 10)\n"
+                "  --jitter MS      Mean of the exponential jitter on top (default 10)\n"
+                "  --time S         Seconds the countdown timed before and after starts from (default 240)\n"
+                "  --seed N\n");
+        return 2;
+    }
+
+    std::vector<double> skews(DEFAULT_SKEWS, DEFAULT_SKEWS + sizeof(DEFAULT_SKEWS) / sizeof(DEFAULT_SKEWS[0]));
+    if (oneSkew) skews.assign(1, options.skewPpm);
+    const int lengths = sizeof(LENGTHS_S) / sizeof(LENGTHS_S[0]);
+    const uint64_t appUs = CalibrationOptions().calibrateUs;
+
+    printf("clock frames every %.1f s over a %.0f ms link with %.0f ms of jitter; a %d s countdown and %d beeps\n\n",
+           (double) options.intervalUs / SECOND_US, options.latencyMs, options.jitterMs, options.time,
+           CALIBRATION_BEEPS);
+    printf("error of the correction in ppm, by length of calibration (- for too short to keep)\n");
+    printf("%8s %9s", "skew", "expected");
+    for (int length : LENGTHS_S) {
+        printf(" %6d s", length);
+    }
+    printf("\n");
+
+    std::vector<CalibrationRun> atAppLength(skews.size());
+    for (size_t s = 0; s < skews.size(); ++s) {
+        options.skewPpm = skews[s];
+        // The correction that exactly undoes the skew
+        const double expected = -skews[s] / (1 + skews[s] / 1e6);
+        printf("%+8.0f %+9.1f", skews[s], expected);
+        for (int l = 0; l < lengths; ++l) {
+            options.calibrateUs = LENGTHS_S[l] * SECOND_US;
+            const CalibrationRun run = runCalibration(options);
+            if (run.calibrated) {
+                printf(" %+8.1f", run.trimPpm - expected);
+            } else {
+                printf(" %8s", "-");
+            }
+            fflush(stdout);
+            if (options.calibrateUs == appUs) atAppLength[s] = run;
+        }
+        printf("\n");
+    }
+
+    // Error in true time, against a receiver with an exact clock, which the loop holds up the same
+    CalibrationOptions exact = options;
+    exact.skewPpm = 0;
+    exact.calibrateUs = 0;
+    const CalibrationRun reference = runCalibration(exact);
+    const double countdownMs = reference.countdownMs[0];
+    const double beepsMs = reference.beepsMs[0];
+    printf("\nerror in ms against true time, calibrated for %.0f s as the app does\n", (double) appUs / SECOND_US);
+    printf("%8s %9s %17s %9s %13s %9s\n", "skew", "trim", "countdown before", "after", "beeps before", "after");
+    bool within = true;
+    for (size_t s = 0; s < skews.size(); ++s) {
+        const CalibrationRun &run = atAppLength[s];
+        printf("%+8.0f %+9d %+17.1f %+9.1f %+13.1f %+9.1f\n", skews[s], run.trimPpm,
+               run.countdownMs[0] - countdownMs, run.countdownMs[1] - countdownMs, run.beepsMs[0] - beepsMs,
+               run.beepsMs[1] - beepsMs);
+        if (!run.calibrated || fabs(run.countdownMs[1] - countdownMs) > RESIDUAL_LIMIT_MS) within = false;
+    }
+    printf("\nCalibrated receivers %s within %.0f ms of true time at the end of the countdown\n",
+           within ? "all end" : "do NOT all end", RESIDUAL_LIMIT_MS);
+    return within ? 0 : 1;
+}
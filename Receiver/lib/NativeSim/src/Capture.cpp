@@ -0,0 +1,283 @@
+#include "Capture.h"
+#include "LoadGen.h"
+#include "SimBoard.h"
+
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+
+static const char MAGIC[6] = {'T', 'L', 'C', 'A', 'P', '1'};
+static const uint64_t SECOND_US = 1000000;
+// How long to keep running after the last byte, so the last packet's debug output can finish
+static const uint64_t TAIL_US = 2 * SECOND_US;
+
+//region file
+static void putVarint(std::vector<uint8_t> &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((uint8_t) (value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t) value);
+}
+
+static bool getVarint(const std::vector<uint8_t> &in, size_t &pos, uint64_t &value) {
+    value = 0;
+    for (int shift = 0; pos < in.size() && shift < 64; shift += 7) {
+        const uint8_t b = in[pos++];
+        value |= (uint64_t) (b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+bool writeCapture(const char *path, const Capture &capture) {
+    std::vector<uint8_t> out(MAGIC, MAGIC + sizeof(MAGIC));
+    for (int i = 0; i < 4; ++i) {
+        out.push_back((uint8_t) (capture.baud >> (8 * i)));
+    }
+    uint64_t last = 0;
+    for (const CapturedByte &b : capture.bytes) {
+        putVarint(out, b.us - last);
+        out.push_back(b.value);
+        last = b.us;
+    }
+
+    FILE *f = fopen(path, "wb");
+    if (!f) return false;
+    const bool ok = fwrite(out.data(), 1, out.size(), f) == out.size();
+    return fclose(f) == 0 && ok;
+}
+
+bool readCapture(const char *path, Capture &capture, std::string &error) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        error = strerror(errno);
+        return false;
+    }
+    std::vector<uint8_t> in;
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        in.insert(in.end(), chunk, chunk + n);
+    }
+    fclose(f);
+
+    if (in.size() < sizeof(MAGIC) + 4 || memcmp(in.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        error = "not a capture";
+        return false;
+    }
+    size_t pos = sizeof(MAGIC);
+    capture.baud = in[pos] | in[pos + 1] << 8 | in[pos + 2] << 16 | (uint32_t) in[pos + 3] << 24;
+    pos += 4;
+    capture.bytes.clear();
+    uint64_t us = 0;
+    while (pos < in.size()) {
+        uint64_t delta;
+        if (!getVarint(in, pos, delta) || pos >= in.size()) break;
+        us += delta;
+        capture.bytes.push_back({us, in[pos++]});
+    }
+    return true;
+}
+//endregion
+
+//region replay
+static uint32_t fnv(uint32_t hash, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        hash = (hash ^ (uint8_t) (value >> (8 * i))) * 16777619u;
+    }
+    return hash;
+}
+
+ReplayReport replayCapture(const Capture &capture, uint64_t bootUs, bool printSerial) {
+    ReplayReport report = {};
+    // The child would print anything still buffered a second time
+    fflush(stdout);
+    bool ok = runIsolated<ReplayReport>([&]() {
+        SimBoard sim;
+        sim.boot();
+        sim.runUntil([]() { return false; }, bootUs);
+        if (sim.getBaud() != capture.baud) {
+            fprintf(stderr, "warning: captured at %u baud, the receiver runs at %lu\n", capture.baud, sim.getBaud());
+        }
+
+        // Each byte is sent so that its stop bit completes at the recorded time
+        const uint64_t start = sim.now();
+        const uint64_t byteUs = sim.byteTimeUs();
+        uint64_t lastByte = start;
+        for (const CapturedByte &b : capture.bytes) {
+            const uint64_t at = start + b.us;
+            lastByte = sim.transmit(at > start + byteUs ? at - byteUs : start, &b.value, 1);
+        }
+        const uint64_t quiet = lastByte + TAIL_US;
+        sim.runUntil([&]() { return sim.now() >= quiet && sim.pendingRx() == 0; }, quiet + 60 * SECOND_US);
+
+        ReplayReport r;
+        memset(&r, 0, sizeof(r));   // Padding too, as runs are compared byte for byte
+        r.bytes = (long) capture.bytes.size();
+        uint32_t digest = 2166136261u;
+        for (const TxByte &b : sim.txHistory()) {
+            digest = fnv(fnv(digest, b.us, 8), b.value, 1);
+        }
+        for (const ShownFrame &frame : sim.frames()) {
+            digest = fnv(fnv(fnv(digest, frame.startUs, 8), frame.endUs, 8), frame.hash, 4);
+        }
+        for (const SerialLine &line : sim.lines()) {
+            if (line.text.find("Time value:") != std::string::npos) r.stateFrames++;
+            if (printSerial) printf("%10.3f  %s\n", line.us / 1000.0, line.text.c_str());
+        }
+        fflush(stdout);
+        r.lines = (int) sim.lines().size();
+        r.rxOverflows = sim.getRxOverflows();
+        r.rxOverruns = sim.getRxOverruns();
+        r.shows = (int) sim.frames().size();
+        r.blackoutUs = sim.getBlackoutUs();
+        r.longestBlackoutUs = sim.getLongestBlackoutUs();
+        r.endUs = sim.now();
+        r.digest = digest;
+        return r;
+    }, report);
+
+    if (!ok) fprintf(stderr, "Simulated receiver crashed replaying the capture\n");
+    return report;
+}
+
+int replayMain(int argc, char **argv) {
+    uint64_t bootUs = 100000;
+    bool printSerial = false;
+    int runs = 1;
+    const char *path = argc > 0 ? argv[0] : nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--serial")) {
+            printSerial = true;
+        } else if (!strcmp(argv[i], "--boot") && i + 1 < argc) {
+            bootUs = (uint64_t) (atof(argv[++i]) * 1000);
+        } else if (!strcmp(argv[i], "--check") && i + 1 < argc) {
+            runs = atoi(argv[++i]);
+        } else {
+            path = nullptr;
+        }
+    }
+    if (!path || runs < 1) {
+        fprintf(stderr,
+                "usage: program replay <capture> [options]\n"
+                "  --boot MS     When the capture starts, after the receiver is powered on (default 100)\n"
+                "  --serial      Print the receiver's serial output, with virtual times in ms\n"
+                "  --check N     Replay N times and fail unless every run is identical\n");
+        return 2;
+    }
+
+    Capture capture;
+    std::string error;
+    if (!readCapture(path, capture, error)) {
+        fprintf(stderr, "%s: %s\n", path, error.c_str());
+        return 1;
+    }
+
+    const ReplayReport r = replayCapture(capture, bootUs, printSerial);
+    const double seconds = capture.bytes.empty() ? 0 : capture.bytes.back().us / (double) SECOND_US;
+    printf("%ld bytes over %.1f s at %u baud\n", r.bytes, seconds, capture.baud);
+    printf("state frames handled %d, serial lines %d, overflow %lu, overrun %lu, shows %d, blackout %.1f ms "
+           "(max %.2f), ended at %.3f s\n", r.stateFrames, r.lines, r.rxOverflows, r.rxOverruns, r.shows,
+           r.blackoutUs / 1000.0, r.longestBlackoutUs / 1000.0, r.endUs / (double) SECOND_US);
+    printf("digest %08x\n", r.digest);
+
+    for (int run = 1; run < runs; ++run) {
+        const ReplayReport again = replayCapture(capture, bootUs, false);
+        if (memcmp(&again, &r, sizeof(r)) != 0) {
+            printf("run %d differs: digest %08x\n", run + 1, again.digest);
+            return 1;
+        }
+    }
+    if (runs > 1) printf("%d runs identical\n", runs);
+    return 0;
+}
+//endregion
+
+//region capture
+static volatile sig_atomic_t stopCapture = 0;
+
+static void onInterrupt(int) {
+    stopCapture = 1;
+}
+
+static uint64_t hostMicros() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+int captureMain(int argc, char **argv) {
+    const char *device = nullptr;
+    const char *out = nullptr;
+    unsigned long baud = 9600;
+    double duration = 0;
+
+    for (int i = 0; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--device")) {
+            device = argv[i + 1];
+        } else if (!strcmp(argv[i], "--out")) {
+            out = argv[i + 1];
+        } else if (!strcmp(argv[i], "--baud")) {
+            baud = strtoul(argv[i + 1], nullptr, 10);
+        } else if (!strcmp(argv[i], "--duration")) {
+            duration = atof(argv[i + 1]);
+        } else {
+            argc = -1;
+        }
+    }
+    if (argc < 0 || argc % 2 || !device || !out || baud == 0) {
+        fprintf(stderr,
+                "usage: program capture --device PATH --out FILE [options]\n"
+                "  --device PATH  Serial device tapped onto the receiver's RX line, e.g. a USB adapter or radio\n"
+                "  --out FILE     Where to write the capture\n"
+                "  --baud B       Serial baud (default 9600)\n"
+                "  --duration S   Stop after this many seconds (default: on Ctrl-C)\n");
+        return 2;
+    }
+
+    const int fd = openSerial(device, baud);
+    if (fd < 0) {
+        fprintf(stderr, "Could not open %s: %s\n", device, strerror(errno));
+        return 1;
+    }
+    signal(SIGINT, onInterrupt);
+    signal(SIGTERM, onInterrupt);
+
+    Capture capture;
+    capture.baud = (uint32_t) baud;
+    const uint64_t byteUs = 10 * SECOND_US / baud;
+    const uint64_t start = hostMicros();
+    uint64_t last = 0;
+    pollfd pfd = {fd, POLLIN, 0};
+    fprintf(stderr, "Capturing from %s at %lu baud, Ctrl-C to stop\n", device, baud);
+    while (!stopCapture && (duration <= 0 || hostMicros() - start < duration * SECOND_US)) {
+        if (poll(&pfd, 1, 50) <= 0) continue;
+        uint8_t chunk[256];
+        const ssize_t n = read(fd, chunk, sizeof(chunk));
+        if (n <= 0) break;
+        // The read returns as the last byte's stop bit completes; the ones before it came back-to-back
+        const uint64_t now = hostMicros() - start;
+        for (ssize_t i = 0; i < n; ++i) {
+            const uint64_t back = (uint64_t) (n - 1 - i) * byteUs;
+            uint64_t us = now > back ? now - back : 0;
+            if (us < last) us = last;
+            capture.bytes.push_back({us, chunk[i]});
+            last = us;
+        }
+    }
+    close(fd);
+
+    if (!writeCapture(out, capture)) {
+        fprintf(stderr, "Could not write %s: %s\n", out, strerror(errno));
+        return 1;
+    }
+    fprintf(stderr, "%zu bytes over %.1f s written to %s\n", capture.bytes.size(), last / (double) SECOND_US, out);
+    return 0;
+}
+//endregion
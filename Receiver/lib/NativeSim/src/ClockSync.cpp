@@ -0,0 +1,317 @@
+#include "ClockSync.h"
+#include "Packets.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+// The firmware's id, read straight out of the simulated receiver
+extern uint16_t receiverId;
+
+static const uint64_t SECOND_US = 1000000;
+static const uint64_t SETTLE_US = 100000;
+// Estimates are left out of the summary until drift has had two baselines to settle
+static const double SETTLED_S = 150;
+// The controller starts well away from the receiver's clock
+static const double CONTROLLER_START_MS = 3600000;
+
+// Same filter as ControllerClock.h, run on the controller's side as the app does, over the app's 8 exchanges rather
+// than the receiver's CLOCK_EXCHANGES
+static const size_t EXCHANGES = 8;
+static const double DRIFT_BASELINE_MS = 60000;
+
+/**
+ * A completed exchange, as the controller sees it.
+ */
+struct Exchange {
+    double offsetMs;        // Controller minus receiver
+    double roundTripMs;
+    double receiverMs;      // t2
+};
+
+/**
+ * The controller's estimate for one receiver: the newest exchange until drift is known, then the one with the
+ * shortest round trip out of the last few, carried forward by the drift measured between exchanges at least a
+ * baseline apart.
+ */
+class ControllerEstimator {
+private:
+    std::vector<Exchange> exchanges;
+    Exchange best = {};
+    Exchange anchor = {};
+    bool driftMeasured = false;
+    double driftPpm = 0;
+
+public:
+    void add(uint32_t t1, uint32_t t2, uint32_t t3, uint32_t t4) {
+        Exchange exchange;
+        exchange.offsetMs = ((double) (int32_t) (t1 - t2) + (double) (int32_t) (t4 - t3)) / 2;
+        exchange.roundTripMs = std::max(0.0, (double) (int32_t) (t4 - t1) - (double) (int32_t) (t3 - t2));
+        exchange.receiverMs = t2;
+        exchanges.push_back(exchange);
+        if (exchanges.size() > EXCHANGES) exchanges.erase(exchanges.begin());
+
+        const Exchange lowest = *std::min_element(exchanges.begin(), exchanges.end(),
+                                                  [](const Exchange &a, const Exchange &b) {
+                                                      return a.roundTripMs < b.roundTripMs;
+                                                  });
+        best = driftMeasured ? lowest : exchange;
+
+        const double baseline = lowest.receiverMs - anchor.receiverMs;
+        if (exchanges.size() == 1 || (!driftMeasured && baseline < DRIFT_BASELINE_MS / 2
+                                      && lowest.roundTripMs < anchor.roundTripMs)) {
+            anchor = lowest;
+            return;
+        }
+        if (baseline < DRIFT_BASELINE_MS) return;
+
+        const double measured = (lowest.offsetMs - anchor.offsetMs) * 1e6 / baseline;
+        driftPpm = driftMeasured ? (3 * driftPpm + measured) / 4 : measured;
+        driftMeasured = true;
+        anchor = lowest;
+        best = lowest;
+    }
+
+    bool synced() const {
+        return !exchanges.empty();
+    }
+
+    double offsetAt(double receiverMs) const {
+        return best.offsetMs + driftPpm * (receiverMs - best.receiverMs) / 1e6;
+    }
+
+    double roundTrip() const {
+        return best.roundTripMs;
+    }
+
+    double drift() const {
+        return driftPpm;
+    }
+};
+
+/**
+ * The link between the controller and the receiver, one way.
+ */
+class Link {
+private:
+    const ClockSyncOptions &options;
+    std::mt19937 &rng;
+    double fixedMs;
+
+public:
+    Link(const ClockSyncOptions &options, std::mt19937 &rng, double fixedMs)
+            : options(options), rng(rng), fixedMs(fixedMs) {}
+
+    uint64_t delayUs() {
+        double jitterMs = 0;
+        if (options.model == JITTER_UNIFORM) {
+            jitterMs = std::uniform_real_distribution<double>(0, options.jitterMs)(rng);
+        } else if (options.model == JITTER_EXPONENTIAL && options.jitterMs > 0) {
+            jitterMs = std::exponential_distribution<double>(1 / options.jitterMs)(rng);
+        }
+        return (uint64_t) ((fixedMs + jitterMs) * 1000);
+    }
+};
+
+/**
+ * A frame from the receiver, as it reaches the controller.
+ */
+struct Arrival {
+    uint64_t us;
+    DecodedFrame frame;
+};
+
+ClockSyncReport runClockSync(const ClockSyncOptions &options) {
+    ClockSyncReport report = {};
+
+    bool ok = runIsolated<ClockSyncReport>([&]() {
+        ClockSyncReport r = {};
+        r.trueRoundTripMs = 2 * options.latencyMs + options.asymmetryMs;
+
+        std::mt19937 rng(options.seed);
+        Link down(options, rng, options.latencyMs);
+        Link up(options, rng, options.latencyMs + options.asymmetryMs);
+        auto controllerMs = [&](uint64_t us) {
+            return CONTROLLER_START_MS + us * (1 + options.driftPpm / 1e6) / 1000;
+        };
+
+        SimBoard sim;
+        sim.setNoiseSeed(options.seed);
+        sim.boot();
+        sim.runUntil([]() { return false; }, SETTLE_US);
+
+        ControllerEstimator estimator;
+        std::vector<Arrival> arrivals;
+        size_t nextByte = 0;
+        uint16_t id = ANY_RECEIVER;
+        uint8_t sequence = 0;
+        uint8_t lastSequence = 0;
+        uint32_t lastT4 = 0;
+        bool heardPong = false;
+
+        const uint64_t start = sim.now();
+        uint64_t nextQuery = start + options.queryIntervalUs;
+        for (uint64_t at = start; at < start + options.durationUs; at += options.pingIntervalUs) {
+            sim.runUntil([&]() { return sim.now() >= at; }, at + SECOND_US);
+
+            for (const DecodedFrame &frame : decodeFrames(sim.txHistory(), nextByte)) {
+                arrivals.push_back({frame.endUs + up.delayUs(), frame});
+            }
+            std::sort(arrivals.begin(), arrivals.end(), [](const Arrival &a, const Arrival &b) {
+                return a.us < b.us;
+            });
+
+            // Everything heard since the last ping. The controller stamps the moment the last byte arrives, and
+            // takes off the frame's time on the wire.
+            size_t heard = 0;
+            for (; heard < arrivals.size() && arrivals[heard].us <= at; ++heard) {
+                const std::vector<uint8_t> &data = arrivals[heard].frame.data;
+                const uint32_t t4 = (uint32_t) controllerMs(arrivals[heard].us)
+                                    - wireMillis(data.size() + PACKET_OVERHEAD);
+                if (data[0] == FRAME_PONG && data.size() >= PONG_FRAME_SIZE) {
+                    r.pongs++;
+                    lastSequence = data[3];
+                    lastT4 = t4;
+                    heardPong = true;
+                    estimator.add(readField(data, 4, 4), readField(data, 8, 4), readField(data, 12, 4), t4);
+                } else if (data[0] == FRAME_CLOCK_REPORT && data.size() >= CLOCK_REPORT_FRAME_SIZE) {
+                    id = readField(data, 1, 2);
+                    if (r.samples == CLOCK_SYNC_MAX_SAMPLES) continue;
+
+                    const double localMs = readField(data, 12, 4);
+                    const double trueOffset = controllerMs((uint64_t) (localMs * 1000)) - localMs;
+                    const uint16_t roundTrip = readField(data, 7, 2);
+
+                    ClockSyncSample &sample = r.sample[r.samples++];
+                    sample.atS = (localMs * 1000 - start) / SECOND_US;
+                    sample.trueOffsetMs = trueOffset;
+                    sample.receiver.offsetErrorMs = (int32_t) readField(data, 3, 4) - trueOffset;
+                    sample.receiver.roundTripMs = roundTrip == 0xFFFF ? -1 : roundTrip;
+                    sample.receiver.driftPpm = (int16_t) readField(data, 9, 2);
+                    sample.controller.offsetErrorMs = estimator.offsetAt(localMs) - trueOffset;
+                    sample.controller.roundTripMs = estimator.synced() ? (int) lround(estimator.roundTrip()) : -1;
+                    sample.controller.driftPpm = (int) lround(estimator.drift());
+                }
+            }
+            arrivals.erase(arrivals.begin(), arrivals.begin() + heard);
+
+            sequence++;
+            const std::vector<uint8_t> ping = encodePingPacket(id, sequence, (uint32_t) controllerMs(at),
+                                                               heardPong ? lastSequence : sequence, lastT4);
+            uint64_t sentUs = sim.transmit(at + down.delayUs(), ping.data(), ping.size());
+            r.pings++;
+
+            if (at >= nextQuery) {
+                const std::vector<uint8_t> query = encodeClockQueryPacket(id);
+                sim.transmit(sentUs + down.delayUs(), query.data(), query.size());
+                nextQuery += options.queryIntervalUs;
+            }
+        }
+        r.receiverId = receiverId;
+        return r;
+    }, report);
+
+    if (!ok) fprintf(stderr, "Simulated receiver crashed\n");
+    return report;
+}
+
+/**
+ * Median and worst of the absolute offset errors once settled.
+ */
+static void summarise(const ClockSyncReport &report, bool receiver, double &p50, double &max, double &drift) {
+    std::vector<double> errors;
+    double driftSum = 0;
+    for (int i = 0; i < report.samples; ++i) {
+        const ClockSyncSample &sample = report.sample[i];
+        if (sample.atS < SETTLED_S) continue;
+        const ClockEstimate &estimate = receiver ? sample.receiver : sample.controller;
+        errors.push_back(fabs(estimate.offsetErrorMs));
+        driftSum += estimate.driftPpm;
+    }
+    p50 = max = drift = 0;
+    if (errors.empty()) return;
+
+    drift = driftSum / errors.size();
+    std::sort(errors.begin(), errors.end());
+    p50 = errors[errors.size() / 2];
+    max = errors.back();
+}
+
+int clockSyncMain(int argc, char **argv) {
+    ClockSyncOptions options;
+
+    for (int i = 0; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--duration")) {
+            options.durationUs = (uint64_t) (atof(argv[i + 1]) * SECOND_US);
+        } else if (!strcmp(argv[i], "--interval")) {
+            options.pingIntervalUs = (uint64_t) (atof(argv[i + 1]) * SECOND_US);
+        } else if (!strcmp(argv[i], "--query")) {
+            options.queryIntervalUs = (uint64_t) (atof(argv[i + 1]) * SECOND_US);
+        } else if (!strcmp(argv[i], "--latency")) {
+            options.latencyMs = atof(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--asymmetry")) {
+            options.asymmetryMs = atof(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--jitter")) {
+            options.jitterMs = atof(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--model")) {
+            if (!strcmp(argv[i + 1], "none")) {
+                options.model = JITTER_NONE;
+            } else if (!strcmp(argv[i + 1], "uniform")) {
+                options.model = JITTER_UNIFORM;
+            } else if (!strcmp(argv[i + 1], "exp")) {
+                options.model = JITTER_EXPONENTIAL;
+            } else {
+                argc = -1;
+            }
+        } else if (!strcmp(argv[i], "--drift")) {
+            options.driftPpm = atof(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--seed")) {
+            options.seed = (uint32_t) strtoul(argv[i + 1], nullptr, 10);
+        } else {
+            argc = -1;
+        }
+    }
+    if (argc < 0 || argc % 2 || options.pingIntervalUs == 0 || options.queryIntervalUs == 0) {
+        fprintf(stderr,
+                "usage: program clocksync [options]\n"
+                "  --duration S      Seconds to run (default 600)\n"
+                "  --interval S      Seconds between pings (default 5)\n"
+                "  --query S         Seconds between clock queries (default 30)\n"
+                "  --latency MS      Fixed link delay each way (default 10)\n"
+                "  --asymmetry MS    Extra fixed delay from the receiver back (default 0)\n"
+                "  --jitter MS       Extra delay per frame (default 10)\n"
+                "  --model M         How the jitter is drawn: none, uniform or exp (default exp, jitter is the mean)\n"
+                "  --drift PPM       How much faster the controller's clock runs (default 500)\n"
+                "  --seed N\n");
+        return 2;
+    }
+
+    static const char *const MODELS[] = {"no", "uniform", "exponential"};
+    ClockSyncReport r = runClockSync(options);
+    printf("receiver %04X, link %.0f ms each way (+%.0f ms back) with %s jitter of %.0f ms, "
+           "controller drift %.0f ppm\n", r.receiverId, options.latencyMs, options.asymmetryMs,
+           MODELS[options.model], options.jitterMs, options.driftPpm);
+    printf("%d pings, %d pongs heard\n\n", r.pings, r.pongs);
+
+    printf("%7s %12s | %11s %8s %8s | %11s %8s %8s\n", "", "", "receiver", "", "", "controller", "", "");
+    printf("%7s %12s | %11s %8s %8s | %11s %8s %8s\n", "t s", "offset ms", "error ms", "rtt ms", "ppm",
+           "error ms", "rtt ms", "ppm");
+    for (int i = 0; i < r.samples; ++i) {
+        const ClockSyncSample &s = r.sample[i];
+        printf("%7.1f %12.1f | %11.1f %8d %8d | %11.1f %8d %8d\n", s.atS, s.trueOffsetMs,
+               s.receiver.offsetErrorMs, s.receiver.roundTripMs, s.receiver.driftPpm,
+               s.controller.offsetErrorMs, s.controller.roundTripMs, s.controller.driftPpm);
+    }
+
+    printf("\nafter %.0f s (fixed round trip %.0f ms):\n", SETTLED_S, r.trueRoundTripMs);
+    for (bool receiver : {true, false}) {
+        double p50, max, drift;
+        summarise(r, receiver, p50, max, drift);
+        printf("  %-10s offset error p50 %.1f ms, max %.1f ms, drift %.0f ppm\n",
+               receiver ? "receiver" : "controller", p50, max, drift);
+    }
+    return 0;
+}
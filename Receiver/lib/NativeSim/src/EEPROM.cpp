@@ -0,0 +1,20 @@
+#include "EEPROM.h"
+#include "SimBoard.h"
+
+EEPROMClass EEPROM;
+
+uint8_t EEPROMClass::read(int idx) {
+    return board().eepromRead(idx);
+}
+
+void EEPROMClass::write(int idx, uint8_t val) {
+    board().eepromWrite(idx, val);
+}
+
+void EEPROMClass::update(int idx, uint8_t val) {
+    if (read(idx) != val) write(idx, val);
+}
+
+uint16_t EEPROMClass::length() {
+    return SimBoard::EEPROM_SIZE;
+}
@@ -0,0 +1,206 @@
+#include "EmergencyStop.h"
+#include "Packets.h"
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+extern bool isrFraming;
+
+static const uint64_t SECOND_US = 1000000;
+static const uint64_t SETTLE_US = 100000;       // After boot, before the scenario starts
+static const uint64_t PRESS_US = SECOND_US;     // From the start of the scenario to the start of the window
+static const uint64_t AFTER_US = 3 * SECOND_US; // Run on after the stop, long enough for a countdown to tick
+// The detail and number LEDs, which the stop blanks but for "StP" on the number; the red light pulses
+static const size_t PROBE_FIRST = 0;
+static const size_t PROBE_COUNT = 161;
+
+const EstopScenario ESTOP_SCENARIOS[] = {
+        {"quiet",      "Green shown, nothing else on the line",                         50000},
+        {"countdown",  "Countdown running, state repeated at 2 Hz",                     SECOND_US},
+        {"transition", "Just after an end transition sent as four back-to-back frames", SECOND_US},
+        {"mid-frame",  "Part-way through a state frame, which the signal breaks into",  15000},
+};
+const int NUM_ESTOP_SCENARIOS = sizeof(ESTOP_SCENARIOS) / sizeof(ESTOP_SCENARIOS[0]);
+
+static StateFields shootingState(int16_t time) {
+    StateFields fields;
+    fields.countdown = true;
+    fields.detail = 1;
+    fields.colour = 2;
+    fields.timeEnabled = true;
+    fields.time = time;
+    fields.endNumBeeps = 3;
+    return fields;
+}
+
+/**
+ * Send the traffic leading up to the stop, and the stop itself.
+ *
+ * @return When the first byte of the stop went out.
+ */
+static uint64_t sendScenario(SimBoard &sim, int scenario, bool signal, uint64_t start, uint64_t pressUs) {
+    const std::vector<uint8_t> begin = encodeStatePacket(shootingState(240));
+    sim.transmit(start, begin.data(), begin.size());
+
+    std::vector<uint8_t> stop;
+    if (signal) stop = encodeEmergencyStopSignal();
+    StateFields stopped;
+    stopped.emergencyStop = true;
+    const std::vector<uint8_t> state = encodeGenerationPacket(1, stopped);
+    stop.insert(stop.end(), state.begin(), state.end());
+
+    switch (scenario) {
+        case 1:
+            for (uint64_t at = SECOND_US / 2; at < PRESS_US + SECOND_US; at += SECOND_US / 2) {
+                const std::vector<uint8_t> repeat = encodeStatePacket(shootingState((int16_t) (240 - at / SECOND_US)));
+                sim.transmit(start + at, repeat.data(), repeat.size());
+            }
+            break;
+
+        case 2: {
+            StateFields fields;
+            fields.colour = 1;
+            for (int step = 0; step < 4; ++step) {
+                if (step == 1) fields.detail = 2;
+                if (step == 2) fields.timeEnabled = true, fields.time = 10;
+                if (step == 3) fields.startNumBeeps = 2;
+                const std::vector<uint8_t> packet = encodeStatePacket(fields);
+                sim.transmit(start + PRESS_US, packet.data(), packet.size());
+            }
+            break;
+        }
+
+        case 3: {
+            // The controller gives up on the rest of the frame for the signal; a state has to wait for it
+            std::vector<uint8_t> packet = encodeStatePacket(shootingState(239));
+            const size_t cut = signal ? (size_t) (pressUs * 9600 / 10 / SECOND_US) % packet.size() : packet.size();
+            packet.resize(cut);
+            const uint64_t pressed = sim.transmit(start + PRESS_US, packet.data(), packet.size());
+            sim.transmit(pressed, stop.data(), stop.size());
+            return cut ? pressed : start + PRESS_US;
+        }
+
+        default:
+            break;
+    }
+    const uint64_t at = start + PRESS_US + pressUs;
+    return sim.transmit(at, stop.data(), stop.size()) - (stop.size() - 1) * 10 * SECOND_US / 9600;
+}
+
+/**
+ * The probe of what a stop leaves on the display, from a receiver sent nothing but the stop. The palettes have the
+ * brightness baked in, so the LEDs go out as drawn and a lit display hashes the same from one show() to the next.
+ */
+static uint32_t stoppedProbe(bool isr) {
+    uint32_t probe = 0;
+    bool ok = runIsolated<uint32_t>([&]() {
+        SimBoard sim;
+        sim.setProbe(PROBE_FIRST, PROBE_COUNT);
+        isrFraming = isr;
+        sim.boot();
+        sim.runUntil([]() { return false; }, SETTLE_US);
+
+        StateFields stopped;
+        stopped.emergencyStop = true;
+        const std::vector<uint8_t> state = encodeGenerationPacket(1, stopped);
+        const uint64_t sent = sim.transmit(sim.now(), state.data(), state.size());
+        sim.runUntil([]() { return false; }, sent + SECOND_US);
+        return sim.frames().back().probe;
+    }, probe);
+    if (!ok) fprintf(stderr, "Simulated receiver crashed stopping from idle\n");
+    return probe;
+}
+
+/**
+ * One press of the stop.
+ */
+struct EstopRun {
+    uint64_t latencyUs;         // 0 if the display was never stopped
+    bool held;
+};
+
+EstopReport runEstop(int scenario, bool signal, int runs, bool isr) {
+    EstopReport report = {};
+    report.runs = runs;
+    uint64_t totalUs = 0;
+    const uint32_t stop = stoppedProbe(isr);
+    for (int run = 0; run < runs; ++run) {
+        const uint64_t pressUs = ESTOP_SCENARIOS[scenario].windowUs * run / runs;
+        EstopRun result = {};
+        bool ok = runIsolated<EstopRun>([&]() {
+            SimBoard sim;
+            sim.setProbe(PROBE_FIRST, PROBE_COUNT);
+            isrFraming = isr;
+            sim.boot();
+            sim.runUntil([]() { return false; }, SETTLE_US);
+
+            const uint64_t start = sim.now();
+            const uint64_t pressed = sendScenario(sim, scenario, signal, start, pressUs);
+            sim.runUntil([]() { return false; }, pressed + AFTER_US);
+
+            EstopRun r = {};
+            const std::vector<ShownFrame> &frames = sim.frames();
+            for (const ShownFrame &frame : frames) {
+                if (frame.startUs < pressed || frame.probe != stop) continue;
+                r.latencyUs = frame.endUs - pressed;
+                break;
+            }
+            r.held = frames.back().probe == stop;
+            return r;
+        }, result);
+        if (!ok) fprintf(stderr, "Simulated receiver crashed in scenario %s\n", ESTOP_SCENARIOS[scenario].name);
+
+        if (result.held) report.held++;
+        if (!result.latencyUs) continue;
+        report.stopped++;
+        totalUs += result.latencyUs;
+        report.worstUs = std::max(report.worstUs, result.latencyUs);
+    }
+    report.meanUs = report.stopped ? (double) totalUs / report.stopped : 0;
+    return report;
+}
+
+int estopMain(int argc, char **argv) {
+    int runs = 20;
+    const char *only = nullptr;
+    bool isr = false;
+
+    for (int i = 0; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--runs")) {
+            runs = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--scenario")) {
+            only = argv[i + 1];
+        } else if (!strcmp(argv[i], "--rx")) {
+            isr = !strcmp(argv[i + 1], "isr");
+            if (!isr && strcmp(argv[i + 1], "ring") != 0) argc = -1;
+        } else {
+            argc = -1;
+        }
+    }
+    if (argc < 0 || argc % 2 || runs < 1) {
+        fprintf(stderr,
+                "usage: program estop [options]\n"
+                "  --runs N          Presses of the stop per scenario, spread over its window (default 20)\n"
+                "  --scenario NAME   Run only this scenario: quiet, countdown, transition or mid-frame\n"
+                "  --rx X            Frames read from the serial ring in loop() (ring) or by the RX interrupt (isr)\n"
+                "                    (default ring)\n");
+        return 2;
+    }
+
+    printf("%-11s %-7s %5s %8s %5s %8s %9s\n", "scenario", "stop as", "runs", "stopped", "held", "mean ms",
+           "worst ms");
+    for (int s = 0; s < NUM_ESTOP_SCENARIOS; ++s) {
+        if (only && strcmp(only, ESTOP_SCENARIOS[s].name) != 0) continue;
+        for (bool signal : {false, true}) {
+            const EstopReport r = runEstop(s, signal, runs, isr);
+            printf("%-11s %-7s %5d %8d %5d %8.2f %9.2f\n", ESTOP_SCENARIOS[s].name, signal ? "signal" : "state",
+                   r.runs, r.stopped, r.held, r.meanUs / 1000.0, r.worstUs / 1000.0);
+            fflush(stdout);
+        }
+    }
+    return 0;
+}
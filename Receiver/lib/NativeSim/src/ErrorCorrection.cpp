@@ -0,0 +1,234 @@
+#include "ErrorCorrection.h"
+#include "Packets.h"
+#include "SimBoard.h"
+
+#include <Fec.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <set>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC
+#endif
+
+static const uint64_t SECOND_US = 1000000;
+// How long to keep running after the last byte, so the last packet's debug output can finish
+static const uint64_t TAIL_US = 2000000;
+// Times per decode benchmark
+static const int BENCH_ROUNDS = 200000;
+
+static const double BIT_ERROR_RATES[] = {0, 1e-4, 3e-4, 1e-3, 3e-3, 1e-2, 2e-2, 5e-2};
+
+/**
+ * Flips the data bits of bytes on their way to the receiver. Start and stop bits are left alone, as a flipped one
+ * is a framing error the UART drops the byte for rather than a wrong byte.
+ */
+class NoisyLink {
+private:
+    std::mt19937 rng;
+    std::uniform_real_distribution<double> uniform{0, 1};
+    double eventRate;
+    int burst;
+    int burstLeft = 0;
+
+public:
+    long flipped = 0;
+
+    NoisyLink(const NoiseOptions &options) : rng(options.seed), eventRate(options.bitErrorRate / options.burst),
+                                              burst(options.burst) {}
+
+    void apply(std::vector<uint8_t> &bytes) {
+        for (uint8_t &b : bytes) {
+            for (int bit = 0; bit < 8; ++bit) {
+                if (burstLeft == 0 && uniform(rng) < eventRate) burstLeft = burst;
+                if (burstLeft > 0) {
+                    b ^= 1 << bit;
+                    burstLeft--;
+                    flipped++;
+                }
+            }
+        }
+    }
+};
+
+static bool parseTime(const std::string &line, int &time) {
+    const char *marker = "Time value:";
+    size_t pos = line.find(marker);
+    if (pos == std::string::npos) return false;
+    time = atoi(line.c_str() + pos + strlen(marker));
+    return true;
+}
+
+NoiseResult runNoisyLink(const NoiseOptions &options, bool fec) {
+    NoiseResult result = {options.updates, 0, 0, 0, 0};
+
+    runIsolated<NoiseResult>([&]() {
+        SimBoard sim;
+        sim.boot();
+        sim.runUntil([]() { return false; }, 100000);
+
+        NoisyLink link(options);
+        StateFields fields;
+        fields.timeEnabled = true;
+        const uint64_t start = sim.now();
+        uint64_t lastByte = start;
+        for (int i = 0; i < options.updates; ++i) {
+            fields.time = (int16_t) (i + 1);
+            std::vector<uint8_t> packet = fec ? encodeFecStatePacket(fields) : encodeStatePacket(fields);
+            link.apply(packet);
+            lastByte = sim.transmit(start + i * options.spacingUs, packet.data(), packet.size());
+        }
+        const uint64_t quiet = lastByte + TAIL_US;
+        sim.runUntil([&]() { return sim.now() >= quiet && sim.pendingRx() == 0; }, quiet + 60 * SECOND_US);
+
+        NoiseResult trial = result;
+        trial.flippedBits = link.flipped;
+        std::set<int> seen;
+        bool corrected = false;
+        for (const SerialLine &line : sim.lines()) {
+            int time;
+            if (line.text.find("FEC corrected") != std::string::npos) {
+                corrected = true;
+            } else if (parseTime(line.text, time)) {
+                if (time >= 1 && time <= options.updates && seen.insert(time).second) {
+                    trial.delivered++;
+                    if (corrected) trial.corrected++;
+                } else if (time < 1 || time > options.updates) {
+                    trial.wrong++;
+                }
+                corrected = false;
+            }
+        }
+        return trial;
+    }, result);
+    return result;
+}
+
+//region benchmark
+
+/**
+ * Time a decode, in cycles (or nanoseconds where there is no cycle counter) per byte of frame.
+ */
+template<typename F>
+static double timePerByte(F decode, int frameBytes) {
+    volatile int sink = 0;
+    for (int i = 0; i < BENCH_ROUNDS / 10; ++i) {
+        sink = sink + decode();
+    }
+#ifdef HAVE_RDTSC
+    const uint64_t begin = __rdtsc();
+    for (int i = 0; i < BENCH_ROUNDS; ++i) {
+        sink = sink + decode();
+    }
+    const double elapsed = (double) (__rdtsc() - begin);
+#else
+    const auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCH_ROUNDS; ++i) {
+        sink = sink + decode();
+    }
+    const double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+#endif
+    return elapsed / BENCH_ROUNDS / frameBytes;
+}
+
+static void benchmarkDecode() {
+    StateFields fields;
+    fields.timeEnabled = true;
+    fields.time = 123;
+    const std::vector<uint8_t> plain = encodeStatePacket(fields);
+    const std::vector<uint8_t> data(plain.begin() + PACKET_OVERHEAD, plain.end());
+    const std::vector<uint8_t> packet = encodeFecStatePacket(fields);
+    const uint8_t length = (uint8_t) data.size();
+    const uint8_t bodySize = fecBodySize(length);
+
+    std::vector<uint8_t> clean(packet.begin() + FEC_HEADER_SIZE + FEC_LENGTH_SIZE, packet.end());
+    // Bit 0 of every codeword flipped, the most that can be corrected: the first bodySize bits of the body
+    std::vector<uint8_t> noisy = clean;
+    for (int i = 0; i < bodySize; ++i) {
+        noisy[i >> 3] ^= 1 << (i & 7);
+    }
+
+    uint8_t out[FEC_MAX_DATA];
+    const double checksum = timePerByte([&]() {
+        unsigned int sum = 0;
+        for (uint8_t b : data) {
+            sum += b;
+        }
+        return (int) sum;
+    }, length);
+    const double decodeClean = timePerByte([&]() { return fecDecodeBody(clean.data(), length, out); }, length);
+    const double decodeNoisy = timePerByte([&]() { return fecDecodeBody(noisy.data(), length, out); }, length);
+    const int correctedBits = fecDecodeBody(noisy.data(), length, out);
+
+#ifdef HAVE_RDTSC
+    const char *unit = "cycles";
+#else
+    const char *unit = "ns";
+#endif
+    printf("decode of a %d byte state frame (%d bytes on the wire plain, %d with FEC), host %s per frame byte:\n",
+           length, (int) plain.size(), (int) packet.size(), unit);
+    printf("  %-34s %8.1f\n", "additive checksum only", checksum);
+    printf("  %-34s %8.1f\n", "FEC, no errors", decodeClean);
+    printf("  %-34s %8.1f  (%d bits corrected)\n\n", "FEC, one bit flipped per codeword", decodeNoisy,
+           correctedBits);
+}
+
+//endregion
+
+int fecMain(int argc, char **argv) {
+    NoiseOptions options;
+    bool sweep = true;
+    bool bench = true;
+
+    for (int i = 0; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--updates")) {
+            options.updates = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--spacing")) {
+            options.spacingUs = (uint64_t) (atof(argv[i + 1]) * 1000);
+        } else if (!strcmp(argv[i], "--burst")) {
+            options.burst = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--seed")) {
+            options.seed = (uint32_t) strtoul(argv[i + 1], nullptr, 10);
+        } else if (!strcmp(argv[i], "--only")) {
+            sweep = !strcmp(argv[i + 1], "sweep");
+            bench = !strcmp(argv[i + 1], "bench");
+            if (!sweep && !bench) argc = -1;
+        } else {
+            argc = -1;
+        }
+    }
+    if (argc < 0 || argc % 2 || options.updates < 1 || options.burst < 1 || options.spacingUs == 0) {
+        fprintf(stderr,
+                "usage: program fec [options]\n"
+                "  --updates N    State updates per run (default 200)\n"
+                "  --spacing MS   Time between updates (default 500)\n"
+                "  --burst N      Bits flipped in a row for each error (default 1)\n"
+                "  --seed N\n"
+                "  --only X       Just the decode benchmark (bench) or the error rate sweep (sweep)\n");
+        return 2;
+    }
+
+    if (bench) benchmarkDecode();
+    if (!sweep) return 0;
+
+    printf("%d updates %.0f ms apart, errors in bursts of %d bits\n\n", options.updates,
+           options.spacingUs / 1000.0, options.burst);
+    printf("%9s | %9s %7s %7s | %9s %7s %7s %9s\n", "", "plain", "", "", "FEC", "", "", "");
+    printf("%9s | %9s %7s %7s | %9s %7s %7s %9s\n", "BER", "delivered", "%", "wrong", "delivered", "%", "wrong",
+           "corrected");
+    for (double ber : BIT_ERROR_RATES) {
+        options.bitErrorRate = ber;
+        const NoiseResult plain = runNoisyLink(options, false);
+        const NoiseResult fec = runNoisyLink(options, true);
+        printf("%9.0e | %9d %6.1f%% %7d | %9d %6.1f%% %7d %9d\n", ber,
+               plain.delivered, 100.0 * plain.delivered / plain.sent, plain.wrong,
+               fec.delivered, 100.0 * fec.delivered / fec.sent, fec.wrong, fec.corrected);
+    }
+    return 0;
+}
@@ -0,0 +1,92 @@
+#include "FastLED.h"
+#include "SimBoard.h"
+
+#include <vector>
+
+CFastLED FastLED;
+bool simDithering = true;
+
+CLEDController &CFastLED::add(CRGB *data, int nLeds, uint8_t pin, EOrder order) {
+    if (numControllers == MAX_CONTROLLERS) numControllers--;  // Reuse the last slot rather than overrun
+    CLEDController &controller = controllers[numControllers++];
+    if (numControllers > 1) {
+        const CLEDController &previous = controllers[numControllers - 2];
+        controller.first = previous.first + previous.numLeds;
+    }
+    controller.leds = data;
+    controller.numLeds = nLeds;
+    controller.pin = pin;
+    controller.order = order;
+    return controller;
+}
+
+/**
+ * Scale a channel the way FastLED's scale8() does.
+ */
+static uint8_t scale8(uint8_t value, uint8_t scale) {
+    return (uint8_t) (((uint16_t) value * (1 + (uint16_t) scale)) >> 8);
+}
+
+void CLEDController::encode(uint8_t brightness, uint8_t *wire) {
+    const uint8_t adjust[3] = {
+            scale8(correction.r, brightness),
+            scale8(correction.g, brightness),
+            scale8(correction.b, brightness)
+    };
+
+    // Binary dithering as FastLED's PixelController does it: a pattern stepped on every show, of up to one step of
+    // the scale added to each lit channel, alternating from one LED to the next
+    uint8_t d[3] = {0, 0, 0};
+    uint8_t e[3] = {0, 0, 0};
+    if (dither && simDithering) {
+        static uint8_t shows = 0;
+        shows++;
+        uint8_t q = 0;
+        if (shows & 0x01) q |= 0x80;
+        if (shows & 0x02) q |= 0x40;
+        if (shows & 0x04) q |= 0x20;
+        for (int c = 0; c < 3; ++c) {
+            e[c] = adjust[c] ? 256 / adjust[c] + 1 : 0;
+            d[c] = scale8(q, e[c]);
+            if (d[c]) d[c]--;
+            if (e[c]) e[c]--;
+        }
+    }
+
+    for (int i = 0; i < numLeds; ++i) {
+        const uint8_t in[3] = {leds[i].r, leds[i].g, leds[i].b};
+        uint8_t rgb[3];
+        for (int c = 0; c < 3; ++c) {
+            const uint8_t dithered = in[c] ? (uint8_t) (in[c] + d[c] > 255 ? 255 : in[c] + d[c]) : 0;
+            rgb[c] = scale8(dithered, adjust[c]);
+            d[c] = e[c] - d[c];
+        }
+        // EOrder packs the source channel for each wire position as octal digits, first out in the top digit
+        *wire++ = rgb[(order >> 6) & 7];
+        *wire++ = rgb[(order >> 3) & 7];
+        *wire++ = rgb[order & 7];
+    }
+}
+
+void CLEDController::showLeds(uint8_t brightness) {
+    std::vector<uint8_t> wire(numLeds * 3);
+    encode(brightness, wire.data());
+    board().show(wire.data(), first, numLeds);
+}
+
+void CFastLED::setDither(uint8_t mode) {
+    for (int c = 0; c < numControllers; ++c) {
+        controllers[c].setDither(mode);
+    }
+}
+
+void CFastLED::show() {
+    for (int c = 0; c < numControllers; ++c) {
+        // FastLED leaves dithering out of its own show() while it counts under 100 frames a second, as a display
+        // redrawn on change always does; a chain's showLeds() called directly dithers regardless
+        const uint8_t mode = controllers[c].dither;
+        controllers[c].dither = DISABLE_DITHER;
+        controllers[c].showLeds(brightness);
+        controllers[c].dither = mode;
+    }
+}
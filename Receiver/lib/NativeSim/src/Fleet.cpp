@@ -0,0 +1,463 @@
+#include "Fleet.h"
+#include "Packets.h"
+
+#include <Arduino.h>
+#include <Board.h>
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <sys/wait.h>
+#include <thread>
+
+static const uint64_t SECOND_US = 1000000;
+static const uint64_t QUERY_US = 1500000;
+static const int DISCOVERY_MAX_ROUNDS = 10;
+static const uint64_t END_SPACING_US = 30 * SECOND_US;
+static const uint64_t TAIL_US = 2 * SECOND_US;
+// All three lights, so any change of colour shows up
+static const int LIGHTS_LEDS = NUM_LEDS - LIGHTS_FIRST_LED;
+
+/**
+ * A packet from the controller, in controller time.
+ */
+struct Send {
+    uint64_t atUs;
+    std::vector<uint8_t> packet;
+};
+
+/**
+ * From a query for every receiver to the last report to it reaching the controller: every slot, and the radio's
+ * delay both ways.
+ */
+static uint64_t slotsUs(const FleetOptions &options) {
+    return CLOCK_REPORT_SLOTS * CLOCK_REPORT_SLOT_MS * 1000 + 2 * (options.maxDelayUs + options.jitterUs);
+}
+
+/**
+ * When each discovery round starts, and after them all, when the queries to each receiver by its id start.
+ */
+static std::vector<uint64_t> roundStarts(const FleetOptions &options, const std::vector<std::vector<uint16_t>> &found) {
+    std::vector<uint64_t> starts(1, QUERY_US);
+    for (const std::vector<uint16_t> &round : found) {
+        starts.push_back(starts.back() + slotsUs(options) + (round.size() + 1) * options.pollGapUs);
+    }
+    return starts;
+}
+
+/**
+ * The session: rounds of a query for every receiver to report in, each followed by a query by id to each receiver
+ * heard clear in it, which has it leave the next rounds to the rest; then one query to each receiver by its id, then
+ * the ends as TargetFragment sends them, each state repeated until the next.
+ *
+ * @param found     The receivers heard clear in each discovery round so far. With no ids, the session stops after
+ *                  one more round for the receivers not yet found.
+ * @param commandUs Filled with when each state was first sent.
+ * @param commands  And its packet.
+ */
+static std::vector<Send> planSession(const FleetOptions &options, const std::vector<std::vector<uint16_t>> &found,
+                                     const std::vector<uint16_t> &ids, std::vector<uint64_t> &commandUs,
+                                     std::vector<std::vector<uint8_t>> &commands) {
+    std::vector<Send> sends;
+    const std::vector<uint64_t> starts = roundStarts(options, found);
+    for (size_t r = 0; r < found.size(); ++r) {
+        sends.push_back({starts[r], encodeClockQueryPacket(ANY_RECEIVER)});
+        for (size_t i = 0; i < found[r].size(); ++i) {
+            const uint64_t at = starts[r] + slotsUs(options) + i * options.pollGapUs;
+            sends.push_back({at, encodeClockQueryPacket(found[r][i])});
+        }
+    }
+    if (ids.empty()) {
+        sends.push_back({starts.back(), encodeClockQueryPacket(ANY_RECEIVER)});
+        return sends;
+    }
+
+    const uint64_t pollUs = starts.back();
+    for (size_t i = 0; i < ids.size(); ++i) {
+        sends.push_back({pollUs + i * options.pollGapUs, encodeClockQueryPacket(ids[i])});
+    }
+
+    const uint64_t firstEndUs = pollUs + ids.size() * options.pollGapUs + SECOND_US;
+    std::vector<Send> states;
+    for (int end = 0; end < options.ends; ++end) {
+        const uint64_t start = firstEndUs + end * END_SPACING_US;
+        StateFields amber;
+        amber.countdownContinues = true;
+        amber.countdown = true;
+        amber.detail = 1;
+        amber.colour = 1;
+        amber.timeEnabled = true;
+        amber.time = 10;
+        amber.startNumBeeps = 2;
+        amber.endNumBeeps = 1;
+        StateFields green = amber;
+        green.countdownContinues = false;
+        green.colour = 2;
+        green.time = 240;
+        green.startNumBeeps = 0;
+        green.endNumBeeps = 3;
+        StateFields score;
+        score.timeEnabled = true;
+        score.time = 240;
+        score.endNumBeeps = 3;
+
+        const StateFields fields[3] = {amber, green, score};
+        for (int c = 0; c < 3; ++c) {
+            const uint64_t at = start + c * 10 * SECOND_US;
+            commandUs.push_back(at);
+            commands.push_back(encodeGenerationPacket((uint16_t) commandUs.size(), fields[c]));
+            states.push_back({at, commands.back()});
+        }
+    }
+    for (size_t i = 0; i < states.size(); ++i) {
+        const uint64_t until = i + 1 < states.size() ? states[i + 1].atUs : states[i].atUs + TAIL_US;
+        for (uint64_t at = states[i].atUs; at < until; at += options.repeatUs) {
+            sends.push_back({at, states[i].packet});
+        }
+    }
+    return sends;
+}
+
+// A child's result must fit in its pipe, so that it can exit before runFleet() gets round to reading it
+static_assert(sizeof(FleetReceiver) <= PIPE_BUF, "FleetReceiver must fit in a pipe's buffer");
+
+/**
+ * Start one receiver through the session on its own radio link, in a child of its own.
+ *
+ * @return If the child was started, for finishIsolated() to collect its FleetReceiver.
+ */
+static bool startReceiver(const FleetOptions &options, const std::vector<Send> &sends,
+                          const std::vector<std::vector<uint8_t>> &commands, uint64_t endUs, int index,
+                          IsolatedRun &run) {
+    // The same receiver gets the same power-on time, id and link on every pass
+    std::mt19937 rng(options.seed * 7919 + index);
+    std::mt19937 uplink(options.seed * 7919 + index + 0x9E3779B9u);
+    const uint64_t bootUs = std::uniform_int_distribution<uint64_t>(SECOND_US / 10, SECOND_US)(rng);
+    const uint64_t delayUs = std::uniform_int_distribution<uint64_t>(options.minDelayUs, options.maxDelayUs)(rng);
+    std::uniform_int_distribution<uint64_t> jitterDist(0, options.jitterUs);
+    std::bernoulli_distribution lostDist(options.loss);
+
+    // Jitter and loss are drawn in the order packets are sent, so a pass that sends more draws the same for the
+    // packets both send
+    std::vector<Send> heard;
+    for (const Send &send : sends) {
+        const uint64_t jitterUs = jitterDist(rng);
+        if (lostDist(rng)) continue;
+        heard.push_back({send.atUs + bootUs + delayUs + jitterUs, send.packet});
+    }
+    std::stable_sort(heard.begin(), heard.end(), [](const Send &a, const Send &b) { return a.atUs < b.atUs; });
+
+    // Each state counts from the first copy of it the receiver heard, so a change the receiver makes by itself just
+    // before it, like a countdown running out, is not taken for it
+    std::vector<uint64_t> heardUs(commands.size(), 0);
+    for (size_t c = 0; c < commands.size(); ++c) {
+        for (const Send &send : heard) {
+            if (send.packet == commands[c]) {
+                heardUs[c] = send.atUs;
+                break;
+            }
+        }
+    }
+
+    return startIsolated([&](void *out) {
+        SimBoard sim;
+        sim.setProbe(LIGHTS_FIRST_LED, LIGHTS_LEDS);
+        sim.setPin(QUIET_PIN, LOW);
+        sim.setNoiseSeed(options.seed * 7919 + index);
+        sim.boot();
+
+        for (const Send &send : heard) {
+            sim.transmit(send.atUs, send.packet.data(), send.packet.size());
+        }
+        sim.runUntil([&]() { return sim.now() >= endUs + bootUs; }, endUs + bootUs + SECOND_US);
+
+        FleetReceiver r;
+        memset(&r, 0, sizeof(r));   // Padding too, as passes are compared byte for byte
+        size_t next = 0;
+        for (const DecodedFrame &frame : decodeFrames(sim.txHistory(), next)) {
+            const uint8_t type = frame.data[0];
+            if ((type != FRAME_CLOCK_REPORT && type != FRAME_PONG) || r.replies == FLEET_MAX_REPLIES) continue;
+            r.id = (uint16_t) readField(frame.data, 1, 2);
+            const uint64_t airUs = (frame.data.size() + PACKET_OVERHEAD) * sim.byteTimeUs();
+            const uint64_t endAt = frame.endUs - bootUs + delayUs + jitterDist(uplink);
+            r.reply[r.replies++] = {endAt - airUs, endAt, type};
+        }
+
+        const std::vector<ShownFrame> &frames = sim.frames();
+        for (size_t c = 0; c < commands.size() && c < FLEET_MAX_COMMANDS; ++c) {
+            for (size_t i = 1; heardUs[c] && i < frames.size(); ++i) {
+                if (frames[i].endUs >= heardUs[c] && frames[i].probe != frames[i - 1].probe) {
+                    r.lightUs[c] = frames[i].endUs - bootUs;
+                    break;
+                }
+            }
+        }
+        memcpy(out, &r, sizeof(r));
+    }, sizeof(FleetReceiver), run);
+}
+
+std::vector<FleetReceiver> runFleet(const FleetOptions &options, const std::vector<std::vector<uint16_t>> &found,
+                                    const std::vector<uint16_t> &ids, int threads) {
+    std::vector<uint64_t> commandUs;
+    std::vector<std::vector<uint8_t>> commands;
+    const std::vector<Send> sends = planSession(options, found, ids, commandUs, commands);
+    const uint64_t endUs = commandUs.empty() ? roundStarts(options, found).back() + slotsUs(options)
+                                             : commandUs.back() + TAIL_US;
+
+    // Each receiver is a whole forked run. This thread alone forks them, keeping up to `threads` running, and starts
+    // the next as soon as any one exits; a receiver that runs long holds up nothing but itself
+    std::vector<FleetReceiver> results(options.receivers);
+    std::map<pid_t, std::pair<IsolatedRun, int>> running;
+    int next = 0;
+    fflush(stdout);
+    while (next < options.receivers || !running.empty()) {
+        while (next < options.receivers && (int) running.size() < threads) {
+            IsolatedRun run;
+            if (startReceiver(options, sends, commands, endUs, next, run)) {
+                running[run.pid] = {run, next};
+            } else {
+                fprintf(stderr, "Simulated receiver %d could not be started\n", next);
+            }
+            next++;
+        }
+        if (running.empty()) continue;
+
+        // Find a child that has exited, leaving finishIsolated() to reap it
+        siginfo_t info = {};
+        if (waitid(P_ALL, 0, &info, WEXITED | WNOWAIT) != 0) info.si_pid = running.begin()->first;
+        const auto child = running.find(info.si_pid);
+        if (child == running.end()) {
+            waitpid(info.si_pid, nullptr, 0);   // Not one of ours
+            continue;
+        }
+        const int index = child->second.second;
+        if (!finishIsolated(child->second.first, &results[index], sizeof(FleetReceiver))) {
+            results[index] = {};
+            fprintf(stderr, "Simulated receiver %d crashed\n", index);
+        }
+        running.erase(child);
+    }
+    return results;
+}
+
+/**
+ * The receivers whose replies went out over the air without overlapping any other's, so the controller heard them.
+ */
+static std::vector<bool> clearReplies(const std::vector<FleetReceiver> &fleet, std::vector<const FleetReply *> &all) {
+    for (const FleetReceiver &receiver : fleet) {
+        for (int i = 0; i < receiver.replies; ++i) {
+            all.push_back(&receiver.reply[i]);
+        }
+    }
+    std::sort(all.begin(), all.end(), [](const FleetReply *a, const FleetReply *b) { return a->startUs < b->startUs; });
+    std::vector<bool> clear(all.size(), true);
+    for (size_t i = 0; i < all.size(); ++i) {
+        for (size_t j = i + 1; j < all.size() && all[j]->startUs < all[i]->endUs; ++j) {
+            clear[i] = clear[j] = false;
+        }
+    }
+    return clear;
+}
+
+static const FleetReceiver *sender(const std::vector<FleetReceiver> &fleet, const FleetReply *reply) {
+    for (const FleetReceiver &receiver : fleet) {
+        if (reply >= receiver.reply && reply < receiver.reply + receiver.replies) return &receiver;
+    }
+    return nullptr;
+}
+
+static double wallSeconds(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+}
+
+int fleetMain(int argc, char **argv) {
+    FleetOptions options;
+    bool scaling = false;
+
+    for (int i = 0; i < argc; i += 2) {
+        if (!strcmp(argv[i], "--scaling")) {
+            scaling = true;
+            --i;
+        } else if (i + 1 >= argc) {
+            argc = -1;
+        } else if (!strcmp(argv[i], "--receivers")) {
+            options.receivers = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--ends")) {
+            options.ends = std::min(atoi(argv[i + 1]), FLEET_MAX_COMMANDS / 3);
+        } else if (!strcmp(argv[i], "--threads")) {
+            options.threads = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--delay")) {
+            // min-max in ms
+            double lo = 0, hi = 0;
+            if (sscanf(argv[i + 1], "%lf-%lf", &lo, &hi) != 2) argc = -1;
+            options.minDelayUs = (uint64_t) (lo * 1000);
+            options.maxDelayUs = (uint64_t) (std::max(lo, hi) * 1000);
+        } else if (!strcmp(argv[i], "--jitter")) {
+            options.jitterUs = (uint64_t) (atof(argv[i + 1]) * 1000);
+        } else if (!strcmp(argv[i], "--loss")) {
+            options.loss = atof(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--poll-gap")) {
+            options.pollGapUs = (uint64_t) (atof(argv[i + 1]) * 1000);
+        } else if (!strcmp(argv[i], "--seed")) {
+            options.seed = (uint32_t) strtoul(argv[i + 1], nullptr, 10);
+        } else {
+            argc = -1;
+        }
+    }
+    if (argc < 0 || options.receivers < 1 || options.ends < 1 || options.threads < 0 || options.pollGapUs == 0 ||
+        options.loss < 0 || options.loss >= 1) {
+        fprintf(stderr,
+                "usage: program fleet [options]\n"
+                "  --receivers N   Receivers on the field (default 40)\n"
+                "  --ends N        Ends to run, three states each (default 5, at most 20)\n"
+                "  --threads N     Receivers simulated at once (default: one per core)\n"
+                "  --delay LO-HI   Fixed radio delay per receiver, in ms (default 5-15)\n"
+                "  --jitter MS     Extra delay per packet, up to this (default 20)\n"
+                "  --loss P        Chance of a receiver missing each packet, 0 to 1 (default 0)\n"
+                "  --poll-gap MS   Between queries to each receiver by its id (default 60)\n"
+                "  --scaling       Run the field again on 1, 2, 4... threads up to the default, and time each\n"
+                "  --seed N\n");
+        return 2;
+    }
+    const int cores = std::max(1, (int) std::thread::hardware_concurrency());
+    const int threads = options.threads ? options.threads : cores;
+
+    printf("%d receivers, %d ends, radio delay %.0f-%.0f ms, jitter up to %.0f ms, %.0f%% of packets lost, "
+           "%d thread%s on %d core%s\n\n", options.receivers, options.ends, options.minDelayUs / 1000.0,
+           options.maxDelayUs / 1000.0, options.jitterUs / 1000.0, options.loss * 100, threads,
+           threads == 1 ? "" : "s", cores, cores == 1 ? "" : "s");
+
+    // The first passes only go as far as the receivers reporting in, one more discovery round each, until a round
+    // brings no reports. What the controller heard clear in each decides what it sends in the next, so each pass runs
+    // the session again from the start. The last pass queries every id, not just those found, so that addressing is
+    // checked for the whole field.
+    const auto started = std::chrono::steady_clock::now();
+    std::vector<std::vector<uint16_t>> found;
+    std::vector<uint16_t> known;
+    std::vector<uint16_t> ids;
+    int duplicateIds = 0;
+    std::vector<FleetReceiver> fleet;
+    std::vector<const FleetReply *> replies;
+    std::vector<bool> clear;
+    for (int round = 0; round < DISCOVERY_MAX_ROUNDS; ++round) {
+        fleet = runFleet(options, found, {}, threads);
+        replies.clear();
+        clear = clearReplies(fleet, replies);
+        const uint64_t startUs = roundStarts(options, found).back();
+        std::vector<uint16_t> heard;
+        int reports = 0;
+        for (size_t i = 0; i < replies.size(); ++i) {
+            if (replies[i]->type != FRAME_CLOCK_REPORT || replies[i]->startUs < startUs) continue;
+            reports++;
+            const uint16_t id = sender(fleet, replies[i])->id;
+            if (clear[i] && std::find(known.begin(), known.end(), id) == known.end()) {
+                heard.push_back(id);
+                known.push_back(id);
+            }
+        }
+        if (round == 0) {
+            for (const FleetReceiver &receiver : fleet) {
+                if (std::find(ids.begin(), ids.end(), receiver.id) == ids.end()) {
+                    ids.push_back(receiver.id);
+                } else {
+                    duplicateIds++;
+                }
+            }
+        }
+        printf("%-11s round %d at %5.1f s: %2d reports in %d slots, %2zu heard clear, %zu of %zu found\n",
+               round == 0 ? "discovery" : "", round + 1, (double) startUs / SECOND_US, reports, CLOCK_REPORT_SLOTS,
+               heard.size(), known.size(), ids.size());
+        fflush(stdout);
+        found.push_back(heard);
+        if (!reports) break;
+    }
+    printf("%-11s %zu of %zu found in %.1f s, %d sharing another's id\n", "", known.size(), ids.size(),
+           (double) roundStarts(options, found).back() / SECOND_US, duplicateIds);
+
+    fleet = runFleet(options, found, ids, threads);
+    const double wall = wallSeconds(started);
+    std::vector<uint64_t> commandUs;
+    std::vector<std::vector<uint8_t>> commands;
+    planSession(options, found, ids, commandUs, commands);
+    const uint64_t pollUs = roundStarts(options, found).back();
+
+    // Each query to one receiver should be answered by that receiver alone. A reply can land after the next query
+    // has gone out, so it is matched to the query for its sender, if that went out no more than a round trip before.
+    replies.clear();
+    clear = clearReplies(fleet, replies);
+    const uint64_t roundTripUs = 2 * (options.maxDelayUs + options.jitterUs) + options.pollGapUs;
+    std::vector<bool> answered(ids.size(), false);
+    int unasked = 0;
+    for (size_t i = 0; i < replies.size(); ++i) {
+        if (replies[i]->startUs < pollUs) continue;
+        const size_t q = std::find(ids.begin(), ids.end(), sender(fleet, replies[i])->id) - ids.begin();
+        const uint64_t askedUs = pollUs + q * options.pollGapUs;
+        if (q == ids.size() || replies[i]->startUs < askedUs || replies[i]->startUs > askedUs + roundTripUs) {
+            unasked++;
+        } else if (clear[i]) {
+            answered[q] = true;
+        }
+    }
+    printf("addressed   %zu queried, %d answered clear, %d replies not asked for\n", ids.size(),
+           (int) std::count(answered.begin(), answered.end(), true), unasked);
+
+    // Delivery per receiver, and how far apart the receivers that acted on a state did so
+    int worst = (int) commandUs.size();
+    long total = 0;
+    int missing = 0;
+    for (const FleetReceiver &receiver : fleet) {
+        int acted = 0;
+        for (size_t c = 0; c < commandUs.size(); ++c) {
+            acted += receiver.lightUs[c] != 0;
+        }
+        worst = std::min(worst, acted);
+        total += acted;
+        missing += acted < (int) commandUs.size();
+    }
+    std::vector<uint64_t> skews;
+    std::vector<uint64_t> latencies;
+    for (size_t c = 0; c < commandUs.size(); ++c) {
+        uint64_t first = UINT64_MAX;
+        uint64_t last = 0;
+        for (const FleetReceiver &receiver : fleet) {
+            if (!receiver.lightUs[c]) continue;
+            first = std::min(first, receiver.lightUs[c]);
+            last = std::max(last, receiver.lightUs[c]);
+            latencies.push_back(receiver.lightUs[c] - commandUs[c]);
+        }
+        if (last) skews.push_back(last - first);
+    }
+    std::sort(skews.begin(), skews.end());
+    std::sort(latencies.begin(), latencies.end());
+    printf("delivery    %zu states, per receiver %.1f%% mean and %.1f%% worst, %d receiver%s missed one\n",
+           commandUs.size(), 100.0 * total / (commandUs.size() * fleet.size()), 100.0 * worst / commandUs.size(),
+           missing, missing == 1 ? "" : "s");
+    if (!skews.empty()) {
+        printf("skew        p50 %.1f ms, max %.1f ms; latency p50 %.1f ms, p99 %.1f ms\n",
+               skews[skews.size() / 2] / 1000.0, skews.back() / 1000.0, latencies[latencies.size() / 2] / 1000.0,
+               latencies[latencies.size() * 99 / 100] / 1000.0);
+    }
+    const double simulated = options.receivers * (commandUs.back() + TAIL_US) / (double) SECOND_US;
+    printf("wall        %.2f s for every pass, %.0f receiver-seconds simulated a second\n", wall,
+           simulated / wall);
+
+    if (!scaling) return 0;
+    printf("\n%-8s %8s %8s %10s\n", "threads", "wall s", "speedup", "identical");
+    double single = 0;
+    for (int t = 1; t <= threads; t = t < threads && t * 2 > threads ? threads : t * 2) {
+        const auto from = std::chrono::steady_clock::now();
+        const std::vector<FleetReceiver> again = runFleet(options, found, ids, t);
+        const double seconds = wallSeconds(from);
+        if (t == 1) single = seconds;
+        const bool same = !memcmp(again.data(), fleet.data(), fleet.size() * sizeof(FleetReceiver));
+        printf("%-8d %8.2f %7.2fx %10s\n", t, seconds, single / seconds, same ? "yes" : "no");
+        fflush(stdout);
+        if (t == threads) break;
+    }
+    return 0;
+}
@@ -0,0 +1,267 @@
+#include "FlowControl.h"
+#include "Packets.h"
+
+#include <Board.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+extern bool flowControl;
+
+static const uint64_t SECOND_US = 1000000;
+static const uint64_t SETTLE_US = 100000;       // After boot, before the first update
+// How long to keep running after the last update is written, so the receiver can finish what it has buffered
+static const uint64_t TAIL_US = 2 * SECOND_US;
+// Grounded on a receiver wired as a chain per region
+static const int MAX_TAG = 999;
+static const double SWEEP_RATES[] = {1, 2, 3, 4, 5, 6, 8, 12};
+// The check on holds kept up past FLOW_HOLD_MAX_MS
+static const double CUT_RATE = 2;
+static const int CUT_EVERY = 10;
+static const size_t CUT_BYTES = 7;              // Header, size and checksum
+
+FlowController::FlowController(SimBoard &sim, const std::vector<PlannedSend> &sends, uint64_t startUs,
+                               uint64_t reactionUs, bool follows)
+        : sim(sim), sends(sends), startUs(startUs), reactionUs(reactionUs), follows(follows), next(0), scanned(0) {
+}
+
+/**
+ * The earliest time from the given one at which the controller is not holding off, from the flow bytes heard by then.
+ */
+uint64_t FlowController::freeAt(uint64_t us) const {
+    size_t i = 0;
+    for (;;) {
+        while (i < heard.size() && heard[i].first <= us) ++i;
+        if (i == 0 || !heard[i - 1].second) return us;
+        const uint64_t timeout = heard[i - 1].first + FLOW_HOLD_MAX_MS * 1000;
+        if (us >= timeout) return us;
+        us = i < heard.size() && heard[i].first < timeout ? heard[i].first : timeout;
+    }
+}
+
+void FlowController::operator()(uint64_t nowUs) {
+    // Every byte heard by now has been written already, as each takes a byte's time to go out
+    std::vector<DecodedFlow> flow;
+    decodeFrames(sim.txHistory(), scanned, &flow);
+    for (const DecodedFlow &f : flow) {
+        heard.emplace_back(f.us + reactionUs, f.busy);
+    }
+
+    while (next < sends.size()) {
+        uint64_t at = startUs + sends[next].startUs;
+        if (follows) at = freeAt(at);
+        if (at > nowUs) break;
+        lastByteUs.push_back(sim.transmit(at, sends[next].bytes.data(), sends[next].bytes.size()));
+        next++;
+    }
+}
+
+bool FlowController::done() const {
+    return next == sends.size();
+}
+
+uint64_t FlowController::heldUs(uint64_t untilUs) const {
+    uint64_t held = 0;
+    for (size_t i = 0; i < heard.size() && heard[i].first < untilUs; ++i) {
+        if (!heard[i].second) continue;
+        uint64_t end = heard[i].first + FLOW_HOLD_MAX_MS * 1000;
+        if (i + 1 < heard.size()) end = std::min(end, heard[i + 1].first);
+        held += std::min(end, untilUs) - heard[i].first;
+    }
+    return held;
+}
+
+int FlowController::timeouts(uint64_t untilUs) const {
+    int count = 0;
+    for (size_t i = 0; i < heard.size(); ++i) {
+        const uint64_t timeout = heard[i].first + FLOW_HOLD_MAX_MS * 1000;
+        if (!heard[i].second || timeout > untilUs) continue;
+        if (i + 1 == heard.size() || heard[i + 1].first >= timeout) count++;
+    }
+    return count;
+}
+
+/**
+ * The updates, each due a random interval after the last.
+ */
+static std::vector<PlannedSend> planUpdates(const FlowOptions &options) {
+    // Raw mt19937 output is specified bit-for-bit by the standard, unlike the distributions
+    std::mt19937 rng(options.seed);
+
+    StateFields fields;
+    fields.countdown = options.countdown;
+    fields.detail = 1;
+    fields.colour = 2;
+    fields.timeEnabled = true;
+
+    std::vector<PlannedSend> sends;
+    uint64_t at = 0;
+    for (int i = 0; i < options.updates; ++i) {
+        PlannedSend send;
+        send.startUs = at;
+        send.tag = i % MAX_TAG + 1;
+        fields.time = (int16_t) send.tag;
+        send.bytes = encodeStatePacket(fields);
+        if (options.cutEvery && (i + 1) % options.cutEvery == 0) {
+            send.bytes.insert(send.bytes.end(), send.bytes.begin(), send.bytes.begin() + CUT_BYTES);
+        }
+        send.garbageBytes = 0;
+        send.kind = KIND_TIME;
+        sends.push_back(send);
+        // Half to one and a half times the mean interval
+        at += (uint64_t) ((0.5 + (rng() % 1000) / 1000.0) * SECOND_US / options.rate);
+    }
+    return sends;
+}
+
+FlowReport runFlow(const FlowOptions &options, bool flow, bool splitChains) {
+    std::vector<PlannedSend> sends = planUpdates(options);
+    FlowReport report = {};
+
+    bool ok = runIsolated<FlowReport>([&]() {
+        SimBoard sim;
+        if (splitChains) sim.setPin(SPLIT_CHAINS_PIN, LOW);
+        flowControl = flow;
+        sim.boot();
+        sim.runUntil([]() { return false; }, SETTLE_US);
+
+        const uint64_t start = sim.now();
+        const size_t showsBefore = sim.frames().size();
+        FlowController controller(sim, sends, start, options.reactionUs, flow);
+        sim.setPeer([&](uint64_t nowUs) { controller(nowUs); });
+        const uint64_t limit = start + sends.back().startUs + 600 * SECOND_US;
+        sim.runUntil([&]() {
+            return controller.done() && sim.now() >= controller.lastByteUs.back() + TAIL_US && sim.pendingRx() == 0;
+        }, limit);
+        sim.setPeer(nullptr);
+
+        FlowReport r = {};
+        r.rate = options.rate;
+        r.sent = (int) controller.lastByteUs.size();
+        const std::vector<uint64_t> handled = findAcks(sends, sim.lines(), start);
+        std::vector<uint64_t> latencies;
+        for (size_t i = 0; i < handled.size(); ++i) {
+            if (!handled[i]) continue;
+            r.delivered++;
+            latencies.push_back(handled[i] - (start + sends[i].startUs));
+        }
+        if (!latencies.empty()) {
+            std::sort(latencies.begin(), latencies.end());
+            r.latencyP50Us = latencies[latencies.size() / 2];
+            r.latencyMaxUs = latencies.back();
+        }
+        r.rxOverflows = sim.getRxOverflows();
+        r.rxOverruns = sim.getRxOverruns();
+        r.shows = (int) (sim.frames().size() - showsBefore);
+        uint64_t busyUs = 0;
+        for (const TxByte &b : sim.txHistory()) {
+            if (b.value != FLOW_BUSY && b.value != FLOW_READY) continue;
+            if (busyUs) r.longestHoldUs = std::max(r.longestHoldUs, b.us - busyUs);
+            busyUs = b.value == FLOW_BUSY ? b.us : 0;
+            if (b.value == FLOW_BUSY) r.busy++;
+        }
+        r.timeouts = controller.timeouts(sim.now());
+        r.heldPercent = 100.0 * controller.heldUs(sim.now()) / (sim.now() - start);
+        return r;
+    }, report);
+
+    if (!ok) fprintf(stderr, "Simulated receiver crashed at %.2f updates/s\n", options.rate);
+    return report;
+}
+
+static void printFlowHeader() {
+    printf("%-6s %-4s %6s %4s %9s %5s %8s %8s %6s %5s %8s %6s %8s %8s %8s\n", "chains", "flow", "rate/s", "sent",
+           "delivered", "lost", "overflow", "overrun", "shows", "busy", "timeouts", "held %", "hold ms", "p50 ms",
+           "max ms");
+}
+
+/**
+ * Run the updates with flow control off and on, and print a row for each.
+ *
+ * @return The bytes lost to overruns with flow control on.
+ */
+static unsigned long printFlowRows(const FlowOptions &options, bool splitChains) {
+    unsigned long overruns = 0;
+    for (bool flow : {false, true}) {
+        const FlowReport r = runFlow(options, flow, splitChains);
+        printf("%-6s %-4s %6.1f %4d %9d %5d %8lu %8lu %6d %5d %8d %6.1f %8.1f %8.1f %8.1f\n",
+               splitChains ? "split" : "single", flow ? "on" : "off", r.rate, r.sent, r.delivered,
+               r.sent - r.delivered, r.rxOverflows, r.rxOverruns, r.shows, r.busy, r.timeouts, r.heldPercent,
+               r.longestHoldUs / 1000.0, r.latencyP50Us / 1000.0, r.latencyMaxUs / 1000.0);
+        fflush(stdout);
+        if (flow) overruns += r.rxOverruns;
+    }
+    return overruns;
+}
+
+int flowMain(int argc, char **argv) {
+    FlowOptions options;
+    bool sweep = true;
+    bool single = true;
+    bool split = true;
+
+    for (int i = 0; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--rate")) {
+            options.rate = atof(argv[i + 1]);
+            sweep = false;
+        } else if (!strcmp(argv[i], "--updates")) {
+            options.updates = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--reaction")) {
+            options.reactionUs = (uint64_t) (atof(argv[i + 1]) * 1000);
+        } else if (!strcmp(argv[i], "--countdown")) {
+            options.countdown = atoi(argv[i + 1]) != 0;
+        } else if (!strcmp(argv[i], "--cut")) {
+            options.cutEvery = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--seed")) {
+            options.seed = (uint32_t) strtoul(argv[i + 1], nullptr, 10);
+        } else if (!strcmp(argv[i], "--layout")) {
+            single = !strcmp(argv[i + 1], "single");
+            split = !strcmp(argv[i + 1], "split");
+            if (!single && !split) argc = -1;
+        } else {
+            argc = -1;
+        }
+    }
+    if (argc < 0 || argc % 2 || options.rate <= 0 || options.updates < 1 || options.cutEvery < 0) {
+        fprintf(stderr,
+                "usage: program flow [options]\n"
+                "  --rate R          Updates a second; by default a sweep from 1 to 12\n"
+                "  --updates N       Updates per run (default 200)\n"
+                "  --reaction MS     From a flow byte on the wire to the controller acting on it (default 5)\n"
+                "  --countdown 0|1   If the countdown runs between updates (default 1)\n"
+                "  --cut N           Follow every Nth update with a frame cut short (default 0, none)\n"
+                "  --seed S          Random seed for the intervals (default 1)\n"
+                "  --layout X        Only one LED chain (single) or a chain per region (split); both by default\n");
+        return 2;
+    }
+
+    printFlowHeader();
+    unsigned long overruns = 0;
+    for (int layout = 0; layout < 2; ++layout) {
+        const bool splitChains = layout == 1;
+        if (splitChains ? !split : !single) continue;
+
+        const int rates = sweep ? (int) (sizeof(SWEEP_RATES) / sizeof(SWEEP_RATES[0])) : 1;
+        for (int i = 0; i < rates; ++i) {
+            if (sweep) options.rate = SWEEP_RATES[i];
+            overruns += printFlowRows(options, splitChains);
+        }
+    }
+
+    if (sweep && !options.cutEvery) {
+        // The receiver waits for the rest of a frame cut short, which the controller it holds off never sends, until
+        // the controller gives up on the hold
+        printf("\nwith every %dth update followed by a frame cut short, so holds outlast FLOW_HOLD_MAX_MS\n", CUT_EVERY);
+        printFlowHeader();
+        FlowOptions cut = options;
+        cut.rate = CUT_RATE;
+        cut.cutEvery = CUT_EVERY;
+        if (single) overruns += printFlowRows(cut, false);
+        if (split) overruns += printFlowRows(cut, true);
+    }
+    printf("\n%s\n", overruns ? "Bytes LOST to shows with flow control" : "No byte lost to a show with flow control");
+    return overruns ? 1 : 0;
+}
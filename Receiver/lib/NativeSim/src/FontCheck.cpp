@@ -0,0 +1,173 @@
+#include "FontCheck.h"
+
+#include <Arduino.h>
+#include <Board.h>
+#include <FastLED.h>
+#include <NumericLEDs.h>
+#include <Palette.h>
+#include <SegmentFont.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC
+#endif
+
+static const uint32_t DIGIT_OFFSETS[NUMERIC_DIGITS] = {HUNDREDS_OFFSET, TENS_OFFSET, ONES_OFFSET};
+static const int DIGIT_LEDS = NUMBER_LEDS / NUMERIC_DIGITS;
+static const int RENDER_ROUNDS = 200000;
+
+// The digit bitmaps NumericLEDs.h had before the font, one bit per LED, kept to check the font against
+static const uint64_t OLD_NUMBERS[11] = {
+        0b0000000000000000000000000000000000111111111111111111111111111111,
+        0b0000000000000000000000000000000000000000000011111111110000000000,
+        0b0000000000000000000000000000011111000001111111111000001111111111,
+        0b0000000000000000000000000000011111000001111111111111111111100000,
+        0b0000000000000000000000000000011111111110000011111111110000000000,
+        0b0000000000000000000000000000011111111111111100000111111111100000,
+        0b0000000000000000000000000000011111111111111100000111111111111111,
+        0b0000000000000000000000000000000000000001111111111111110000000000,
+        0b0000000000000000000000000000011111111111111111111111111111111111,
+        0b0000000000000000000000000000011111111111111111111111111111100000,
+        0,
+};
+
+static void oldDisplayDigit(CRGB leds[], uint32_t offset, uint32_t digit) {
+    const auto segs = OLD_NUMBERS[digit];
+    for (int i = 0; i < DIGIT_LEDS; ++i) {
+        leds[i + offset] = (segs >> i) & 1 ? 0xFFFF00 : 0x000000;
+    }
+}
+
+/**
+ * Time a render, in cycles (or nanoseconds where there is no cycle counter) per call.
+ */
+template<typename F>
+static double timeRender(F render) {
+    for (int i = 0; i < RENDER_ROUNDS / 10; ++i) {
+        render(i);
+    }
+#ifdef HAVE_RDTSC
+    const uint64_t begin = __rdtsc();
+    for (int i = 0; i < RENDER_ROUNDS; ++i) {
+        render(i);
+    }
+    return (double) (__rdtsc() - begin) / RENDER_ROUNDS;
+#else
+    const auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < RENDER_ROUNDS; ++i) {
+        render(i);
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / RENDER_ROUNDS;
+#endif
+}
+
+FontReport checkFont() {
+    // The plain colours the old bitmaps were drawn in, as the receiver has not picked a palette in setup()
+    static Palette plain;
+    makePalette(plain, 255, UncorrectedColor);
+    palette = &plain;
+
+    FontReport report = {};
+    CRGB before[NUM_LEDS] = {};
+    CRGB after[NUM_LEDS] = {};
+    for (uint32_t digit = 0; digit < 10; ++digit) {
+        oldDisplayDigit(before, DIGIT_OFFSETS[0], digit);
+        displayDigit(after, DIGIT_OFFSETS[0], digit);
+        if (memcmp(before, after, sizeof(before)) != 0) report.mismatchedDigits++;
+    }
+    for (byte glyph : FONT) {
+        if (glyph & 0x80) report.badGlyphs++;
+    }
+
+    // On the AVR a const array without PROGMEM lives in SRAM, and its initial values in flash as well
+    report.sramBefore = sizeof(OLD_NUMBERS);
+    report.flashBefore = sizeof(OLD_NUMBERS);
+    report.sramAfter = 0;
+    report.flashAfter = sizeof(FONT) + 7;    // And NUMERIC_SEGMENT_ORDER
+
+    static CRGB leds[NUM_LEDS];
+    report.oldDigit = timeRender([](int i) { oldDisplayDigit(leds, DIGIT_OFFSETS[i % 3], i % 10); });
+    report.newGlyph = timeRender([](int i) { displayDigit(leds, DIGIT_OFFSETS[i % 3], i % 10); });
+    return report;
+}
+
+/**
+ * Draw the numerical display as text, reading which segment each LED belongs to from displayGlyph() itself.
+ */
+static void printDisplay(const CRGB leds[]) {
+    int segmentOf[DIGIT_LEDS];
+    for (int bit = 0; bit < 7; ++bit) {
+        CRGB probe[NUM_LEDS] = {};
+        displayGlyph(probe, 0, 1 << bit);
+        for (int i = 0; i < DIGIT_LEDS; ++i) {
+            if (probe[i].r) segmentOf[i] = bit;
+        }
+    }
+
+    byte segments[3] = {};
+    for (int d = 0; d < 3; ++d) {
+        for (int i = 0; i < DIGIT_LEDS; ++i) {
+            if (leds[DIGIT_OFFSETS[d] + i].r) segments[d] |= 1 << segmentOf[i];
+        }
+    }
+    for (int row = 0; row < 3; ++row) {
+        printf("  ");
+        for (byte s : segments) {
+            if (row == 0) {
+                printf(" %c  ", s & SEG_A ? '_' : ' ');
+            } else if (row == 1) {
+                printf("%c%c%c ", s & SEG_F ? '|' : ' ', s & SEG_G ? '_' : ' ', s & SEG_B ? '|' : ' ');
+            } else {
+                printf("%c%c%c ", s & SEG_E ? '|' : ' ', s & SEG_D ? '_' : ' ', s & SEG_C ? '|' : ' ');
+            }
+        }
+        printf("\n");
+    }
+}
+
+int fontMain(int argc, char **argv) {
+    const char *show = nullptr;
+    for (int i = 0; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--show")) {
+            show = argv[i + 1];
+        } else {
+            argc = -1;
+        }
+    }
+    if (argc < 0 || argc % 2) {
+        fprintf(stderr,
+                "usage: program font [options]\n"
+                "  --show TEXT    Also draw TEXT on the numerical display, as the receiver would\n");
+        return 2;
+    }
+
+    const FontReport report = checkFont();
+    printf("digits matching the old bitmaps: %d of 10, glyphs with stray bits: %d\n\n", 10 - report.mismatchedDigits,
+           report.badGlyphs);
+    printf("glyph tables on the AVR:   %6s %6s\n", "SRAM", "flash");
+    printf("  %-22s %6zu %6zu\n", "uint64_t NUMBERS[11]", report.sramBefore, report.flashBefore);
+    printf("  %-22s %6zu %6zu\n", "PROGMEM font", report.sramAfter, report.flashAfter);
+    printf("  %-22s %+6d %+6d\n\n", "change", (int) report.sramAfter - (int) report.sramBefore,
+           (int) report.flashAfter - (int) report.flashBefore);
+
+#ifdef HAVE_RDTSC
+    const char *unit = "cycles";
+#else
+    const char *unit = "ns";
+#endif
+    printf("host %s to draw one 35 LED character:\n", unit);
+    printf("  %-34s %8.1f\n", "64-bit bitmap, one shift per LED", report.oldDigit);
+    printf("  %-34s %8.1f\n", "font, one test per segment", report.newGlyph);
+
+    if (show) {
+        static CRGB leds[NUM_LEDS];
+        displayText(leds, show);
+        printf("\n");
+        printDisplay(leds);
+    }
+    return report.mismatchedDigits || report.badGlyphs ? 1 : 0;
+}
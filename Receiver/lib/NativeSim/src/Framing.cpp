@@ -0,0 +1,103 @@
+#include "Framing.h"
+#include "Packets.h"
+
+#include <Arduino.h>
+#include <Bench.h>
+#include <Board.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+extern bool isrFraming;
+
+static const uint64_t SECOND_US = 1000000;
+static const uint64_t TAIL_US = 2 * SECOND_US;
+
+FramingReport runFraming(const UartScenario &scenario, uint64_t durationUs, bool splitChains, bool isr) {
+    std::vector<PlannedSend> sends = scenario.traffic(durationUs);
+    FramingReport report = {};
+
+    bool ok = runIsolated<FramingReport>([&]() {
+        SimBoard sim;
+        if (splitChains) sim.setPin(SPLIT_CHAINS_PIN, LOW);
+        isrFraming = isr;
+        sim.boot();
+        sim.runUntil([]() { return false; }, 100000);
+
+        const uint64_t start = sim.now();
+        FramingReport r = {};
+        std::vector<uint64_t> lastByteUs;
+        for (const PlannedSend &send : sends) {
+            lastByteUs.push_back(sim.transmit(start + send.startUs, send.bytes.data(), send.bytes.size()));
+            r.bytes += (long) send.bytes.size();
+        }
+        const uint64_t quiet = start + durationUs + TAIL_US;
+        sim.runUntil([&]() { return sim.now() >= quiet && sim.pendingRx() == 0; }, quiet + 60 * SECOND_US);
+
+        // Every packet is a state frame, so the packets acknowledged went through handlePacket() in order
+        r.sent = (int) sends.size();
+        std::vector<uint64_t> handled;
+        for (const BenchMarker &marker : sim.benchMarkers()) {
+            if (marker.id == BENCH_HANDLE_PACKET && marker.us >= start) handled.push_back(marker.us);
+            if (marker.id == BENCH_BYTE_READ) r.loopReads++;
+        }
+        const std::vector<uint64_t> acks = findAcks(sends, sim.lines(), start);
+        uint64_t totalUs = 0;
+        for (size_t i = 0; i < acks.size(); ++i) {
+            if (!acks[i] || (size_t) r.delivered >= handled.size()) continue;
+            const uint64_t latency = handled[r.delivered++] - lastByteUs[i];
+            totalUs += latency;
+            r.maxLatencyUs = std::max(r.maxLatencyUs, latency);
+        }
+        r.meanLatencyUs = r.delivered ? (double) totalUs / r.delivered : 0;
+        r.lostBytes = sim.getRxOverflows() + sim.getRxOverruns();
+        return r;
+    }, report);
+
+    if (!ok) fprintf(stderr, "Simulated receiver crashed in scenario %s\n", scenario.name);
+    return report;
+}
+
+int framingMain(int argc, char **argv) {
+    uint64_t durationUs = 60 * SECOND_US;
+    const char *only = nullptr;
+    bool splitChains = false;
+
+    for (int i = 0; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--duration")) {
+            durationUs = (uint64_t) (atof(argv[i + 1]) * SECOND_US);
+        } else if (!strcmp(argv[i], "--scenario")) {
+            only = argv[i + 1];
+        } else if (!strcmp(argv[i], "--layout")) {
+            splitChains = !strcmp(argv[i + 1], "split");
+            if (!splitChains && strcmp(argv[i + 1], "single") != 0) argc = -1;
+        } else {
+            argc = -1;
+        }
+    }
+    if (argc < 0 || argc % 2) {
+        fprintf(stderr,
+                "usage: program framing [options]\n"
+                "  --duration S      Seconds of traffic per scenario (default 60)\n"
+                "  --scenario NAME   Run only this scenario (those of `program uart`)\n"
+                "  --layout X        One LED chain (single) or a chain per region (split) (default single)\n");
+        return 2;
+    }
+
+    printf("%-15s %-5s %6s %9s %7s %6s %10s %8s %9s\n", "scenario", "rx", "sent", "delivered", "bytes", "lost",
+           "loop reads", "mean ms", "worst ms");
+    for (int i = 0; i < NUM_UART_SCENARIOS; ++i) {
+        const UartScenario &scenario = UART_SCENARIOS[i];
+        if (only && strcmp(only, scenario.name) != 0) continue;
+
+        for (bool isr : {false, true}) {
+            const FramingReport r = runFraming(scenario, durationUs, splitChains, isr);
+            printf("%-15s %-5s %6d %9d %7ld %6lu %10ld %8.2f %9.2f\n", scenario.name, isr ? "isr" : "ring", r.sent,
+                   r.delivered, r.bytes, r.lostBytes, r.loopReads, r.meanLatencyUs / 1000.0, r.maxLatencyUs / 1000.0);
+            fflush(stdout);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,307 @@
+#include "Handoffs.h"
+#include "Packets.h"
+
+#include <Arduino.h>
+#include <Board.h>
+#include <Handoff.h>
+#include <State.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+extern State state;
+
+static const uint64_t SECOND_US = 1000000;
+static const uint64_t START_US = 2 * SECOND_US;
+static const int MAX_ARROWS = 32;
+
+/**
+ * What one side's receiver did in a run: when its light turned green for each of its turns and left green again,
+ * and the handoffs it sent, as its partner hears them in the next run.
+ */
+struct SideRun {
+    int starts;
+    uint64_t startUs[MAX_ARROWS];
+    int ends;
+    uint64_t endUs[MAX_ARROWS];
+    int sent;
+    uint64_t sentEndUs[HANDOFF_COPIES * MAX_ARROWS];       // When the last byte went out
+    uint8_t sentData[HANDOFF_COPIES * MAX_ARROWS][HANDOFF_FRAME_SIZE];
+};
+
+/**
+ * A packet on the radio, and when it started out.
+ */
+struct Send {
+    uint64_t atUs;
+    std::vector<uint8_t> packet;
+};
+
+static uint64_t mix(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+/**
+ * If the radio loses a packet for one listener. Drawn from the packet's time rather than a running generator, so
+ * a packet sent at the same moment in every run has the same fate in every run.
+ */
+static bool lost(const HandoffOptions &options, uint64_t atUs, int listener) {
+    return (mix(options.seed ^ mix(atUs * 2 + listener)) >> 11) * (1.0 / 9007199254740992.0) < options.loss;
+}
+
+/**
+ * @return If the side's turn has a time for the given event, and what it is.
+ */
+static bool turnGreen(const SideRun *sides, int turn, uint64_t &us) {
+    const SideRun &side = sides[turn % 2];
+    if (turn / 2 >= side.starts) return false;
+    us = side.startUs[turn / 2];
+    return true;
+}
+
+static bool turnRed(const SideRun *sides, int turn, uint64_t &us) {
+    const SideRun &side = sides[turn % 2];
+    if (turn / 2 >= side.ends) return false;
+    us = side.endUs[turn / 2];
+    return true;
+}
+
+static StateFields turnState(const HandoffOptions &options, int turn, bool green) {
+    StateFields fields;
+    fields.matchplay = true;
+    fields.countdown = green;
+    fields.detail = (uint8_t) (turn % 2 + 1);
+    fields.colour = green ? 2 : 0;
+    fields.timeEnabled = true;
+    fields.time = (int16_t) options.time;
+    fields.endNumBeeps = turn == 2 * options.arrows - 1 ? MATCH_END_BEEPS : 0;
+    return fields;
+}
+
+/**
+ * What the controller sends, given how the turns went in the last run. Relaying, it starts the first turn with a
+ * matchplay state, and each later one once it hears the turn before has ended: one hop back, and noticeUs to react.
+ * Otherwise it only sends the first handoff. A judge stopping turns has the controller send a stop, and when
+ * relaying, the next side's start straight after it.
+ *
+ * States are repeated until the next is sent, as SerialCommunications repeats the last state.
+ */
+static std::vector<Send> controllerSends(const HandoffOptions &options, bool direct, const SideRun *sides,
+                                         uint64_t endUs) {
+    const int turns = 2 * options.arrows;
+    std::vector<Send> states;
+    std::vector<Send> sends;
+    uint16_t generation = 0;
+
+    if (direct) {
+        const HandoffFrame first = {1, (uint8_t) (turns - 1), (int16_t) options.time, 1};
+        for (int copy = 0; copy < HANDOFF_COPIES; ++copy) {
+            sends.push_back({START_US + copy * HANDOFF_GAP_MS * 1000, encodeHandoffPacket(first)});
+        }
+    } else {
+        states.push_back({START_US, encodeGenerationPacket(generation++, turnState(options, 0, true))});
+    }
+
+    for (int turn = 0; turn < turns; ++turn) {
+        uint64_t us;
+        if (options.shotUs) {
+            if (!turnGreen(sides, turn, us)) break;
+            const uint64_t stopUs = us + options.shotUs;
+            states.push_back({stopUs, encodeGenerationPacket(generation++, turnState(options, turn, false))});
+            if (!direct && turn + 1 < turns) {
+                states.push_back({stopUs, encodeGenerationPacket(generation++, turnState(options, turn + 1, true))});
+            }
+        } else if (!direct && turn + 1 < turns) {
+            if (!turnRed(sides, turn, us)) break;
+            const uint64_t heardUs = us + options.delayUs + options.noticeUs;
+            states.push_back({heardUs, encodeGenerationPacket(generation++, turnState(options, turn + 1, true))});
+        }
+    }
+
+    for (size_t i = 0; i < states.size(); ++i) {
+        const uint64_t until = i + 1 < states.size() ? states[i + 1].atUs : endUs;
+        sends.push_back(states[i]);
+        for (uint64_t at = states[i].atUs + options.repeatUs; at < until; at += options.repeatUs) {
+            sends.push_back({at, states[i].packet});
+        }
+    }
+    std::stable_sort(sends.begin(), sends.end(), [](const Send &a, const Send &b) { return a.atUs < b.atUs; });
+    return sends;
+}
+
+/**
+ * Run one side's receiver, hearing the controller and what its partner sent in the last run.
+ *
+ * @param side 0 for A/B (left), 1 for C/D (right).
+ */
+static SideRun runSide(const HandoffOptions &options, const std::vector<Send> &controller, const SideRun &partner,
+                       int side, uint64_t endUs, bool &ok) {
+    SideRun run = {};
+    ok = runIsolated<SideRun>([&]() {
+        SimBoard sim;
+        sim.setPin(QUIET_PIN, LOW);
+        sim.setPin(MATCHPLAY_PIN, side ? HIGH : LOW);
+        sim.boot();
+
+        std::vector<Send> heard;
+        for (const Send &send : controller) {
+            if (!lost(options, send.atUs, side)) heard.push_back({send.atUs + options.delayUs, send.packet});
+        }
+        for (int i = 0; i < partner.sent; ++i) {
+            const std::vector<uint8_t> data(partner.sentData[i], partner.sentData[i] + HANDOFF_FRAME_SIZE);
+            const std::vector<uint8_t> packet = encodePacket(data);
+            const uint64_t startUs = partner.sentEndUs[i] - packet.size() * sim.byteTimeUs();
+            if (!lost(options, startUs, side)) heard.push_back({startUs + options.delayUs, packet});
+        }
+        std::stable_sort(heard.begin(), heard.end(), [](const Send &a, const Send &b) { return a.atUs < b.atUs; });
+        for (const Send &send : heard) {
+            sim.transmit(send.atUs, send.packet.data(), send.packet.size());
+        }
+
+        // Changes are seen once the loop pass that made them, and its show, is over
+        SideRun r;
+        memset(&r, 0, sizeof(r));   // Padding too, as runs are compared byte for byte
+        bool green = false;
+        sim.runUntil([&]() {
+            const bool nowGreen = state.countdown && state.colour == GREEN;
+            if (nowGreen && !green && r.starts < MAX_ARROWS) r.startUs[r.starts++] = sim.now();
+            if (!nowGreen && green && r.ends < MAX_ARROWS) r.endUs[r.ends++] = sim.now();
+            green = nowGreen;
+            return sim.now() >= endUs;
+        }, endUs + SECOND_US);
+
+        size_t next = 0;
+        for (const DecodedFrame &frame : decodeFrames(sim.txHistory(), next)) {
+            if (frame.data[0] != FRAME_HANDOFF || frame.data.size() < HANDOFF_FRAME_SIZE) continue;
+            if (r.sent == HANDOFF_COPIES * MAX_ARROWS) break;
+            r.sentEndUs[r.sent] = frame.endUs;
+            memcpy(r.sentData[r.sent++], frame.data.data(), HANDOFF_FRAME_SIZE);
+        }
+        return r;
+    }, run);
+    return run;
+}
+
+HandoffReport runHandoffs(const HandoffOptions &options, bool direct) {
+    const int turns = 2 * options.arrows;
+    const uint64_t endUs = START_US + turns * (options.time + 5) * SECOND_US;
+
+    // Each side's turns hang on the other's, so run both again, each hearing what the other did last time, until
+    // neither changes. Each pass settles at least one more turn.
+    SideRun sides[2] = {};
+    std::vector<Send> controller;
+    HandoffReport report = {};
+    bool ok = true;
+    while (report.passes < 2 * turns + 2) {
+        report.passes++;
+        const SideRun last[2] = {sides[0], sides[1]};
+        for (int side = 0; side < 2 && ok; ++side) {
+            controller = controllerSends(options, direct, sides, endUs);
+            sides[side] = runSide(options, controller, sides[1 - side], side, endUs, ok);
+        }
+        if (!ok) {
+            fprintf(stderr, "Simulated receiver crashed\n");
+            return report;
+        }
+        if (!memcmp(last, sides, sizeof(sides))) break;
+    }
+
+    report.packets = (int) controller.size() + sides[0].sent + sides[1].sent;
+    int64_t totalGapUs = 0;
+    int64_t totalFromStopUs = 0;
+    for (int turn = 0; turn + 1 < turns; ++turn) {
+        report.handoffs++;
+        uint64_t redUs, greenUs, startedUs;
+        if (!turnRed(sides, turn, redUs) || !turnGreen(sides, turn + 1, greenUs)) {
+            report.missed++;
+            continue;
+        }
+        if (greenUs < redUs) {
+            report.overlapped++;
+            continue;
+        }
+        const int64_t gap = (int64_t) greenUs - (int64_t) redUs;
+        const bool first = report.handoffs - report.missed - report.overlapped == 1;
+        totalGapUs += gap;
+        report.minGapUs = first ? gap : std::min(report.minGapUs, gap);
+        report.maxGapUs = first ? gap : std::max(report.maxGapUs, gap);
+        if (options.shotUs && turnGreen(sides, turn, startedUs)) {
+            const int64_t fromStop = (int64_t) greenUs - (int64_t) (startedUs + options.shotUs);
+            totalFromStopUs += fromStop;
+            report.maxFromStopUs = first ? fromStop : std::max(report.maxFromStopUs, fromStop);
+        }
+    }
+    const int handed = report.handoffs - report.missed - report.overlapped;
+    report.meanGapUs = handed ? (double) totalGapUs / handed : 0;
+    report.meanFromStopUs = handed ? (double) totalFromStopUs / handed : 0;
+    return report;
+}
+
+int handoffMain(int argc, char **argv) {
+    HandoffOptions options;
+
+    for (int i = 0; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--arrows")) {
+            options.arrows = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--time")) {
+            options.time = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--shot")) {
+            options.shotUs = (uint64_t) (atof(argv[i + 1]) * SECOND_US);
+        } else if (!strcmp(argv[i], "--delay")) {
+            options.delayUs = (uint64_t) (atof(argv[i + 1]) * 1000);
+        } else if (!strcmp(argv[i], "--notice")) {
+            options.noticeUs = (uint64_t) (atof(argv[i + 1]) * 1000);
+        } else if (!strcmp(argv[i], "--repeat")) {
+            options.repeatUs = (uint64_t) (atof(argv[i + 1]) * 1000);
+        } else if (!strcmp(argv[i], "--loss")) {
+            options.loss = atof(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--seed")) {
+            options.seed = (uint32_t) strtoul(argv[i + 1], nullptr, 10);
+        } else {
+            argc = -1;
+        }
+    }
+    if (argc < 0 || argc % 2 || options.arrows < 1 || options.arrows > MAX_ARROWS || options.time < 2 ||
+        options.time > 255 || options.shotUs >= (options.time - 1) * SECOND_US || options.repeatUs == 0 ||
+        options.loss < 0 || options.loss >= 1) {
+        fprintf(stderr,
+                "usage: program handoff [options]\n"
+                "  --arrows N     Arrows each side shoots, one per turn (default 3)\n"
+                "  --time S       Seconds per turn (default 20)\n"
+                "  --shot S       Seconds into each turn the judge stops it, 0 to let turns time out (default 0)\n"
+                "  --delay MS     Each radio hop, on top of the time on the wire (default 100)\n"
+                "  --notice MS    For the app to react to a turn ending, when it relays (default 200)\n"
+                "  --repeat MS    How often the controller repeats the state last sent (default 250)\n"
+                "  --loss P       Chance of the radio losing each packet, 0 to 1 (default 0)\n"
+                "  --seed N\n");
+        return 2;
+    }
+
+    printf("%d arrows a side, %d s a turn, ", options.arrows, options.time);
+    if (options.shotUs) {
+        printf("stopped %.1f s in, ", options.shotUs / (double) SECOND_US);
+    } else {
+        printf("every turn timed out, ");
+    }
+    printf("%.0f ms a hop, %.0f%% of packets lost\n\n", options.delayUs / 1000.0, options.loss * 100);
+    printf("%-10s %8s %6s %7s %8s %8s %8s %11s %8s %7s\n", "handoff", "handoffs", "missed", "overlap", "mean ms",
+           "min ms", "max ms", "stop-go ms", "packets", "passes");
+    for (bool direct : {false, true}) {
+        const HandoffReport r = runHandoffs(options, direct);
+        printf("%-10s %8d %6d %7d %8.1f %8.1f %8.1f ", direct ? "direct" : "controller", r.handoffs, r.missed,
+               r.overlapped, r.meanGapUs / 1000.0, r.minGapUs / 1000.0, r.maxGapUs / 1000.0);
+        if (options.shotUs) {
+            printf("%5.0f/%5.0f", r.meanFromStopUs / 1000.0, r.maxFromStopUs / 1000.0);
+        } else {
+            printf("%11s", "-");
+        }
+        printf(" %8d %7d\n", r.packets, r.passes);
+        fflush(stdout);
+    }
+    return 0;
+}
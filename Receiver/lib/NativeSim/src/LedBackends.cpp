@@ -0,0 +1,62 @@
+#include "LedBackends.h"
+
+#include <Board.h>
+#include <FastLED.h>
+#include <LedOutput.h>
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+PaletteRun runBackend(bool capture, bool splitChains) {
+    // Dithering modelled, so that a chain FastLED left dithering would show up as differing
+    return runPalette(true, true, splitChains, capture);
+}
+
+int ledsMain(int argc, char **argv) {
+    bool single = true;
+    bool split = true;
+
+    for (int i = 0; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--layout")) {
+            single = !strcmp(argv[i + 1], "single");
+            split = !strcmp(argv[i + 1], "split");
+            if (!single && !split) argc = -1;
+        } else {
+            argc = -1;
+        }
+    }
+    if (argc < 0 || argc % 2) {
+        fprintf(stderr,
+                "usage: program leds [options]\n"
+                "  --layout X        Only one LED chain (single) or a chain per region (split); both by default\n");
+        return 2;
+    }
+
+    // Heap allocated: each run holds a hash for every frame
+    std::vector<PaletteRun> runs(2);
+    printf("the palette script through each LED backend, palettes baked\n\n");
+    printf("%-6s %-8s %6s %7s %12s %12s\n", "chains", "backend", "frames", "differ", "show ms", "ms per show");
+    bool same = true;
+    for (int layout = 0; layout < 2; ++layout) {
+        const bool splitChains = layout == 1;
+        if (splitChains ? !split : !single) continue;
+
+        for (int capture = 0; capture < 2; ++capture) {
+            const PaletteRun &run = runs[capture] = runBackend(capture, splitChains);
+            const size_t differ = differing(runs[0], run);
+            printf("%-6s %-8s %6zu %7zu %12.2f %12.3f\n", splitChains ? "split" : "single",
+                   capture ? "capture" : "FastLED", run.frames, differ, run.showUs / 1000.0,
+                   run.frames ? run.showUs / 1000.0 / run.frames : 0.0);
+            fflush(stdout);
+            if (differ || !run.frames) same = false;
+        }
+    }
+
+    printf("\nshow() of all %d LEDs at 20 cycles a bit, either backend on the AVR: %.2f ms on the wire, then %.0f us "
+           "latch\n", NUM_LEDS, NUM_LEDS * LED_WIRE_US / 1000.0, (double) LED_LATCH_US);
+    printf("Flash and SRAM are not measured here: the simulator builds for the host, and no environment builds "
+           "LED_BITBANG yet;\n`pio run -e uno` prints FastLED's. Cycles per show(): -t bench on uno-bench\n");
+    printf("\nThe capture backend %s FastLED\n", same ? "sends the same frames as" : "DIFFERS from");
+    return same ? 0 : 1;
+}
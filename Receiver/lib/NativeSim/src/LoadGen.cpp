@@ -0,0 +1,480 @@
+#include "LoadGen.h"
+#include "Packets.h"
+#include "SimBoard.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <random>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+
+const char *const PACKET_KIND_NAMES[NUM_KINDS] = {"time", "colour", "detail", "countdown", "repeat", "estop"};
+
+// Tags cycle through the values the 3 digit display can show
+static const int MAX_TAG = 999;
+// How long to keep running after the last byte, so that queued packets and refreshes can finish
+static const uint64_t TAIL_US = 2000000;
+
+/**
+ * A packet the receiver acknowledged through its debug output.
+ */
+struct Ack {
+    uint64_t us;
+    int tag;
+};
+
+struct PacketOutcome {
+    uint64_t lastByteUs;
+    bool delivered;
+    uint64_t handledUs;
+};
+
+std::vector<PlannedSend> planLoad(const LoadProfile &profile) {
+    // Raw mt19937 output is specified bit-for-bit by the standard, unlike the distributions
+    std::mt19937 rng(profile.seed);
+
+    int totalWeight = 0;
+    for (int weight : profile.mix) {
+        totalWeight += weight;
+    }
+
+    std::vector<PlannedSend> sends;
+    StateFields fields;
+    fields.timeEnabled = true;
+    int nextTag = 1;
+
+    for (int i = 0; i < profile.packets; ++i) {
+        PlannedSend send;
+        send.startUs = (uint64_t) ((i / profile.burst) * profile.burst * 1000000.0 / profile.rate);
+
+        auto kind = KIND_TIME;
+        if (totalWeight > 0) {
+            int pick = (int) (rng() % totalWeight);
+            for (int k = 0; k < NUM_KINDS; ++k) {
+                if (pick < profile.mix[k]) {
+                    kind = (PacketKind) k;
+                    break;
+                }
+                pick -= profile.mix[k];
+            }
+        }
+        if (kind == KIND_REPEAT && sends.empty()) kind = KIND_TIME;
+        send.kind = kind;
+
+        std::vector<uint8_t> packet;
+        if (kind == KIND_REPEAT) {
+            const PlannedSend &previous = sends.back();
+            packet.assign(previous.bytes.begin() + previous.garbageBytes, previous.bytes.end());
+            send.tag = previous.tag;
+        } else {
+            send.tag = nextTag;
+            nextTag = nextTag % MAX_TAG + 1;
+            fields.time = (int16_t) send.tag;
+            fields.emergencyStop = kind == KIND_ESTOP;
+            if (kind == KIND_COLOUR) fields.colour = (fields.colour + 1) % 3;
+            if (kind == KIND_DETAIL) fields.detail = (fields.detail + 1) % 3;
+            if (kind == KIND_COUNTDOWN) fields.countdown = !fields.countdown;
+            packet = encodeStatePacket(fields);
+        }
+
+        double wanted = profile.garbage * packet.size();
+        send.garbageBytes = (int) wanted;
+        if ((rng() % 1000000) < (wanted - send.garbageBytes) * 1000000) {
+            send.garbageBytes++;
+        }
+        for (int g = 0; g < send.garbageBytes; ++g) {
+            send.bytes.push_back((uint8_t) (rng() & 0xFF));
+        }
+        send.bytes.insert(send.bytes.end(), packet.begin(), packet.end());
+        sends.push_back(send);
+    }
+    return sends;
+}
+
+double wireRate(const LoadProfile &profile, unsigned long baud) {
+    double bytesPerPacket = (PACKET_OVERHEAD + 8) * (1 + profile.garbage);
+    return baud / 10.0 / bytesPerPacket;
+}
+
+static bool parseAck(const std::string &line, int &tag) {
+    const char *marker = "Time value:";
+    size_t pos = line.find(marker);
+    if (pos == std::string::npos) return false;
+    tag = atoi(line.c_str() + pos + strlen(marker));
+    return true;
+}
+
+/**
+ * Match acknowledgements to sent packets, in order. Tags repeat every MAX_TAG packets, so each ack is matched
+ * to the first outstanding packet with its tag, never going backwards.
+ */
+static void matchAcks(const std::vector<PlannedSend> &sends, const std::vector<Ack> &acks,
+                      std::vector<PacketOutcome> &outcomes) {
+    size_t next = 0;
+    for (const Ack &ack : acks) {
+        for (size_t i = next; i < sends.size() && i < next + MAX_TAG; ++i) {
+            if (sends[i].tag == ack.tag) {
+                outcomes[i].delivered = true;
+                outcomes[i].handledUs = ack.us;
+                next = i + 1;
+                break;
+            }
+        }
+    }
+}
+
+std::vector<uint64_t> findAcks(const std::vector<PlannedSend> &sends, const std::vector<SerialLine> &lines,
+                               uint64_t fromUs) {
+    std::vector<Ack> acks;
+    for (const SerialLine &line : lines) {
+        int tag;
+        if (line.us >= fromUs && parseAck(line.text, tag)) acks.push_back({line.us, tag});
+    }
+
+    std::vector<PacketOutcome> outcomes(sends.size());
+    matchAcks(sends, acks, outcomes);
+    std::vector<uint64_t> handled;
+    for (const PacketOutcome &outcome : outcomes) {
+        handled.push_back(outcome.delivered ? outcome.handledUs : 0);
+    }
+    return handled;
+}
+
+static void summariseLatency(std::vector<uint64_t> &latencies, TrialResult &result) {
+    if (latencies.empty()) return;
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        return latencies[std::min(latencies.size() - 1, (size_t) (p * latencies.size()))];
+    };
+    uint64_t total = 0;
+    for (uint64_t latency : latencies) {
+        total += latency;
+    }
+    result.latencyMin = latencies.front();
+    result.latencyP50 = percentile(0.50);
+    result.latencyP95 = percentile(0.95);
+    result.latencyP99 = percentile(0.99);
+    result.latencyMax = latencies.back();
+    result.latencyMean = total / latencies.size();
+}
+
+static TrialResult emptyResult(const LoadProfile &profile, const std::vector<PlannedSend> &sends) {
+    TrialResult result = {};
+    result.rate = profile.rate;
+    result.sent = (int) sends.size();
+    for (const PlannedSend &send : sends) {
+        result.garbageBytes += send.garbageBytes;
+    }
+    return result;
+}
+
+TrialResult runSimTrial(const LoadProfile &profile) {
+    std::vector<PlannedSend> sends = planLoad(profile);
+    TrialResult result = emptyResult(profile, sends);
+
+    bool ok = runIsolated<TrialResult>([&]() {
+        SimBoard sim;
+        sim.boot();
+        sim.runUntil([]() { return false; }, 100000);
+
+        const uint64_t start = sim.now();
+        std::vector<uint64_t> lastByte;
+        for (const PlannedSend &send : sends) {
+            lastByte.push_back(sim.transmit(start + send.startUs, send.bytes.data(), send.bytes.size()));
+        }
+
+        const uint64_t quiet = lastByte.back() + TAIL_US;
+        sim.runUntil([&]() { return sim.now() >= quiet && sim.pendingRx() == 0; }, quiet + 60000000);
+
+        std::vector<uint64_t> handled = findAcks(sends, sim.lines(), start);
+        std::vector<PacketOutcome> outcomes;
+        for (size_t i = 0; i < sends.size(); ++i) {
+            outcomes.push_back({lastByte[i], handled[i] != 0, handled[i]});
+        }
+
+        TrialResult trial = result;
+        trial.rxOverflows = sim.getRxOverflows();
+        trial.rxOverruns = sim.getRxOverruns();
+        const std::vector<ShownFrame> &frames = sim.frames();
+        std::vector<uint64_t> latencies;
+        for (const PacketOutcome &outcome : outcomes) {
+            if (!outcome.delivered) continue;
+            trial.delivered++;
+            auto shown = std::lower_bound(frames.begin(), frames.end(), outcome.handledUs,
+                                          [](const ShownFrame &f, uint64_t us) { return f.startUs < us; });
+            if (shown != frames.end() && shown->changed) {
+                trial.displayed++;
+                latencies.push_back(shown->endUs - outcome.lastByteUs);
+            }
+        }
+        for (const ShownFrame &frame : frames) {
+            if (frame.startUs >= start) trial.shows++;
+        }
+        summariseLatency(latencies, trial);
+        return trial;
+    }, result);
+
+    if (!ok) fprintf(stderr, "Simulated receiver crashed at %.2f packets/s\n", profile.rate);
+    return result;
+}
+
+//region device
+static uint64_t hostMicros() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static speed_t baudConstant(unsigned long baud) {
+    switch (baud) {
+        case 1200: return B1200;
+        case 2400: return B2400;
+        case 4800: return B4800;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        default: return B9600;
+    }
+}
+
+int openSerial(const char *path, unsigned long baud) {
+    int fd = open(path, O_RDWR | O_NOCTTY);
+    if (fd < 0) return -1;
+
+    termios tty = {};
+    if (tcgetattr(fd, &tty) != 0) {
+        close(fd);
+        return -1;
+    }
+    cfmakeraw(&tty);
+    cfsetispeed(&tty, baudConstant(baud));
+    cfsetospeed(&tty, baudConstant(baud));
+    tty.c_cflag |= CLOCAL | CREAD;
+    tty.c_cflag &= ~(CSTOPB | PARENB);
+    if (tcsetattr(fd, TCSANOW, &tty) != 0) {
+        close(fd);
+        return -1;
+    }
+    tcflush(fd, TCIOFLUSH);
+    return fd;
+}
+
+TrialResult runDeviceTrial(const LoadProfile &profile, int fd, unsigned long baud) {
+    std::vector<PlannedSend> sends = planLoad(profile);
+    TrialResult result = emptyResult(profile, sends);
+
+    std::atomic<bool> stop(false);
+    std::vector<Ack> acks;
+    std::thread reader([&]() {
+        std::string line;
+        pollfd pfd = {fd, POLLIN, 0};
+        while (!stop) {
+            if (poll(&pfd, 1, 50) <= 0) continue;
+            char chunk[64];
+            ssize_t n = read(fd, chunk, sizeof(chunk));
+            uint64_t now = hostMicros();
+            for (ssize_t i = 0; i < n; ++i) {
+                if (chunk[i] != '\n') {
+                    line.push_back(chunk[i]);
+                    continue;
+                }
+                int tag;
+                if (parseAck(line, tag)) acks.push_back({now, tag});
+                line.clear();
+            }
+        }
+    });
+
+    std::vector<PacketOutcome> outcomes(sends.size());
+    const uint64_t start = hostMicros();
+    for (size_t i = 0; i < sends.size(); ++i) {
+        uint64_t at = start + sends[i].startUs;
+        uint64_t now = hostMicros();
+        if (at > now) std::this_thread::sleep_for(std::chrono::microseconds(at - now));
+        if (write(fd, sends[i].bytes.data(), sends[i].bytes.size()) < 0) break;
+        tcdrain(fd);
+        outcomes[i] = {hostMicros(), false, 0};
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(TAIL_US + (uint64_t) 2000 * 10000000 / baud));
+    stop = true;
+    reader.join();
+
+    matchAcks(sends, acks, outcomes);
+    std::vector<uint64_t> latencies;
+    for (const PacketOutcome &outcome : outcomes) {
+        if (!outcome.delivered) continue;
+        result.delivered++;
+        result.displayed++;
+        latencies.push_back(outcome.handledUs > outcome.lastByteUs ? outcome.handledUs - outcome.lastByteUs : 0);
+    }
+    summariseLatency(latencies, result);
+    return result;
+}
+//endregion
+
+//region command line
+static void printUsage() {
+    fprintf(stderr,
+            "usage: program loadgen [options]\n"
+            "  --rate R          Average packets per second (default 10)\n"
+            "  --burst N         Packets sent back-to-back per burst (default 1)\n"
+            "  --garbage G       Garbage bytes injected per packet byte (default 0)\n"
+            "  --mix K=W,...     Packet mix weights; kinds: time colour detail countdown repeat estop\n"
+            "                    (default time=6,colour=2,detail=1,repeat=1)\n"
+            "  --packets N       Packets per trial (default 200)\n"
+            "  --seed S          Random seed (default 1)\n"
+            "  --search          Binary search for the highest rate at which every packet is displayed in time\n"
+            "  --resolution R    Search resolution in packets per second (default 0.1)\n"
+            "  --max-latency MS  The longest a packet may take to be displayed, for --search (default 1000)\n"
+            "  --device PATH     Drive a real receiver on a serial device instead of the simulator\n"
+            "  --baud B          Serial baud (default 9600)\n");
+}
+
+static bool parseMix(const char *spec, int mix[NUM_KINDS]) {
+    for (int k = 0; k < NUM_KINDS; ++k) {
+        mix[k] = 0;
+    }
+    std::string rest(spec);
+    while (!rest.empty()) {
+        size_t comma = rest.find(',');
+        std::string item = rest.substr(0, comma);
+        rest = comma == std::string::npos ? "" : rest.substr(comma + 1);
+
+        size_t eq = item.find('=');
+        if (eq == std::string::npos) return false;
+        std::string name = item.substr(0, eq);
+        int k = 0;
+        while (k < NUM_KINDS && name != PACKET_KIND_NAMES[k]) ++k;
+        if (k == NUM_KINDS) return false;
+        mix[k] = atoi(item.c_str() + eq + 1);
+    }
+    return true;
+}
+
+/**
+ * If the receiver kept up in a trial: every packet displayed, none later than maxLatencyUs. Zero loss alone passes a
+ * receiver that falls ever further behind, so long as the trial ends before its ring overflows.
+ */
+static bool keptUp(const TrialResult &r, uint64_t maxLatencyUs) {
+    return r.delivered == r.sent && r.displayed == r.sent && r.latencyMax <= maxLatencyUs;
+}
+
+static void printTrial(const TrialResult &r) {
+    printf("%8.2f pkt/s  sent %4d  delivered %4d  lost %4d  displayed %4d  garbage %5ld  overflow %4lu  overrun %4lu"
+           "  shows %4d", r.rate, r.sent, r.delivered, r.sent - r.delivered, r.displayed, r.garbageBytes,
+           r.rxOverflows, r.rxOverruns, r.shows);
+    if (r.displayed > 0) {
+        printf("  latency ms min %.1f p50 %.1f p95 %.1f p99 %.1f max %.1f",
+               r.latencyMin / 1000.0, r.latencyP50 / 1000.0, r.latencyP95 / 1000.0, r.latencyP99 / 1000.0,
+               r.latencyMax / 1000.0);
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+int loadGenMain(int argc, char **argv) {
+    LoadProfile profile;
+    bool search = false;
+    double resolution = 0.1;
+    uint64_t maxLatencyUs = 1000000;
+    const char *device = nullptr;
+    unsigned long baud = 9600;
+
+    for (int i = 0; i < argc; ++i) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!strcmp(arg, "--search")) {
+            search = true;
+            continue;
+        }
+        if (!value) {
+            printUsage();
+            return 2;
+        }
+        if (!strcmp(arg, "--rate")) {
+            profile.rate = atof(value);
+        } else if (!strcmp(arg, "--burst")) {
+            profile.burst = std::max(1, atoi(value));
+        } else if (!strcmp(arg, "--garbage")) {
+            profile.garbage = atof(value);
+        } else if (!strcmp(arg, "--mix")) {
+            if (!parseMix(value, profile.mix)) {
+                printUsage();
+                return 2;
+            }
+        } else if (!strcmp(arg, "--packets")) {
+            profile.packets = atoi(value);
+        } else if (!strcmp(arg, "--seed")) {
+            profile.seed = (uint32_t) strtoul(value, nullptr, 10);
+        } else if (!strcmp(arg, "--resolution")) {
+            resolution = atof(value);
+        } else if (!strcmp(arg, "--max-latency")) {
+            maxLatencyUs = (uint64_t) (atof(value) * 1000);
+        } else if (!strcmp(arg, "--device")) {
+            device = value;
+        } else if (!strcmp(arg, "--baud")) {
+            baud = strtoul(value, nullptr, 10);
+        } else {
+            printUsage();
+            return 2;
+        }
+        ++i;
+    }
+
+    int fd = -1;
+    if (device) {
+        fd = openSerial(device, baud);
+        if (fd < 0) {
+            fprintf(stderr, "Could not open %s: %s\n", device, strerror(errno));
+            return 1;
+        }
+        // Opening the port resets an Uno; give the bootloader time to hand over to the firmware
+        sleep(2);
+    }
+    auto trial = [&](double rate) {
+        LoadProfile p = profile;
+        p.rate = rate;
+        TrialResult r = device ? runDeviceTrial(p, fd, baud) : runSimTrial(p);
+        printTrial(r);
+        return r;
+    };
+
+    if (!search) {
+        trial(profile.rate);
+    } else {
+        double hi = wireRate(profile, baud);
+        printf("Link limit for this mix: %.2f pkt/s\n", hi);
+        if (keptUp(trial(hi), maxLatencyUs)) {
+            printf("Every packet displayed within %.0f ms up to the link limit.\n", maxLatencyUs / 1000.0);
+        } else {
+            double lo = 0;
+            while (hi - lo > resolution) {
+                double mid = (lo + hi) / 2;
+                if (keptUp(trial(mid), maxLatencyUs)) {
+                    lo = mid;
+                } else {
+                    hi = mid;
+                }
+            }
+            if (lo > 0) {
+                printf("Highest rate with every packet displayed within %.0f ms: %.2f pkt/s\n", maxLatencyUs / 1000.0,
+                       lo);
+            } else {
+                printf("Packets were lost or late at every rate down to %.2f pkt/s.\n", hi);
+            }
+        }
+    }
+
+    if (fd >= 0) close(fd);
+    return 0;
+}
+//endregion
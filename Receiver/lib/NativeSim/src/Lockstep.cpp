@@ -0,0 +1,240 @@
+#include "Lockstep.h"
+#include "Packets.h"
+
+#include <Arduino.h>
+#include <Board.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+static const uint64_t SECOND_US = 1000000;
+static const uint64_t FIRST_END_US = 2 * SECOND_US;
+static const uint64_t END_SPACING_US = 30 * SECOND_US;
+// All three lights, so any change of colour shows up
+static const int LIGHTS_LEDS = NUM_LEDS - LIGHTS_FIRST_LED;
+
+/**
+ * A state the controller sends at a set point in an end.
+ */
+struct Command {
+    uint64_t atUs;          // Controller time
+    StateFields fields;
+    bool beeps;             // If acting on it starts the buzzer
+};
+
+/**
+ * The commands for each end, as TargetFragment sends them: amber with the walk-up countdown, green ten seconds
+ * later, then the score button ten seconds into the green.
+ */
+static std::vector<Command> endCommands(int ends) {
+    std::vector<Command> commands;
+    for (int end = 0; end < ends; ++end) {
+        uint64_t start = FIRST_END_US + end * END_SPACING_US;
+
+        StateFields amber;
+        amber.countdownContinues = true;
+        amber.countdown = true;
+        amber.detail = 1;
+        amber.colour = 1;
+        amber.timeEnabled = true;
+        amber.time = 10;
+        amber.startNumBeeps = 2;
+        amber.endNumBeeps = 1;
+        commands.push_back({start, amber, true});
+
+        StateFields green;
+        green.countdown = true;
+        green.detail = 1;
+        green.colour = 2;
+        green.timeEnabled = true;
+        green.time = 240;
+        green.endNumBeeps = 3;
+        commands.push_back({start + 10 * SECOND_US, green, false});
+
+        StateFields score;
+        score.timeEnabled = true;
+        score.time = 240;
+        score.endNumBeeps = 3;
+        commands.push_back({start + 20 * SECOND_US, score, true});
+    }
+    return commands;
+}
+
+/**
+ * Run one receiver through the commands.
+ *
+ * @param bootUs How long the receiver had been powered on at controller time 0.
+ * @param rng    Draws this receiver's link delays.
+ */
+static ReceiverActivations runReceiver(const LockstepOptions &options, const std::vector<Command> &commands,
+                                       bool scheduled, uint64_t bootUs, std::mt19937 &rng) {
+    std::uniform_int_distribution<uint64_t> delayDist(options.minDelayUs, options.maxDelayUs);
+    std::uniform_int_distribution<uint64_t> jitterDist(0, options.jitterUs);
+    const uint64_t delayUs = delayDist(rng);
+
+    // Everything the receiver will hear, and when, is fixed before it boots
+    struct Send {
+        uint64_t simUs;
+        std::vector<uint8_t> bytes;
+    };
+    std::vector<Send> sends;
+    std::vector<uint64_t> commandSimUs;
+    for (const Command &command : commands) {
+        uint64_t sentUs = scheduled ? command.atUs - options.leadUs : command.atUs;
+        commandSimUs.push_back(sentUs + bootUs);
+        if (scheduled) {
+            sends.push_back({sentUs + bootUs + delayUs + jitterDist(rng), encodeClockPacket(sentUs / 1000)});
+            sends.push_back({sentUs + bootUs + delayUs + jitterDist(rng),
+                             encodeScheduledStatePacket(command.atUs / 1000, command.fields)});
+        } else {
+            sends.push_back({sentUs + bootUs + delayUs + jitterDist(rng), encodeStatePacket(command.fields)});
+        }
+    }
+
+    ReceiverActivations activations = {};
+    bool ok = runIsolated<ReceiverActivations>([&]() {
+        SimBoard sim;
+        sim.setProbe(LIGHTS_FIRST_LED, LIGHTS_LEDS);
+        sim.setPin(QUIET_PIN, LOW);
+        sim.boot();
+
+        for (const Send &send : sends) {
+            sim.transmit(send.simUs, send.bytes.data(), send.bytes.size());
+        }
+        const uint64_t endUs = commands.back().atUs + bootUs + 2 * SECOND_US;
+        sim.runUntil([&]() { return sim.now() >= endUs; }, endUs + SECOND_US);
+
+        ReceiverActivations a = {};
+        const std::vector<ShownFrame> &frames = sim.frames();
+        const std::vector<AnalogChange> &analog = sim.analogHistory();
+        for (size_t c = 0; c < commands.size() && c < LOCKSTEP_MAX_COMMANDS; ++c) {
+            for (size_t i = 1; i < frames.size(); ++i) {
+                if (frames[i].endUs >= commandSimUs[c] && frames[i].probe != frames[i - 1].probe) {
+                    a.lightUs[c] = frames[i].endUs - bootUs;
+                    break;
+                }
+            }
+            if (!commands[c].beeps) continue;
+            for (const AnalogChange &change : analog) {
+                if (change.us >= commandSimUs[c] && change.pin == BUZZER_PIN && change.level > 0) {
+                    a.beepUs[c] = change.us - bootUs;
+                    break;
+                }
+            }
+        }
+        return a;
+    }, activations);
+
+    if (!ok) fprintf(stderr, "Simulated receiver crashed\n");
+    return activations;
+}
+
+std::vector<ReceiverActivations> runLockstep(const LockstepOptions &options, bool scheduled) {
+    const std::vector<Command> commands = endCommands(options.ends);
+    std::vector<ReceiverActivations> results;
+    for (int r = 0; r < options.receivers; ++r) {
+        // The same receiver gets the same power-on time and links in both modes
+        std::mt19937 rng(options.seed * 7919 + r);
+        uint64_t bootUs = std::uniform_int_distribution<uint64_t>(SECOND_US / 10, SECOND_US)(rng);
+        results.push_back(runReceiver(options, commands, scheduled, bootUs, rng));
+    }
+    return results;
+}
+
+/**
+ * Work out the skew across receivers for each command, from either the lights or the buzzer.
+ */
+static SkewSummary summarise(const std::vector<ReceiverActivations> &results, const std::vector<Command> &commands,
+                             bool beeps) {
+    SkewSummary summary = {};
+    std::vector<uint64_t> skews;
+    std::vector<uint64_t> latencies;
+    for (size_t c = 0; c < commands.size(); ++c) {
+        if (beeps && !commands[c].beeps) continue;
+
+        uint64_t first = UINT64_MAX;
+        uint64_t last = 0;
+        bool all = true;
+        for (const ReceiverActivations &a : results) {
+            uint64_t at = beeps ? a.beepUs[c] : a.lightUs[c];
+            if (!at) {
+                all = false;
+                break;
+            }
+            first = std::min(first, at);
+            last = std::max(last, at);
+            latencies.push_back(at > commands[c].atUs ? at - commands[c].atUs : 0);
+        }
+        if (all) skews.push_back(last - first);
+    }
+
+    summary.commands = (int) skews.size();
+    if (!skews.empty()) {
+        std::sort(skews.begin(), skews.end());
+        summary.skewP50Us = skews[skews.size() / 2];
+        summary.skewMaxUs = skews.back();
+    }
+    if (!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        summary.latencyP50Us = latencies[latencies.size() / 2];
+    }
+    return summary;
+}
+
+int lockstepMain(int argc, char **argv) {
+    LockstepOptions options;
+
+    for (int i = 0; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--receivers")) {
+            options.receivers = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--ends")) {
+            options.ends = std::min(atoi(argv[i + 1]), LOCKSTEP_MAX_COMMANDS / 3);
+        } else if (!strcmp(argv[i], "--lead")) {
+            options.leadUs = (uint64_t) (atof(argv[i + 1]) * 1000);
+        } else if (!strcmp(argv[i], "--delay")) {
+            // min-max in ms
+            double lo = 0, hi = 0;
+            if (sscanf(argv[i + 1], "%lf-%lf", &lo, &hi) != 2) argc = -1;
+            options.minDelayUs = (uint64_t) (lo * 1000);
+            options.maxDelayUs = (uint64_t) (std::max(lo, hi) * 1000);
+        } else if (!strcmp(argv[i], "--jitter")) {
+            options.jitterUs = (uint64_t) (atof(argv[i + 1]) * 1000);
+        } else if (!strcmp(argv[i], "--seed")) {
+            options.seed = (uint32_t) strtoul(argv[i + 1], nullptr, 10);
+        } else {
+            argc = -1;
+        }
+    }
+    if (argc < 0 || argc % 2 || options.receivers < 2 || options.ends < 1) {
+        fprintf(stderr,
+                "usage: program lockstep [options]\n"
+                "  --receivers N   Receivers on the line (default 8)\n"
+                "  --ends N        Ends to run, three commands each (default 5, at most 20)\n"
+                "  --lead MS       How far ahead scheduled frames are sent (default 250)\n"
+                "  --delay LO-HI   Fixed radio delay per receiver, in ms (default 5-15)\n"
+                "  --jitter MS     Extra delay per frame, up to this (default 20)\n"
+                "  --seed N\n");
+        return 2;
+    }
+
+    const std::vector<Command> commands = endCommands(options.ends);
+    printf("%d receivers, %d ends, radio delay %.0f-%.0f ms, jitter up to %.0f ms, lead %.0f ms\n\n",
+           options.receivers, options.ends, options.minDelayUs / 1000.0, options.maxDelayUs / 1000.0,
+           options.jitterUs / 1000.0, options.leadUs / 1000.0);
+    printf("%-10s %-6s %8s %12s %12s %15s\n", "mode", "event", "commands", "skew p50 ms", "skew max ms",
+           "latency p50 ms");
+    for (bool scheduled : {false, true}) {
+        std::vector<ReceiverActivations> results = runLockstep(options, scheduled);
+        for (bool beeps : {false, true}) {
+            SkewSummary s = summarise(results, commands, beeps);
+            printf("%-10s %-6s %8d %12.1f %12.1f %15.1f\n", scheduled ? "scheduled" : "immediate",
+                   beeps ? "beep" : "light", s.commands, s.skewP50Us / 1000.0, s.skewMaxUs / 1000.0,
+                   s.latencyP50Us / 1000.0);
+        }
+        fflush(stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,207 @@
+#include "Packets.h"
+
+#include <Fec.h>
+#include <Frames.h>
+
+static void writeShort(std::vector<uint8_t> &out, uint16_t value) {
+    out.push_back(value >> 8);
+    out.push_back(value & 0xFF);
+}
+
+uint16_t packStateFlags(const StateFields &fields) {
+    uint16_t ret = 0;
+    ret |= (fields.countdownContinues ? 1 : 0) << 9;
+    ret |= (fields.lastEnd ? 1 : 0) << 8;
+    ret |= (fields.emergencyStop ? 1 : 0) << 7;
+    ret |= (fields.matchplay ? 1 : 0) << 6;
+    ret |= (fields.countdown ? 1 : 0) << 5;
+    ret |= (fields.detail & 0x3) << 3;
+    ret |= (fields.colour & 0x3) << 1;
+    ret |= fields.timeEnabled ? 1 : 0;
+    return ret;
+}
+
+std::vector<uint8_t> encodePacket(const std::vector<uint8_t> &data) {
+    uint16_t checksum = 0;
+    for (uint8_t b : data) {
+        checksum += b;
+    }
+
+    std::vector<uint8_t> packet(PACKET_HEADER, PACKET_HEADER + 4);
+    packet.push_back((uint8_t) (data.size() + PACKET_OVERHEAD));
+    writeShort(packet, checksum);
+    packet.insert(packet.end(), data.begin(), data.end());
+    return packet;
+}
+
+static void writeLong(std::vector<uint8_t> &out, uint32_t value) {
+    writeShort(out, value >> 16);
+    writeShort(out, value & 0xFFFF);
+}
+
+static void writeState(std::vector<uint8_t> &out, const StateFields &fields) {
+    writeShort(out, packStateFlags(fields));
+    writeShort(out, fields.time);
+    writeShort(out, fields.startNumBeeps);
+    writeShort(out, fields.endNumBeeps);
+}
+
+std::vector<uint8_t> encodeStatePacket(const StateFields &fields) {
+    std::vector<uint8_t> data;
+    writeState(data, fields);
+    return encodePacket(data);
+}
+
+std::vector<uint8_t> encodeFecPacket(const std::vector<uint8_t> &data) {
+    std::vector<uint8_t> packet(FEC_HEADER, FEC_HEADER + FEC_HEADER_SIZE);
+    packet.resize(fecPacketSize(data.size()));
+    fecEncodeLength(data.size(), &packet[FEC_HEADER_SIZE]);
+    fecEncodeBody(data.data(), data.size(), &packet[FEC_HEADER_SIZE + FEC_LENGTH_SIZE]);
+    return packet;
+}
+
+std::vector<uint8_t> encodeFecStatePacket(const StateFields &fields) {
+    std::vector<uint8_t> data;
+    writeState(data, fields);
+    return encodeFecPacket(data);
+}
+
+std::vector<uint8_t> encodeClockPacket(uint32_t controllerMs) {
+    std::vector<uint8_t> data = {FRAME_CLOCK};
+    writeLong(data, controllerMs);
+    return encodePacket(data);
+}
+
+std::vector<uint8_t> encodeScheduledStatePacket(uint32_t atMs, const StateFields &fields) {
+    std::vector<uint8_t> data = {FRAME_SCHEDULED_STATE};
+    writeLong(data, atMs);
+    writeState(data, fields);
+    return encodePacket(data);
+}
+
+std::vector<uint8_t> encodeGenerationPacket(uint16_t generation, const StateFields &fields) {
+    std::vector<uint8_t> data = {FRAME_GENERATION};
+    writeShort(data, generation);
+    writeState(data, fields);
+    return encodePacket(data);
+}
+
+std::vector<uint8_t> encodeGenerationPacket(uint16_t generation, const std::vector<uint8_t> &packet) {
+    std::vector<uint8_t> data = {FRAME_GENERATION};
+    writeShort(data, generation);
+    data.insert(data.end(), packet.begin() + PACKET_OVERHEAD, packet.end());
+    return encodePacket(data);
+}
+
+std::vector<uint8_t> encodeRoundSchedulePacket(const RoundScheduleFrame &schedule) {
+    std::vector<uint8_t> data(ROUND_SCHEDULE_FRAME_SIZE);
+    encodeRoundScheduleFrame(schedule, data.data());
+    return encodePacket(data);
+}
+
+std::vector<uint8_t> encodeRoundControlPacket(uint8_t sequence, uint8_t command, uint32_t atMs) {
+    RoundControlFrame frame = {sequence, command, atMs};
+    std::vector<uint8_t> data(ROUND_CONTROL_FRAME_SIZE);
+    encodeRoundControlFrame(frame, data.data());
+    return encodePacket(data);
+}
+
+std::vector<uint8_t> encodeHandoffPacket(const HandoffFrame &frame) {
+    std::vector<uint8_t> data(HANDOFF_FRAME_SIZE);
+    encodeHandoffFrame(frame, data.data());
+    return encodePacket(data);
+}
+
+std::vector<uint8_t> encodeBatchPacket(const std::vector<std::vector<uint8_t>> &packets) {
+    std::vector<uint8_t> data = {FRAME_BATCH, (uint8_t) packets.size()};
+    for (const std::vector<uint8_t> &packet : packets) {
+        data.push_back((uint8_t) (packet.size() - PACKET_OVERHEAD));
+        data.insert(data.end(), packet.begin() + PACKET_OVERHEAD, packet.end());
+    }
+    return encodePacket(data);
+}
+
+std::vector<uint8_t> encodeEmergencyStopSignal() {
+    std::vector<uint8_t> signal;
+    for (int i = 0; i < ESTOP_SIGNAL_COPIES; ++i) {
+        writeLong(signal, ESTOP_SIGNAL);
+    }
+    return signal;
+}
+
+std::vector<uint8_t> encodePingPacket(uint16_t receiverId, uint8_t sequence, uint32_t t1, uint8_t lastSequence,
+                                      uint32_t t4) {
+    std::vector<uint8_t> data = {FRAME_PING};
+    writeShort(data, receiverId);
+    data.push_back(sequence);
+    writeLong(data, t1);
+    data.push_back(lastSequence);
+    writeLong(data, t4);
+    return encodePacket(data);
+}
+
+std::vector<uint8_t> encodeClockQueryPacket(uint16_t receiverId) {
+    std::vector<uint8_t> data = {FRAME_CLOCK_QUERY};
+    writeShort(data, receiverId);
+    return encodePacket(data);
+}
+
+std::vector<uint8_t> encodeCalibratePacket(uint16_t receiverId, uint8_t command) {
+    CalibrateFrame frame = {receiverId, command};
+    std::vector<uint8_t> data(CALIBRATE_FRAME_SIZE);
+    encodeCalibrateFrame(frame, data.data());
+    return encodePacket(data);
+}
+
+std::vector<DecodedFrame> decodeFrames(const std::vector<TxByte> &bytes, size_t &next,
+                                       std::vector<DecodedFlow> *flow) {
+    std::vector<DecodedFrame> frames;
+    while (next < bytes.size()) {
+        const uint8_t first = bytes[next].value;
+        if (first == FLOW_BUSY || first == FLOW_READY) {
+            if (flow) flow->push_back({bytes[next].us, first == FLOW_BUSY});
+            next++;
+            continue;
+        }
+        // Only what could yet turn out to be a header waits for more
+        size_t matched = 0;
+        while (matched < 4 && next + matched < bytes.size() && bytes[next + matched].value == PACKET_HEADER[matched]) {
+            matched++;
+        }
+        if (matched < 4 && next + matched < bytes.size()) {
+            next++;
+            continue;
+        }
+        if (next + PACKET_OVERHEAD > bytes.size()) break;
+
+        const size_t size = bytes[next + 4].value;
+        if (size < PACKET_OVERHEAD) {
+            next++;
+            continue;
+        }
+        if (next + size > bytes.size()) break;
+
+        DecodedFrame frame;
+        uint16_t checksum = 0;
+        for (size_t i = next + PACKET_OVERHEAD; i < next + size; ++i) {
+            frame.data.push_back(bytes[i].value);
+            checksum += bytes[i].value;
+        }
+        if (checksum != (bytes[next + 5].value << 8 | bytes[next + 6].value)) {
+            next++;
+            continue;
+        }
+        frame.endUs = bytes[next + size - 1].us;
+        frames.push_back(frame);
+        next += size;
+    }
+    return frames;
+}
+
+uint32_t readField(const std::vector<uint8_t> &data, size_t offset, size_t size) {
+    uint32_t value = 0;
+    for (size_t i = offset; i < offset + size && i < data.size(); ++i) {
+        value = value << 8 | data[i];
+    }
+    return value;
+}
@@ -0,0 +1,200 @@
+#include "PaletteCheck.h"
+#include "Packets.h"
+
+#include <Arduino.h>
+#include <Board.h>
+#include <FastLED.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC
+#endif
+
+extern bool bakedColours;
+extern bool ledCapture;
+
+static const uint64_t MS_US = 1000;
+static const uint64_t SETTLE_US = 100000;       // After boot, before the script starts
+static const int ENCODE_ROUNDS = 20000;
+
+struct ScriptedState {
+    uint64_t atMs;
+    uint8_t colour;         // 0 = red, 1 = amber, 2 = green
+    uint8_t detail;
+    int16_t time;           // 0 for no countdown
+    bool emergencyStop;
+};
+
+static const ScriptedState SCRIPT[] = {
+        {0,     2, 1, 15, false},
+        {3000,  1, 1, 0,  false},
+        {5000,  0, 1, 0,  false},   // The amber light fades out
+        {7000,  2, 2, 12, false},   // Flashes for its final seconds
+        {11000, 0, 0, 0,  true},    // The red light pulses
+};
+
+// When the brightness switch changes, from the start of the script; the first of each pair is the level it goes to
+static const uint64_t SWITCH_MS[][2] = {
+        {LOW,  2000},
+        {HIGH, 5200},   // Part-way through the fade
+        {LOW,  9300},   // While the time flashes
+        {HIGH, 12200},  // While the red light pulses
+};
+static const uint64_t END_MS = 13500;
+
+PaletteRun runPalette(bool baked, bool dithering, bool splitChains, bool capture) {
+    PaletteRun run = {};
+
+    bool ok = runIsolated<PaletteRun>([&]() {
+        SimBoard sim;
+        if (splitChains) sim.setPin(SPLIT_CHAINS_PIN, LOW);
+        sim.setPin(QUIET_PIN, LOW);
+        bakedColours = baked;
+        simDithering = dithering;
+        ledCapture = capture;
+        sim.boot();
+        sim.runUntil([]() { return false; }, SETTLE_US);
+
+        const uint64_t start = sim.now();
+        uint16_t generation = 0;
+        for (const ScriptedState &step : SCRIPT) {
+            StateFields fields;
+            fields.colour = step.colour;
+            fields.detail = step.detail;
+            fields.countdown = step.time > 0;
+            fields.timeEnabled = step.time > 0;
+            fields.time = step.time;
+            fields.emergencyStop = step.emergencyStop;
+            const std::vector<uint8_t> bytes = encodeGenerationPacket(++generation, fields);
+            sim.transmit(start + step.atMs * MS_US, bytes.data(), bytes.size());
+        }
+        for (const uint64_t *change : SWITCH_MS) {
+            sim.runUntil([]() { return false; }, start + change[1] * MS_US);
+            sim.setPin(BRIGHTNESS_PIN, (int) change[0]);
+        }
+        sim.runUntil([]() { return false; }, start + END_MS * MS_US);
+
+        PaletteRun r = {};
+        for (const ShownFrame &frame : sim.frames()) {
+            if (r.frames == PaletteRun::MAX_FRAMES) break;
+            r.showUs += frame.endUs - frame.startUs;
+            r.hashes[r.frames++] = frame.hash;
+        }
+        return r;
+    }, run);
+
+    if (!ok) fprintf(stderr, "Simulated receiver crashed\n");
+    return run;
+}
+
+template<typename F>
+static double timeRounds(F encode) {
+    for (int i = 0; i < ENCODE_ROUNDS / 10; ++i) {
+        encode();
+    }
+#ifdef HAVE_RDTSC
+    const uint64_t begin = __rdtsc();
+    for (int i = 0; i < ENCODE_ROUNDS; ++i) {
+        encode();
+    }
+    return (double) (__rdtsc() - begin) / ENCODE_ROUNDS;
+#else
+    const auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < ENCODE_ROUNDS; ++i) {
+        encode();
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / ENCODE_ROUNDS;
+#endif
+}
+
+EncodeTiming timeEncode() {
+    static CRGB leds[NUM_LEDS];
+    static uint8_t wire[NUM_LEDS * 3];
+    for (int i = 0; i < NUM_LEDS; ++i) {
+        leds[i] = i % 3 ? CRGB(0xFFFF00) : CRGB(0xFF8000);
+    }
+    const bool dithering = simDithering;
+    simDithering = true;
+
+    CLEDController scaled;
+    scaled.leds = leds;
+    scaled.numLeds = NUM_LEDS;
+    scaled.setCorrection(TypicalSMD5050).setDither(BINARY_DITHER);
+    CLEDController raw;
+    raw.leds = leds;
+    raw.numLeds = NUM_LEDS;
+    raw.setCorrection(UncorrectedColor).setDither(DISABLE_DITHER);
+
+    EncodeTiming timing;
+    timing.scaled = timeRounds([&]() { scaled.encode(LOW_BRIGHTNESS, wire); });
+    timing.raw = timeRounds([&]() { raw.encode(255, wire); });
+    simDithering = dithering;
+    return timing;
+}
+
+size_t differing(const PaletteRun &a, const PaletteRun &b) {
+    size_t count = std::max(a.frames, b.frames) - std::min(a.frames, b.frames);
+    for (size_t i = 0; i < std::min(a.frames, b.frames); ++i) {
+        if (a.hashes[i] != b.hashes[i]) ++count;
+    }
+    return count;
+}
+
+int paletteMain(int argc, char **argv) {
+    bool single = true;
+    bool split = true;
+
+    for (int i = 0; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--layout")) {
+            single = !strcmp(argv[i + 1], "single");
+            split = !strcmp(argv[i + 1], "split");
+            if (!single && !split) argc = -1;
+        } else {
+            argc = -1;
+        }
+    }
+    if (argc < 0 || argc % 2) {
+        fprintf(stderr,
+                "usage: program palette [options]\n"
+                "  --layout X        Only one LED chain (single) or a chain per region (split); both by default\n");
+        return 2;
+    }
+
+    // Heap allocated: each run holds a hash for every frame
+    std::vector<PaletteRun> runs(3);
+    PaletteRun &scaled = runs[0], &baked = runs[1], &dithered = runs[2];
+    printf("every colour, a lamp fade, the final seconds and an emergency stop, with the brightness switch flipped\n\n");
+    printf("%-6s %6s %6s %17s %19s\n", "chains", "scaled", "baked", "baked differ", "altered by dither");
+    bool same = true;
+    for (int layout = 0; layout < 2; ++layout) {
+        const bool splitChains = layout == 1;
+        if (splitChains ? !split : !single) continue;
+
+        scaled = runPalette(false, false, splitChains, false);
+        baked = runPalette(true, false, splitChains, false);
+        dithered = runPalette(false, true, splitChains, false);
+        const size_t bakedDiffer = differing(scaled, baked);
+        printf("%-6s %6zu %6zu %17zu %19zu\n", splitChains ? "split" : "single", scaled.frames, baked.frames,
+               bakedDiffer, differing(scaled, dithered));
+        fflush(stdout);
+        if (bakedDiffer || scaled.frames != baked.frames || !scaled.frames) same = false;
+    }
+
+    const EncodeTiming timing = timeEncode();
+#ifdef HAVE_RDTSC
+    const char *unit = "cycles";
+#else
+    const char *unit = "ns";
+#endif
+    printf("\nhost %s to encode %d LEDs for the wire on each show()\n", unit, NUM_LEDS);
+    printf("  brightness %d, colour corrected, dithered  %9.0f\n", LOW_BRIGHTNESS, timing.scaled);
+    printf("  baked into the palette                    %9.0f\n", timing.raw);
+    printf("\nBaked palettes %s FastLED's scaling\n", same ? "send the same frames as" : "DIFFER from");
+    return same ? 0 : 1;
+}
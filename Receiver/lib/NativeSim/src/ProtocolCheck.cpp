@@ -0,0 +1,168 @@
+#include "ProtocolCheck.h"
+#include "Packets.h"
+
+#include <../lib/ByteBuf/include/ByteBuf.h>
+#include <Protocol.h>
+#include <State.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC
+#endif
+
+// Frames decoded per timing
+static const int DECODE_ROUNDS = 1000000;
+
+/**
+ * The simulator's hand-written encoders, which mirror the app's, against the generated decoders.
+ */
+bool checkSimEncoders() {
+    StateFields fields;
+    fields.colour = 2;
+    fields.timeEnabled = true;
+    fields.time = -5;
+    fields.endNumBeeps = 3;
+    const std::vector<uint8_t> packet = encodeScheduledStatePacket(0x12345678, fields);
+    ScheduledStateFrame scheduled;
+    decodeScheduledStateFrame(packet.data() + PACKET_OVERHEAD, scheduled);
+    return packet.size() == PACKET_OVERHEAD + SCHEDULED_STATE_FRAME_SIZE && scheduled.at == 0x12345678 &&
+           scheduled.state.flags == packStateFlags(fields) && scheduled.state.time == -5 &&
+           scheduled.state.endNumBeeps == 3;
+}
+
+//region decode comparison
+
+// Each decoder goes in a section of its own, so the linker's __start_ and __stop_ symbols give its code size
+#define DECODER(name) extern "C" const char __start_##name[], __stop_##name[]; \
+    __attribute__((noinline, section(#name)))
+
+DECODER(decode_shifts) void decodeWithShifts(ByteBuf &buf, State &s) {
+    int data = buf.readInt();
+    s.countdownContinues = ((1 << 9) & data) != 0;
+    s.lastEnd = ((1 << 8) & data) != 0;
+    s.countdown = ((1 << 5) & data) != 0;
+    s.detail = data >> 3 & 0x3;
+    s.colour = data >> 1 & 0x3;
+    s.timeEnabled = (1 & data) != 0;
+    s.time = buf.readInt();
+    s.startNumBeeps = buf.readInt();
+    s.endNumBeeps = buf.readInt();
+}
+
+static void applyFrame(const StateFrame &frame, State &s) {
+    s.countdownContinues = stateCountdownContinues(frame.flags);
+    s.lastEnd = stateLastEnd(frame.flags);
+    s.countdown = stateCountdown(frame.flags);
+    s.detail = stateDetail(frame.flags);
+    s.colour = stateColour(frame.flags);
+    s.timeEnabled = stateTimeEnabled(frame.flags);
+    s.time = frame.time;
+    s.startNumBeeps = frame.startNumBeeps;
+    s.endNumBeeps = frame.endNumBeeps;
+}
+
+DECODER(decode_buf_frame) void decodeFromByteBuf(ByteBuf &buf, State &s) {
+    if (buf.getReadableBytes() < STATE_FRAME_SIZE) return;
+    StateFrame frame;
+    decodeStateFrame(buf.peekBytes(), frame);
+    buf.skip(STATE_FRAME_SIZE);
+    applyFrame(frame, s);
+}
+
+DECODER(decode_array_frame) void decodeFromArray(const byte *data, State &s) {
+    StateFrame frame;
+    decodeStateFrame(data, frame);
+    applyFrame(frame, s);
+}
+
+template<typename F>
+static double timeDecode(F decode) {
+    for (int i = 0; i < DECODE_ROUNDS / 10; ++i) {
+        decode();
+    }
+#ifdef HAVE_RDTSC
+    const uint64_t begin = __rdtsc();
+    for (int i = 0; i < DECODE_ROUNDS; ++i) {
+        decode();
+    }
+    return (double) (__rdtsc() - begin) / DECODE_ROUNDS;
+#else
+    const auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < DECODE_ROUNDS; ++i) {
+        decode();
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / DECODE_ROUNDS;
+#endif
+}
+
+DecodeComparison compareDecode() {
+    StateFields fields;
+    fields.countdown = true;
+    fields.detail = 2;
+    fields.colour = 1;
+    fields.timeEnabled = true;
+    fields.time = 240;
+    fields.startNumBeeps = 2;
+    fields.endNumBeeps = 3;
+    const std::vector<uint8_t> packet = encodeStatePacket(fields);
+    const byte *data = packet.data() + PACKET_OVERHEAD;
+
+    ByteBuf buf(STATE_FRAME_SIZE);
+    for (byte i = 0; i < STATE_FRAME_SIZE; i++) {
+        buf.writeByte(data[i]);
+    }
+    volatile State sink;
+    State s;
+
+    DecodeComparison c;
+    c.byteBufShifts.bytes = __stop_decode_shifts - __start_decode_shifts;
+    c.byteBufShifts.cycles = timeDecode([&]() {
+        buf.setReaderIndex(0);
+        decodeWithShifts(buf, s);
+        sink.time = s.time;
+    });
+    c.byteBufFrame.bytes = __stop_decode_buf_frame - __start_decode_buf_frame;
+    c.byteBufFrame.cycles = timeDecode([&]() {
+        buf.setReaderIndex(0);
+        decodeFromByteBuf(buf, s);
+        sink.time = s.time;
+    });
+    c.arrayFrame.bytes = __stop_decode_array_frame - __start_decode_array_frame;
+    c.arrayFrame.cycles = timeDecode([&]() {
+        decodeFromArray(data, s);
+        sink.time = s.time;
+    });
+    return c;
+}
+
+//endregion
+
+int protocolMain(int argc, char **) {
+    if (argc > 0) {
+        fprintf(stderr,
+                "usage: program protocol\n"
+                "The round trip of every field is a unit test: pio test -e native-test\n");
+        return 2;
+    }
+
+    const bool encoders = checkSimEncoders();
+    printf("simulator encoders against the generated decoders: %s\n\n", encoders ? "match" : "DIFFER");
+
+#ifdef HAVE_RDTSC
+    const char *unit = "cycles";
+#else
+    const char *unit = "ns";
+#endif
+    DecodeComparison c = compareDecode();
+    printf("state frame decode, host code bytes and %s per frame:\n", unit);
+    printf("  %-40s %6zu %8.1f\n", "ByteBuf::readInt() and shifts (before)", c.byteBufShifts.bytes,
+           c.byteBufShifts.cycles);
+    printf("  %-40s %6zu %8.1f\n", "decodeStateFrame() in the ByteBuf (now)", c.byteBufFrame.bytes,
+           c.byteBufFrame.cycles);
+    printf("  %-40s %6zu %8.1f\n", "decodeStateFrame() from an array", c.arrayFrame.bytes, c.arrayFrame.cycles);
+    return encoders ? 0 : 1;
+}
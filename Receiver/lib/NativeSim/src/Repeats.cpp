@@ -0,0 +1,115 @@
+#include "Repeats.h"
+#include "Packets.h"
+
+#include <../lib/ByteBuf/include/ByteBuf.h>
+#include <State.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+extern State state;
+
+void handleFrame(ByteBuf &buf);
+
+static const uint64_t SECOND_US = 1000000;
+// handleFrame() calls timed per mode
+static const int HOST_CALLS = 2000;
+
+static std::vector<uint8_t> repeatPacket(const RepeatOptions &options, const StateFields &fields) {
+    return options.generation ? encodeGenerationPacket(1, fields) : encodeStatePacket(fields);
+}
+
+RepeatReport runRepeats(const RepeatOptions &options) {
+    RepeatReport report = {};
+
+    bool ok = runIsolated<RepeatReport>([&]() {
+        SimBoard sim;
+        sim.boot();
+        sim.runUntil([]() { return false; }, 100000);
+
+        StateFields fields;
+        fields.countdown = true;
+        fields.detail = 1;
+        fields.colour = 2;
+        fields.timeEnabled = true;
+        fields.time = 240;
+        const std::vector<uint8_t> packet = repeatPacket(options, fields);
+
+        RepeatReport r = {};
+        const uint64_t start = sim.now();
+        const size_t showsBefore = sim.frames().size();
+        uint64_t busyUs = 0;
+        size_t txBytes = 0;
+        for (uint64_t at = 0; at < options.durationUs; at += options.intervalUs) {
+            const int timeBefore = state.time;
+            const size_t txBefore = sim.txHistory().size();
+            const uint64_t lastByte = sim.transmit(start + at, packet.data(), packet.size());
+            sim.runUntil([&]() { return sim.now() >= lastByte && sim.pendingRx() == 0 && sim.rxAvailable() == 0; },
+                         lastByte + 10 * SECOND_US);
+            if (at == 0) continue;
+
+            r.repeats++;
+            busyUs += sim.now() - lastByte;
+            r.maxBusyUs = std::max(r.maxBusyUs, sim.now() - lastByte);
+            txBytes += sim.txHistory().size() - txBefore;
+            if (state.time > timeBefore) r.rewinds++;
+        }
+        sim.runUntil([&]() { return sim.now() >= start + options.durationUs; }, start + options.durationUs + SECOND_US);
+        r.shows = (int) (sim.frames().size() - showsBefore);
+        r.busyUs = r.repeats ? (double) busyUs / r.repeats : 0;
+        r.txBytes = r.repeats ? (double) txBytes / r.repeats : 0;
+
+        // The same repeat straight into handleFrame(), past the checksum as the loop hands it over
+        ByteBuf buf(packet.size());
+        const auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < HOST_CALLS; ++i) {
+            buf.clear();
+            for (size_t b = PACKET_OVERHEAD; b < packet.size(); ++b) {
+                buf.writeByte(packet[b]);
+            }
+            handleFrame(buf);
+        }
+        r.hostNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() /
+                   HOST_CALLS;
+        return r;
+    }, report);
+
+    if (!ok) fprintf(stderr, "Simulated receiver crashed\n");
+    return report;
+}
+
+int repeatsMain(int argc, char **argv) {
+    RepeatOptions options;
+
+    for (int i = 0; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--duration")) {
+            options.durationUs = (uint64_t) (atof(argv[i + 1]) * SECOND_US);
+        } else if (!strcmp(argv[i], "--interval")) {
+            options.intervalUs = (uint64_t) (atof(argv[i + 1]) * 1000);
+        } else {
+            argc = -1;
+        }
+    }
+    if (argc < 0 || argc % 2 || options.intervalUs == 0) {
+        fprintf(stderr,
+                "usage: program repeats [options]\n"
+                "  --duration S     Seconds of countdown (default 30)\n"
+                "  --interval MS    Time between repeats (default 250)\n");
+        return 2;
+    }
+
+    printf("countdown from 240 with the state repeated every %.0f ms for %.0f s\n\n",
+           options.intervalUs / 1000.0, options.durationUs / (double) SECOND_US);
+    printf("%-11s %8s %13s %12s %14s %6s %8s %12s\n", "repeats as", "repeats", "busy ms/each", "max busy ms",
+           "debug B/each", "shows", "rewinds", "host ns/each");
+    for (bool generation : {false, true}) {
+        options.generation = generation;
+        RepeatReport r = runRepeats(options);
+        printf("%-11s %8d %13.2f %12.2f %14.1f %6d %8d %12.0f\n", generation ? "generation" : "plain",
+               r.repeats, r.busyUs / 1000.0, r.maxBusyUs / 1000.0, r.txBytes, r.shows, r.rewinds, r.hostNs);
+    }
+    return 0;
+}
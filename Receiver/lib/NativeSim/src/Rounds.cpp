@@ -0,0 +1,298 @@
+#include "Rounds.h"
+#include "Packets.h"
+
+#include <Arduino.h>
+#include <Board.h>
+#include <Frames.h>
+#include <NumericLEDs.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+static const uint64_t SECOND_US = 1000000;
+static const uint64_t UPLOAD_US = 1 * SECOND_US;
+static const uint64_t FIRST_END_US = 2 * SECOND_US;
+// A change of the lights this soon before a transition's frame was heard, or before it was due if the receiver
+// makes it by itself, is the transition shown early. One before that belongs to the transition before it, as a fade
+// or the idle state after the end's beeps does.
+static const uint64_t EARLY_WINDOW_US = 2 * SECOND_US;
+// The detail and all three lights, so a change of either shows up, but not the countdown
+static const int DETAIL_LEDS = HUNDREDS_OFFSET;
+static const int LIGHTS_LEDS = NUM_LEDS - LIGHTS_FIRST_LED;
+static const uint8_t WALK_UP_BEEPS = 2;
+static const uint8_t SHOOT_BEEPS = 1;
+static const uint8_t END_BEEPS = 3;
+
+static const char *const TRANSITION_NAMES[NUM_TRANSITIONS] = {"walk-up", "shoot", "warn", "end"};
+
+/**
+ * A change of the lights the round calls for, and the frame the controller sends for it, if any.
+ */
+struct Transition {
+    uint64_t atUs;
+    RoundTransition kind;
+    std::vector<uint8_t> packet;    // Empty if the receiver makes the change by itself
+};
+
+/**
+ * Lay the round out in time. Sending every phase, the frames are those TargetFragment sends for an end, with a
+ * warning and a second detail added; the last detail's countdown ends the end by itself. Uploaded, the schedule
+ * goes out once before the round and a start command at the start of each end.
+ */
+static std::vector<Transition> planRound(const RoundOptions &options, bool uploaded,
+                                         std::vector<uint8_t> &upload) {
+    RoundScheduleFrame schedule = {};
+    schedule.ends = (uint8_t) options.ends;
+    schedule.walkUp = (uint8_t) options.walkUp;
+    schedule.maxTime = (uint16_t) options.maxTime;
+    schedule.warnTime = (uint16_t) options.warnTime;
+    schedule.options = withRoundScheduleDetails(schedule.options, (byte) options.details);
+    schedule.options = withRoundScheduleRotate(schedule.options, options.rotate);
+    schedule.options = withRoundScheduleWalkUpBeeps(schedule.options, WALK_UP_BEEPS);
+    schedule.options = withRoundScheduleShootBeeps(schedule.options, SHOOT_BEEPS);
+    schedule.options = withRoundScheduleEndBeeps(schedule.options, END_BEEPS);
+    upload = uploaded ? encodeRoundSchedulePacket(schedule) : std::vector<uint8_t>();
+
+    const bool warns = options.warnTime > 0 && options.warnTime < options.maxTime;
+    std::vector<Transition> plan;
+    uint64_t at = FIRST_END_US;
+    for (int end = 0; end < options.ends; ++end) {
+        for (int turn = 0; turn < options.details; ++turn) {
+            const bool lastTurn = turn == options.details - 1;
+            const bool cdFirst = options.rotate && end % 2 == 1;
+            StateFields fields;
+            fields.countdown = true;
+            fields.detail = options.details == 1 || (turn == 0) != cdFirst ? 1 : 2;
+            fields.timeEnabled = true;
+
+            fields.countdownContinues = true;
+            fields.colour = 1;
+            fields.time = (int16_t) options.walkUp;
+            fields.startNumBeeps = WALK_UP_BEEPS;
+            std::vector<uint8_t> walkUp;
+            if (!uploaded) {
+                walkUp = encodeGenerationPacket((uint16_t) plan.size(), fields);
+            } else if (turn == 0) {
+                walkUp = encodeRoundControlPacket((uint8_t) end, ROUND_START, 0);
+            }
+            plan.push_back({at, TRANSITION_WALK_UP, walkUp});
+            at += options.walkUp * SECOND_US;
+
+            // The last detail's countdown finishes the end; another's is held for the next walk-up
+            fields.countdownContinues = !lastTurn;
+            fields.colour = 2;
+            fields.time = (int16_t) options.maxTime;
+            fields.startNumBeeps = SHOOT_BEEPS;
+            fields.endNumBeeps = lastTurn ? END_BEEPS : 0;
+            plan.push_back({at, TRANSITION_SHOOT,
+                            uploaded ? std::vector<uint8_t>() : encodeGenerationPacket(plan.size(), fields)});
+
+            if (warns) {
+                fields.colour = 1;
+                fields.time = (int16_t) options.warnTime;
+                plan.push_back({at + (options.maxTime - options.warnTime) * SECOND_US, TRANSITION_WARN,
+                                uploaded ? std::vector<uint8_t>() : encodeGenerationPacket(plan.size(), fields)});
+            }
+            at += options.maxTime * SECOND_US;
+        }
+        plan.push_back({at, TRANSITION_END, {}});
+        at += options.scoringUs;
+    }
+    return plan;
+}
+
+RoundReport runRound(const RoundOptions &options, bool uploaded) {
+    std::vector<uint8_t> upload;
+    const std::vector<Transition> plan = planRound(options, uploaded, upload);
+
+    // Every frame is repeated until the next one is sent, and any copy can be lost
+    struct Send {
+        uint64_t atUs;
+        const std::vector<uint8_t> *packet;
+    };
+    std::vector<Send> sends;
+    std::vector<const std::vector<uint8_t> *> frames;
+    if (uploaded) frames.push_back(&upload);
+    std::vector<uint64_t> frameUs(uploaded ? 1 : 0, UPLOAD_US);
+    for (const Transition &transition : plan) {
+        if (transition.packet.empty()) continue;
+        frames.push_back(&transition.packet);
+        frameUs.push_back(transition.atUs);
+    }
+    const uint64_t endUs = plan.back().atUs + 5 * SECOND_US;
+    for (size_t f = 0; f < frames.size(); ++f) {
+        const uint64_t until = f + 1 < frames.size() ? frameUs[f + 1] : endUs;
+        for (uint64_t at = frameUs[f]; at < until; at += options.repeatUs) {
+            sends.push_back({at, frames[f]});
+        }
+    }
+
+    RoundReport report = {};
+    report.frames = (int) frames.size();
+    for (const std::vector<uint8_t> *frame : frames) {
+        report.frameBytes += (int) frame->size();
+    }
+    report.packets = (int) sends.size();
+
+    std::mt19937 rng(options.seed);
+    std::bernoulli_distribution lost(options.loss);
+    std::vector<Send> heard;
+    for (const Send &send : sends) {
+        if (lost(rng)) {
+            report.lost++;
+        } else {
+            heard.push_back(send);
+        }
+    }
+
+    bool ok = runIsolated<RoundReport>([&]() {
+        SimBoard sim;
+        sim.setProbe(0, DETAIL_LEDS);
+        sim.addProbe(LIGHTS_FIRST_LED, LIGHTS_LEDS);
+        sim.setPin(QUIET_PIN, LOW);
+        sim.setSkipIdle(options.skipIdle);
+        sim.boot();
+
+        // When the receiver had the whole of the first copy of each frame
+        std::vector<uint64_t> heardUs(plan.size(), 0);
+        for (const Send &send : heard) {
+            const uint64_t doneUs = sim.transmit(send.atUs, send.packet->data(), send.packet->size());
+            for (size_t t = 0; t < plan.size(); ++t) {
+                if (&plan[t].packet == send.packet && !heardUs[t]) heardUs[t] = doneUs;
+            }
+        }
+        sim.runUntil([]() { return false; }, endUs);
+
+        // A transition the controller sends a frame for shows as the first change of the lights once the receiver
+        // has that frame, and one the receiver makes by itself as the first change once it is due. A change in the
+        // EARLY_WINDOW_US before that is an error: the receiver changed the lights without the frame, or ahead of
+        // time. A transition made by itself is not counted as shown by its early change.
+        RoundReport r = report;
+        r.simulatedUs = sim.now();
+        r.passes = sim.getPasses();
+        const std::vector<ShownFrame> &shown = sim.frames();
+        int64_t totalUs[NUM_TRANSITIONS] = {};
+        size_t from = 1;
+        for (size_t t = 0; t < plan.size(); ++t) {
+            const RoundTransition kind = plan[t].kind;
+            const bool byItself = plan[t].packet.empty();
+            const uint64_t nextUs = t + 1 < plan.size() ? plan[t + 1].atUs : endUs;
+            const uint64_t readyUs = byItself ? plan[t].atUs : heardUs[t];
+            r.transitions[kind]++;
+            bool early = false;
+            bool seen = false;
+            for (size_t i = from; i < shown.size() && shown[i].endUs < nextUs && !seen; ++i) {
+                if (shown[i].probe == shown[i - 1].probe) continue;
+                from = i + 1;
+                seen = readyUs && shown[i].endUs >= readyUs;
+                if (!seen && readyUs && shown[i].endUs + EARLY_WINDOW_US < readyUs) continue;
+                if (!seen) {
+                    early = true;
+                    // Made by itself, the early change was this transition's
+                    if (byItself) break;
+                    continue;
+                }
+                const int64_t latency = (int64_t) shown[i].endUs - (int64_t) plan[t].atUs;
+                totalUs[kind] += latency;
+                r.minLatencyUs[kind] = r.timed[kind] ? std::min(r.minLatencyUs[kind], latency) : latency;
+                r.maxLatencyUs[kind] = r.timed[kind] ? std::max(r.maxLatencyUs[kind], latency) : latency;
+                r.timed[kind]++;
+            }
+            if (early) r.early[kind]++;
+            if (!seen && !(early && byItself)) r.missed[kind]++;
+        }
+        for (int kind = 0; kind < NUM_TRANSITIONS; ++kind) {
+            r.meanLatencyUs[kind] = r.timed[kind] ? (double) totalUs[kind] / r.timed[kind] : 0;
+        }
+        return r;
+    }, report);
+
+    if (!ok) fprintf(stderr, "Simulated receiver crashed\n");
+    return report;
+}
+
+int roundMain(int argc, char **argv) {
+    RoundOptions options;
+
+    for (int i = 0; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--ends")) {
+            options.ends = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--details")) {
+            options.details = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--rotate")) {
+            options.rotate = atoi(argv[i + 1]) != 0;
+        } else if (!strcmp(argv[i], "--walk-up")) {
+            options.walkUp = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--max-time")) {
+            options.maxTime = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--warn-time")) {
+            options.warnTime = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--scoring")) {
+            options.scoringUs = (uint64_t) (atof(argv[i + 1]) * SECOND_US);
+        } else if (!strcmp(argv[i], "--repeat")) {
+            options.repeatUs = (uint64_t) (atof(argv[i + 1]) * 1000);
+        } else if (!strcmp(argv[i], "--loss")) {
+            options.loss = atof(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--skip-idle")) {
+            options.skipIdle = atoi(argv[i + 1]) != 0;
+        } else if (!strcmp(argv[i], "--seed")) {
+            options.seed = (uint32_t) strtoul(argv[i + 1], nullptr, 10);
+        } else {
+            argc = -1;
+        }
+    }
+    if (argc < 0 || argc % 2 || options.ends < 1 || options.ends > 255 || options.details < 1 ||
+        options.details > 2 || options.walkUp < 1 || options.walkUp > 255 || options.maxTime < 1 ||
+        options.warnTime < 0 || options.repeatUs == 0 || options.loss < 0 || options.loss >= 1) {
+        fprintf(stderr,
+                "usage: program round [options]\n"
+                "  --ends N         Ends in the round (default 2)\n"
+                "  --details N      1 for A/B alone, 2 for A/B and C/D in turn (default 2)\n"
+                "  --rotate 0|1     C/D shoots first in every other end (default 1)\n"
+                "  --walk-up S      Seconds of amber before each detail shoots (default 10)\n"
+                "  --max-time S     Seconds each detail has to shoot (default 120)\n"
+                "  --warn-time S    Seconds left when the light turns amber, 0 for none (default 30)\n"
+                "  --scoring S      Between the end of one end and the start of the next (default 20)\n"
+                "  --repeat MS      How often the controller repeats the frame last sent (default 250)\n"
+                "  --loss P         Chance of the radio losing each packet, 0 to 1 (default 0)\n"
+                "  --skip-idle 0|1  Jump the clock over idle time, rather than stepping through it (default 1)\n"
+                "  --seed N\n");
+        return 2;
+    }
+
+    printf("%d ends, %d detail%s, %d s walk-up, %d s to shoot with a warning at %d s, %.0f%% of packets lost\n\n",
+           options.ends, options.details, options.details == 1 ? "" : "s", options.walkUp, options.maxTime,
+           options.warnTime, options.loss * 100);
+    printf("%-11s %7s %7s %8s %5s   %-8s %11s %7s %6s %8s %8s %8s\n", "controller", "frames", "bytes", "packets",
+           "lost", "change", "transitions", "missed", "early", "mean ms", "min ms", "max ms");
+    int errors = 0;
+    for (bool uploaded : {false, true}) {
+        const RoundReport r = runRound(options, uploaded);
+        for (int kind = 0; kind < NUM_TRANSITIONS; ++kind) {
+            if (!r.transitions[kind]) continue;
+            if (kind == 0) {
+                printf("%-11s %7d %7d %8d %5d   ", uploaded ? "uploads" : "each phase", r.frames, r.frameBytes,
+                       r.packets, r.lost);
+            } else {
+                printf("%-11s %7s %7s %8s %5s   ", "", "", "", "", "");
+            }
+            printf("%-8s %11d %7d %6d ", TRANSITION_NAMES[kind], r.transitions[kind], r.missed[kind], r.early[kind]);
+            if (r.timed[kind]) {
+                printf("%8.1f %8.1f %8.1f\n", r.meanLatencyUs[kind] / 1000.0, r.minLatencyUs[kind] / 1000.0,
+                       r.maxLatencyUs[kind] / 1000.0);
+            } else {
+                printf("%8s %8s %8s\n", "-", "-", "-");
+            }
+            // Sending every phase changes the lights early by design (see the README); only the receiver's own
+            // running of an uploaded round is held to it
+            if (uploaded) errors += r.early[kind];
+        }
+        fflush(stdout);
+    }
+    if (errors) printf("\n%d transition%s of the uploaded round changed the lights early\n", errors,
+                       errors == 1 ? "" : "s");
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,473 @@
+#include "Arduino.h"
+#include "SimBoard.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static SimBoard *currentBoard = nullptr;
+
+SimBoard &board() {
+    return *currentBoard;
+}
+
+void setBoard(SimBoard *b) {
+    currentBoard = b;
+}
+
+SimBoard::SimBoard() {
+    nowUs = 0;
+    baud = 9600;
+    skipIdle = false;
+    wakeUs = 0;
+    wakeSet = false;
+    activity = 0;
+    idlePasses = 0;
+    passes = 0;
+    jumps = 0;
+    skippedUs = 0;
+    lineFreeUs = 0;
+    rxShift = -1;
+    rxOverflows = 0;
+    rxOverruns = 0;
+    rxIsr = nullptr;
+    interruptsOn = true;
+    interruptsOffUs = 0;
+    blackoutUs = 0;
+    longestBlackoutUs = 0;
+    txDoneUs = 0;
+    noise = 1;
+    lastHash = 0;
+    memset(eeprom, 0xFF, sizeof(eeprom));
+    memset(eepromCellWrites, 0, sizeof(eepromCellWrites));
+    eepromWrites = 0;
+    for (int i = 0; i < NUM_PINS; ++i) {
+        // Unconnected inputs read as pulled up, which matches every switch being open
+        pinLevels[i] = 1;
+        pinModes[i] = 0;
+        analogLevels[i] = 0;
+    }
+}
+
+void SimBoard::boot() {
+    setBoard(this);
+    setup();
+}
+
+//region clock
+uint64_t SimBoard::now() const {
+    return nowUs;
+}
+
+void SimBoard::advance(uint64_t us) {
+    nowUs += us;
+    if (peer) peer(nowUs);
+    deliverRx();
+}
+
+void SimBoard::step() {
+    const unsigned long before = activity;
+    wakeSet = false;
+    loop();
+    advance(cost.loopUs);
+    passes++;
+    idlePasses = activity == before ? idlePasses + 1 : 0;
+}
+
+void SimBoard::runUntil(const std::function<bool()> &done, uint64_t maxUs) {
+    while (nowUs < maxUs && !done()) {
+        step();
+        // A pass that did nothing can still have changed what the next one does, e.g. a handler that ran finding
+        // nothing to show and not yet saying when it is next due, so it takes a second idle pass to be sure
+        if (skipIdle && idlePasses >= 2) skipIdleTime(maxUs);
+    }
+}
+
+void SimBoard::setSkipIdle(bool enabled) {
+    skipIdle = enabled;
+}
+
+void SimBoard::wakeBy(uint64_t us) {
+    if (!wakeSet || us < wakeUs) wakeUs = us;
+    wakeSet = true;
+}
+
+void SimBoard::skipIdleTime(uint64_t limitUs) {
+    uint64_t to = limitUs;
+    if (!incoming.empty()) to = std::min(to, incoming.front().first);
+    if (wakeSet) to = std::min(to, wakeUs);
+    if (to <= nowUs) return;
+
+    jumps++;
+    skippedUs += to - nowUs;
+    advance(to - nowUs);
+    // What woke it is due now, and only the passes from here on say when it is next due
+    idlePasses = 0;
+}
+
+unsigned long SimBoard::getPasses() const {
+    return passes;
+}
+
+unsigned long SimBoard::getJumps() const {
+    return jumps;
+}
+
+uint64_t SimBoard::getSkippedUs() const {
+    return skippedUs;
+}
+
+void SimBoard::setInterrupts(bool enabled) {
+    if (enabled == interruptsOn) return;
+    interruptsOn = enabled;
+    if (!enabled) {
+        interruptsOffUs = nowUs;
+        return;
+    }
+
+    uint64_t blackout = nowUs - interruptsOffUs;
+    blackoutUs += blackout;
+    if (blackout > longestBlackoutUs) longestBlackoutUs = blackout;
+
+    // The pending RX interrupts run as soon as they are re-enabled
+    while (!rxFifo.empty()) {
+        pushRing(rxFifo.front());
+        rxFifo.pop_front();
+    }
+    if (rxShift >= 0) {
+        pushRing(rxShift);
+        rxShift = -1;
+    }
+}
+
+bool SimBoard::interruptsEnabled() const {
+    return interruptsOn;
+}
+
+uint64_t SimBoard::getBlackoutUs() const {
+    return blackoutUs;
+}
+
+uint64_t SimBoard::getLongestBlackoutUs() const {
+    return longestBlackoutUs;
+}
+//endregion
+
+//region serial
+unsigned long SimBoard::getBaud() const {
+    return baud;
+}
+
+void SimBoard::setBaud(unsigned long rate) {
+    baud = rate;
+}
+
+uint32_t SimBoard::byteTimeUs() const {
+    // 8N1: start bit, 8 data bits, stop bit
+    return (uint32_t) ((10 * 1000000UL + baud - 1) / baud);
+}
+
+uint64_t SimBoard::transmit(uint64_t atUs, const uint8_t *bytes, size_t count) {
+    uint64_t at = atUs > lineFreeUs ? atUs : lineFreeUs;
+    for (size_t i = 0; i < count; ++i) {
+        at += byteTimeUs();
+        incoming.emplace_back(at, bytes[i]);
+    }
+    lineFreeUs = at;
+    return at;
+}
+
+void SimBoard::setPeer(const std::function<void(uint64_t)> &far) {
+    peer = far;
+}
+
+size_t SimBoard::pendingRx() const {
+    return incoming.size() + rxFifo.size() + (rxShift >= 0 ? 1 : 0) + rxRing.size();
+}
+
+unsigned long SimBoard::getRxOverflows() const {
+    return rxOverflows;
+}
+
+unsigned long SimBoard::getRxOverruns() const {
+    return rxOverruns;
+}
+
+void SimBoard::pushRing(uint8_t b) {
+    if (rxIsr) {
+        // It runs there and then; bytes arriving meanwhile wait in the USART until the next deliverRx()
+        nowUs += cost.rxIsrUs;
+        activity++;
+        rxIsr(b);
+        return;
+    }
+
+    // The RX ISR drops the new byte when the ring is full
+    if (rxRing.size() < SERIAL_BUFFER_SIZE - 1) {
+        rxRing.push_back(b);
+    } else {
+        rxOverflows++;
+    }
+}
+
+void SimBoard::deliverRx() {
+    while (!incoming.empty() && incoming.front().first <= nowUs) {
+        uint8_t b = incoming.front().second;
+        incoming.pop_front();
+        if (interruptsOn) {
+            pushRing(b);
+        } else if (rxFifo.size() < UART_FIFO_SIZE) {
+            rxFifo.push_back(b);
+        } else {
+            // A byte already waiting in the shift register is overwritten by the next one (DOR0)
+            if (rxShift >= 0) rxOverruns++;
+            rxShift = b;
+        }
+    }
+}
+
+void SimBoard::setRxInterrupt(void (*isr)(uint8_t)) {
+    rxIsr = isr;
+}
+
+int SimBoard::rxAvailable() {
+    deliverRx();
+    return (int) rxRing.size();
+}
+
+int SimBoard::rxPeek() {
+    deliverRx();
+    return rxRing.empty() ? -1 : rxRing.front();
+}
+
+int SimBoard::rxRead() {
+    advance(cost.readByteUs);
+    if (rxRing.empty()) return -1;
+    activity++;
+    int b = rxRing.front();
+    rxRing.pop_front();
+    return b;
+}
+
+void SimBoard::txWrite(uint8_t b) {
+    // Serial.write() blocks while the TX ring is full, i.e. while more than a ring's worth is still to go out
+    uint64_t byteUs = byteTimeUs();
+    uint64_t ringUs = (SERIAL_BUFFER_SIZE - 1) * byteUs;
+    if (txDoneUs > nowUs + ringUs) {
+        advance(txDoneUs - nowUs - ringUs);
+    }
+    advance(cost.writeByteUs);
+    activity++;
+    txDoneUs = (txDoneUs > nowUs ? txDoneUs : nowUs) + byteUs;
+    txBytes.push_back({txDoneUs, b});
+
+    if (b == '\n') {
+        if (!txLine.empty() && txLine.back() == '\r') txLine.pop_back();
+        txLines.push_back({nowUs, txLine});
+        txLine.clear();
+    } else {
+        txLine.push_back((char) b);
+    }
+}
+
+bool SimBoard::txIdle() const {
+    return txDoneUs <= nowUs;
+}
+
+int SimBoard::txFree() const {
+    // Everything still to go out is in the ring, bar the byte in the shift register
+    uint64_t byteUs = byteTimeUs();
+    uint64_t pending = txDoneUs > nowUs ? (txDoneUs - nowUs + byteUs - 1) / byteUs : 0;
+    uint64_t queued = pending > 1 ? pending - 1 : 0;
+    if (queued > SERIAL_BUFFER_SIZE - 1) queued = SERIAL_BUFFER_SIZE - 1;
+    return (int) (SERIAL_BUFFER_SIZE - 1 - queued);
+}
+
+const std::vector<SerialLine> &SimBoard::lines() const {
+    return txLines;
+}
+
+const std::vector<TxByte> &SimBoard::txHistory() const {
+    return txBytes;
+}
+//endregion
+
+void SimBoard::mark(uint8_t id) {
+    markers.push_back({nowUs, id});
+}
+
+const std::vector<BenchMarker> &SimBoard::benchMarkers() const {
+    return markers;
+}
+
+//region pins
+void SimBoard::setPin(uint8_t pin, int level) {
+    if (pin < NUM_PINS) pinLevels[pin] = level;
+}
+
+void SimBoard::setPinMode(uint8_t pin, int mode) {
+    if (pin < NUM_PINS) pinModes[pin] = mode;
+}
+
+int SimBoard::readPin(uint8_t pin) const {
+    return pin < NUM_PINS ? pinLevels[pin] : 0;
+}
+
+void SimBoard::writePin(uint8_t pin, int level) {
+    if (pin >= NUM_PINS) return;
+    if (pinLevels[pin] != level) activity++;
+    pinLevels[pin] = level;
+}
+
+void SimBoard::writeAnalog(uint8_t pin, int level) {
+    if (pin >= NUM_PINS) return;
+    if (analogLevels[pin] != level) {
+        analogChanges.push_back({nowUs, pin, level});
+        activity++;
+    }
+    analogLevels[pin] = level;
+}
+
+int SimBoard::readAnalog(uint8_t pin) const {
+    return pin < NUM_PINS ? analogLevels[pin] : 0;
+}
+
+int SimBoard::readAnalogInput(uint8_t) {
+    // xorshift32, settling around mid-scale
+    noise ^= noise << 13;
+    noise ^= noise >> 17;
+    noise ^= noise << 5;
+    return 508 + (int) (noise % 8);
+}
+
+void SimBoard::setNoiseSeed(uint32_t seed) {
+    // Mixed first, as xorshift from neighbouring seeds gives the same low bits for a while, and receivers numbered
+    // one apart would pick the same report slots
+    seed ^= seed >> 16;
+    seed *= 0x85EBCA6Bu;
+    seed ^= seed >> 13;
+    seed *= 0xC2B2AE35u;
+    seed ^= seed >> 16;
+    noise = seed ? seed : 1;
+}
+
+const std::vector<AnalogChange> &SimBoard::analogHistory() const {
+    return analogChanges;
+}
+//endregion
+
+//region leds
+void SimBoard::show(const uint8_t *grb, size_t first, size_t numLeds) {
+    if (display.size() < (first + numLeds) * 3) display.resize((first + numLeds) * 3);
+    std::copy(grb, grb + numLeds * 3, display.begin() + first * 3);
+
+    uint32_t hash = 2166136261u;
+    uint32_t probe = 2166136261u;
+    for (size_t i = 0; i < display.size(); ++i) {
+        hash = (hash ^ display[i]) * 16777619u;
+    }
+    for (const std::pair<size_t, size_t> &run : probes) {
+        for (size_t i = run.first * 3; i < (run.first + run.second) * 3 && i < display.size(); ++i) {
+            probe = (probe ^ display[i]) * 16777619u;
+        }
+    }
+
+    // The WS2812 bits are bit-banged with interrupts off; they come back on for the latch gap
+    activity++;
+    uint64_t start = nowUs;
+    setInterrupts(false);
+    advance(numLeds * cost.ledUs);
+    setInterrupts(true);
+    advance(cost.latchUs);
+    shownFrames.push_back({start, nowUs, hash, shownFrames.empty() || hash != lastHash, probe, numLeds});
+    lastHash = hash;
+}
+
+const std::vector<ShownFrame> &SimBoard::frames() const {
+    return shownFrames;
+}
+
+void SimBoard::setProbe(size_t first, size_t count) {
+    probes.assign(1, {first, count});
+}
+
+void SimBoard::addProbe(size_t first, size_t count) {
+    probes.emplace_back(first, count);
+}
+//endregion
+
+//region eeprom
+uint8_t SimBoard::eepromRead(int idx) const {
+    return idx >= 0 && idx < EEPROM_SIZE ? eeprom[idx] : 0xFF;
+}
+
+void SimBoard::eepromWrite(int idx, uint8_t val) {
+    if (idx < 0 || idx >= EEPROM_SIZE) return;
+    advance(cost.eepromWriteUs);
+    activity++;
+    eeprom[idx] = val;
+    eepromCellWrites[idx]++;
+    eepromWrites++;
+}
+
+unsigned long SimBoard::getEepromWrites() const {
+    return eepromWrites;
+}
+
+unsigned int SimBoard::getEepromWrites(int idx) const {
+    return idx >= 0 && idx < EEPROM_SIZE ? eepromCellWrites[idx] : 0;
+}
+
+void SimBoard::saveEeprom(uint8_t out[EEPROM_SIZE]) const {
+    memcpy(out, eeprom, EEPROM_SIZE);
+}
+
+void SimBoard::loadEeprom(const uint8_t in[EEPROM_SIZE]) {
+    memcpy(eeprom, in, EEPROM_SIZE);
+}
+//endregion
+
+bool runIsolated(const std::function<void(void *)> &scenario, void *result, size_t size) {
+    IsolatedRun run;
+    return startIsolated(scenario, size, run) && finishIsolated(run, result, size);
+}
+
+bool startIsolated(const std::function<void(void *)> &scenario, size_t size, IsolatedRun &run) {
+    int fds[2];
+    if (pipe(fds) != 0) return false;
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+
+    if (pid == 0) {
+        close(fds[0]);
+        std::vector<uint8_t> out(size);
+        scenario(out.data());
+        ssize_t written = write(fds[1], out.data(), size);
+        _exit(written == (ssize_t) size ? 0 : 1);
+    }
+
+    close(fds[1]);
+    run.pid = pid;
+    run.fd = fds[0];
+    return true;
+}
+
+bool finishIsolated(const IsolatedRun &run, void *result, size_t size) {
+    size_t got = 0;
+    while (got < size) {
+        ssize_t n = read(run.fd, (uint8_t *) result + got, size - got);
+        if (n <= 0) break;
+        got += n;
+    }
+    close(run.fd);
+
+    int status = 0;
+    waitpid(run.pid, &status, 0);
+    return got == size && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
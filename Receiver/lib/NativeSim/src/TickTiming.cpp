@@ -0,0 +1,168 @@
+#include "TickTiming.h"
+#include "FlowControl.h"
+#include "Packets.h"
+
+#include <Animation.h>
+#include <Board.h>
+#include <State.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+extern State state;
+extern unsigned long startTime;
+extern bool tickAhead;
+
+static const uint64_t SECOND_US = 1000000;
+static const uint64_t SETTLE_US = 100000;       // After boot, before the state is sent
+static const uint64_t TAIL_US = 2 * SECOND_US;  // After the tick to 0, for the beeps to start
+
+/**
+ * The state, then its repeats until the countdown is over.
+ */
+static std::vector<PlannedSend> planTicks(const TickOptions &options) {
+    StateFields fields;
+    fields.countdown = true;
+    fields.detail = 1;
+    fields.colour = 2;
+    fields.timeEnabled = true;
+    fields.time = (int16_t) options.time;
+    fields.endNumBeeps = 3;
+
+    PlannedSend send;
+    send.bytes = encodeGenerationPacket(1, fields);
+    send.garbageBytes = 0;
+    send.tag = options.time;
+    send.kind = KIND_TIME;
+
+    std::vector<PlannedSend> sends;
+    const uint64_t untilUs = (options.time + 1) * SECOND_US;
+    for (send.startUs = 0; send.startUs < untilUs; send.startUs += options.repeatUs) {
+        sends.push_back(send);
+        if (!options.repeatUs) break;
+    }
+    return sends;
+}
+
+static int64_t percentile(const std::vector<int64_t> &sorted, int percent) {
+    return sorted[(sorted.size() - 1) * percent / 100];
+}
+
+TickReport runTicks(const TickOptions &options, bool ahead, bool splitChains) {
+    const std::vector<PlannedSend> sends = planTicks(options);
+    TickReport report = {};
+
+    bool ok = runIsolated<TickReport>([&]() {
+        SimBoard sim;
+        if (splitChains) sim.setPin(SPLIT_CHAINS_PIN, LOW);
+        sim.setPin(QUIET_PIN, LOW);
+        sim.setProbe(HUNDREDS_OFFSET, NUMBER_LEDS);
+        tickAhead = ahead;
+        sim.boot();
+        sim.runUntil([]() { return false; }, SETTLE_US);
+
+        // The controller holds off as the app does, so that the repeats are not lost to the shows
+        FlowController controller(sim, sends, sim.now(), options.reactionUs, true);
+        sim.setPeer([&](uint64_t nowUs) { controller(nowUs); });
+        sim.runUntil([]() { return state.countdown; }, SETTLE_US + 10 * SECOND_US);
+        const size_t firstFrame = sim.frames().size();
+        // Every tick falls due on a whole second from here. The countdown shows one less than the time sent at once,
+        // so tick k shows time - 1 - k, and the tick to 0 is the one after the tick to 1.
+        const uint64_t anchorUs = (uint64_t) startTime * 1000;
+        const uint64_t zeroUs = anchorUs + (options.time - 1) * SECOND_US;
+        sim.runUntil([]() { return false; }, zeroUs + TAIL_US);
+        sim.setPeer(nullptr);
+
+        TickReport r = {};
+        std::vector<int64_t> latencies;
+        const std::vector<ShownFrame> &frames = sim.frames();
+        for (size_t i = firstFrame; i < frames.size(); ++i) {
+            const int tick = (int) latencies.size() + 1;
+            if (options.time - 1 - tick < FINAL_SECONDS) break;
+            if (i == 0 || frames[i].probe == frames[i - 1].probe) continue;
+            latencies.push_back((int64_t) frames[i].endUs - (int64_t) (anchorUs + tick * SECOND_US));
+        }
+        for (const ShownFrame &frame : frames) {
+            if (frame.endUs <= zeroUs) continue;
+            r.blankUs = (int64_t) frame.endUs - (int64_t) zeroUs;
+            break;
+        }
+        for (const AnalogChange &change : sim.analogHistory()) {
+            if (change.pin != BUZZER_PIN || !change.level || change.us < zeroUs) continue;
+            r.beepUs = (int64_t) change.us - (int64_t) zeroUs;
+            break;
+        }
+
+        r.ticks = (int) latencies.size();
+        if (!latencies.empty()) {
+            r.lastUs = latencies.back();
+            std::sort(latencies.begin(), latencies.end());
+            r.minUs = latencies.front();
+            r.p5Us = percentile(latencies, 5);
+            r.p50Us = percentile(latencies, 50);
+            r.p95Us = percentile(latencies, 95);
+            r.maxUs = latencies.back();
+        }
+        return r;
+    }, report);
+
+    if (!ok) fprintf(stderr, "Simulated receiver crashed\n");
+    return report;
+}
+
+int ticksMain(int argc, char **argv) {
+    TickOptions options;
+    bool single = true;
+    bool split = true;
+
+    for (int i = 0; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--time")) {
+            options.time = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--repeat")) {
+            options.repeatUs = (uint64_t) (atof(argv[i + 1]) * 1000);
+        } else if (!strcmp(argv[i], "--reaction")) {
+            options.reactionUs = (uint64_t) (atof(argv[i + 1]) * 1000);
+        } else if (!strcmp(argv[i], "--layout")) {
+            single = !strcmp(argv[i + 1], "single");
+            split = !strcmp(argv[i + 1], "split");
+            if (!single && !split) argc = -1;
+        } else {
+            argc = -1;
+        }
+    }
+    if (argc < 0 || argc % 2 || options.time <= FINAL_SECONDS + 1 || options.time > 999) {
+        fprintf(stderr,
+                "usage: program ticks [options]\n"
+                "  --time S          Seconds the countdown starts from, over %d (default 30)\n"
+                "  --repeat MS       How often the controller repeats the state, 0 to send it once (default 250)\n"
+                "  --reaction MS     From a flow byte on the wire to the controller acting on it (default 5)\n"
+                "  --layout X        Only one LED chain (single) or a chain per region (split); both by default\n",
+                FINAL_SECONDS + 1);
+        return 2;
+    }
+
+    printf("tick to photon, ms, from each tick's whole second to the end of its show\n\n");
+    printf("%-6s %-11s %5s %7s %7s %7s %7s %7s %7s %7s %9s %7s\n", "chains", "tick", "ticks", "min", "p5", "p50",
+           "p95", "max", "jitter", "last", "blank @0", "beep @0");
+    bool better = true;
+    for (int layout = 0; layout < 2; ++layout) {
+        const bool splitChains = layout == 1;
+        if (splitChains ? !split : !single) continue;
+
+        TickReport reports[2];
+        for (int ahead = 0; ahead < 2; ++ahead) {
+            const TickReport &r = reports[ahead] = runTicks(options, ahead, splitChains);
+            printf("%-6s %-11s %5d %7.2f %7.2f %7.2f %7.2f %7.2f %7.2f %7.2f %9.2f %7.2f\n",
+                   splitChains ? "split" : "single", ahead ? "drawn ahead" : "end of loop", r.ticks, r.minUs / 1000.0,
+                   r.p5Us / 1000.0, r.p50Us / 1000.0, r.p95Us / 1000.0, r.maxUs / 1000.0,
+                   (r.maxUs - r.minUs) / 1000.0, r.lastUs / 1000.0, r.blankUs / 1000.0, r.beepUs / 1000.0);
+            fflush(stdout);
+        }
+        if (reports[1].maxUs - reports[1].minUs > reports[0].maxUs - reports[0].minUs) better = false;
+    }
+    printf("\nJitter %s drawing ticks ahead\n", better ? "no worse" : "WORSE");
+    return better ? 0 : 1;
+}
@@ -0,0 +1,211 @@
+#include "UartScenarios.h"
+#include "Packets.h"
+
+#include <Board.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static const uint64_t SECOND_US = 1000000;
+// How long to keep running after the traffic stops, so the receiver can finish what it has buffered
+static const uint64_t TAIL_US = 2 * SECOND_US;
+// Grounded on a receiver wired as a chain per region
+
+static PlannedSend stateSend(uint64_t atUs, const StateFields &fields) {
+    PlannedSend send;
+    send.startUs = atUs;
+    send.bytes = encodeStatePacket(fields);
+    send.garbageBytes = 0;
+    send.tag = fields.time;
+    send.kind = KIND_TIME;
+    return send;
+}
+
+/**
+ * The controller repeating an unchanged idle state twice a second. Nothing is redrawn after the first packet.
+ */
+static std::vector<PlannedSend> idleRepeatTraffic(uint64_t durationUs) {
+    StateFields fields;
+    fields.detail = 1;
+    fields.timeEnabled = true;
+    fields.time = 240;
+
+    std::vector<PlannedSend> sends;
+    for (uint64_t at = 0; at < durationUs; at += SECOND_US / 2) {
+        sends.push_back(stateSend(at, fields));
+    }
+    return sends;
+}
+
+/**
+ * A new time four times a second, so every packet is followed by a redraw.
+ */
+static std::vector<PlannedSend> timeUpdateTraffic(uint64_t durationUs) {
+    StateFields fields;
+    fields.timeEnabled = true;
+
+    std::vector<PlannedSend> sends;
+    for (uint64_t at = 0; at < durationUs; at += SECOND_US / 4) {
+        fields.time = (int16_t) (fields.time % 999 + 1);
+        sends.push_back(stateSend(at, fields));
+    }
+    return sends;
+}
+
+/**
+ * A 240 second end counting down on the receiver, with the controller repeating its view of the state twice a
+ * second. The receiver's own once-a-second redraws land at arbitrary points in the repeats.
+ */
+static std::vector<PlannedSend> countdownTraffic(uint64_t durationUs) {
+    StateFields fields;
+    fields.countdown = true;
+    fields.detail = 1;
+    fields.colour = 2;
+    fields.timeEnabled = true;
+
+    std::vector<PlannedSend> sends;
+    for (uint64_t at = 0; at < durationUs; at += SECOND_US / 2) {
+        fields.time = (int16_t) (240 - at / SECOND_US);
+        sends.push_back(stateSend(at, fields));
+    }
+    return sends;
+}
+
+/**
+ * Every 10 seconds, an end transition sent as four back-to-back frames: colour, detail, time, then beeps.
+ * Each frame's redraw runs while the next frame is arriving.
+ */
+static std::vector<PlannedSend> endTransitionTraffic(uint64_t durationUs) {
+    StateFields fields;
+    fields.timeEnabled = true;
+
+    std::vector<PlannedSend> sends;
+    int16_t time = 0;
+    for (uint64_t at = 0; at < durationUs; at += 10 * SECOND_US) {
+        for (int step = 0; step < 4; ++step) {
+            fields.time = ++time;
+            if (step == 0) fields.colour = (fields.colour + 1) % 3;
+            if (step == 1) fields.detail = (fields.detail + 1) % 3;
+            if (step == 3) fields.endNumBeeps = (int16_t) (fields.endNumBeeps ^ 3);
+            sends.push_back(stateSend(at, fields));
+        }
+    }
+    return sends;
+}
+
+/**
+ * Frames back-to-back for the whole run, each with a new time.
+ */
+static std::vector<PlannedSend> floodTraffic(uint64_t durationUs) {
+    StateFields fields;
+    fields.timeEnabled = true;
+
+    std::vector<PlannedSend> sends;
+    const uint64_t frameUs = (PACKET_OVERHEAD + 8) * 10 * SECOND_US / 9600;
+    for (uint64_t at = 0; at < durationUs; at += frameUs) {
+        fields.time = (int16_t) (fields.time % 999 + 1);
+        sends.push_back(stateSend(0, fields));
+    }
+    return sends;
+}
+
+const UartScenario UART_SCENARIOS[] = {
+        {"idle-repeat",    "Unchanged state repeated at 2 Hz",                  idleRepeatTraffic},
+        {"time-updates",   "New time at 4 Hz, a redraw per packet",             timeUpdateTraffic},
+        {"countdown",      "Countdown running, state repeated at 2 Hz",         countdownTraffic},
+        {"end-transition", "Four back-to-back frames every 10 s",               endTransitionTraffic},
+        {"flood",          "Back-to-back frames for the whole run",             floodTraffic},
+};
+const int NUM_UART_SCENARIOS = sizeof(UART_SCENARIOS) / sizeof(UART_SCENARIOS[0]);
+
+UartReport runUartScenario(const UartScenario &scenario, uint64_t durationUs, bool splitChains) {
+    std::vector<PlannedSend> sends = scenario.traffic(durationUs);
+    UartReport report = {};
+
+    bool ok = runIsolated<UartReport>([&]() {
+        SimBoard sim;
+        if (splitChains) sim.setPin(SPLIT_CHAINS_PIN, LOW);
+        sim.boot();
+        sim.runUntil([]() { return false; }, 100000);
+
+        // Only count what happens once the traffic starts
+        const uint64_t start = sim.now();
+        const uint64_t blackoutBefore = sim.getBlackoutUs();
+        const size_t showsBefore = sim.frames().size();
+
+        UartReport r = {};
+        for (const PlannedSend &send : sends) {
+            sim.transmit(start + send.startUs, send.bytes.data(), send.bytes.size());
+            r.bytes += (long) send.bytes.size();
+        }
+        const uint64_t quiet = start + durationUs + TAIL_US;
+        sim.runUntil([&]() { return sim.now() >= quiet && sim.pendingRx() == 0; }, quiet + 60 * SECOND_US);
+
+        r.sent = (int) sends.size();
+        for (uint64_t handled : findAcks(sends, sim.lines(), start)) {
+            if (handled) r.delivered++;
+        }
+        r.rxOverflows = sim.getRxOverflows();
+        r.rxOverruns = sim.getRxOverruns();
+        r.shows = (int) (sim.frames().size() - showsBefore);
+        for (size_t i = showsBefore; i < sim.frames().size(); ++i) {
+            r.ledsShown += (long) sim.frames()[i].leds;
+        }
+        r.blackoutUs = sim.getBlackoutUs() - blackoutBefore;
+        r.longestBlackoutUs = sim.getLongestBlackoutUs();
+        return r;
+    }, report);
+
+    if (!ok) fprintf(stderr, "Simulated receiver crashed in scenario %s\n", scenario.name);
+    return report;
+}
+
+int uartMain(int argc, char **argv) {
+    uint64_t durationUs = 60 * SECOND_US;
+    const char *only = nullptr;
+    bool single = true;
+    bool split = true;
+
+    for (int i = 0; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--duration")) {
+            durationUs = (uint64_t) (atof(argv[i + 1]) * SECOND_US);
+        } else if (!strcmp(argv[i], "--scenario")) {
+            only = argv[i + 1];
+        } else if (!strcmp(argv[i], "--layout")) {
+            single = !strcmp(argv[i + 1], "single");
+            split = !strcmp(argv[i + 1], "split");
+            if (!single && !split) argc = -1;
+        } else {
+            argc = -1;
+        }
+    }
+    if (argc < 0 || argc % 2) {
+        fprintf(stderr,
+                "usage: program uart [options]\n"
+                "  --duration S      Seconds of traffic per scenario (default 60)\n"
+                "  --scenario NAME   Run only this scenario\n"
+                "  --layout X        Only one LED chain (single) or a chain per region (split); both by default\n");
+        return 2;
+    }
+
+    printf("%-15s %-6s %6s %9s %7s %8s %8s %6s %9s %12s %9s\n", "scenario", "chains", "sent", "delivered", "bytes",
+           "overflow", "overrun", "shows", "LEDs/show", "blackout ms", "max ms");
+    for (int i = 0; i < NUM_UART_SCENARIOS; ++i) {
+        const UartScenario &scenario = UART_SCENARIOS[i];
+        if (only && strcmp(only, scenario.name) != 0) continue;
+
+        for (int layout = 0; layout < 2; ++layout) {
+            const bool splitChains = layout == 1;
+            if (splitChains ? !split : !single) continue;
+
+            UartReport r = runUartScenario(scenario, durationUs, splitChains);
+            printf("%-15s %-6s %6d %9d %7ld %8lu %8lu %6d %9.0f %12.1f %9.2f\n",
+                   scenario.name, splitChains ? "split" : "single", r.sent, r.delivered, r.bytes, r.rxOverflows,
+                   r.rxOverruns, r.shows, r.shows ? (double) r.ledsShown / r.shows : 0.0, r.blackoutUs / 1000.0,
+                   r.longestBlackoutUs / 1000.0);
+            fflush(stdout);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,151 @@
+#include "VirtualClock.h"
+#include "Packets.h"
+
+#include <Arduino.h>
+#include <Board.h>
+#include <Frames.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+static const uint64_t SECOND_US = 1000000;
+static const uint64_t UPLOAD_US = 1 * SECOND_US;
+static const uint64_t FIRST_END_US = 2 * SECOND_US;
+static const uint64_t TAIL_US = 10 * SECOND_US;
+
+void runVirtualClock(const VirtualClockOptions &options, bool skipIdle, VirtualClockRun &run) {
+    RoundScheduleFrame schedule = {};
+    schedule.ends = (uint8_t) options.ends;
+    schedule.walkUp = (uint8_t) options.walkUp;
+    schedule.maxTime = (uint16_t) options.maxTime;
+    schedule.warnTime = (uint16_t) options.warnTime;
+    schedule.options = withRoundScheduleDetails(schedule.options, (byte) options.details);
+    schedule.options = withRoundScheduleRotate(schedule.options, true);
+    schedule.options = withRoundScheduleWalkUpBeeps(schedule.options, 2);
+    schedule.options = withRoundScheduleShootBeeps(schedule.options, 1);
+    schedule.options = withRoundScheduleEndBeeps(schedule.options, 3);
+
+    const uint64_t endLengthUs = options.details * (options.walkUp + options.maxTime) * SECOND_US;
+    const uint64_t endUs = FIRST_END_US + options.ends * (endLengthUs + options.scoringUs) + TAIL_US;
+
+    const auto started = std::chrono::steady_clock::now();
+    bool ok = runIsolated([&](void *out) {
+        VirtualClockRun &r = *(VirtualClockRun *) out;
+        SimBoard sim;
+        sim.setPin(QUIET_PIN, LOW);
+        sim.setSkipIdle(skipIdle);
+        sim.boot();
+
+        const std::vector<uint8_t> upload = encodeRoundSchedulePacket(schedule);
+        sim.transmit(UPLOAD_US, upload.data(), upload.size());
+        for (int end = 0; end < options.ends; ++end) {
+            const uint64_t startUs = FIRST_END_US + end * (endLengthUs + options.scoringUs);
+            const std::vector<uint8_t> start = encodeRoundControlPacket((uint8_t) end, ROUND_START, 0);
+            const uint64_t untilUs = options.repeatUs ? startUs + endLengthUs : startUs + 1;
+            for (uint64_t at = startUs; at < untilUs; at += options.repeatUs ? options.repeatUs : 1) {
+                sim.transmit(at, start.data(), start.size());
+            }
+        }
+        sim.runUntil([]() { return false; }, endUs);
+
+        r.simulatedUs = sim.now();
+        r.passes = sim.getPasses();
+        r.jumps = sim.getJumps();
+        r.skippedUs = sim.getSkippedUs();
+        r.frames = (int) sim.frames().size();
+        for (int i = 0; i < r.frames && i < VIRTUAL_CLOCK_MAX_FRAMES; ++i) {
+            r.frameUs[i] = sim.frames()[i].endUs;
+            r.frameHash[i] = sim.frames()[i].hash;
+        }
+        r.edges = 0;
+        for (const AnalogChange &change : sim.analogHistory()) {
+            if (change.pin != BUZZER_PIN) continue;
+            if (r.edges < VIRTUAL_CLOCK_MAX_EDGES) {
+                r.edgeUs[r.edges] = change.us;
+                r.edgeLevel[r.edges] = change.level;
+            }
+            r.edges++;
+        }
+    }, &run, sizeof(run));
+    run.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    if (!ok) fprintf(stderr, "Simulated receiver crashed\n");
+}
+
+int virtualClockMain(int argc, char **argv) {
+    VirtualClockOptions options;
+
+    for (int i = 0; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--ends")) {
+            options.ends = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--details")) {
+            options.details = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--walk-up")) {
+            options.walkUp = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--max-time")) {
+            options.maxTime = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--warn-time")) {
+            options.warnTime = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--scoring")) {
+            options.scoringUs = (uint64_t) (atof(argv[i + 1]) * SECOND_US);
+        } else if (!strcmp(argv[i], "--repeat")) {
+            options.repeatUs = (uint64_t) (atof(argv[i + 1]) * 1000);
+        } else {
+            argc = -1;
+        }
+    }
+    if (argc < 0 || argc % 2 || options.ends < 1 || options.ends > 255 || options.details < 1 ||
+        options.details > 2 || options.walkUp < 1 || options.walkUp > 255 || options.maxTime < 1 ||
+        options.warnTime < 0) {
+        fprintf(stderr,
+                "usage: program clock [options]\n"
+                "  --ends N         Ends in the round (default 6)\n"
+                "  --details N      1 for A/B alone, 2 for A/B and C/D in turn (default 2)\n"
+                "  --walk-up S      Seconds of amber before each detail shoots (default 10)\n"
+                "  --max-time S     Seconds each detail has to shoot (default 240)\n"
+                "  --warn-time S    Seconds left when the light turns amber, 0 for none (default 30)\n"
+                "  --scoring S      Between the end of one end and the start of the next (default 20)\n"
+                "  --repeat MS      How often the controller repeats the start of an end, 0 to send it once "
+                "(default 0)\n");
+        return 2;
+    }
+
+    printf("%d ends, %d detail%s, %d s walk-up, %d s to shoot with a warning at %d s, start %s\n\n", options.ends,
+           options.details, options.details == 1 ? "" : "s", options.walkUp, options.maxTime, options.warnTime,
+           options.repeatUs ? "repeated" : "sent once");
+    printf("%-9s %10s %7s %9s %8s %9s %16s\n", "clock", "passes", "jumps", "idle %", "sim s", "wall s",
+           "sim s per wall s");
+
+    std::unique_ptr<VirtualClockRun> runs[2];
+    for (int skip = 0; skip < 2; ++skip) {
+        runs[skip].reset(new VirtualClockRun());
+        runVirtualClock(options, skip, *runs[skip]);
+        const VirtualClockRun &r = *runs[skip];
+        printf("%-9s %10lu %7lu %9.2f %8.1f %9.3f %16.0f\n", skip ? "jumps" : "steps", r.passes, r.jumps,
+               100.0 * r.skippedUs / r.simulatedUs, r.simulatedUs / (double) SECOND_US, r.wallSeconds,
+               r.simulatedUs / (double) SECOND_US / r.wallSeconds);
+        fflush(stdout);
+    }
+
+    // Jumping should show the same frames and sound the same buzzer, only up to a pass of loop() sooner
+    const VirtualClockRun &steps = *runs[0];
+    const VirtualClockRun &jumps = *runs[1];
+    bool same = steps.frames == jumps.frames && steps.edges == jumps.edges;
+    int64_t worstUs = 0;
+    for (int i = 0; same && i < std::min(steps.frames, VIRTUAL_CLOCK_MAX_FRAMES); ++i) {
+        same = steps.frameHash[i] == jumps.frameHash[i];
+        worstUs = std::max(worstUs, std::abs((int64_t) steps.frameUs[i] - (int64_t) jumps.frameUs[i]));
+    }
+    for (int i = 0; same && i < std::min(steps.edges, VIRTUAL_CLOCK_MAX_EDGES); ++i) {
+        same = steps.edgeLevel[i] == jumps.edgeLevel[i];
+        worstUs = std::max(worstUs, std::abs((int64_t) steps.edgeUs[i] - (int64_t) jumps.edgeUs[i]));
+    }
+    printf("\n%d frames and %d buzzer edges, %s", steps.frames, steps.edges, same ? "the same" : "DIFFERENT");
+    if (same) printf(", at most %.3f ms apart", worstUs / 1000.0);
+    printf("; jumping ran %.0fx faster\n", steps.wallSeconds / jumps.wallSeconds);
+    return same ? 0 : 1;
+}
@@ -0,0 +1,78 @@
+#include "AnimationScenarios.h"
+#include "Batching.h"
+#include "Brownout.h"
+#include "Calibration.h"
+#include "Capture.h"
+#include "EmergencyStop.h"
+#include "ClockSync.h"
+#include "ErrorCorrection.h"
+#include "Fleet.h"
+#include "FlowControl.h"
+#include "PaletteCheck.h"
+#include "LedBackends.h"
+#include "TickTiming.h"
+#include "FontCheck.h"
+#include "Framing.h"
+#include "Handoffs.h"
+#include "LoadGen.h"
+#include "Lockstep.h"
+#include "ProtocolCheck.h"
+#include "Repeats.h"
+#include "Rounds.h"
+#include "UartScenarios.h"
+#include "VirtualClock.h"
+
+#include <cstdio>
+#include <cstring>
+
+/**
+ * A tool built into the native simulator, run as `program <name> [options]`.
+ */
+struct Command {
+    const char *name;
+    const char *description;
+    int (*run)(int argc, char **argv);
+};
+
+static const Command COMMANDS[] = {
+        {"loadgen",   "Drive a receiver with generated packets and find the highest loss-free rate", loadGenMain},
+        {"uart",      "Count bytes lost to the serial ring and to show() blackouts, per traffic scenario", uartMain},
+        {"animation", "Check animation frame pacing, and the packets lost while animating", animationMain},
+        {"lockstep",  "Measure how far apart a line of receivers acts on the same command", lockstepMain},
+        {"brownout",  "Cut the power part-way through an end and check the state comes back from EEPROM", brownoutMain},
+        {"clocksync", "Estimate clock offset, round trip and drift over a link with latency and jitter", clockSyncMain},
+        {"fec",       "Compare updates delivered with and without error correction as bit errors rise", fecMain},
+        {"repeats",   "Measure what a repeated state frame costs, with and without a generation", repeatsMain},
+        {"protocol",  "Check the simulator's encoders against the generated frames, and time the state decode", protocolMain},
+        {"capture",   "Record the bytes on a serial line with microsecond timestamps, for replay", captureMain},
+        {"replay",    "Feed a capture to the simulated receiver on its virtual clock, deterministically", replayMain},
+        {"font",      "Check the flash segment font against the old digit bitmaps, and time a glyph", fontMain},
+        {"round",     "Run a round sent phase by phase or uploaded once; count packets, time each change", roundMain},
+        {"fleet",     "Run a tournament field of receivers across a thread pool; delivery, addressing and skew", fleetMain},
+        {"handoff",   "Time matchplay turns passing between two receivers, relayed by the controller or direct", handoffMain},
+        {"clock",     "Run a long round stepping through idle time and jumping over it; compare, and time both", virtualClockMain},
+        {"framing",   "Compare reading frames from the serial ring in loop() with framing them in the RX interrupt", framingMain},
+        {"batch",     "Send common transitions as separate frames and as one batch; bytes on air and time to display", batchMain},
+        {"estop",     "Time an emergency stop to a blank display, as a state frame and as the stop signal", estopMain},
+        {"flow",      "Send updates at rising rates with and without flow control around shows; updates lost", flowMain},
+        {"ticks",     "Time each countdown tick to the display, drawn ahead and shown on the tick or not", ticksMain},
+        {"palette",   "Check palettes with brightness baked in send FastLED's frames; dithering, and encode time", paletteMain},
+        {"leds",      "Run the palette script through FastLED and the capture LED backend; frames and show time", ledsMain},
+        {"calibrate", "Calibrate receivers with skewed clocks; convergence, and countdown error before and after", calibrateMain},
+};
+
+int main(int argc, char **argv) {
+    if (argc >= 2) {
+        for (const Command &command : COMMANDS) {
+            if (!strcmp(argv[1], command.name)) {
+                return command.run(argc - 2, argv + 2);
+            }
+        }
+    }
+
+    fprintf(stderr, "usage: %s <command> [options]\n\ncommands:\n", argc ? argv[0] : "program");
+    for (const Command &command : COMMANDS) {
+        fprintf(stderr, "  %-12s %s\n", command.name, command.description);
+    }
+    return 2;
+}
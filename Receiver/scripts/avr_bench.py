@@ -0,0 +1,28 @@
+"""
+Adds a `bench` target to the uno-bench environment: builds bench/AvrBench.c for the host against simavr, then runs
+the firmware under it. Options for the run go in custom_bench_args in platformio.ini, or on the command line:
+
+    pio run -e uno-bench -t bench
+    BENCH_ARGS="--updates 200 --spacing 100" pio run -e uno-bench -t bench
+
+Needs simavr and libelf installed where the host compiler can find them (pkg-config, or /usr/include/simavr).
+"""
+
+import os
+
+Import("env")  # noqa: F821 (defined when PlatformIO runs this as an extra script)
+
+harness = os.path.join("$BUILD_DIR", "avr_bench")
+args = os.environ.get("BENCH_ARGS", env.GetProjectOption("custom_bench_args", ""))  # noqa: F821
+
+env.AddCustomTarget(  # noqa: F821
+    name="bench",
+    dependencies="$BUILD_DIR/${PROGNAME}.elf",
+    actions=[
+        "cc -std=c99 -O2 -o %s $PROJECT_DIR/bench/AvrBench.c "
+        "`pkg-config --cflags --libs simavr 2>/dev/null || echo -I/usr/include/simavr -lsimavr` -lelf" % harness,
+        "%s $BUILD_DIR/${PROGNAME}.elf %s" % (harness, args),
+    ],
+    title="AVR bench",
+    description="Run the firmware under simavr and report cycle counts",
+)
@@ -0,0 +1,422 @@
+"""
+Generates include/Protocol.h, ../Documentation/Protocol.txt and the app's Protocol.kt from protocol/Frames.schema.
+
+Runs before every PlatformIO build (extra_scripts in platformio.ini), or by hand with
+`python3 scripts/generate_protocol.py` from the Receiver directory. Files are only rewritten when their contents
+change, so an unchanged schema does not trigger a rebuild.
+"""
+
+import os
+import re
+import sys
+
+try:
+    Import("env")  # noqa: F821 (defined when PlatformIO runs this as an extra script)
+    PROJECT_DIR = env.subst("$PROJECT_DIR")  # noqa: F821
+except NameError:
+    PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+SCHEMA = os.path.join(PROJECT_DIR, "protocol", "Frames.schema")
+HEADER = os.path.join(PROJECT_DIR, "include", "Protocol.h")
+SPEC = os.path.join(PROJECT_DIR, os.pardir, "Documentation", "Protocol.txt")
+KOTLIN = os.path.join(PROJECT_DIR, os.pardir, "Controller-App", "app", "src", "main", "java", "io", "github", "igneel32",
+                      "remote", "serial", "Protocol.kt")
+KOTLIN_PACKAGE = "io.github.igneel32.remote.serial"
+
+INTEGERS = {
+    "u8": (1, "uint8_t"),
+    "u16": (2, "uint16_t"),
+    "u32": (4, "uint32_t"),
+    "i16": (2, "int16_t"),
+    "i32": (4, "int32_t"),
+}
+
+
+class SchemaError(Exception):
+    pass
+
+
+class Bits:
+    def __init__(self, name, lsb, msb, comment):
+        self.name = name
+        self.lsb = lsb
+        self.msb = msb
+        self.comment = comment
+
+    @property
+    def width(self):
+        return self.msb - self.lsb + 1
+
+
+class Value:
+    def __init__(self, name, value, comment):
+        self.name = name
+        self.value = value
+        self.comment = comment
+
+
+class Constant:
+    def __init__(self, name, type, text, comment, doc):
+        self.name = name
+        self.type = type
+        self.text = text        # As written in the schema, hex or decimal
+        self.value = int(text, 0)
+        self.comment = comment
+        self.doc = doc          # The lines of any comment on lines of its own straight above
+
+
+class Field:
+    def __init__(self, name, type, comment):
+        self.name = name
+        self.type = type
+        self.comment = comment
+        self.offset = 0
+        self.size = 0
+        self.embedded = None    # The frame embedded in this field
+        self.follows = False    # If any frame may follow here
+        self.bits = []
+        self.values = []        # Named values of a u8 field
+
+
+class Frame:
+    def __init__(self, name, type_byte, comment):
+        self.name = name
+        self.type_byte = type_byte
+        self.comment = comment
+        self.fields = []
+        self.size = 0
+
+
+def upper(name):
+    return re.sub(r"(?<=[a-z0-9])(?=[A-Z])", "_", name).upper()
+
+
+def parse(text):
+    constants = []
+    frames = []
+    by_name = {}
+    doc = []
+    for number, raw in enumerate(text.splitlines(), 1):
+        line, _, comment = raw.partition("#")
+        comment = comment.strip()
+        if not line.strip():
+            doc = doc + [comment] if raw.strip() else []
+            continue
+        indent = len(line) - len(line.lstrip())
+        words = line.split()
+        try:
+            if indent == 0 and words[0] == "const":
+                if len(words) != 4 or words[2] not in INTEGERS or not re.fullmatch(r"[A-Z][A-Z0-9_]*", words[1]):
+                    raise SchemaError("expected: const <NAME> <integer type> <value>")
+                constant = Constant(words[1], words[2], words[3], comment, doc)
+                size = INTEGERS[constant.type][0]
+                low = -(1 << (8 * size - 1)) if constant.type.startswith("i") else 0
+                if not low <= constant.value < low + (1 << 8 * size) or constant.value >= 1 << 31:
+                    raise SchemaError("value out of range for %s, or for a Kotlin Int" % constant.type)
+                constants.append(constant)
+            elif indent == 0:
+                if words[0] != "frame" or len(words) not in (2, 3):
+                    raise SchemaError("expected: frame <Name> [<type byte>]")
+                frame = Frame(words[1], int(words[2], 0) if len(words) == 3 else None, comment)
+                frames.append(frame)
+                by_name[frame.name] = frame
+            elif indent == 4:
+                if len(words) != 2 or not frames:
+                    raise SchemaError("expected: <field> <type>")
+                frames[-1].fields.append(Field(words[0], words[1], comment))
+            elif indent == 8 and len(words) == 3 and words[1] == "=":
+                field = frames[-1].fields[-1] if frames and frames[-1].fields else None
+                if field is None or field.type != "u8" or not re.fullmatch(r"[A-Z][A-Z0-9_]*", words[0]):
+                    raise SchemaError("expected: <NAME> = <value>, under a u8 field")
+                value = Value(words[0], int(words[2], 0), comment)
+                if not 0 <= value.value <= 0xFF:
+                    raise SchemaError("value out of range")
+                field.values.append(value)
+            elif indent == 8:
+                field = frames[-1].fields[-1] if frames and frames[-1].fields else None
+                if len(words) != 2 or field is None or field.type != "u16":
+                    raise SchemaError("expected: <bit> <lsb>[..<msb>], under a u16 field")
+                lsb, _, msb = words[1].partition("..")
+                bits = Bits(words[0], int(lsb), int(msb or lsb), comment)
+                if not 0 <= bits.lsb <= bits.msb < 16:
+                    raise SchemaError("bits out of range")
+                field.bits.append(bits)
+            else:
+                raise SchemaError("unexpected indent")
+        except (SchemaError, ValueError) as e:
+            raise SchemaError("%s:%d: %s" % (SCHEMA, number, e))
+        doc = []
+
+    for frame in frames:
+        offset = 0 if frame.type_byte is None else 1
+        for field in frame.fields:
+            follows = re.fullmatch(r"frame\((\w+)\)", field.type)
+            if field.type in INTEGERS:
+                field.size = INTEGERS[field.type][0]
+            elif follows and follows.group(1) in by_name:
+                field.follows = True
+                field.size = by_name[follows.group(1)].size
+            elif field.type in by_name:
+                field.embedded = by_name[field.type]
+                field.size = field.embedded.size
+            else:
+                raise SchemaError("%s.%s: unknown type %s (frames must be defined before use)"
+                                  % (frame.name, field.name, field.type))
+            if field.follows and field is not frame.fields[-1]:
+                raise SchemaError("%s.%s: a following frame must be the last field" % (frame.name, field.name))
+            field.offset = offset
+            offset += field.size
+        frame.size = offset
+        if frame.type_byte is not None and not 0x10 <= frame.type_byte <= 0xFF:
+            raise SchemaError("%s: type bytes must be from 0x10 to 0xFF, to tell them from a state frame" % frame.name)
+        if frame.type_byte is None and any(b.msb >= 12 for f in frame.fields[:1] for b in f.bits):
+            raise SchemaError("%s: the first byte of a state frame must stay below 0x10" % frame.name)
+    return constants, frames
+
+
+def read_expression(type, offset):
+    size, ctype = INTEGERS[type]
+    parts = []
+    for i in range(size):
+        shift = 8 * (size - 1 - i)
+        byte = "data[%d]" % (offset + i)
+        if shift == 0:
+            parts.append(byte)
+        elif shift == 8:
+            parts.append("(uint16_t) %s << 8" % byte)
+        else:
+            parts.append("(uint32_t) %s << %d" % (byte, shift))
+    return "(%s) (%s)" % (ctype, " | ".join(parts)) if size > 1 else parts[0]
+
+
+def write_statements(type, offset, value):
+    size = INTEGERS[type][0]
+    lines = []
+    for i in range(size):
+        shift = 8 * (size - 1 - i)
+        lines.append("data[%d] = (byte) (%s%s);" % (offset + i, value, " >> %d" % shift if shift else ""))
+    return lines
+
+
+def wrap(line, width=120):
+    """
+    Break a long decode line after the middle | of its expression.
+    """
+    if len(line) <= width:
+        return [line]
+    bars = [m.start() for m in re.finditer(r" \| ", line)]
+    split = bars[len(bars) // 2]
+    indent = line.index("((") + 1
+    return [line[:split + 2], " " * indent + line[split + 3:]]
+
+
+def javadoc(comment):
+    if not comment.endswith("."):
+        comment += "."
+    return ["/**", " * %s" % comment[0].upper() + comment[1:], " */"]
+
+
+def documented(doc):
+    return ["/**"] + [" * " + line if line else " *" for line in doc] + [" */"] if doc else []
+
+
+def commented(declaration, comment):
+    return declaration.ljust(48) + " // " + comment if comment else declaration
+
+
+def generate_header(constants, frames):
+    out = [
+        "#pragma once",
+        "#include <Arduino.h>",
+        "",
+        "// Generated from protocol/Frames.schema by scripts/generate_protocol.py. Edit the schema, not this file.",
+        "//",
+        "// Offsets are from the start of the frame, type byte included, and multi-byte fields are big-endian.",
+        "// The decoders and encoders only ever touch fixed offsets, so they compile to straight-line loads, stores",
+        "// and shifts.",
+    ]
+    out.append("")
+    out.append("//region Constants")
+    for constant in constants:
+        ctype = "byte" if constant.type == "u8" else INTEGERS[constant.type][1]
+        out.extend(documented(constant.doc))
+        out.append(commented("constexpr %s %s = %s;" % (ctype, constant.name, constant.text),
+                             constant.comment))
+    out.append("//endregion")
+    for frame in frames:
+        prefix = upper(frame.name)
+        out.append("")
+        out.append("//region %s" % frame.name)
+        if frame.comment:
+            out.extend(javadoc(frame.comment))
+        if frame.type_byte is not None:
+            out.append("constexpr byte FRAME_%s = 0x%02X;" % (prefix, frame.type_byte))
+        out.append("constexpr byte %s_FRAME_SIZE = %d;" % (prefix, frame.size))
+        for field in frame.fields:
+            out.append("constexpr byte %s_%s_OFFSET = %d;" % (prefix, upper(field.name), field.offset))
+        for field in frame.fields:
+            for bits in field.bits:
+                mask = ((1 << bits.width) - 1) << bits.lsb
+                out.append("constexpr uint16_t %s_%s_MASK = 0x%04X;" % (prefix, upper(bits.name), mask))
+                out.append("constexpr byte %s_%s_SHIFT = %d;" % (prefix, upper(bits.name), bits.lsb))
+        for field in frame.fields:
+            for value in field.values:
+                out.append(commented("constexpr byte %s = %d;" % (value.name, value.value), value.comment))
+
+        out.append("")
+        out.append("struct %sFrame {" % frame.name)
+        for field in frame.fields:
+            if field.follows:
+                continue
+            ctype = INTEGERS[field.type][1] if field.embedded is None else field.embedded.name + "Frame"
+            declaration = "    %s %s;" % (ctype, field.name)
+            out.append(declaration.ljust(32) + " // " + field.comment if field.comment else declaration)
+        out.append("};")
+
+        decode = ["", "inline void decode%sFrame(const byte *data, %sFrame &frame) {" % (frame.name, frame.name)]
+        encode = ["", "inline void encode%sFrame(const %sFrame &frame, byte *data) {" % (frame.name, frame.name)]
+        if frame.type_byte is not None:
+            encode.append("    data[0] = FRAME_%s;" % prefix)
+        for field in frame.fields:
+            if field.follows:
+                continue
+            if field.embedded is not None:
+                decode.append("    decode%sFrame(data + %d, frame.%s);" % (field.type, field.offset, field.name))
+                encode.append("    encode%sFrame(frame.%s, data + %d);" % (field.type, field.name, field.offset))
+                continue
+            decode.extend(wrap("    frame.%s = %s;" % (field.name, read_expression(field.type, field.offset))))
+            encode.extend("    " + s for s in write_statements(field.type, field.offset, "frame." + field.name))
+        out.extend(decode + ["}"] + encode + ["}"])
+
+        for field in frame.fields:
+            for bits in field.bits:
+                name = "%s%s" % (frame.name[0].lower() + frame.name[1:], bits.name[0].upper() + bits.name[1:])
+                setter = "with" + name[0].upper() + name[1:]
+                constant = "%s_%s" % (prefix, upper(bits.name))
+                ctype = "bool" if bits.width == 1 else "byte"
+                out.append("")
+                if bits.comment:
+                    out.extend(javadoc(bits.comment))
+                if bits.width == 1:
+                    out.append("inline bool %s(uint16_t %s) {" % (name, field.name))
+                    out.append("    return %s & %s_MASK;" % (field.name, constant))
+                else:
+                    out.append("inline byte %s(uint16_t %s) {" % (name, field.name))
+                    out.append("    return (%s & %s_MASK) >> %s_SHIFT;" % (field.name, constant, constant))
+                out.append("}")
+                out.append("")
+                out.append("inline uint16_t %s(uint16_t %s, %s value) {" % (setter, field.name, ctype))
+                out.append("    return (%s & ~%s_MASK) |" % (field.name, constant))
+                out.append("           ((uint16_t) value << %s_SHIFT & %s_MASK);" % (constant, constant))
+                out.append("}")
+        out.append("//endregion")
+    return "\n".join(out) + "\n"
+
+
+def generate_spec(constants, frames):
+    out = [
+        "# Generated from Receiver/protocol/Frames.schema by Receiver/scripts/generate_protocol.py. Edit the schema,",
+        "# not this file.",
+        "#",
+        "# Every frame goes inside a packet: A4 11 E4 D8, the packet's total size (u8), the sum of the frame's bytes",
+        "# (u16), then the frame. Multi-byte fields are big-endian. One line per item, fields separated by spaces:",
+        "#",
+        "#   const <name> <type> <value>",
+        "#   frame <name> <type byte, or - for a state frame> <size>",
+        "#   field <frame> <field> <offset> <size> <type>",
+        "#   value <frame> <field> <name> <value>",
+        "#   bits <frame> <field> <bit> <lsb> <width>",
+        "#",
+        "# Offsets count the type byte. A field of type frame(<name>) is followed by any frame at least that big.",
+        "# Anything after a # is a comment.",
+    ]
+
+    def line(text, comment):
+        return text.ljust(52) + " # " + comment if comment else text
+
+    out.append("")
+    for constant in constants:
+        out.extend("# " + text if text else "#" for text in constant.doc)
+        out.append(line("const %s %s %s" % (constant.name, constant.type, constant.text), constant.comment))
+
+    for frame in frames:
+        type_byte = "-" if frame.type_byte is None else "0x%02X" % frame.type_byte
+        out.append("")
+        out.append(line("frame %s %s %d" % (frame.name, type_byte, frame.size), frame.comment))
+        for field in frame.fields:
+            out.append(line("field %s %s %d %d %s" % (frame.name, field.name, field.offset, field.size, field.type),
+                            field.comment))
+            for bits in field.bits:
+                out.append(line("bits %s %s %s %d %d" % (frame.name, field.name, bits.name, bits.lsb, bits.width),
+                                bits.comment))
+    return "\n".join(out) + "\n"
+
+
+def generate_kotlin(constants, frames):
+    """
+    The constants, frame types, sizes, offsets, bit fields and named values, as the app's Protocol.kt. Every one is an
+    Int, as Netty's ByteBuf reads and writes them.
+    """
+    out = [
+        "// Generated from Receiver/protocol/Frames.schema by Receiver/scripts/generate_protocol.py. Edit the schema,",
+        "// not this file.",
+        "package %s" % KOTLIN_PACKAGE,
+        "",
+        "//region Constants",
+    ]
+
+    def const(name, value, comment=""):
+        declaration = "const val %s = %s" % (name, value)
+        out.append(declaration.ljust(48) + " // " + comment if comment else declaration)
+
+    for constant in constants:
+        out.extend(documented(constant.doc))
+        const(constant.name, constant.text, constant.comment)
+    out.append("//endregion")
+    for frame in frames:
+        prefix = upper(frame.name)
+        out.append("")
+        out.append("//region %s" % frame.name)
+        if frame.comment:
+            out.extend(javadoc(frame.comment))
+        if frame.type_byte is not None:
+            const("FRAME_%s" % prefix, "0x%02X" % frame.type_byte)
+        const("%s_FRAME_SIZE" % prefix, frame.size)
+        for field in frame.fields:
+            const("%s_%s_OFFSET" % (prefix, upper(field.name)), field.offset)
+        for field in frame.fields:
+            for bits in field.bits:
+                const("%s_%s_MASK" % (prefix, upper(bits.name)), "0x%04X" % (((1 << bits.width) - 1) << bits.lsb),
+                      bits.comment)
+                const("%s_%s_SHIFT" % (prefix, upper(bits.name)), bits.lsb)
+        for field in frame.fields:
+            for value in field.values:
+                const(value.name, value.value, value.comment)
+        out.append("//endregion")
+    return "\n".join(out) + "\n"
+
+
+def write_if_changed(path, text):
+    path = os.path.normpath(path)
+    if os.path.exists(path):
+        with open(path, newline="") as f:
+            if f.read() == text:
+                return
+    with open(path, "w", newline="\n") as f:
+        f.write(text)
+    print("Generated %s" % os.path.relpath(path, PROJECT_DIR))
+
+
+def main():
+    with open(SCHEMA) as f:
+        constants, frames = parse(f.read())
+    write_if_changed(HEADER, generate_header(constants, frames))
+    write_if_changed(SPEC, generate_spec(constants, frames))
+    write_if_changed(KOTLIN, generate_kotlin(constants, frames))
+
+
+try:
+    main()
+except SchemaError as e:
+    sys.stderr.write("%s\n" % e)
+    sys.exit(1)
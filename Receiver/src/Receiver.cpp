@@ -1,94 +1,282 @@
 #include <Arduino.h>
 #include <../lib/ByteBuf/include/ByteBuf.h>
-#include "FastLED.h"
+#include <Board.h>
+#include <LedOutput.h>
+#include <Palette.h>
 #include <DetailLEDs.h>
 #include <TrafficLights.h>
 #include <NumericLEDs.h>
+#include <State.h>
+#include <Snapshot.h>
+#include <Animation.h>
+#include <Frames.h>
+#include <ControllerClock.h>
+#include <ClockTrim.h>
+#include <Schedule.h>
+#include <Round.h>
+#include <Handoff.h>
+#include <Fec.h>
+#include <RxFramer.h>
+#include <Bench.h>
+#include <Wake.h>
+#include <TxSerial.h>
 
 #define DEBUG_LOGGING
 //#define VERBOSE_DEBUG_LOGGING
-#define QUIET_PIN 7
-#define MATCHPLAY_PIN 8
-#define BRIGHTNESS_PIN 9
-#define LED_PIN 10
-#define BUZZER_PIN 11
-#define LOUD_PIN 12
-#define CHIPSET WS2812
-#define COLOR_ORDER GRB
-#define NUM_LEDS 251
-#define HIGH_BRIGHTNESS 192
-#define LOW_BRIGHTNESS 64
+#define LED_CORRECTION TypicalSMD5050
 #define MUTE 0
 #define QUIET 64
 #define LOUD 254
 
 const byte HEADER[4] = {(byte) 0xA4, 0x11, (byte) 0xE4, (byte) 0xD8};
-const char *HEX_CHARS = "0123456789ABCDEF";
-
-// Packet format:
-// ____ ___L XYCD DccT
-// _ = Unused
-// L = Last end (matchplay)
-// X = Emergency Stop
-// Y = Matchplay
-// C = Countdown
-// D = Detail
-// c = Colour
-// T = TimeEnabled
-
-struct State {
-   bool countdownContinues;  // If the countdown currently ending will be followed by another
-   bool lastEnd;             // If the current end is the last (for matchplay)
-   bool countdown;           // If the unit should count down the seconds
-   byte detail;              // The detail being displayed (none, A/B, or C/D)
-   byte colour;              // The colour on the traffic light (red, amber, or green)
-   bool timeEnabled;         // If the time should be displayed on the panel
-   int time;                 // The time to display
-   int startNumBeeps;        // Number of beeps to sound at the start of the countdown
-   int endNumBeeps;          // Number of beeps to sound at the end of the countdown
-};
-
-const byte DETAIL_OFF = 0;
-const byte DETAIL_AB = 1;
-const byte DETAIL_CD = 2;
-
-const byte RED = 0;
-const byte AMBER = 1;
-const byte GREEN = 2;
+const char HEX_CHARS[] PROGMEM = "0123456789ABCDEF";
+
+// The layout of every frame is in protocol/Frames.schema
+
+/**
+ * The regions of leds[], in chain order. Each can be wired as a chain of its own, so that a change to one region
+ * only clocks out that region's LEDs with interrupts off, rather than all 251.
+ */
+const byte REGION_DETAIL = 0x01;
+const byte REGION_NUMBER = 0x02;
+const byte REGION_LIGHTS = 0x04;
+const byte REGION_ALL = 0x07;
+const byte REGION_COUNT = 3;
+const int REGION_FIRST_LED[REGION_COUNT + 1] = {0, HUNDREDS_OFFSET, LIGHTS_FIRST_LED, NUM_LEDS};
+
+const int PACKET_MAX_SIZE = PACKET_OVERHEAD + BATCH_MAX_SIZE;     // The largest packet taken, a batch
+static_assert(PACKET_MAX_SIZE >= FEC_HEADER_SIZE + FEC_LENGTH_SIZE + 2 * (FEC_MAX_DATA + 1),
+              "buffer must hold an FEC packet of FEC_MAX_DATA");
+
+const int FLOW_SAFE_LEDS = FLOW_USART_BYTES * 10000000UL / SERIAL_BAUD / LED_WIRE_US;  // The longest chain the
+                                                                                         // USART rides out
 
 const int BUZZER_DURATION = 500;   // How long the buzzer should sound on/off for
+const int RECEIVER_ID_ADDRESS = SNAPSHOT_ADDRESS + SNAPSHOT_SLOTS * sizeof(Snapshot);
+const int ROUND_ADDRESS = RECEIVER_ID_ADDRESS + sizeof(uint16_t);
+const int TRIM_ADDRESS = ROUND_ADDRESS + sizeof(StoredRound);
 
-ByteBuf buffer(320);
+ByteBuf buffer(PACKET_MAX_SIZE);
 int expectedSize = -1;
+bool fecPacket;                  // The packet being read is an FEC packet
+ByteBuf fecBuffer(FEC_MAX_DATA);
 State state;
 CRGB leds[NUM_LEDS];
 unsigned long startTime;
+uint16_t startFraction;          // Of a ms in Q16, carried from each countdown second to the next (nextSecond())
 bool buzzerIsActive;
 unsigned long buzzerStart;
 unsigned long buzzerEnd;
-bool ledsDirty;
+byte ledsDirty;                  // REGION_* bits of the LEDs changed since the last show
+LedChain chains[REGION_COUNT];   // One per region when split, otherwise just the first
+byte chainCount;
 int oldBrightness;
 byte matchplayMode;
+Snapshot snapshot;       // The snapshot last written to (or restored from) EEPROM
+int snapshotSlot = -1;
+bool restoreHeld;                // The snapshot is live, and waits on the controller to repeat its generation
+unsigned long lastRxMs;          // When serial data last arrived
+byte activeAnimations;           // ANIMATION_* bits
+unsigned long nextFrameMs;
+byte fadingLight;
+unsigned long fadeStart;
+unsigned long estopStart;
+ControllerClock controllerClock;
+ClockTrim clockTrim;             // How fast true time runs against millis(), kept in EEPROM
+Calibration calibration;
+Schedule schedule;               // Scheduled state frames waiting for their time
+bool runningScheduled;           // A scheduled state frame is being acted on, which logging must not hold up
+ByteBuf scheduledBuffer(STATE_FRAME_SIZE);
+uint16_t receiverId;             // Picked at random on first power-on, and kept in EEPROM
+bool reportDue;                  // A clock report is waiting for this receiver's slot
+unsigned long reportAt;
+bool addressed;                  // The controller has sent to this receiver by its id, and so has found it
+unsigned long addressedAt;
+unsigned int appliedGeneration;  // The last generation acted on, if generationApplied
+bool generationApplied;
+Round roundState;                // The round uploaded by the controller, and how far through it the range is
+Handoff handoff;                 // Matchplay turns, passed between the two sides' receivers
+ByteBuf replyBuffer(PONG_FRAME_SIZE > CLOCK_REPORT_FRAME_SIZE ? PONG_FRAME_SIZE : CLOCK_REPORT_FRAME_SIZE);
+#ifdef RX_FRAMER
+RxFramer rxFramer;
+#endif
+bool isrFraming;                 // Frames are read by the RX interrupt into rxFramer, rather than by loop() from Serial
+#ifdef SIM_LED_CAPTURE
+bool ledCapture;                 // Shows go straight to the simulated board, rather than through FastLED
+#endif
+#ifndef ISR_FRAMING
+uint32_t estopWindow;            // The last four bytes loop() read, for the emergency stop signal
+ByteBuf rxAhead(SERIAL_RX_BUFFER_SIZE);    // Read from Serial by stopPending() while debug text waited, for loop()
+uint32_t aheadWindow;            // The last four bytes read into rxAhead, for the emergency stop signal
+bool estopAhead;                 // The signal turned up in rxAhead, and loop() has yet to stop
+#endif
+ByteBuf batchBuffer(BATCH_MAX_SIZE);    // Each frame of a batch in turn
+bool batching;                   // A batch is being applied, and persistState() waits for the end of it
+bool batchStateChanged;          // A state frame in the batch has been applied, and is logged at the end of it
+unsigned long batchLateMs;       // How much later the frame being applied from a batch was read than if sent alone
+bool flowControl = true;         // Long shows hold the controller off with FLOW_BUSY and FLOW_READY
+bool flowHeld;                   // FLOW_BUSY has gone out, and FLOW_READY is yet to follow
+unsigned long flowBusyMs;        // When FLOW_BUSY reaches the end of the wire
+bool tickAhead = true;           // Countdown ticks are worked out ahead and shown on the tick, not at the end of loop()
+byte nextGlyphs[NUMERIC_DIGITS]; // The numerical display's glyphs as the countdown's next tick shows them
+int nextNumberTime = -1;         // The time nextGlyphs show, or -1
+bool tickHeld;                   // The controller is held off for the tick about to fall due
+int showBeeps;                   // Beeps to start as the next show's first chain goes out
+bool bakedColours = true;        // Brightness and colour correction are baked into the palettes, rather than applied by
+                                 // FastLED on every show()
+Palette palettes[2];             // For HIGH_BRIGHTNESS and LOW_BRIGHTNESS
+const Palette *palette = palettes;
+
+void printBuffer(const __FlashStringHelper *prefix, ByteBuf &buf);
+
+void printState(bool brief);
+
+bool debugWrite(char c);
+
+bool debugPrint(const char *text);
+
+bool debugPrint(const __FlashStringHelper *text);
+
+void debugPrintln(const String &line);
+
+void debugPrintln(const __FlashStringHelper *line);
 
-void printBuffer(const String &prefix, ByteBuf &buf);
+bool stopPending();
+
+bool moreToRead();
+
+bool packetPartWay();
 
 unsigned int makeChecksum(ByteBuf &buf);
 
+void handleFrame(ByteBuf &buf);
+
+bool startsFecPacket(ByteBuf &buf);
+
+void handleFecPacket(ByteBuf &buf);
+
+void handleFecBody(const byte *body, byte length);
+
+#ifdef RX_FRAMER
+void takeFrames();
+
+void takeEmergencyStop();
+#endif
+
+void handleScheduledState(ByteBuf &buf);
+
+void handleGeneration(ByteBuf &buf);
+
+void handleBatch(ByteBuf &buf);
+
+byte batchedFrameSize(byte type);
+
+void handleSchedule();
+
+void handleRoundSchedule(ByteBuf &buf);
+
+void handleRoundControl(ByteBuf &buf);
+
+void runRoundCommand(byte command);
+
+void handleRound();
+
+void startRoundPhase(byte phase, unsigned long start);
+
+void finishTurn(unsigned long start);
+
+void handleHandoff(ByteBuf &buf);
+
+void startHandoffTurn();
+
+void passTurn();
+
+void sendHandoffCopies();
+
+void handlePing(ByteBuf &buf);
+
+void handleCalibrate(ByteBuf &buf);
+
+void handleClockQuery(ByteBuf &buf);
+
+void handleClockReport();
+
+void sendClockReport();
+
+void sendFrame(ByteBuf &buf);
+
+uint16_t loadReceiverId();
+
+uint16_t noiseBits();
+
+bool discovered();
+
 void handlePacket(ByteBuf &buf);
 
 void configureBrightness();
 
 void enterBlankState();
 
-bool isBitSet(byte index, int b) {
-    return ((1 << index) & b) != 0;
+void restoreState();
+
+void emergencyStop();
+
+void startAnimation(byte animation);
+
+void stopAnimation(byte animation);
+
+void fadeOutLight(byte light);
+
+void addChains();
+
+void makePalettes();
+
+void showChains();
+
+void beep(int times);
+
+bool flowAllowsShow();
+
+void flowHold();
+
+void flowRelease();
+
+int longestChain(byte regions);
+
+bool showIfClear();
+
+bool prepareTick(unsigned long msLeft);
+
+#ifdef SIM_RX_INTERRUPT
+void rxInterrupt(byte b) {
+    BENCH_SCOPE(BENCH_RX_ISR);
+    rxFramerByte(rxFramer, b);
 }
+#elif defined(ISR_FRAMING)
+/**
+ * The USART's RX interrupt. The uno-isr build writes through TxSerial in place of the core's Serial, which would bring
+ * HardwareSerial's RX interrupt with it.
+ */
+ISR(USART_RX_vect) {
+    BENCH_SCOPE(BENCH_RX_ISR);
+    rxFramerByte(rxFramer, UDR0);
+}
+#endif
 
 /**
  * Initialize serial communications, LEDs, and Arduino pins.
  */
 void setup() {
     Serial.begin(9600);
+#ifdef ISR_FRAMING
+    isrFraming = true;
+#endif
+#ifdef RX_FRAMER
+    rxFramerReset(rxFramer, HEADER);
+#endif
+#ifdef SIM_RX_INTERRUPT
+    if (isrFraming) simAttachRxInterrupt(rxInterrupt);
+#endif
 
     // Initialize pins
     pinMode(BUZZER_PIN, OUTPUT);
@@ -100,7 +288,9 @@ void setup() {
     TCCR2B = TCCR2B & 0b11111000 | 0x01;
 
     // Initialize LEDs to off
-    CFastLED::addLeds<CHIPSET, LED_PIN, COLOR_ORDER>(leds, NUM_LEDS).setCorrection(TypicalSMD5050);
+    pinMode(SPLIT_CHAINS_PIN, INPUT_PULLUP);
+    addChains();
+    makePalettes();
     oldBrightness = -1;
     configureBrightness();
     for (auto & led : leds) {
@@ -108,6 +298,181 @@ void setup() {
     }
 
     enterBlankState();
+
+    // Pick up where we left off if the power went mid-end, once the controller shows it is still running that end.
+    // Until then the lights stay red. A repeat of the generation a finished end was started by is not acted on again.
+    snapshotSlot = findLatestSnapshot(snapshot);
+    if (snapshotSlot != -1 && (snapshot.flags & SNAPSHOT_GENERATION)) {
+        appliedGeneration = snapshot.generation;
+        generationApplied = true;
+        restoreHeld = isLiveSnapshot(snapshot);
+    }
+
+    receiverId = loadReceiverId();
+    loadRound(roundState, ROUND_ADDRESS);
+    loadClockTrim(clockTrim, TRIM_ADDRESS);
+}
+
+/**
+ * Set up the LED chains: one chain of every LED on LED_PIN, or with SPLIT_CHAINS_PIN grounded, a chain per region on
+ * its own pin.
+ */
+void addChains() {
+    if (digitalRead(SPLIT_CHAINS_PIN) == HIGH) {
+        ledChainBegin<LED_PIN>(chains[0], leds, 0, NUM_LEDS);
+        chainCount = 1;
+    } else {
+        const int *first = REGION_FIRST_LED;
+        ledChainBegin<LED_PIN>(chains[0], leds, first[0], first[1] - first[0]);
+        ledChainBegin<NUMBER_LED_PIN>(chains[1], leds, first[1], first[2] - first[1]);
+        ledChainBegin<LIGHTS_LED_PIN>(chains[2], leds, first[2], first[3] - first[2]);
+        chainCount = REGION_COUNT;
+    }
+    // Dithering between shows only evens out colours at a high enough frame rate, which the display is far below
+    if (bakedColours) ledsScale(255, UncorrectedColor);
+}
+
+/**
+ * Work out the palettes for the two settings of the brightness switch. Without bakedColours, both are the plain
+ * colours, and FastLED scales them on every show().
+ */
+void makePalettes() {
+    if (bakedColours) {
+        makePalette(palettes[0], HIGH_BRIGHTNESS, LED_CORRECTION);
+        makePalette(palettes[1], LOW_BRIGHTNESS, LED_CORRECTION);
+    } else {
+        makePalette(palettes[0], 255, UncorrectedColor);
+        palettes[1] = palettes[0];
+    }
+}
+
+/**
+ * Clock out the chains with changed LEDs. A single chain goes out whole whichever region changed. Interrupts come back
+ * on between chains, so the serial receive blackout is the longest chain sent, not the total.
+ */
+void showChains() {
+    for (byte i = 0; i < chainCount; ++i) {
+        if (chainCount != 1 && !(ledsDirty & 1 << i)) continue;
+
+        ledChainShow(chains[i]);
+        // Beeps that start with the show sound from its first chain, rather than once the rest are out too
+        beep(showBeeps);
+        showBeeps = 0;
+    }
+    ledsDirty = 0;
+    flowRelease();
+}
+
+/**
+ * Show the changed LEDs, unless that would lose what is coming in: a packet part-way in, or what the controller has
+ * yet to stop sending (flowAllowsShow()).
+ *
+ * @return If they were shown.
+ */
+bool showIfClear() {
+    if (!ledsDirty || packetPartWay() || !flowAllowsShow()) return false;
+
+    benchMark(BENCH_SHOW);
+    showChains();
+    benchMark(BENCH_SHOW | BENCH_END);
+    return true;
+}
+
+/**
+ * The most LEDs showChains() would clock out in one go, with interrupts off throughout, to show the given regions.
+ *
+ * @param regions REGION_* bits, as of ledsDirty.
+ */
+int longestChain(byte regions) {
+    if (chainCount == 1) return NUM_LEDS;
+
+    int longest = 0;
+    for (byte i = 0; i < chainCount; ++i) {
+        const int leds = REGION_FIRST_LED[i + 1] - REGION_FIRST_LED[i];
+        if (regions & 1 << i && leds > longest) longest = leds;
+    }
+    return longest;
+}
+
+/**
+ * If the LEDs can be shown now without losing what the controller sends meanwhile. A show the USART can ride out
+ * goes ahead at once. A longer one first holds the controller off: FLOW_BUSY goes out, and the show waits until it
+ * has reached the controller and the line has gone quiet, or FLOW_HOLD_MS at most. showChains() lets the controller
+ * go again.
+ *
+ * A hold kept up past FLOW_HOLD_STALE_MS, as by a packet part-way in that the controller was held from finishing, is
+ * started afresh: the controller gives up on it at FLOW_HOLD_MAX_MS, and may be writing again by the time of the show.
+ */
+bool flowAllowsShow() {
+    if (!flowControl || longestChain(ledsDirty) <= FLOW_SAFE_LEDS) return true;
+
+    if (flowHeld && (long) (millis() - flowBusyMs) >= (long) FLOW_HOLD_STALE_MS) flowHeld = false;
+    flowHold();
+    unsigned long now = millis();
+    if ((long) (now - flowBusyMs) >= (long) FLOW_HOLD_MS) return true;
+
+    unsigned long clearMs = flowBusyMs + FLOW_GUARD_MS;
+    if ((long) (lastRxMs + FLOW_QUIET_MS - clearMs) > 0) clearMs = lastRxMs + FLOW_QUIET_MS;
+    if ((long) (now - clearMs) < 0) {
+        wakeBy(clearMs);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Have the controller hold off, if it is not already.
+ */
+void flowHold() {
+    if (!flowControl || flowHeld) return;
+
+    Serial.write(FLOW_BUSY);
+    flowHeld = true;
+    // Behind whatever debug text is still in the TX ring
+    flowBusyMs = millis() + wireMillis(SERIAL_TX_BUFFER_SIZE - Serial.availableForWrite());
+}
+
+/**
+ * Let the controller go again, if it is holding off.
+ */
+void flowRelease() {
+    if (!flowHeld) return;
+
+    Serial.write(FLOW_READY);
+    flowHeld = false;
+}
+
+/**
+ * Read this receiver's id from EEPROM, picking one on first power-on. The bits come from the noise on a floating
+ * analog input, so receivers built from the same firmware end up with different ids.
+ *
+ * @return The receiver's id, never ANY_RECEIVER or 0.
+ */
+uint16_t loadReceiverId() {
+    uint16_t id;
+    EEPROM.get(RECEIVER_ID_ADDRESS, id);
+    if (id != ANY_RECEIVER && id != 0) return id;
+
+    do {
+        id = noiseBits();
+    } while (id == ANY_RECEIVER || id == 0);
+    EEPROM.put(RECEIVER_ID_ADDRESS, id);
+
+#ifdef DEBUG_LOGGING
+    debugPrintln(String(F("Receiver id: ")) + String(id, HEX));
+#endif
+    return id;
+}
+
+/**
+ * 16 bits of the noise on the unconnected A0.
+ */
+uint16_t noiseBits() {
+    uint16_t bits = 0;
+    for (byte bit = 0; bit < 16; ++bit) {
+        bits = bits << 1 | (analogRead(A0) & 1);
+    }
+    return bits;
 }
 
 /**
@@ -120,7 +485,8 @@ void beep(int times) {
 
     buzzerIsActive = true;
     buzzerStart = millis();
-    buzzerEnd = buzzerStart + (times * BUZZER_DURATION * 2);  // Multiply by 2 to allow for gap between beeps
+    // Multiply by 2 to allow for gap between beeps
+    buzzerEnd = buzzerStart + trimmedMs(clockTrim, times * BUZZER_DURATION * 2UL);
     if (digitalRead(LOUD_PIN) && digitalRead(QUIET_PIN)) {
         // Central switch (mute)
         buzzerIsActive = false;
@@ -140,26 +506,31 @@ void updateColourFromState() {
             displayRedLight(leds);
             clearAmberLight(leds);
             clearGreenLight(leds);
-            ledsDirty = true;
+            ledsDirty |= REGION_LIGHTS;
             break;
 
         case AMBER:
             clearRedLight(leds);
             displayAmberLight(leds);
             clearGreenLight(leds);
-            ledsDirty = true;
+            ledsDirty |= REGION_LIGHTS;
             break;
 
         case GREEN:
             clearRedLight(leds);
             clearAmberLight(leds);
             displayGreenLight(leds);
-            ledsDirty = true;
+            ledsDirty |= REGION_LIGHTS;
             break;
 
         default:
             break;
     }
+
+    // A new end has started before the last light finished fading out
+    if (state.colour != RED) {
+        stopAnimation(ANIMATION_LAMP_FADE);
+    }
 }
 
 /**
@@ -170,19 +541,19 @@ void updateDetailFromState() {
         case DETAIL_OFF:
             clearAC(leds);
             clearBD(leds);
-            ledsDirty = true;
+            ledsDirty |= REGION_DETAIL;
             break;
 
         case DETAIL_AB:
             displayA(leds);
             displayB(leds);
-            ledsDirty = true;
+            ledsDirty |= REGION_DETAIL;
             break;
 
         case DETAIL_CD:
             displayC(leds);
             displayD(leds);
-            ledsDirty = true;
+            ledsDirty |= REGION_DETAIL;
             break;
 
         default:
@@ -199,7 +570,7 @@ void enterBlankState() {
     clearNumber(leds);
     state.colour = RED;
     updateColourFromState();
-    ledsDirty = true;
+    ledsDirty |= REGION_DETAIL | REGION_NUMBER;
 }
 
 /**
@@ -209,24 +580,25 @@ void enterIdleState() {
     state.colour = RED;
     updateColourFromState();
     displayNumber(leds, state.time);
+    ledsDirty |= REGION_NUMBER;
 
     switch (state.detail) {
         case DETAIL_OFF:
             clearAC(leds);
             clearBD(leds);
-            ledsDirty = true;
+            ledsDirty |= REGION_DETAIL;
             break;
 
         case DETAIL_AB:
             displayA(leds);
             displayB(leds);
-            ledsDirty = true;
+            ledsDirty |= REGION_DETAIL;
             break;
 
         case DETAIL_CD:
             displayC(leds);
             displayD(leds);
-            ledsDirty = true;
+            ledsDirty |= REGION_DETAIL;
             break;
 
         default:
@@ -235,35 +607,136 @@ void enterIdleState() {
 }
 
 /**
- * Updates the time being displayed if a countdown is running.
- * If the countdown should finish, beeps 3 times and enters a blank state.
+ * Restore the state from the snapshot found in EEPROM, and redraw it, once the controller has repeated the generation
+ * it was taken under. The countdown resumes from the snapshot's anchor, which is at most SNAPSHOT_CHECKPOINT_SECONDS,
+ * plus however long the power was off and the controller took to repeat, behind.
  */
-void handleCountDown() {
+void restoreState() {
+    restoreHeld = false;
+    applySnapshot(snapshot, state);
+    updateColourFromState();
+    updateDetailFromState();
+    if (state.timeEnabled) {
+        displayNumber(leds, state.time);
+    }
     if (state.countdown) {
-        unsigned long now = millis();
-        if (now - 1000 >= startTime) {
+        startTime = millis();
+        startFraction = 0;
+    }
+    ledsDirty |= REGION_ALL;
 
+#ifdef DEBUG_LOGGING
+    debugPrintln(String(F("Restored state from EEPROM, time: ")) + String(state.time));
+#endif
+}
 
-            Serial.println(state.time);
+/**
+ * Write the state to EEPROM if it differs from the last snapshot. A batch writes it once, after its last frame.
+ * A running countdown only does this every SNAPSHOT_CHECKPOINT_SECONDS, so a whole end costs a couple of dozen writes.
+ * Nor is a state written that an emergency stop already on its way replaces; the stop writes its own, and the 3.4 ms
+ * each EEPROM byte takes would hold it up. The stop's further copies replace nothing.
+ */
+void persistState() {
+    restoreHeld = false;        // Whatever replaced the held snapshot's state is what the controller wants now
+    if (batching) return;
+    if (!(activeAnimations & ANIMATION_ESTOP) && stopPending()) return;
+    Snapshot next = makeSnapshot(state, snapshot.sequence + 1, generationApplied, appliedGeneration);
+    if (snapshotSlot != -1 && sameSnapshot(next, snapshot)) return;
+
+    writeSnapshot(next, snapshotSlot);
+    snapshot = next;
+}
 
+/**
+ * Get ready for the countdown's next tick, due in the given ms. The glyphs of the number it shows are worked out into
+ * nextGlyphs, leaving only their LEDs to draw into leds[] on the tick before the show. Just before the tick, the
+ * controller is held off, so that the show need not wait on the guard and quiet time of flowAllowsShow() once the tick
+ * is due.
+ *
+ * @return If the controller is being held off for the tick.
+ */
+bool prepareTick(unsigned long msLeft) {
+    if (state.time > 1 && nextNumberTime != state.time - 1) {
+        nextNumberTime = state.time - 1;
+        numberGlyphs(nextGlyphs, nextNumberTime);
+    }
+    if (state.time <= 1 && state.countdownContinues) return false;     // Nothing to show
+
+    // Behind whatever debug text is still in the TX ring, as in flowHold()
+    const unsigned long leadMs =
+            FLOW_GUARD_MS + FLOW_QUIET_MS + wireMillis(SERIAL_TX_BUFFER_SIZE - Serial.availableForWrite());
+    if (msLeft > leadMs) {
+        wakeBy(millis() + msLeft - leadMs);
+        return false;
+    }
+    flowHold();
+    return flowHeld;
+}
 
+/**
+ * Updates the time being displayed if a countdown is running. With tickAhead, the new number was worked out ahead by
+ * prepareTick(), and is drawn and shown as soon as the tick is due, ahead of the rest of what the tick does. Ticks
+ * then keep to whole seconds from the start of the countdown, rather than each counting from when the last was
+ * handled.
+ * Each second is a true one, as corrected by clockTrim.
+ * If the countdown should finish, beeps 3 times and enters a blank state.
+ */
+void handleCountDown() {
+    tickHeld = false;
+    if (state.countdown) {
+        unsigned long now = millis();
+        const unsigned long secondMs = secondLength(clockTrim, startFraction);
+        wakeBy(startTime + secondMs);
+        if (tickAhead && now - startTime < secondMs) tickHeld = prepareTick(startTime + secondMs - now);
+        if (now - startTime >= secondMs) {
             if (state.time > 1) {
-                displayNumber(leds, --state.time);
-                ledsDirty = true;
-                startTime = now;
+                --state.time;
+                ledsDirty |= REGION_NUMBER;
+                if (tickAhead) {
+                    if (nextNumberTime != state.time) numberGlyphs(nextGlyphs, state.time);
+                    displayGlyphs(leds, nextGlyphs);
+                    startTime += nextSecond(clockTrim, startFraction);
+                    showIfClear();
+                } else {
+                    displayNumber(leds, state.time);
+                    startTime = now;
+                    nextSecond(clockTrim, startFraction);
+                }
+                debugPrintln(String(state.time + 1));
+                if (state.time <= FINAL_SECONDS && !state.countdownContinues) {
+                    startAnimation(ANIMATION_FINAL_SECONDS);
+                }
+                if (state.time % SNAPSHOT_CHECKPOINT_SECONDS == 0) {
+                    persistState();
+                }
                 return;
             }
 
-            Serial.println("about to reach 0");
+            debugPrintln(String(state.time));
+            debugPrintln(F("about to reach 0"));
+
+            if (handoff.shooting) {
+                passTurn();
+                return;
+            }
 
             // About to reach 0 seconds on countdown
-            beep(state.endNumBeeps);
             if (!state.countdownContinues) {
+                byte oldColour = state.colour;
                 state.countdown = false;
                 enterBlankState();
+                fadeOutLight(oldColour);
+                // The beeps start as the blank display does, with its first chain, or now if it waits
+                showBeeps = state.endNumBeeps;
+                if (tickAhead) showIfClear();
+                beep(showBeeps);
+                showBeeps = 0;
+                persistState();
                 return;
             }
+            beep(state.endNumBeeps);
             state.countdownContinues = false;
+            persistState();
 
 
 //            // About to reach 0 seconds on countdown
@@ -285,14 +758,16 @@ void handleCountDown() {
 
 /**
  * Toggles the buzzer on/off every BUZZER_DURATION ms, if the buzzer should be making sound.
- * Once the buzzer has finished, enters the idle state.
+ * Once the buzzer has finished at the end of a countdown, enters the idle state.
  */
 void handleBuzzer() {
     if (buzzerIsActive) {
         unsigned long now = millis();
         if (buzzerEnd > now) {
+            const unsigned long sounded = trueMs(clockTrim, now - buzzerStart);
+            wakeBy(buzzerStart + trimmedMs(clockTrim, (sounded / BUZZER_DURATION + 1) * BUZZER_DURATION));
             // Toggle the buzzer on/off every BUZZER_DURATION ms
-            if ((now - buzzerStart) % (BUZZER_DURATION * 2) < BUZZER_DURATION) {
+            if (sounded % (BUZZER_DURATION * 2) < BUZZER_DURATION) {
                 // Consideration here only needs to be given to the loud/quiet conditions and not the mute condition
                 // as if the unit should be muted it should not pass the first if condition
                 if (digitalRead(LOUD_PIN)) {
@@ -306,25 +781,106 @@ void handleBuzzer() {
         } else {
             buzzerIsActive = false;
             analogWrite(BUZZER_PIN, MUTE);
-            enterIdleState();
+            // Only the beeps at the end of a countdown lead into the idle state, not those at the start
+            if (!state.countdown) {
+                enterIdleState();
+            }
+        }
+    }
+}
+
+/**
+ * Start an animation running. Frames are timed from when the first of the running animations started.
+ *
+ * @param animation The ANIMATION_* bit.
+ */
+void startAnimation(byte animation) {
+    if (!activeAnimations) {
+        nextFrameMs = millis();
+    }
+    activeAnimations |= animation;
+}
+
+void stopAnimation(byte animation) {
+    activeAnimations &= ~animation;
+}
+
+/**
+ * Keep the light that was on lit while the red comes on, then fade it out.
+ *
+ * @param light The colour that was showing before the red.
+ */
+void fadeOutLight(byte light) {
+    if (light == RED) return;
+
+    displayLightLevel(leds, light, 255);
+    fadingLight = light;
+    fadeStart = millis();
+    startAnimation(ANIMATION_LAMP_FADE);
+}
+
+/**
+ * Renders a frame of the running animations, if one is due. Does nothing beyond a single test when none are
+ * running.
+ */
+void handleAnimations() {
+    if (!activeAnimations) return;
+
+    unsigned long now = millis();
+    bool lineBusy = Serial.available() || packetPartWay() || now - lastRxMs < ANIMATION_QUIET_MS;
+    if (!animationFrameDue(now, nextFrameMs, lineBusy)) {
+        wakeBy(lineBusy ? lastRxMs + ANIMATION_QUIET_MS : nextFrameMs);
+        return;
+    }
+
+    unsigned long renderStart = micros();
+
+    if (activeAnimations & ANIMATION_LAMP_FADE) {
+        if (renderLampFade(leds, fadingLight, now - fadeStart)) ledsDirty |= REGION_LIGHTS;
+        if (now - fadeStart >= LAMP_FADE_MS) {
+            stopAnimation(ANIMATION_LAMP_FADE);
+        }
+    }
+
+    if (activeAnimations & ANIMATION_FINAL_SECONDS) {
+        if (state.countdown && !state.countdownContinues && state.timeEnabled && state.time <= FINAL_SECONDS) {
+            if (renderFlash(leds, state.time, now - startTime)) ledsDirty |= REGION_NUMBER;
+        } else {
+            stopAnimation(ANIMATION_FINAL_SECONDS);
+            if (state.countdown && state.timeEnabled && !numberShown(leds)) {
+                displayNumber(leds, state.time);
+                ledsDirty |= REGION_NUMBER;
+            }
         }
     }
+
+    if (activeAnimations & ANIMATION_ESTOP) {
+        if (renderEStop(leds, now - estopStart)) ledsDirty |= REGION_LIGHTS;
+    }
+
+    // Give the time back by skipping the next frame if this one ran over
+    if (micros() - renderStart > ANIMATION_RENDER_BUDGET_US) {
+        nextFrameMs += ANIMATION_FRAME_MS;
+    }
 }
 
 /**
- * Configures the brightness of the LEDs based on the physical switch.
+ * Configures the brightness of the LEDs based on the physical switch. With bakedColours this swaps palettes, and
+ * recolours what is on the display from one to the other.
  */
 void configureBrightness() {
     int brightness = digitalRead(BRIGHTNESS_PIN);
     if (brightness == oldBrightness) return;
 
-    if (brightness == HIGH) {
-        FastLED.setBrightness(HIGH_BRIGHTNESS);
+    const Palette *old = palette;
+    palette = &palettes[brightness == HIGH ? 0 : 1];
+    if (bakedColours) {
+        recolour(leds, NUM_LEDS, *old, *palette);
     } else {
-        FastLED.setBrightness(LOW_BRIGHTNESS);
+        ledsScale(brightness == HIGH ? HIGH_BRIGHTNESS : LOW_BRIGHTNESS, LED_CORRECTION);
     }
     oldBrightness = brightness;
-    ledsDirty = true;
+    ledsDirty |= REGION_ALL;
 }
 
 /**
@@ -343,47 +899,118 @@ void configureMatchplayMode() {
  */
 void loop() {
     // While there is serial data available
-    while (Serial.available()) {
-        // Read any data available into the buffer
-        buffer.writeByte(Serial.read());
+    if (Serial.available()) {
+        lastRxMs = millis();
+    }
+#ifdef RX_FRAMER
+    if (rxFramer.seen) {
+        rxFramer.seen = false;
+        lastRxMs = millis();
+    }
+    takeEmergencyStop();
+    if (isrFraming) {
+        takeFrames();
+    }
+#endif
+#ifndef ISR_FRAMING
+    while (!isrFraming && (estopAhead || rxAhead.getReadableBytes() || Serial.available())) {
+        // Read any data available into the buffer, what debug text read ahead first
+        if (!estopAhead) {
+            const byte b = rxAhead.getReadableBytes() ? rxAhead.readByte() : Serial.read();
+            buffer.writeByte(b);
+            benchMark(BENCH_BYTE_READ);
+            estopWindow = estopWindow << 8 | b;
+        }
+
+        // The emergency stop signal is acted on wherever it turns up, and whatever frame it broke into is dropped
+        if (estopAhead || estopWindow == ESTOP_SIGNAL) {
+            estopAhead = false;
+            buffer.clear();
+            expectedSize = -1;
+            fecPacket = false;
+            emergencyStop();
+            continue;
+        }
+
+        // If we have 4 bytes, see if they start an FEC packet
+        if (buffer.getSize() == FEC_HEADER_SIZE && expectedSize == -1 && startsFecPacket(buffer)) {
+            fecPacket = true;
+            expectedSize = FEC_HEADER_SIZE + FEC_LENGTH_SIZE;
+        }
 
         // If we have 5 bytes, try and parse the header
-        if (buffer.getSize() == 5) {
+        if (buffer.getSize() == 5 && !fecPacket) {
             for (int i = 0; i < 4; i++) {
                 byte b = buffer.peekByte(i);
                 if (b != HEADER[i]) {
 #ifdef DEBUG_LOGGING
-                    printBuffer("Header failed: ", buffer);
+                    printBuffer(F("Header failed: "), buffer);
 #endif
                     // If the header doesnt match, remove the leading byte and try again
                     buffer.setReaderIndex(1);
                     buffer.take();
+                    if (startsFecPacket(buffer)) {
+                        fecPacket = true;
+                        expectedSize = FEC_HEADER_SIZE + FEC_LENGTH_SIZE;
+                    }
                     goto cont;
                 }
             }
             // Header validated, grab the size, and exit the loop
             expectedSize = buffer.peekByte(4);
+            if (expectedSize < PACKET_OVERHEAD || expectedSize > PACKET_MAX_SIZE) {
+                // A corrupted size the buffer has already passed, or could never hold, would never be reached, leaving
+                // the receiver deaf
+#ifdef DEBUG_LOGGING
+                printBuffer(F("Size failed: "), buffer);
+#endif
+                expectedSize = -1;
+                buffer.setReaderIndex(1);
+                buffer.take();
+                goto cont;
+            }
 #ifdef VERBOSE_DEBUG_LOGGING
-            Serial.println("Valid packet. Expected size: " + String(expectedSize));
+            debugPrintln(String(F("Valid packet. Expected size: ")) + String(expectedSize));
+#endif
+        }
+
+        // With the length of an FEC packet's frame, work out how much more is to come
+        if (fecPacket && expectedSize == FEC_HEADER_SIZE + FEC_LENGTH_SIZE && (int) buffer.getSize() == expectedSize) {
+            int length = fecDecodeLength(buffer.peekByte(FEC_HEADER_SIZE), buffer.peekByte(FEC_HEADER_SIZE + 1));
+            if (length < 0) {
+#ifdef DEBUG_LOGGING
+                printBuffer(F("FEC length failed: "), buffer);
 #endif
+                buffer.clear();
+                expectedSize = -1;
+                fecPacket = false;
+                goto cont;
+            }
+            expectedSize = fecPacketSize(length);
+            goto cont;
         }
 
-        if (expectedSize != -1 && buffer.getSize() == expectedSize) {
+        if (fecPacket && (int) buffer.getSize() == expectedSize) {
+            handleFecPacket(buffer);
+            buffer.clear();
+            expectedSize = -1;
+            fecPacket = false;
+        } else if (expectedSize != -1 && (int) buffer.getSize() == expectedSize) {
 #ifdef VERBOSE_DEBUG_LOGGING
-            printBuffer("Full packet: ", buffer);
+            printBuffer(F("Full packet: "), buffer);
 #endif
             buffer.skip(5);
             unsigned int expectedChecksum = buffer.readUInt();
 
             unsigned int checksum = makeChecksum(buffer);
 #ifdef VERBOSE_DEBUG_LOGGING
-            Serial.println("Expected checksum: " + String(expectedChecksum) + ", Calculated: " + String(checksum));
+            debugPrintln(String(F("Expected checksum: ")) + String(expectedChecksum) + F(", Calculated: ") + String(checksum));
 #endif
             if (expectedChecksum == checksum) {
 #ifdef VERBOSE_DEBUG_LOGGING
-                Serial.println("Checksum validated.");
+                debugPrintln(F("Checksum validated."));
 #endif
-                handlePacket(buffer);
+                handleFrame(buffer);
             }
 
             // Clear buffer in case of unread bytes
@@ -392,91 +1019,915 @@ void loop() {
         }
         cont:;
     }
+#endif
 
+    handleSchedule();
+    handleClockReport();
+    sendHandoffCopies();
+    handleRound();      // Ahead of the countdown, so a phase ends before its countdown can reach 0
     handleCountDown();
     handleBuzzer();
+    handleAnimations();
     configureBrightness();
     configureMatchplayMode();
 
-    // Only send FastLED updates if the LEDs were changed AND no more packet data is expected.
-    // Too many calls to FastLED.show() fills up the serial buffer and causes packet read failure.
-    if (ledsDirty && expectedSize == -1) {
-        FastLED.show();
-        ledsDirty = false;
+    // Only show the LEDs if they were changed AND no more packet data is expected.
+    // Too many shows fill up the serial buffer and cause packet read failure.
+    if (!showIfClear() && flowHeld && !ledsDirty && !tickHeld) {
+        // Held off for a state that changed nothing
+        flowRelease();
     }
 }
 
 /**
- * Updates the internal state from the received byte buffer, and handles the inputs.
+ * Passes a frame that has passed the checksum on to the handler for its type.
  *
- * @param buf A ByteBuf containing the packet data sent by the Android app.
+ * @param buf A ByteBuf containing the frame's data.
  */
-void handlePacket(ByteBuf &buf) {
-    int data = buf.readInt();
+void handleFrame(ByteBuf &buf) {
+    switch (buf.peekByte(0)) {
+        case FRAME_CLOCK: {
+            if (buf.getReadableBytes() < CLOCK_FRAME_SIZE) return;
+            buf.skip(1);
+            const unsigned long controllerMs = buf.readULong();
+            const unsigned long localMs = millis() - batchLateMs;
+            addClockSample(controllerClock, controllerMs, localMs);
+            addCalibrationSample(calibration, controllerMs, localMs);
+            break;
+        }
 
-    bool oldCountdownContinues = state.countdownContinues;
-    bool oldCountdown = state.countdown;
-    bool oldDetail = state.detail;
-    byte oldColour = state.colour;
-    bool oldTimeEnabled = state.timeEnabled;
-    bool oldTime = state.time;
+        case FRAME_SCHEDULED_STATE:
+            if (buf.getReadableBytes() < SCHEDULED_STATE_FRAME_SIZE) return;
+            buf.skip(1);
+            handleScheduledState(buf);
+            break;
 
-    // Update internal state
-    int detail = data >> 3 & 0x3;
-    if (isBitSet(6, data) && detail != matchplayMode) {
-        // If in matchplay mode and detail does not indicate matchplay mode, ignore the packet
-        return;
-    }
+        case FRAME_PING:
+            if (buf.getReadableBytes() < PING_FRAME_SIZE) return;
+            buf.skip(1);
+            handlePing(buf);
+            break;
 
-    state.countdownContinues = isBitSet(9, data);
-    state.lastEnd = isBitSet(8, data);
-    state.countdown = isBitSet(5, data);
-    // 00 = DETAIL_OFF, 01 = DETAIL_AB, 10 = DETAIL_CD
-    state.detail = detail;
-    // 00 = RED, 01 = AMBER, 10 = GREEN
-    state.colour = data >> 1 & 0x3;
-    state.timeEnabled = isBitSet(0, data);
-    state.time = buf.readInt();
-    state.startNumBeeps = buf.readInt();
-    state.endNumBeeps = buf.readInt();
+        case FRAME_CLOCK_QUERY:
+            if (buf.getReadableBytes() < CLOCK_QUERY_FRAME_SIZE) return;
+            buf.skip(1);
+            handleClockQuery(buf);
+            break;
 
-#ifdef DEBUG_LOGGING
-    Serial.print(data, BIN);
-    Serial.println();
+        case FRAME_GENERATION:
+            if (buf.getReadableBytes() < GENERATION_FRAME_SIZE) return;
+            buf.skip(1);
+            handleGeneration(buf);
+            break;
 
-    Serial.println("Updated State:");
-    Serial.println("  Countdown continues:  " + String(state.countdownContinues));
-    Serial.println("  Last end (matchplay): " + String(state.lastEnd));
-    Serial.println("  Should count down:    " + String(state.countdown));
-    Serial.println("  Detail:               " + String(state.detail == 0 ? "None" : state.detail == 1 ? "A/B" : "C/D"));
-    Serial.println("  Colour:               " + String(state.colour == 0 ? "Red" : state.colour == 1 ? "Amber" : "Green"));
-    Serial.println("  Should show time:     " + String(state.timeEnabled));
-    Serial.println("  Time value:           " + String(state.time));
-#endif
+        case FRAME_ROUND_SCHEDULE:
+            if (buf.getReadableBytes() < ROUND_SCHEDULE_FRAME_SIZE) return;
+            buf.skip(1);
+            handleRoundSchedule(buf);
+            break;
 
-    if (oldCountdownContinues != state.countdownContinues && oldCountdownContinues) {
-        // Last instruction says countdown continues, new one says countdown does not
-        // => ignore new packet countdownContinues to allow for lag between light and controller
-        state.countdownContinues = true;
-    }
+        case FRAME_ROUND_CONTROL:
+            if (buf.getReadableBytes() < ROUND_CONTROL_FRAME_SIZE) return;
+            buf.skip(1);
+            handleRoundControl(buf);
+            break;
 
-    if (isBitSet(7, data)) {
-        //TODO: Properly handle emergency stop (stop countdown)
+        case FRAME_HANDOFF:
+            if (buf.getReadableBytes() < HANDOFF_FRAME_SIZE) return;
+            buf.skip(1);
+            handleHandoff(buf);
+            break;
 
-        // Emergency stop pushed
-        beep(5);
-        enterBlankState();
-        return;
+        case FRAME_BATCH:
+            if (buf.getReadableBytes() < BATCH_FRAME_SIZE) return;
+            buf.skip(1);
+            handleBatch(buf);
+            break;
+
+        case FRAME_CALIBRATE:
+            if (buf.getReadableBytes() < CALIBRATE_FRAME_SIZE) return;
+            buf.skip(1);
+            handleCalibrate(buf);
+            break;
+
+        default:
+            handlePacket(buf);
+            break;
     }
+}
 
-    if ((oldTime != state.time && state.timeEnabled) || (!oldTimeEnabled && state.timeEnabled)) {
+/**
+ * Answers a ping with a pong giving when it arrived and when the pong leaves, and completes the last exchange if
+ * the ping carries the controller's receive time for it.
+ *
+ * Times are those of the first byte of each frame. Bytes already waiting behind the ping, or queued in the TX ring
+ * ahead of the pong, are allowed for.
+ *
+ * @param buf A ByteBuf positioned after the frame type.
+ */
+void handlePing(ByteBuf &buf) {
+    uint16_t id = buf.readUInt();
+    if (id != receiverId && id != ANY_RECEIVER) return;
+    if (id == receiverId) {
+        addressed = true;
+        addressedAt = millis();
+    }
+
+    byte sequence = buf.readByte();
+    unsigned long t1 = buf.readULong();
+    byte lastSequence = buf.readByte();
+    unsigned long t4 = buf.readULong();
+
+    unsigned long now = millis();
+    unsigned long t2 = now - batchLateMs - wireMillis(PACKET_OVERHEAD + PING_FRAME_SIZE + Serial.available());
+    unsigned long t3 = now + wireMillis(SERIAL_TX_BUFFER_SIZE - 1 - Serial.availableForWrite());
+    addPing(controllerClock, sequence, t1, t2, t3, lastSequence, t4);
+
+    replyBuffer.clear();
+    replyBuffer.writeByte(FRAME_PONG);
+    replyBuffer.writeUInt(receiverId);
+    replyBuffer.writeByte(sequence);
+    replyBuffer.writeULong(t1);
+    replyBuffer.writeULong(t2);
+    replyBuffer.writeULong(t3);
+    sendFrame(replyBuffer);
+}
+
+/**
+ * Answers a clock query. A query to every receiver is answered in a slot picked at random, so that the controller can
+ * find the receivers on the line without them all answering at once. Receivers it has found already keep out of the
+ * way of the rest, and one already waiting for its slot keeps it, so each query finds more until all are found.
+ *
+ * @param buf A ByteBuf positioned after the frame type.
+ */
+void handleClockQuery(ByteBuf &buf) {
+    uint16_t id = buf.readUInt();
+    if (id == receiverId) {
+        addressed = true;
+        addressedAt = millis();
+        sendClockReport();
+    } else if (id == ANY_RECEIVER && !reportDue && !discovered()) {
+        reportDue = true;
+        reportAt = millis() + noiseBits() % CLOCK_REPORT_SLOTS * CLOCK_REPORT_SLOT_MS;
+    }
+}
+
+/**
+ * If the controller has addressed this receiver by its id within DISCOVERED_QUIET_MS, so knows of it.
+ */
+bool discovered() {
+    if (addressed && millis() - addressedAt >= DISCOVERED_QUIET_MS) addressed = false;
+    return addressed;
+}
+
+/**
+ * Runs a calibration command. A finish only counts while calibrating, so its repeats are ignored; a correction worked
+ * out from too short a run is thrown away, leaving the last one in place.
+ *
+ * @param buf A ByteBuf positioned after the frame type.
+ */
+void handleCalibrate(ByteBuf &buf) {
+    uint16_t id = buf.readUInt();
+    byte command = buf.readByte();
+    if (id != receiverId && id != ANY_RECEIVER) return;
+
+    long ppm;
+    switch (command) {
+        case CALIBRATE_START:
+            startCalibration(calibration);
+            break;
+
+        case CALIBRATE_FINISH:
+            if (!calibration.running) return;
+            if (!finishCalibration(calibration, ppm)) {
+#ifdef DEBUG_LOGGING
+                debugPrintln(F("Calibration too short"));
+#endif
+                return;
+            }
+            setClockTrim(clockTrim, ppm);
+            storeClockTrim(clockTrim, TRIM_ADDRESS);
+#ifdef DEBUG_LOGGING
+            debugPrintln(String(F("Clock trim: ")) + String(clockTrim.ppm) + F(" ppm"));
+#endif
+            break;
+
+        case CALIBRATE_CLEAR:
+            calibration.running = false;
+            setClockTrim(clockTrim, 0);
+            storeClockTrim(clockTrim, TRIM_ADDRESS);
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ * Sends a clock report waiting for its slot, once the slot comes round.
+ */
+void handleClockReport() {
+    if (!reportDue) return;
+    if ((long) (millis() - reportAt) < 0) {
+        wakeBy(reportAt);
+        return;
+    }
+
+    reportDue = false;
+    sendClockReport();
+}
+
+/**
+ * Reports the receiver's estimate of the controller's clock: the offset now, the round trip of the exchange it
+ * came from (0xFFFF if it came from clock frames alone) and the drift.
+ */
+void sendClockReport() {
+    unsigned long now = millis();
+    replyBuffer.clear();
+    replyBuffer.writeByte(FRAME_CLOCK_REPORT);
+    replyBuffer.writeUInt(receiverId);
+    replyBuffer.writeULong(clockOffset(controllerClock, now));
+    replyBuffer.writeUInt(controllerClock.exchangeCount ? controllerClock.best.roundTrip : 0xFFFF);
+    replyBuffer.writeUInt(constrain(controllerClock.driftPpm, -32768, 32767));
+    replyBuffer.writeByte(controllerClock.exchangeCount);
+    replyBuffer.writeULong(now);
+    sendFrame(replyBuffer);
+}
+
+/**
+ * Frames the data in the buffer the way the controller frames its packets, and sends it.
+ *
+ * @param buf A ByteBuf holding the frame's data.
+ */
+void sendFrame(ByteBuf &buf) {
+    unsigned int checksum = makeChecksum(buf);
+    Serial.write(HEADER, sizeof(HEADER));
+    Serial.write((byte) (buf.getSize() + PACKET_OVERHEAD));
+    Serial.write((byte) (checksum >> 8));
+    Serial.write((byte) checksum);
+    for (size_t i = 0; i < buf.getSize(); i++) {
+        Serial.write(buf.peekByte(i));
+    }
+}
+
+/**
+ * If the first bytes in the buffer are an FEC header.
+ */
+bool startsFecPacket(ByteBuf &buf) {
+    byte header[FEC_HEADER_SIZE];
+    for (byte i = 0; i < FEC_HEADER_SIZE; i++) {
+        header[i] = buf.peekByte(i);
+    }
+    return isFecHeader(header);
+}
+
+/**
+ * Corrects and unpacks the frame in a full FEC packet, and passes it on. The frame is dropped if it could not be
+ * corrected.
+ *
+ * @param buf A ByteBuf holding the whole packet.
+ */
+void handleFecPacket(ByteBuf &buf) {
+    byte length = fecDecodeLength(buf.peekByte(FEC_HEADER_SIZE), buf.peekByte(FEC_HEADER_SIZE + 1));
+    byte body[2 * (FEC_MAX_DATA + 1)];
+    for (byte i = 0; i < fecBodySize(length); i++) {
+        body[i] = buf.peekByte(FEC_HEADER_SIZE + FEC_LENGTH_SIZE + i);
+    }
+    handleFecBody(body, length);
+}
+
+/**
+ * Corrects and unpacks an FEC packet's body, and passes the frame on.
+ *
+ * @param body   The fecBodySize(length) bytes after the length.
+ * @param length The length of the frame.
+ */
+void handleFecBody(const byte *body, byte length) {
+    byte data[FEC_MAX_DATA];
+    int corrected = fecDecodeBody(body, length, data);
+    if (corrected < 0) {
+#ifdef DEBUG_LOGGING
+        debugPrintln(F("FEC failed"));
+#endif
+        return;
+    }
+#ifdef DEBUG_LOGGING
+    if (corrected) {
+        debugPrintln(String(F("FEC corrected ")) + String(corrected) + F(" bits"));
+    }
+#endif
+
+    fecBuffer.clear();
+    for (byte i = 0; i < length; i++) {
+        fecBuffer.writeByte(data[i]);
+    }
+    handleFrame(fecBuffer);
+}
+
+#ifdef RX_FRAMER
+/**
+ * Handles the frames the RX interrupt has framed and checked, oldest first. Each slot is handed back to the
+ * interrupt as soon as its frame is copied out. An emergency stop signal is acted on ahead of the next frame.
+ */
+void takeFrames() {
+    for (;;) {
+        takeEmergencyStop();
+        if (!rxFramer.ready[rxFramer.reading]) return;
+
+        const byte slot = rxFramer.reading;
+        const byte length = rxFramer.slotLength[slot];
+        if (rxFramer.slotFec[slot]) {
+            byte body[RX_SLOT_SIZE];
+            memcpy(body, rxFramer.slots[slot], fecBodySize(length));
+            rxFramer.ready[slot] = false;
+            rxFramer.reading = (rxFramer.reading + 1) % RX_SLOTS;
+            rxFramer.taken++;
+            handleFecBody(body, length);
+        } else {
+            buffer.clear();
+            for (byte i = 0; i < length; i++) {
+                buffer.writeByte(rxFramer.slots[slot][i]);
+            }
+            rxFramer.ready[slot] = false;
+            rxFramer.reading = (rxFramer.reading + 1) % RX_SLOTS;
+            rxFramer.taken++;
+            handleFrame(buffer);
+        }
+    }
+}
+
+/**
+ * Acts on an emergency stop signal the RX interrupt has seen. The frames framed ahead of it are dropped unread: they
+ * are older than the stop, and any of them could otherwise release it.
+ */
+void takeEmergencyStop() {
+    if (!rxFramer.estop) return;
+    rxFramer.estop = false;
+    while (rxFramer.taken != rxFramer.estopFramed) {
+        rxFramer.ready[rxFramer.reading] = false;
+        rxFramer.reading = (rxFramer.reading + 1) % RX_SLOTS;
+        rxFramer.taken++;
+    }
+    emergencyStop();
+}
+#endif
+
+/**
+ * Acts on a state frame held back until its scheduled time.
+ */
+void runCommand(const ScheduledCommand &command) {
+    scheduledBuffer.clear();
+    for (byte i = 0; i < STATE_FRAME_SIZE; ++i) {
+        scheduledBuffer.writeByte(command.data[i]);
+    }
+    runningScheduled = true;
+    handlePacket(scheduledBuffer);
+    runningScheduled = false;
+}
+
+/**
+ * Queues a scheduled state frame until the controller's clock reaches its time.
+ * Without a clock to go by, or with no room to queue it, it is acted on straight away.
+ *
+ * @param buf A ByteBuf positioned after the frame type.
+ */
+void handleScheduledState(ByteBuf &buf) {
+    ScheduledCommand command;
+    command.at = buf.readULong();
+    for (byte i = 0; i < STATE_FRAME_SIZE; ++i) {
+        command.data[i] = buf.readByte();
+    }
+
+    if (!clockSet(controllerClock) || !scheduleCommand(schedule, command)) {
+        runCommand(command);
+    }
+}
+
+/**
+ * Acts on the frame inside a generation frame, unless it is a repeat of the generation last acted on. A repeat
+ * returns here, before anything is parsed or logged, so the controller can repeat its state as often as it likes.
+ * The one exception is a repeat of the generation a held snapshot was taken under, which restores it.
+ *
+ * @param buf A ByteBuf positioned after the frame type.
+ */
+void handleGeneration(ByteBuf &buf) {
+    unsigned int generation = buf.readUInt();
+    if (generationApplied && generation == appliedGeneration) {
+        if (restoreHeld) restoreState();
+        return;
+    }
+    if (buf.peekByte(0) == FRAME_GENERATION) return;
+
+    appliedGeneration = generation;
+    generationApplied = true;
+    handleFrame(buf);
+}
+
+/**
+ * Applies every frame in a batch in turn, or none of them if any is cut short or is of a type a batch cannot carry.
+ * They are all applied in the one pass of loop(), so the LEDs are redrawn once, after the last, and the snapshot in
+ * EEPROM goes straight from the state before the batch to the state after it. A clock frame or ping in a batch is
+ * timed from the start of the batch's packet, as it would be from the start of its own.
+ *
+ * @param buf A ByteBuf positioned after the frame type.
+ */
+void handleBatch(ByteBuf &buf) {
+    if (batching) return;
+    const byte count = buf.readByte();
+    const byte *data = buf.peekBytes();
+    const size_t size = buf.getReadableBytes();
+
+    size_t at = 0;
+    for (byte i = 0; i < count; ++i) {
+        if (at >= size) return;
+        const byte length = data[at];
+        if (at + 1 + length > size || length > BATCH_MAX_SIZE) return;
+        const byte needed = length ? batchedFrameSize(data[at + 1]) : 0;
+        if (!needed || length < needed) return;
+        at += 1 + length;
+    }
+
+    batching = true;
+    batchStateChanged = false;
+    at = 0;
+    for (byte i = 0; i < count; ++i) {
+        const byte length = data[at++];
+        batchBuffer.clear();
+        for (byte j = 0; j < length; ++j) {
+            batchBuffer.writeByte(data[at + j]);
+        }
+        at += length;
+        batchLateMs = wireMillis(BATCH_FRAME_SIZE + size - length);
+        handleFrame(batchBuffer);
+    }
+    batchLateMs = 0;
+    batching = false;
+    persistState();
+#ifdef DEBUG_LOGGING
+    if (batchStateChanged) printState(moreToRead());
+#endif
+}
+
+/**
+ * The size a frame of the given type needs to be acted on, or 0 for a type a batch cannot carry: another batch, or
+ * a frame only receivers send.
+ */
+byte batchedFrameSize(byte type) {
+    switch (type) {
+        case FRAME_CLOCK: return CLOCK_FRAME_SIZE;
+        case FRAME_SCHEDULED_STATE: return SCHEDULED_STATE_FRAME_SIZE;
+        case FRAME_PING: return PING_FRAME_SIZE;
+        case FRAME_CLOCK_QUERY: return CLOCK_QUERY_FRAME_SIZE;
+        case FRAME_GENERATION: return GENERATION_FRAME_SIZE;
+        case FRAME_ROUND_SCHEDULE: return ROUND_SCHEDULE_FRAME_SIZE;
+        case FRAME_ROUND_CONTROL: return ROUND_CONTROL_FRAME_SIZE;
+        case FRAME_HANDOFF: return HANDOFF_FRAME_SIZE;
+        case FRAME_CALIBRATE: return CALIBRATE_FRAME_SIZE;
+        default: return type < FRAME_CLOCK ? STATE_FRAME_SIZE : 0;
+    }
+}
+
+/**
+ * Runs any scheduled state frames that have fallen due.
+ */
+void handleSchedule() {
+    if (!schedule.size) return;
+
+    unsigned long now = controllerMillis(controllerClock, millis());
+    while (commandDue(schedule, now)) {
+        ScheduledCommand command = schedule.commands[0];
+        popCommand(schedule);
+        runCommand(command);
+    }
+    if (schedule.size) wakeBy(schedule.commands[0].at - clockOffset(controllerClock, millis()));
+}
+
+/**
+ * Takes a round schedule uploaded by the controller, and keeps it in EEPROM. The controller repeats the upload, and
+ * a copy of the schedule already held is ignored, so it does not send the round back to its first end.
+ *
+ * @param buf A ByteBuf positioned after the frame type.
+ */
+void handleRoundSchedule(ByteBuf &buf) {
+    RoundScheduleFrame schedule;
+    schedule.ends = buf.readByte();
+    schedule.walkUp = buf.readByte();
+    schedule.maxTime = buf.readUInt();
+    schedule.warnTime = buf.readUInt();
+    schedule.options = buf.readUInt();
+    if (schedule.ends == 0 || schedule.maxTime == 0) return;
+    if (roundState.loaded && sameSchedule(schedule, roundState.schedule)) return;
+
+    newRound(roundState, schedule);
+    storeRound(schedule, ROUND_ADDRESS);
+
+#ifdef DEBUG_LOGGING
+    debugPrintln(String(F("Round: ")) + String(schedule.ends) + F(" ends of ") + String(schedule.maxTime) + F("s"));
+#endif
+}
+
+/**
+ * Acts on a command for the round, at the controller's time for it if the receiver has a clock to go by.
+ * Repeats of the command last acted on are ignored.
+ *
+ * @param buf A ByteBuf positioned after the frame type.
+ */
+void handleRoundControl(ByteBuf &buf) {
+    byte sequence = buf.readByte();
+    byte command = buf.readByte();
+    unsigned long at = buf.readULong();
+    if (roundState.commandSeen && sequence == roundState.lastSequence) return;
+
+    roundState.lastSequence = sequence;
+    roundState.commandSeen = true;
+    if (clockSet(controllerClock) && scheduledBefore(controllerMillis(controllerClock, millis()), at)) {
+        roundState.pendingCommand = command;
+        roundState.pendingAt = at;
+    } else {
+        runRoundCommand(command);
+    }
+}
+
+/**
+ * Starts, pauses, skips on or stops the round.
+ *
+ * @param command One of the ROUND_* commands.
+ */
+void runRoundCommand(byte command) {
+    if (!roundState.loaded) return;
+    unsigned long now = millis();
+
+    switch (command) {
+        case ROUND_START:
+            if (roundState.paused) {
+                // Carry on from where the pause left the phase and the countdown
+                unsigned long pausedFor = now - roundState.pausedAt;
+                roundState.phaseStart += pausedFor;
+                startTime += pausedFor;
+                roundState.paused = false;
+                state.countdown = true;
+                updateColourFromState();
+                updateDetailFromState();
+                displayNumber(leds, state.time);
+                ledsDirty |= REGION_NUMBER;
+                persistState();
+            } else if (roundState.phase == PHASE_WAITING) {
+                roundState.turn = 0;
+                startRoundPhase(PHASE_WALK_UP, now);
+            }
+            break;
+
+        case ROUND_PAUSE:
+            if (!roundRunning(roundState) || roundState.paused) return;
+            roundState.paused = true;
+            roundState.pausedAt = now;
+            state.countdown = false;
+            persistState();
+            break;
+
+        case ROUND_SKIP:
+            if (!roundRunning(roundState)) return;
+            roundState.paused = false;
+            if (roundState.phase == PHASE_WALK_UP) {
+                startRoundPhase(PHASE_SHOOT, now);
+            } else {
+                finishTurn(now);
+            }
+            break;
+
+        case ROUND_STOP:
+            if (roundRunning(roundState)) {
+                byte oldColour = state.colour;
+                state.countdown = false;
+                enterBlankState();
+                fadeOutLight(oldColour);
+                persistState();
+            }
+            newRound(roundState, roundState.schedule);
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ * Runs a round command that has fallen due, and moves the round on once its phase has run its length.
+ * A phase that ends on time starts the next from its deadline, rather than from now, so an end of several phases
+ * does not gather the loop's latency.
+ */
+void handleRound() {
+    unsigned long now = millis();
+    if (roundState.pendingCommand &&
+        !scheduledBefore(controllerMillis(controllerClock, now), roundState.pendingAt)) {
+        byte command = roundState.pendingCommand;
+        roundState.pendingCommand = 0;
+        runRoundCommand(command);
+    }
+    if (roundState.pendingCommand) wakeBy(roundState.pendingAt - clockOffset(controllerClock, now));
+    if (roundRunning(roundState) && !roundState.paused) wakeBy(phaseEnd(roundState, clockTrim));
+    if (!phaseDue(roundState, now, clockTrim)) return;
+
+    unsigned long deadline = phaseEnd(roundState, clockTrim);
+    if (roundState.phase == PHASE_WALK_UP) {
+        startRoundPhase(PHASE_SHOOT, deadline);
+    } else if (roundState.phase == PHASE_SHOOT && roundWarns(roundState.schedule)) {
+        startRoundPhase(PHASE_WARN, deadline);
+    } else {
+        finishTurn(deadline);
+    }
+}
+
+/**
+ * Puts the lights into a phase of the round. The walk-up and shooting each start a countdown of their own, which
+ * the round ends before it reaches 0; the warning only changes the colour.
+ *
+ * @param phase The PHASE_* to enter.
+ * @param start When the phase started, by millis().
+ */
+void startRoundPhase(byte phase, unsigned long start) {
+    const RoundScheduleFrame &schedule = roundState.schedule;
+    roundState.phase = phase;
+    roundState.phaseStart = start;
+
+    if (phase == PHASE_WARN) {
+        state.colour = AMBER;
+        updateColourFromState();
+    } else {
+        bool walkUp = phase == PHASE_WALK_UP;
+        state.countdown = true;
+        state.countdownContinues = walkUp;      // Only the shooting flashes its final seconds
+        state.timeEnabled = true;
+        state.detail = roundDetail(schedule, roundState.end, roundState.turn);
+        state.colour = walkUp ? AMBER : GREEN;
+        state.time = walkUp ? schedule.walkUp : schedule.maxTime;
+        state.startNumBeeps = walkUp ? roundScheduleWalkUpBeeps(schedule.options)
+                                     : roundScheduleShootBeeps(schedule.options);
+        state.endNumBeeps = 0;
+        startTime = start;
+        startFraction = 0;
+        updateColourFromState();
+        updateDetailFromState();
         displayNumber(leds, state.time);
-        ledsDirty = true;
+        ledsDirty |= REGION_NUMBER;
+        beep(state.startNumBeeps);
+    }
+    persistState();
+
+#ifdef DEBUG_LOGGING
+    debugPrintln(String(F("Round end ")) + String(roundState.end + 1) + F(", phase ") + String(phase));
+#endif
+}
+
+/**
+ * Ends the shooting of the detail whose turn it is. The next detail walks up, or after the last the end is over:
+ * the lights go red, and then show the next end's first detail and time until the controller starts it.
+ *
+ * @param start When the detail's time ran out, by millis().
+ */
+void finishTurn(unsigned long start) {
+    const RoundScheduleFrame &schedule = roundState.schedule;
+    if (++roundState.turn < detailsPerEnd(schedule)) {
+        startRoundPhase(PHASE_WALK_UP, start);
+        return;
+    }
+
+    roundState.turn = 0;
+    roundState.end++;
+    roundState.phase = roundState.end < schedule.ends ? PHASE_WAITING : PHASE_DONE;
+
+    byte oldColour = state.colour;
+    state.countdown = false;
+    state.time = schedule.maxTime;
+    state.detail = roundState.phase == PHASE_WAITING ? roundDetail(schedule, roundState.end, 0) : DETAIL_OFF;
+    state.endNumBeeps = roundScheduleEndBeeps(schedule.options);
+    beep(state.endNumBeeps);
+    enterBlankState();
+    fadeOutLight(oldColour);
+    persistState();
+
+#ifdef DEBUG_LOGGING
+    debugPrintln(String(F("Round end ")) + String(roundState.end) + F(" finished"));
+#endif
+}
+
+/**
+ * Takes the matchplay turn when a handoff names this receiver's side, unless the emergency stop is held. Handoffs
+ * to the other side are only noted, so that a late copy of one is not taken for a new turn.
+ *
+ * @param buf A ByteBuf positioned after the frame type.
+ */
+void handleHandoff(ByteBuf &buf) {
+    HandoffFrame frame;
+    frame.side = buf.readByte();
+    frame.turnsLeft = buf.readByte();
+    frame.time = buf.readUInt();
+    frame.sequence = buf.readByte();
+    if (handoff.sequenceSeen && frame.sequence == handoff.sequence) return;
+
+    handoff.sequence = frame.sequence;
+    handoff.sequenceSeen = true;
+    if (frame.side != matchplayMode || frame.time <= 0 || (activeAnimations & ANIMATION_ESTOP)) return;
+
+    handoff.turnsLeft = frame.turnsLeft;
+    handoff.time = frame.time;
+    startHandoffTurn();
+}
+
+/**
+ * Starts this side's shooter on its turn: green, with the turn's time counting down. There is no beep, as the
+ * shooter watches the lights to know when the other side has shot.
+ */
+void startHandoffTurn() {
+    handoff.shooting = true;
+    if (roundRunning(roundState)) {
+        roundState.phase = PHASE_WAITING;
+        roundState.turn = 0;
+        roundState.paused = false;
+    }
+    stopAnimation(ANIMATION_LAMP_FADE | ANIMATION_FINAL_SECONDS);
+
+    state.countdown = true;
+    state.countdownContinues = false;
+    state.detail = matchplayMode;
+    state.colour = GREEN;
+    state.timeEnabled = true;
+    state.time = handoff.time;
+    state.startNumBeeps = 0;
+    state.endNumBeeps = 0;
+    startTime = millis();
+    startFraction = 0;
+    updateColourFromState();
+    updateDetailFromState();
+    displayNumber(leds, state.time);
+    ledsDirty |= REGION_NUMBER;
+    persistState();
+
+#ifdef DEBUG_LOGGING
+    debugPrintln(String(F("Turn ")) + String(handoff.sequence) + F(", ") + String(handoff.turnsLeft) + F(" to come"));
+#endif
+}
+
+/**
+ * Ends this side's turn, and hands the next one to the partner, or after the last turn beeps the end of the match.
+ * The first copy of the handoff is queued before anything else, so it goes out ahead of the debug output.
+ */
+void passTurn() {
+    handoff.shooting = false;
+    byte oldColour = state.colour;
+    state.countdown = false;
+
+    if (handoff.turnsLeft > 0) {
+        handoff.sent.side = partnerSide(matchplayMode);
+        handoff.sent.turnsLeft = handoff.turnsLeft - 1;
+        handoff.sent.time = handoff.time;
+        handoff.sent.sequence = handoff.sequence + 1;
+        handoff.sequence = handoff.sent.sequence;
+        handoff.copiesLeft = HANDOFF_COPIES;
+        handoff.nextCopyAt = millis();
+        sendHandoffCopies();
+    } else {
+        state.endNumBeeps = MATCH_END_BEEPS;
+        beep(state.endNumBeeps);
+    }
+    enterBlankState();
+    fadeOutLight(oldColour);
+    persistState();
+}
+
+/**
+ * Sends the next copy of the last handoff, once it is due.
+ */
+void sendHandoffCopies() {
+    if (!handoff.copiesLeft) return;
+    if (scheduledBefore(millis(), handoff.nextCopyAt)) {
+        wakeBy(handoff.nextCopyAt);
+        return;
+    }
+
+    replyBuffer.clear();
+    replyBuffer.writeByte(FRAME_HANDOFF);
+    replyBuffer.writeByte(handoff.sent.side);
+    replyBuffer.writeByte(handoff.sent.turnsLeft);
+    replyBuffer.writeUInt(handoff.sent.time);
+    replyBuffer.writeByte(handoff.sent.sequence);
+    sendFrame(replyBuffer);
+    handoff.copiesLeft--;
+    handoff.nextCopyAt += HANDOFF_GAP_MS;
+}
+
+/**
+ * Updates the internal state from the received byte buffer, and handles the inputs.
+ *
+ * @param buf A ByteBuf containing the packet data sent by the Android app.
+ */
+void handlePacket(ByteBuf &buf) {
+    BENCH_SCOPE(BENCH_HANDLE_PACKET);
+    if (buf.getReadableBytes() < STATE_FRAME_SIZE) return;
+    StateFrame frame;
+    decodeStateFrame(buf.peekBytes(), frame);
+    buf.skip(STATE_FRAME_SIZE);
+    uint16_t flags = frame.flags;
+
+    bool oldCountdownContinues = state.countdownContinues;
+    bool oldCountdown = state.countdown;
+    byte oldDetail = state.detail;
+    byte oldColour = state.colour;
+    bool oldTimeEnabled = state.timeEnabled;
+    int oldTime = state.time;
+
+    // Update internal state
+    byte detail = stateDetail(flags);
+    if (stateMatchplay(flags) && detail != matchplayMode) {
+        // If in matchplay mode and detail does not indicate matchplay mode, ignore the packet
+        return;
+    }
+
+    // A matchplay turn the controller stops is over just as if its time had run out. Any other state takes the
+    // lights back from the turns.
+    if (handoff.shooting) {
+        if (stateMatchplay(flags) && !stateCountdown(flags) && !stateEmergencyStop(flags)) {
+            passTurn();
+            return;
+        }
+        handoff.shooting = false;
+    }
+
+    // The controller has taken the lights back from the round, which waits to start the end again
+    if (roundRunning(roundState)) {
+        roundState.phase = PHASE_WAITING;
+        roundState.turn = 0;
+        roundState.paused = false;
+    }
+
+    state.countdownContinues = stateCountdownContinues(flags);
+    state.lastEnd = stateLastEnd(flags);
+    state.countdown = stateCountdown(flags);
+    state.detail = detail;
+    state.colour = stateColour(flags);
+    state.timeEnabled = stateTimeEnabled(flags);
+    state.time = frame.time;
+    state.startNumBeeps = frame.startNumBeeps;
+    state.endNumBeeps = frame.endNumBeeps;
+
+#ifdef DEBUG_LOGGING
+    if (batching) {
+        // A batch logs the state it leaves once, at its end
+        batchStateChanged = true;
+    } else if (!stateEmergencyStop(flags)) {
+        // A show the USART cannot ride out, whether already waiting or one this state makes, holds the controller off
+        // ahead of the log; otherwise the hold would only go out once the log had drained. A state that leaves no
+        // such show holds nothing. A scheduled state is cut short too, as however much of the ring the last log
+        // still fills would otherwise hold it up. A stop is logged once it is shown instead.
+        const bool brief = moreToRead() || runningScheduled;
+        byte regions = ledsDirty;
+        if (state.time != oldTime || state.timeEnabled != oldTimeEnabled || state.countdown != oldCountdown) {
+            regions |= REGION_NUMBER;
+        }
+        if (state.colour != oldColour) regions |= REGION_LIGHTS;
+        if (activeAnimations & ANIMATION_ESTOP) regions |= REGION_LIGHTS | REGION_NUMBER;
+        if (state.detail != oldDetail || (oldCountdown && !state.countdown)) regions |= REGION_DETAIL;
+        if (regions && longestChain(regions) > FLOW_SAFE_LEDS) flowHold();
+        if (!brief) {
+            debugPrintln(String(flags, BIN));
+        }
+        printState(brief);
+    }
+#endif
+
+    if (oldCountdownContinues != state.countdownContinues && oldCountdownContinues) {
+        // Last instruction says countdown continues, new one says countdown does not
+        // => ignore new packet countdownContinues to allow for lag between light and controller
+        state.countdownContinues = true;
+    }
+
+    if (stateEmergencyStop(flags)) {
+        emergencyStop();
+#ifdef DEBUG_LOGGING
+        if (!batching) printState(true);
+#endif
+        return;
+    }
+
+    if (activeAnimations & ANIMATION_ESTOP) {
+        // Emergency stop released
+        stopAnimation(ANIMATION_ESTOP);
+        updateColourFromState();
+        clearNumber(leds);
+        ledsDirty |= REGION_NUMBER;
+    }
+
+    if ((oldTime != state.time && state.timeEnabled) || (!oldTimeEnabled && state.timeEnabled)) {
+        // Leave the time hidden if it is flashing and currently off
+        if (!(activeAnimations & ANIMATION_FINAL_SECONDS) || numberShown(leds)) {
+            displayNumber(leds, state.time);
+            ledsDirty |= REGION_NUMBER;
+        }
     }
 
     if (oldTimeEnabled && !state.timeEnabled) {
         clearNumber(leds);
-        ledsDirty = true;
+        ledsDirty |= REGION_NUMBER;
     }
 
     if (oldColour != state.colour) {
@@ -490,15 +1941,182 @@ void handlePacket(ByteBuf &buf) {
     if (oldCountdown != state.countdown) {
         if (state.countdown) {
             startTime = millis();
+            startFraction = 0;
             state.time -= 1;
             beep(state.startNumBeeps);
             displayNumber(leds, state.time);
-            ledsDirty = true;
+            ledsDirty |= REGION_NUMBER;
         } else {
             beep(state.endNumBeeps);
             enterBlankState();
         }
     }
+
+    if (state.colour == RED) {
+        fadeOutLight(oldColour);
+    }
+
+    persistState();
+}
+
+/**
+ * Stops everything for an emergency: the countdown, anything scheduled, the uploaded round and any matchplay turn.
+ * The display goes blank but for "StP" on the number and the red lit, and goes out straight away rather than at the
+ * end of loop(). Packets sent while the stop is held carry it too, and change nothing.
+ */
+void emergencyStop() {
+    if (activeAnimations & ANIMATION_ESTOP) return;
+
+    state.countdown = false;
+    state.countdownContinues = false;
+    schedule.size = 0;
+    if (roundRunning(roundState)) {
+        roundState.phase = PHASE_WAITING;
+        roundState.turn = 0;
+        roundState.paused = false;
+    }
+    roundState.pendingCommand = 0;
+    handoff.shooting = false;
+    handoff.copiesLeft = 0;
+
+    stopAnimation(ANIMATION_LAMP_FADE | ANIMATION_FINAL_SECONDS);
+    beep(5);
+    enterBlankState();
+    displayText(leds, PSTR("StP"));
+    estopStart = millis();
+    startAnimation(ANIMATION_ESTOP);
+    benchMark(BENCH_SHOW);
+    showChains();
+    benchMark(BENCH_SHOW | BENCH_END);
+    persistState();
+#ifdef DEBUG_LOGGING
+    debugPrintln(F("Emergency stop"));
+#endif
+}
+
+/**
+ * Debugging method to print the state.
+ *
+ * @param brief Only print the time. The whole state takes a quarter of a second on the wire, which loop() spends
+ *              waiting on the TX ring rather than reading.
+ */
+void printState(bool brief) {
+    if (brief) {
+        debugPrintln(String(F("Time value: ")) + String(state.time));
+        return;
+    }
+    debugPrintln(F("Updated State:"));
+    debugPrintln(String(F("  Countdown continues:  ")) + String(state.countdownContinues));
+    debugPrintln(String(F("  Last end (matchplay): ")) + String(state.lastEnd));
+    debugPrintln(String(F("  Should count down:    ")) + String(state.countdown));
+    debugPrintln(String(F("  Detail:               ")) +
+                 (state.detail == 0 ? F("None") : state.detail == 1 ? F("A/B") : F("C/D")));
+    debugPrintln(String(F("  Colour:               ")) +
+                 (state.colour == 0 ? F("Red") : state.colour == 1 ? F("Amber") : F("Green")));
+    debugPrintln(String(F("  Should show time:     ")) + String(state.timeEnabled));
+    debugPrintln(String(F("  Time value:           ")) + String(state.time));
+}
+
+/**
+ * Write a byte of debug text, unless the TX ring is full while the emergency stop signal may be waiting to be read.
+ * The stop would otherwise wait behind the text for as long as the text takes on the wire. A write only waits while
+ * the ring is full, and then for the one byte going out, so the signal is held up by a byte's time at most.
+ *
+ * @return If it went out.
+ */
+bool debugWrite(char c) {
+    if (!Serial.availableForWrite() && stopPending()) return false;
+    Serial.write(c);
+    return true;
+}
+
+/**
+ * Write debug text, dropping the rest of it once a byte cannot go out (debugWrite()).
+ *
+ * @return If all of it went out.
+ */
+bool debugPrint(const char *text) {
+    for (; *text; text++) {
+        if (!debugWrite(*text)) return false;
+    }
+    return true;
+}
+
+/**
+ * Write debug text kept in flash (F("...")), as debugPrint() does text in SRAM.
+ */
+bool debugPrint(const __FlashStringHelper *text) {
+    for (const char *c = reinterpret_cast<const char *>(text); pgm_read_byte(c); c++) {
+        if (!debugWrite(pgm_read_byte(c))) return false;
+    }
+    return true;
+}
+
+/**
+ * Write a line of debug text, as debugPrint(). A line cut short is left unfinished.
+ */
+void debugPrintln(const String &line) {
+    if (debugPrint(line.c_str())) debugPrint(F("\r\n"));
+}
+
+void debugPrintln(const __FlashStringHelper *line) {
+    if (debugPrint(line)) debugPrint(F("\r\n"));
+}
+
+/**
+ * If the emergency stop signal has arrived, and loop() has yet to stop. The RX interrupt looks for it as each byte
+ * arrives. Otherwise what Serial has is read on into rxAhead, with the signal looked for as loop() would, so that it
+ * is found even behind other frames. Those are older than the stop, and dropped with it as takeEmergencyStop() does.
+ * A state with emergencyStop set is only known once loop() has the whole frame, so it still waits behind the text.
+ */
+bool stopPending() {
+#ifdef RX_FRAMER
+    if (rxFramer.estop) return true;
+#endif
+#ifdef ISR_FRAMING
+    return false;
+#else
+    if (estopAhead) return true;
+    if (isrFraming) return false;
+
+    if (!rxAhead.getReadableBytes()) aheadWindow = estopWindow;
+    rxAhead.take();
+    while (Serial.available() && rxAhead.getWriteableBytes()) {
+        const byte b = Serial.read();
+        rxAhead.writeByte(b);
+        aheadWindow = aheadWindow << 8 | b;
+        if (aheadWindow == ESTOP_SIGNAL) {
+            rxAhead.clear();
+            estopAhead = true;
+            return true;
+        }
+    }
+    return false;
+#endif
+}
+
+/**
+ * If debug text should be cut short: more has arrived than loop() has yet read, or the last of the debug text is
+ * still going out, as it does when the controller sends faster than the text can keep up with.
+ */
+bool moreToRead() {
+#ifdef RX_FRAMER
+    if (rxFramerBusy(rxFramer) || rxFramer.ready[rxFramer.reading] || rxFramer.estop) return true;
+#endif
+#ifndef ISR_FRAMING
+    if (rxAhead.getReadableBytes()) return true;
+#endif
+    return Serial.available() || Serial.availableForWrite() < SERIAL_TX_BUFFER_SIZE - 1;
+}
+
+/**
+ * If a packet is part-way in, whether loop() or the RX interrupt is framing it.
+ */
+bool packetPartWay() {
+#ifdef RX_FRAMER
+    if (rxFramerBusy(rxFramer)) return true;
+#endif
+    return expectedSize != -1;
 }
 
 /**
@@ -507,17 +2125,15 @@ void handlePacket(ByteBuf &buf) {
  * @param prefix Message string indicating the reason for error.
  * @param buf    A ByteBuf containing the packet data sent by the Android app.
  */
-void printBuffer(const String &prefix, ByteBuf &buf) {
-    Serial.print(prefix);
+void printBuffer(const __FlashStringHelper *prefix, ByteBuf &buf) {
+    if (!debugPrint(prefix)) return;
     for (int i = 0; i < buf.getSize(); i++) {
         byte b = buf.peekByte(i);
-        if (i) {
-            Serial.print(' ');
-        }
-        Serial.print(HEX_CHARS[(b >> 4) & 0x0F]);
-        Serial.print(HEX_CHARS[b & 0x0F]);
+        const char hex[] = {' ', (char) pgm_read_byte(&HEX_CHARS[(b >> 4) & 0x0F]),
+                            (char) pgm_read_byte(&HEX_CHARS[b & 0x0F]), 0};
+        if (!debugPrint(i ? hex : hex + 1)) return;
     }
-    Serial.println();
+    debugPrint(F("\r\n"));
 }
 
 /**
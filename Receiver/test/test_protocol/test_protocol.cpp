@@ -0,0 +1,244 @@
+#include <Protocol.h>
+#include <unity.h>
+
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+/**
+ * Round-trips every field of every frame in Protocol.h through its encoder and decoder, at its extremes and at random
+ * values. State flags are also checked bit field by bit field, and against the packing the app does.
+ *
+ * Run with `pio test -e native-test`.
+ */
+
+// Random values per field, on top of the extremes
+static const int RANDOM_ROUNDS = 1000;
+
+static std::mt19937 rng;
+
+void setUp() {
+    rng.seed(1);
+}
+
+void tearDown() {}
+
+/**
+ * The values to try for a field: zero, its extremes, every single bit, and random ones.
+ */
+template<typename T>
+static std::vector<T> values() {
+    std::vector<T> out = {0, std::numeric_limits<T>::min(), std::numeric_limits<T>::max()};
+    for (size_t bit = 0; bit < 8 * sizeof(T); ++bit) {
+        out.push_back((T) ((uint64_t) 1 << bit));
+    }
+    for (int i = 0; i < RANDOM_ROUNDS; ++i) {
+        out.push_back((T) rng());
+    }
+    return out;
+}
+
+static void expect(bool ok, const char *frame, const char *field, long long value) {
+    char message[80];
+    snprintf(message, sizeof(message), "%s.%s did not round-trip %lld", frame, field, value);
+    TEST_ASSERT_TRUE_MESSAGE(ok, message);
+}
+
+/**
+ * Round-trip one field of a frame, the rest of the frame holding random bytes, and check the frame's type byte and
+ * size come out right.
+ */
+template<typename Frame, typename T>
+static void field(const char *frameName, const char *fieldName, T Frame::*member, byte type, byte size,
+                  void (*encode)(const Frame &, byte *), void (*decode)(const byte *, Frame &)) {
+    for (T value : values<T>()) {
+        Frame in;
+        memset(&in, 0, sizeof(in));
+        in.*member = value;
+        byte data[32];
+        memset(data, 0xA5, sizeof(data));
+        encode(in, data);
+        Frame out;
+        decode(data, out);
+        expect(out.*member == value && data[size] == 0xA5 && (type == 0 || data[0] == type), frameName, fieldName,
+               (long long) value);
+    }
+}
+
+/**
+ * Set each value a bit field can hold over random flags, and check it reads back with the other bits untouched.
+ */
+template<typename T>
+static void bits(const char *name, uint16_t mask, T (*get)(uint16_t), uint16_t (*with)(uint16_t, T)) {
+    const int count = (mask >> __builtin_ctz(mask)) + 1;
+    for (int i = 0; i < RANDOM_ROUNDS; ++i) {
+        const uint16_t flags = (uint16_t) rng();
+        for (int value = 0; value < count; ++value) {
+            const uint16_t set = with(flags, (T) value);
+            TEST_ASSERT_TRUE_MESSAGE(get(set) == (T) value && (set & ~mask) == (flags & ~mask), name);
+        }
+    }
+}
+
+#define FIELD(frame, member, type, size) \
+    field<frame##Frame>(#frame, #member, &frame##Frame::member, type, size, encode##frame##Frame, decode##frame##Frame)
+
+void testStateFields() {
+    FIELD(State, flags, 0, STATE_FRAME_SIZE);
+    FIELD(State, time, 0, STATE_FRAME_SIZE);
+    FIELD(State, startNumBeeps, 0, STATE_FRAME_SIZE);
+    FIELD(State, endNumBeeps, 0, STATE_FRAME_SIZE);
+}
+
+void testStateBits() {
+    bits<bool>("timeEnabled", STATE_TIME_ENABLED_MASK, stateTimeEnabled, withStateTimeEnabled);
+    bits<byte>("colour", STATE_COLOUR_MASK, stateColour, withStateColour);
+    bits<byte>("detail", STATE_DETAIL_MASK, stateDetail, withStateDetail);
+    bits<bool>("countdown", STATE_COUNTDOWN_MASK, stateCountdown, withStateCountdown);
+    bits<bool>("matchplay", STATE_MATCHPLAY_MASK, stateMatchplay, withStateMatchplay);
+    bits<bool>("emergencyStop", STATE_EMERGENCY_STOP_MASK, stateEmergencyStop, withStateEmergencyStop);
+    bits<bool>("lastEnd", STATE_LAST_END_MASK, stateLastEnd, withStateLastEnd);
+    bits<bool>("countdownContinues", STATE_COUNTDOWN_CONTINUES_MASK, stateCountdownContinues,
+               withStateCountdownContinues);
+}
+
+/**
+ * The generated flags against the app's SerialState.pack(), written out the same way here.
+ */
+void testAppPacking() {
+    for (int i = 0; i < RANDOM_ROUNDS; ++i) {
+        const bool countdownContinues = rng() & 1;
+        const bool lastEnd = rng() & 1;
+        const bool emergencyStop = rng() & 1;
+        const bool matchplay = rng() & 1;
+        const bool countdown = rng() & 1;
+        const byte detail = rng() % 3;
+        const byte colour = rng() % 3;
+        const bool timeEnabled = rng() & 1;
+
+        uint16_t packed = 0;
+        packed |= (countdownContinues ? 1 : 0) << 9;
+        packed |= (lastEnd ? 1 : 0) << 8;
+        packed |= (emergencyStop ? 1 : 0) << 7;
+        packed |= (matchplay ? 1 : 0) << 6;
+        packed |= (countdown ? 1 : 0) << 5;
+        packed |= detail << 3;
+        packed |= colour << 1;
+        packed |= timeEnabled ? 1 : 0;
+
+        uint16_t flags = 0;
+        flags = withStateCountdownContinues(flags, countdownContinues);
+        flags = withStateLastEnd(flags, lastEnd);
+        flags = withStateEmergencyStop(flags, emergencyStop);
+        flags = withStateMatchplay(flags, matchplay);
+        flags = withStateCountdown(flags, countdown);
+        flags = withStateDetail(flags, detail);
+        flags = withStateColour(flags, colour);
+        flags = withStateTimeEnabled(flags, timeEnabled);
+        TEST_ASSERT_EQUAL_HEX16(packed, flags);
+    }
+}
+
+void testClock() {
+    FIELD(Clock, controllerMs, FRAME_CLOCK, CLOCK_FRAME_SIZE);
+}
+
+void testScheduledState() {
+    FIELD(ScheduledState, at, FRAME_SCHEDULED_STATE, SCHEDULED_STATE_FRAME_SIZE);
+    // The embedded state frame, one of its fields at a time
+    for (int16_t time : values<int16_t>()) {
+        ScheduledStateFrame in = {};
+        in.state.time = time;
+        byte data[SCHEDULED_STATE_FRAME_SIZE];
+        encodeScheduledStateFrame(in, data);
+        StateFrame state;
+        decodeStateFrame(data + SCHEDULED_STATE_STATE_OFFSET, state);
+        expect(state.time == time, "ScheduledState", "state.time", time);
+    }
+}
+
+void testPing() {
+    FIELD(Ping, receiverId, FRAME_PING, PING_FRAME_SIZE);
+    FIELD(Ping, sequence, FRAME_PING, PING_FRAME_SIZE);
+    FIELD(Ping, t1, FRAME_PING, PING_FRAME_SIZE);
+    FIELD(Ping, lastSequence, FRAME_PING, PING_FRAME_SIZE);
+    FIELD(Ping, t4, FRAME_PING, PING_FRAME_SIZE);
+}
+
+void testPong() {
+    FIELD(Pong, receiverId, FRAME_PONG, PONG_FRAME_SIZE);
+    FIELD(Pong, sequence, FRAME_PONG, PONG_FRAME_SIZE);
+    FIELD(Pong, t1, FRAME_PONG, PONG_FRAME_SIZE);
+    FIELD(Pong, t2, FRAME_PONG, PONG_FRAME_SIZE);
+    FIELD(Pong, t3, FRAME_PONG, PONG_FRAME_SIZE);
+}
+
+void testClockQuery() {
+    FIELD(ClockQuery, receiverId, FRAME_CLOCK_QUERY, CLOCK_QUERY_FRAME_SIZE);
+}
+
+void testClockReport() {
+    FIELD(ClockReport, receiverId, FRAME_CLOCK_REPORT, CLOCK_REPORT_FRAME_SIZE);
+    FIELD(ClockReport, offset, FRAME_CLOCK_REPORT, CLOCK_REPORT_FRAME_SIZE);
+    FIELD(ClockReport, roundTrip, FRAME_CLOCK_REPORT, CLOCK_REPORT_FRAME_SIZE);
+    FIELD(ClockReport, driftPpm, FRAME_CLOCK_REPORT, CLOCK_REPORT_FRAME_SIZE);
+    FIELD(ClockReport, exchanges, FRAME_CLOCK_REPORT, CLOCK_REPORT_FRAME_SIZE);
+    FIELD(ClockReport, millis, FRAME_CLOCK_REPORT, CLOCK_REPORT_FRAME_SIZE);
+}
+
+void testGeneration() {
+    // Only the generation itself; the frame that follows is checked as its own type
+    FIELD(Generation, generation, FRAME_GENERATION, GENERATION_GENERATION_OFFSET + 2);
+}
+
+void testRoundSchedule() {
+    FIELD(RoundSchedule, ends, FRAME_ROUND_SCHEDULE, ROUND_SCHEDULE_FRAME_SIZE);
+    FIELD(RoundSchedule, walkUp, FRAME_ROUND_SCHEDULE, ROUND_SCHEDULE_FRAME_SIZE);
+    FIELD(RoundSchedule, maxTime, FRAME_ROUND_SCHEDULE, ROUND_SCHEDULE_FRAME_SIZE);
+    FIELD(RoundSchedule, warnTime, FRAME_ROUND_SCHEDULE, ROUND_SCHEDULE_FRAME_SIZE);
+    FIELD(RoundSchedule, options, FRAME_ROUND_SCHEDULE, ROUND_SCHEDULE_FRAME_SIZE);
+}
+
+void testRoundControl() {
+    FIELD(RoundControl, sequence, FRAME_ROUND_CONTROL, ROUND_CONTROL_FRAME_SIZE);
+    FIELD(RoundControl, command, FRAME_ROUND_CONTROL, ROUND_CONTROL_FRAME_SIZE);
+    FIELD(RoundControl, at, FRAME_ROUND_CONTROL, ROUND_CONTROL_FRAME_SIZE);
+}
+
+void testHandoff() {
+    FIELD(Handoff, side, FRAME_HANDOFF, HANDOFF_FRAME_SIZE);
+    FIELD(Handoff, turnsLeft, FRAME_HANDOFF, HANDOFF_FRAME_SIZE);
+    FIELD(Handoff, time, FRAME_HANDOFF, HANDOFF_FRAME_SIZE);
+    FIELD(Handoff, sequence, FRAME_HANDOFF, HANDOFF_FRAME_SIZE);
+}
+
+void testBatch() {
+    FIELD(Batch, count, FRAME_BATCH, BATCH_FRAME_SIZE);
+}
+
+void testCalibrate() {
+    FIELD(Calibrate, receiverId, FRAME_CALIBRATE, CALIBRATE_FRAME_SIZE);
+    FIELD(Calibrate, command, FRAME_CALIBRATE, CALIBRATE_FRAME_SIZE);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(testStateFields);
+    RUN_TEST(testStateBits);
+    RUN_TEST(testAppPacking);
+    RUN_TEST(testClock);
+    RUN_TEST(testScheduledState);
+    RUN_TEST(testPing);
+    RUN_TEST(testPong);
+    RUN_TEST(testClockQuery);
+    RUN_TEST(testClockReport);
+    RUN_TEST(testGeneration);
+    RUN_TEST(testRoundSchedule);
+    RUN_TEST(testRoundControl);
+    RUN_TEST(testHandoff);
+    RUN_TEST(testBatch);
+    RUN_TEST(testCalibrate);
+    return UNITY_END();
+}